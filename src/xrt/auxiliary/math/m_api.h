@@ -747,6 +747,97 @@ void
 math_pose_transform_point(const struct xrt_pose *transform, const struct xrt_vec3 *point, struct xrt_vec3 *out_point);
 
 
+/*
+ *
+ * Batch functions.
+ *
+ */
+
+/*!
+ * A structure of arrays of vectors, each member points to @p count floats
+ * where @p count is given to the batch function. Input arrays are only read.
+ *
+ * @see xrt_vec3
+ * @ingroup aux_math
+ */
+struct math_vec3_soa
+{
+	float *x;
+	float *y;
+	float *z;
+};
+
+/*!
+ * A structure of arrays of quaternions.
+ *
+ * @see xrt_quat
+ * @ingroup aux_math
+ */
+struct math_quat_soa
+{
+	float *x;
+	float *y;
+	float *z;
+	float *w;
+};
+
+/*!
+ * A structure of arrays of poses.
+ *
+ * @see xrt_pose
+ * @ingroup aux_math
+ */
+struct math_pose_soa
+{
+	struct math_quat_soa orientation;
+	struct math_vec3_soa position;
+};
+
+/*!
+ * Rotate @p count vectors, same as @ref math_quat_rotate_vec3 on each element
+ * but done several elements at a time with SIMD.
+ *
+ * OK if the result arrays are the same as the input arrays.
+ *
+ * @ingroup aux_math
+ */
+void
+math_quat_rotate_vec3_n(const struct math_quat_soa *left,
+                        const struct math_vec3_soa *right,
+                        struct math_vec3_soa *result,
+                        size_t count);
+
+/*!
+ * Apply @p count rigid-body transformations, same as @ref math_pose_transform
+ * on each element but done several elements at a time with SIMD.
+ *
+ * OK if the result arrays are the same as the input arrays.
+ *
+ * @ingroup aux_math
+ */
+void
+math_pose_transform_n(const struct math_pose_soa *transform,
+                      const struct math_pose_soa *pose,
+                      struct math_pose_soa *out_pose,
+                      size_t count);
+
+/*!
+ * Slerp @p count pairs of quaternions, each with its own @p t, same as
+ * @ref math_quat_slerp on each element but done several elements at a time
+ * with SIMD.
+ *
+ * OK if the result arrays are the same as the input arrays.
+ *
+ * @ingroup aux_math
+ */
+void
+math_quat_slerp_n(const struct math_quat_soa *left,
+                  const struct math_quat_soa *right,
+                  const float *t,
+                  struct math_quat_soa *result,
+                  size_t count);
+
+
 /*
  *
  * Inline functions.
@@ -937,3 +937,238 @@ math_pose_transform_point(const struct xrt_pose *transform, const struct xrt_vec
 
 	map_vec3(*out_point) = transform_point(*transform, *point);
 }
+
+
+/*
+ *
+ * Batch functions.
+ *
+ */
+
+namespace {
+
+/*!
+ * Elements done at a time, fixed size so that Eigen keeps the arrays in SIMD
+ * registers and uses packet math on them, what is left over is done with the
+ * single element functions.
+ */
+constexpr size_t kBatchSize = 16;
+
+using Batch = Eigen::Array<float, kBatchSize, 1>;
+
+struct Vec3Batch
+{
+	Batch x, y, z;
+};
+
+struct QuatBatch
+{
+	Batch x, y, z, w;
+};
+
+inline Batch
+load(const float *ptr, size_t i)
+{
+	return Eigen::Map<const Batch>(ptr + i);
+}
+
+inline void
+store(const Batch &b, float *ptr, size_t i)
+{
+	Eigen::Map<Batch>(ptr + i) = b;
+}
+
+inline Vec3Batch
+load(const math_vec3_soa &v, size_t i)
+{
+	return {load(v.x, i), load(v.y, i), load(v.z, i)};
+}
+
+inline QuatBatch
+load(const math_quat_soa &q, size_t i)
+{
+	return {load(q.x, i), load(q.y, i), load(q.z, i), load(q.w, i)};
+}
+
+inline void
+store(const Vec3Batch &v, const math_vec3_soa &out, size_t i)
+{
+	store(v.x, out.x, i);
+	store(v.y, out.y, i);
+	store(v.z, out.z, i);
+}
+
+inline void
+store(const QuatBatch &q, const math_quat_soa &out, size_t i)
+{
+	store(q.x, out.x, i);
+	store(q.y, out.y, i);
+	store(q.z, out.z, i);
+	store(q.w, out.w, i);
+}
+
+inline xrt_vec3
+get(const math_vec3_soa &v, size_t i)
+{
+	return {v.x[i], v.y[i], v.z[i]};
+}
+
+inline xrt_quat
+get(const math_quat_soa &q, size_t i)
+{
+	return {q.x[i], q.y[i], q.z[i], q.w[i]};
+}
+
+inline void
+set(const xrt_vec3 &v, const math_vec3_soa &out, size_t i)
+{
+	out.x[i] = v.x;
+	out.y[i] = v.y;
+	out.z[i] = v.z;
+}
+
+inline void
+set(const xrt_quat &q, const math_quat_soa &out, size_t i)
+{
+	out.x[i] = q.x;
+	out.y[i] = q.y;
+	out.z[i] = q.z;
+	out.w[i] = q.w;
+}
+
+//! Same as Eigen's `q * v`: `v + w * t + q.vec x t` where `t = 2 * (q.vec x v)`.
+inline Vec3Batch
+rotate(const QuatBatch &q, const Vec3Batch &v)
+{
+	Batch tx = 2.0f * (q.y * v.z - q.z * v.y);
+	Batch ty = 2.0f * (q.z * v.x - q.x * v.z);
+	Batch tz = 2.0f * (q.x * v.y - q.y * v.x);
+
+	return {
+	    v.x + q.w * tx + (q.y * tz - q.z * ty),
+	    v.y + q.w * ty + (q.z * tx - q.x * tz),
+	    v.z + q.w * tz + (q.x * ty - q.y * tx),
+	};
+}
+
+//! Same as Eigen's `l * r`.
+inline QuatBatch
+multiply(const QuatBatch &l, const QuatBatch &r)
+{
+	return {
+	    l.w * r.x + l.x * r.w + l.y * r.z - l.z * r.y,
+	    l.w * r.y + l.y * r.w + l.z * r.x - l.x * r.z,
+	    l.w * r.z + l.z * r.w + l.x * r.y - l.y * r.x,
+	    l.w * r.w - l.x * r.x - l.y * r.y - l.z * r.z,
+	};
+}
+
+//! Same as Eigen's `l.slerp(t, r)`, both branches are computed and selected per element.
+inline QuatBatch
+slerp(const QuatBatch &l, const QuatBatch &r, const Batch &t)
+{
+	const float one = 1.0f - Eigen::NumTraits<float>::epsilon();
+
+	Batch d = l.x * r.x + l.y * r.y + l.z * r.z + l.w * r.w;
+	Batch abs_d = d.abs();
+
+	// Clamped so the lanes that end up linear never see a NaN.
+	Batch theta = abs_d.min(one).acos();
+	Batch sin_theta = theta.sin();
+
+	Batch scale0 = (abs_d >= one).select(1.0f - t, ((1.0f - t) * theta).sin() / sin_theta);
+	Batch scale1 = (abs_d >= one).select(t, (t * theta).sin() / sin_theta);
+	scale1 = (d < 0.0f).select(-scale1, scale1);
+
+	return {
+	    scale0 * l.x + scale1 * r.x,
+	    scale0 * l.y + scale1 * r.y,
+	    scale0 * l.z + scale1 * r.z,
+	    scale0 * l.w + scale1 * r.w,
+	};
+}
+
+} // namespace
+
+extern "C" void
+math_quat_rotate_vec3_n(const struct math_quat_soa *left,
+                        const struct math_vec3_soa *right,
+                        struct math_vec3_soa *result,
+                        size_t count)
+{
+	assert(left != NULL);
+	assert(right != NULL);
+	assert(result != NULL);
+
+	size_t i = 0;
+	for (; i + kBatchSize <= count; i += kBatchSize) {
+		store(rotate(load(*left, i), load(*right, i)), *result, i);
+	}
+
+	for (; i < count; i++) {
+		xrt_quat q = get(*left, i);
+		xrt_vec3 v = get(*right, i);
+		math_quat_rotate_vec3(&q, &v, &v);
+		set(v, *result, i);
+	}
+}
+
+extern "C" void
+math_pose_transform_n(const struct math_pose_soa *transform,
+                      const struct math_pose_soa *pose,
+                      struct math_pose_soa *out_pose,
+                      size_t count)
+{
+	assert(transform != NULL);
+	assert(pose != NULL);
+	assert(out_pose != NULL);
+
+	size_t i = 0;
+	for (; i + kBatchSize <= count; i += kBatchSize) {
+		QuatBatch t_orientation = load(transform->orientation, i);
+		Vec3Batch t_position = load(transform->position, i);
+		QuatBatch p_orientation = load(pose->orientation, i);
+		Vec3Batch p_position = load(pose->position, i);
+
+		Vec3Batch position = rotate(t_orientation, p_position);
+		position.x += t_position.x;
+		position.y += t_position.y;
+		position.z += t_position.z;
+
+		store(multiply(t_orientation, p_orientation), out_pose->orientation, i);
+		store(position, out_pose->position, i);
+	}
+
+	for (; i < count; i++) {
+		xrt_pose t = {get(transform->orientation, i), get(transform->position, i)};
+		xrt_pose p = {get(pose->orientation, i), get(pose->position, i)};
+		math_pose_transform(&t, &p, &p);
+		set(p.orientation, out_pose->orientation, i);
+		set(p.position, out_pose->position, i);
+	}
+}
+
+extern "C" void
+math_quat_slerp_n(const struct math_quat_soa *left,
+                  const struct math_quat_soa *right,
+                  const float *t,
+                  struct math_quat_soa *result,
+                  size_t count)
+{
+	assert(left != NULL);
+	assert(right != NULL);
+	assert(t != NULL || count == 0);
+	assert(result != NULL);
+
+	size_t i = 0;
+	for (; i + kBatchSize <= count; i += kBatchSize) {
+		store(slerp(load(*left, i), load(*right, i), load(t, i)), *result, i);
+	}
+
+	for (; i < count; i++) {
+		xrt_quat l = get(*left, i);
+		xrt_quat r = get(*right, i);
+		math_quat_slerp(&l, &r, t[i], &l);
+		set(l, *result, i);
+	}
+}
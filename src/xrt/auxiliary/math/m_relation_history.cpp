@@ -30,6 +30,8 @@
 #include <stdint.h>
 #include <assert.h>
 #include <mutex>
+#include <atomic>
+#include <thread>
 
 using namespace xrt::auxiliary::util;
 namespace os = xrt::auxiliary::os;
@@ -42,12 +44,245 @@ struct relation_history_entry
 
 static constexpr size_t BufLen = 4096;
 
+/*!
+ * The history is protected by a sequence lock: writers are serialized by
+ * @ref write_mutex and bump @ref seq to an odd value while they modify the
+ * buffer, readers never take any lock and instead copy what they need out of
+ * the buffer and retry if @ref seq changed underneath them.
+ *
+ * All of the reads done inside of a read section go through the bounds
+ * checked accessors of @ref HistoryBuffer, so a torn read can at worst give
+ * us garbage values that are then thrown away, never an out of bounds access.
+ */
 struct m_relation_history
 {
 	HistoryBuffer<struct relation_history_entry, BufLen> impl;
-	mutable os::Mutex mutex;
+
+	//! Serializes writers against each other, readers never touch it.
+	os::Mutex write_mutex;
+
+	//! Sequence counter, odd while a write is in progress.
+	std::atomic<uint64_t> seq{0};
+};
+
+
+/*
+ *
+ * Seqlock helpers.
+ *
+ */
+
+/*!
+ * Must be called with the write mutex held.
+ */
+static inline void
+write_begin(struct m_relation_history *rh)
+{
+	uint64_t s = rh->seq.load(std::memory_order_relaxed);
+	rh->seq.store(s + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+}
+
+/*!
+ * Must be called with the write mutex held.
+ */
+static inline void
+write_end(struct m_relation_history *rh)
+{
+	uint64_t s = rh->seq.load(std::memory_order_relaxed);
+	rh->seq.store(s + 1, std::memory_order_release);
+}
+
+/*!
+ * Runs @p func in a read section until it has observed a consistent view of
+ * the history, @p func must only copy data out of the buffer and return false
+ * if what it read did not make sense (which means it raced with a writer).
+ */
+template <typename Func>
+static inline void
+read_consistent(const struct m_relation_history *rh, Func &&func)
+{
+	uint32_t spins = 0;
+
+	while (true) {
+		uint64_t before = rh->seq.load(std::memory_order_acquire);
+		if ((before & 1) == 0) {
+			bool ok = func();
+
+			std::atomic_thread_fence(std::memory_order_acquire);
+			uint64_t after = rh->seq.load(std::memory_order_relaxed);
+			if (ok && before == after) {
+				return;
+			}
+		}
+
+		// Writers only hold the sequence odd for a copy, so this is rare.
+		if (++spins > 64) {
+			std::this_thread::yield();
+			spins = 0;
+		}
+	}
+}
+
+/*!
+ * What a read section copies out of the buffer for @ref m_relation_history_get,
+ * everything else is computed from this copy outside of the read section.
+ */
+struct history_bracket
+{
+	//! Number of entries in the buffer.
+	size_t count;
+
+	//! Index of the first entry not less than the requested timestamp.
+	size_t index;
+
+	//! Entry at index - 1, valid if index > 0.
+	struct relation_history_entry lower;
+
+	//! Entry at index, valid if index < count.
+	struct relation_history_entry upper;
 };
 
+static bool
+read_bracket(const struct m_relation_history *rh, uint64_t at_timestamp_ns, struct history_bracket &out)
+{
+	out.count = rh->impl.size();
+	if (out.count == 0) {
+		return true;
+	}
+
+	// Find the first element *not less than* our value.
+	size_t first = 0;
+	size_t len = out.count;
+	while (len > 0) {
+		size_t half = len / 2;
+		const relation_history_entry *e = rh->impl.get_at_index(first + half);
+		if (e == nullptr) {
+			// Buffer shrunk, we raced with a clear.
+			return false;
+		}
+		if (e->timestamp < at_timestamp_ns) {
+			first += half + 1;
+			len -= half + 1;
+		} else {
+			len = half;
+		}
+	}
+	out.index = first;
+
+	if (first > 0) {
+		const relation_history_entry *e = rh->impl.get_at_index(first - 1);
+		if (e == nullptr) {
+			return false;
+		}
+		out.lower = *e;
+	}
+
+	if (first < out.count) {
+		const relation_history_entry *e = rh->impl.get_at_index(first);
+		if (e == nullptr) {
+			return false;
+		}
+		out.upper = *e;
+	}
+
+	return true;
+}
+
+
+/*!
+ * Interpolates or extrapolates from what was copied out of the history.
+ */
+static enum m_relation_history_result
+resolve_bracket(const struct history_bracket &bracket,
+                uint64_t at_timestamp_ns,
+                struct xrt_space_relation *out_relation)
+{
+	if (bracket.count == 0) {
+		// Do nothing. You push nothing to the buffer you get nothing from the buffer.
+		*out_relation = {};
+		return M_RELATION_HISTORY_RESULT_INVALID;
+	}
+
+	if (bracket.index == bracket.count) {
+		// lower bound is at the end:
+		// The desired timestamp is after what our buffer contains.
+		// (pose-prediction)
+		// Output flags match the most recent buffer entry.
+		const auto &back = bracket.lower;
+		int64_t diff_prediction_ns = static_cast<int64_t>(at_timestamp_ns) - back.timestamp;
+		double delta_s = time_ns_to_s(diff_prediction_ns);
+
+		U_LOG_T("Extrapolating %f s past the back of the buffer!", delta_s);
+
+		m_predict_relation(&back.relation, delta_s, out_relation);
+		return M_RELATION_HISTORY_RESULT_PREDICTED;
+	}
+	if (at_timestamp_ns == bracket.upper.timestamp) {
+		// exact match:
+		// Flags copied directly along with everything else.
+		U_LOG_T("Exact match in the buffer!");
+		*out_relation = bracket.upper.relation;
+		return M_RELATION_HISTORY_RESULT_EXACT;
+	}
+	if (bracket.index == 0) {
+		// lower bound is at the beginning (and it's not an exact match):
+		// The desired timestamp is before what our buffer contains.
+		// (an edge case where somebody asks for a really old pose and we do our best)
+		// Output flags are the same as the input flags for the history entry we use
+		const auto &front = bracket.upper;
+		int64_t diff_prediction_ns = static_cast<int64_t>(at_timestamp_ns) - front.timestamp;
+		double delta_s = time_ns_to_s(diff_prediction_ns);
+		U_LOG_T("Extrapolating %f s before the front of the buffer!", delta_s);
+		m_predict_relation(&front.relation, delta_s, out_relation);
+		return M_RELATION_HISTORY_RESULT_REVERSE_PREDICTED;
+	}
+	U_LOG_T("Interpolating within buffer!");
+
+	// We precede upper and follow lower (which we know exists because we already handled
+	// the index == 0 case)
+	const auto &predecessor = bracket.lower;
+	const auto &successor = bracket.upper;
+
+	// Do the thing.
+	int64_t diff_before = static_cast<int64_t>(at_timestamp_ns) - predecessor.timestamp;
+	int64_t diff_after = static_cast<int64_t>(successor.timestamp) - at_timestamp_ns;
+
+	float amount_to_lerp = (float)diff_before / (float)(diff_before + diff_after);
+
+	// Copy intersection of relation flags
+	xrt_space_relation result{};
+	result.relation_flags = (enum xrt_space_relation_flags)(predecessor.relation.relation_flags &
+	                                                        successor.relation.relation_flags);
+	// First-order implementation - lerp between the before and after
+	if (0 != (result.relation_flags & XRT_SPACE_RELATION_POSITION_VALID_BIT)) {
+		result.pose.position =
+		    m_vec3_lerp(predecessor.relation.pose.position, successor.relation.pose.position, amount_to_lerp);
+	}
+	if (0 != (result.relation_flags & XRT_SPACE_RELATION_ORIENTATION_VALID_BIT)) {
+
+		math_quat_slerp(&predecessor.relation.pose.orientation, &successor.relation.pose.orientation,
+		                amount_to_lerp, &result.pose.orientation);
+	}
+
+	//! @todo Does interpolating the velocities make any sense?
+	if (0 != (result.relation_flags & XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT)) {
+		result.angular_velocity = m_vec3_lerp(predecessor.relation.angular_velocity,
+		                                      successor.relation.angular_velocity, amount_to_lerp);
+	}
+	if (0 != (result.relation_flags & XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT)) {
+		result.linear_velocity = m_vec3_lerp(predecessor.relation.linear_velocity,
+		                                     successor.relation.linear_velocity, amount_to_lerp);
+	}
+	*out_relation = result;
+	return M_RELATION_HISTORY_RESULT_INTERPOLATED;
+}
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
 
 void
 m_relation_history_create(struct m_relation_history **rh_ptr)
@@ -64,14 +299,16 @@ m_relation_history_push(struct m_relation_history *rh, struct xrt_space_relation
 	rhe.relation = *in_relation;
 	rhe.timestamp = timestamp;
 	bool ret = false;
-	std::unique_lock<os::Mutex> lock(rh->mutex);
+	std::unique_lock<os::Mutex> lock(rh->write_mutex);
 	try {
 		// if we aren't empty, we can compare against the latest timestamp.
 		if (rh->impl.empty() || rhe.timestamp > rh->impl.back().timestamp) {
 			// Everything explodes if the timestamps in relation_history aren't monotonically increasing. If
 			// we get a timestamp that's before the most recent timestamp in the buffer, don't put it
 			// in the history.
+			write_begin(rh);
 			rh->impl.push_back(rhe);
+			write_end(rh);
 			ret = true;
 		}
 	} catch (std::exception const &e) {
@@ -86,98 +323,44 @@ m_relation_history_get(const struct m_relation_history *rh,
                        struct xrt_space_relation *out_relation)
 {
 	XRT_TRACE_MARKER();
-	std::unique_lock<os::Mutex> lock(rh->mutex);
-	try {
-		if (rh->impl.empty() || at_timestamp_ns == 0) {
-			// Do nothing. You push nothing to the buffer you get nothing from the buffer.
-			*out_relation = {};
-			return M_RELATION_HISTORY_RESULT_INVALID;
-		}
-		const auto b = rh->impl.begin();
-		const auto e = rh->impl.end();
-
-		// Find the first element *not less than* our value. the lambda we pass is the comparison
-		// function, to compare against timestamps.
-		const auto it =
-		    std::lower_bound(b, e, at_timestamp_ns, [](const relation_history_entry &rhe, uint64_t timestamp) {
-			    return rhe.timestamp < timestamp;
-		    });
-
-		if (it == e) {
-			// lower bound is at the end:
-			// The desired timestamp is after what our buffer contains.
-			// (pose-prediction)
-			// Output flags match the most recent buffer entry.
-			int64_t diff_prediction_ns = static_cast<int64_t>(at_timestamp_ns) - rh->impl.back().timestamp;
-			double delta_s = time_ns_to_s(diff_prediction_ns);
-
-			U_LOG_T("Extrapolating %f s past the back of the buffer!", delta_s);
-
-			m_predict_relation(&rh->impl.back().relation, delta_s, out_relation);
-			return M_RELATION_HISTORY_RESULT_PREDICTED;
-		}
-		if (at_timestamp_ns == it->timestamp) {
-			// exact match:
-			// Flags copied directly along with everything else.
-			U_LOG_T("Exact match in the buffer!");
-			*out_relation = it->relation;
-			return M_RELATION_HISTORY_RESULT_EXACT;
-		}
-		if (it == b) {
-			// lower bound is at the beginning (and it's not an exact match):
-			// The desired timestamp is before what our buffer contains.
-			// (an edge case where somebody asks for a really old pose and we do our best)
-			// Output flags are the same as the input flags for the history entry we use
-			int64_t diff_prediction_ns = static_cast<int64_t>(at_timestamp_ns) - rh->impl.front().timestamp;
-			double delta_s = time_ns_to_s(diff_prediction_ns);
-			U_LOG_T("Extrapolating %f s before the front of the buffer!", delta_s);
-			m_predict_relation(&rh->impl.front().relation, delta_s, out_relation);
-			return M_RELATION_HISTORY_RESULT_REVERSE_PREDICTED;
-		}
-		U_LOG_T("Interpolating within buffer!");
-
-		// We precede *it and follow *(it - 1) (which we know exists because we already handled
-		// the it = begin() case)
-		const auto &predecessor = *(it - 1);
-		const auto &successor = *it;
-
-		// Do the thing.
-		int64_t diff_before = static_cast<int64_t>(at_timestamp_ns) - predecessor.timestamp;
-		int64_t diff_after = static_cast<int64_t>(successor.timestamp) - at_timestamp_ns;
-
-		float amount_to_lerp = (float)diff_before / (float)(diff_before + diff_after);
-
-		// Copy intersection of relation flags
-		xrt_space_relation result{};
-		result.relation_flags = (enum xrt_space_relation_flags)(predecessor.relation.relation_flags &
-		                                                        successor.relation.relation_flags);
-		// First-order implementation - lerp between the before and after
-		if (0 != (result.relation_flags & XRT_SPACE_RELATION_POSITION_VALID_BIT)) {
-			result.pose.position = m_vec3_lerp(predecessor.relation.pose.position,
-			                                   successor.relation.pose.position, amount_to_lerp);
-		}
-		if (0 != (result.relation_flags & XRT_SPACE_RELATION_ORIENTATION_VALID_BIT)) {
 
-			math_quat_slerp(&predecessor.relation.pose.orientation, &successor.relation.pose.orientation,
-			                amount_to_lerp, &result.pose.orientation);
-		}
+	if (at_timestamp_ns == 0) {
+		*out_relation = {};
+		return M_RELATION_HISTORY_RESULT_INVALID;
+	}
 
-		//! @todo Does interpolating the velocities make any sense?
-		if (0 != (result.relation_flags & XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT)) {
-			result.angular_velocity = m_vec3_lerp(predecessor.relation.angular_velocity,
-			                                      successor.relation.angular_velocity, amount_to_lerp);
-		}
-		if (0 != (result.relation_flags & XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT)) {
-			result.linear_velocity = m_vec3_lerp(predecessor.relation.linear_velocity,
-			                                     successor.relation.linear_velocity, amount_to_lerp);
-		}
-		*out_relation = result;
-		return M_RELATION_HISTORY_RESULT_INTERPOLATED;
+	struct history_bracket bracket = {};
+	read_consistent(rh, [&] { return read_bracket(rh, at_timestamp_ns, bracket); });
 
-	} catch (std::exception const &e) {
-		U_LOG_E("Caught exception: %s", e.what());
+	return resolve_bracket(bracket, at_timestamp_ns, out_relation);
+}
+
+enum m_relation_history_result
+m_relation_history_resolve(const struct xrt_space_relation *relations,
+                           const uint64_t *timestamps,
+                           uint32_t count,
+                           uint64_t at_timestamp_ns,
+                           struct xrt_space_relation *out_relation)
+{
+	if (at_timestamp_ns == 0) {
+		*out_relation = {};
 		return M_RELATION_HISTORY_RESULT_INVALID;
 	}
+
+	struct history_bracket bracket = {};
+	bracket.count = count;
+	bracket.index = std::lower_bound(timestamps, timestamps + count, at_timestamp_ns) - timestamps;
+
+	if (bracket.index > 0) {
+		bracket.lower.relation = relations[bracket.index - 1];
+		bracket.lower.timestamp = timestamps[bracket.index - 1];
+	}
+	if (bracket.index < count) {
+		bracket.upper.relation = relations[bracket.index];
+		bracket.upper.timestamp = timestamps[bracket.index];
+	}
+
+	return resolve_bracket(bracket, at_timestamp_ns, out_relation);
 }
 
 bool
@@ -232,27 +415,44 @@ m_relation_history_get_latest(const struct m_relation_history *rh,
                               uint64_t *out_time_ns,
                               struct xrt_space_relation *out_relation)
 {
-	std::unique_lock<os::Mutex> lock(rh->mutex);
-	if (rh->impl.empty()) {
+	bool have = false;
+	struct relation_history_entry latest = {};
+
+	read_consistent(rh, [&] {
+		const relation_history_entry *e = rh->impl.get_at_age(0);
+		have = e != nullptr;
+		if (have) {
+			latest = *e;
+		}
+		return true;
+	});
+
+	if (!have) {
 		return false;
 	}
-	*out_relation = rh->impl.back().relation;
-	*out_time_ns = rh->impl.back().timestamp;
+	*out_relation = latest.relation;
+	*out_time_ns = latest.timestamp;
 	return true;
 }
 
 uint32_t
 m_relation_history_get_size(const struct m_relation_history *rh)
 {
-	std::unique_lock<os::Mutex> lock(rh->mutex);
-	return (uint32_t)rh->impl.size();
+	size_t size = 0;
+	read_consistent(rh, [&] {
+		size = rh->impl.size();
+		return true;
+	});
+	return (uint32_t)size;
 }
 
 void
 m_relation_history_clear(struct m_relation_history *rh)
 {
-	std::unique_lock<os::Mutex> lock(rh->mutex);
+	std::unique_lock<os::Mutex> lock(rh->write_mutex);
+	write_begin(rh);
 	rh->impl.clear();
+	write_end(rh);
 }
 
 void
@@ -22,7 +22,8 @@ extern "C" {
  *
  * @note Unlike the bare C++ data structure @ref HistoryBuffer this wraps, **this is a thread safe interface**,
  * and is safe for concurrent access from multiple threads.
- * (It is using a simple mutex, not a reader/writer lock, but that is fine until proven to be a bottleneck.)
+ * Writers are serialized with a mutex, readers use a sequence lock and never block the writer (or each other),
+ * they will only retry if a write happened while they were reading.
  *
  * @ingroup aux_util
  */
@@ -77,6 +78,24 @@ m_relation_history_get(const struct m_relation_history *rh,
                        uint64_t at_timestamp_ns,
                        struct xrt_space_relation *out_relation);
 
+/*!
+ * Interpolates or extrapolates to the desired timestamp from a plain array of
+ * relations, using exactly the same logic as @ref m_relation_history_get. Used
+ * by code that keeps its own copy of a history, like the IPC shared memory.
+ *
+ * @param relations  Relations, oldest first.
+ * @param timestamps Timestamps of the relations, strictly increasing.
+ * @param count      Number of entries in both arrays.
+ *
+ * @relates m_relation_history
+ */
+enum m_relation_history_result
+m_relation_history_resolve(const struct xrt_space_relation *relations,
+                           const uint64_t *timestamps,
+                           uint32_t count,
+                           uint64_t at_timestamp_ns,
+                           struct xrt_space_relation *out_relation);
+
 /*!
  * Estimates the movement (velocity and angular velocity) of a new relation based on
  * the latest relation found in the buffer (as returned by m_relation_history_get_latest).
@@ -0,0 +1,42 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Functions for evaluating tracked trajectories against groundtruth.
+ * @ingroup aux_math
+ */
+
+#include "math/m_trajectory.h"
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <cmath>
+
+
+using PointsMap = Eigen::Map<const Eigen::Matrix<double, 3, Eigen::Dynamic>>;
+
+static_assert(sizeof(struct xrt_vec3_f64) == sizeof(double) * 3, "Must be tightly packed");
+
+extern "C" bool
+m_trajectory_ate_rmse(const struct xrt_vec3_f64 *estimate,
+                      const struct xrt_vec3_f64 *reference,
+                      size_t count,
+                      double *out_rmse)
+{
+	if (count < 3) {
+		return false;
+	}
+
+	PointsMap est(&estimate->x, 3, (Eigen::Index)count);
+	PointsMap ref(&reference->x, 3, (Eigen::Index)count);
+
+	// Least squares rigid alignment, the closed form by Umeyama.
+	Eigen::Matrix4d transform = Eigen::umeyama(est, ref, false);
+
+	Eigen::Matrix3Xd aligned = (transform.topLeftCorner<3, 3>() * est).colwise() + transform.topRightCorner<3, 1>();
+
+	*out_rmse = std::sqrt((aligned - ref).colwise().squaredNorm().mean());
+
+	return true;
+}
@@ -0,0 +1,45 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Functions for evaluating tracked trajectories against groundtruth.
+ * @ingroup aux_math
+ */
+
+#pragma once
+
+#include "xrt/xrt_defines.h"
+
+#include <stddef.h>
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*!
+ * Absolute trajectory error, the RMSE of the distance between matching
+ * positions after @p estimate has been aligned onto @p reference with the
+ * rigid transform (rotation and translation, no scale) that fits them best.
+ * This is what the usual SLAM evaluation scripts report as ATE.
+ *
+ * @param estimate   Tracked positions.
+ * @param reference  Groundtruth positions at the same timestamps.
+ * @param count      Number of positions in both arrays, at least 3.
+ * @param[out] out_rmse  Error in the same unit as the positions.
+ *
+ * @return false if there are too few positions.
+ *
+ * @ingroup aux_math
+ */
+bool
+m_trajectory_ate_rmse(const struct xrt_vec3_f64 *estimate,
+                      const struct xrt_vec3_f64 *reference,
+                      size_t count,
+                      double *out_rmse);
+
+
+#ifdef __cplusplus
+}
+#endif
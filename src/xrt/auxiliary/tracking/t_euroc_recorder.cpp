@@ -13,11 +13,14 @@
 #include "util/u_frame.h"
 #include "util/u_sink.h"
 #include "util/u_var.h"
+#include "util/u_time.h"
 #include "util/u_debug.h"
+#include "util/u_worker.h"
 #include "xrt/xrt_defines.h"
 #include "xrt/xrt_tracking.h"
 
 #include <cassert>
+#include <condition_variable>
 #include <ctime>
 #include <filesystem>
 #include <fstream>
@@ -29,13 +32,18 @@
 #include <opencv2/imgcodecs.hpp>
 
 DEBUG_GET_ONCE_BOOL_OPTION(euroc_recorder_use_jpg, "EUROC_RECORDER_USE_JPG", false)
+DEBUG_GET_ONCE_BOOL_OPTION(euroc_recorder_defer_compression, "EUROC_RECORDER_DEFER_COMPRESSION", false)
+DEBUG_GET_ONCE_NUM_OPTION(euroc_recorder_encode_threads, "EUROC_RECORDER_ENCODE_THREADS", 4)
+DEBUG_GET_ONCE_NUM_OPTION(euroc_recorder_max_pending, "EUROC_RECORDER_MAX_PENDING_FRAMES", 32)
 
+using std::condition_variable;
 using std::lock_guard;
 using std::mutex;
 using std::ofstream;
 using std::queue;
 using std::string;
 using std::to_string;
+using std::unique_lock;
 using std::vector;
 using std::filesystem::create_directories;
 
@@ -69,6 +77,30 @@ struct euroc_recorder
 	queue<xrt_pose_sample> gt_queue{}; //!< GT pushes get saved here and are delayed until left_frame pushes
 	mutex gt_queue_lock{};             //!< Lock for gt_queue
 
+	// Encoder pool: writer sinks hand frames over to it so image compression
+	// doesn't hold up the camera queues. Null if encoding synchronously.
+	struct u_worker_thread_pool *encode_pool = nullptr;
+	struct u_worker_group *encode_group = nullptr;
+
+	bool defer_compression; //!< Write PNGs uncompressed, recompress them after stopping
+	int max_pending;        //!< Max frames handed to the encoder pool and not yet written
+
+	int pending = 0;                 //!< Frames handed to the encoder pool and not yet written
+	mutex pending_lock{};            //!< Lock for pending and stats
+	condition_variable pending_cv{}; //!< Signaled when pending goes down
+	vector<string> deferred_paths{}; //!< Uncompressed PNGs of the current recording
+	mutex deferred_lock{};           //!< Lock for deferred_paths
+
+	//! Backpressure stats, shown in the UI.
+	struct
+	{
+		uint64_t encoded;        //!< Frames written to disk
+		uint64_t max_pending;    //!< Highest number of pending frames seen
+		uint64_t stall_count;    //!< Times a writer sink had to wait for the encoders
+		uint64_t stall_total_ms; //!< Total time writer sinks waited for the encoders
+		uint64_t recompressed;   //!< Deferred PNGs that have been compressed
+	} stats = {};
+
 	// CSV file handles, ofstream implementation is already buffered.
 	// Using pointers because of `container_of`
 	ofstream *imu_csv = nullptr;
@@ -181,21 +213,139 @@ euroc_recorder_save_gt(xrt_pose_sink *sink, struct xrt_pose_sample *sample)
 	*er->gt_csv << o.w << "," << o.x << "," << o.y << "," << o.z << CSV_EOL;
 }
 
+/*!
+ * A frame handed over to the encoder pool.
+ */
+struct euroc_encode_task
+{
+	euroc_recorder *er;
+	struct xrt_frame *frame; //!< Holds a reference
+	string img_path;
+};
+
+/*!
+ * A file written uncompressed that is to be compressed after recording.
+ */
+struct euroc_recompress_task
+{
+	euroc_recorder *er;
+	string img_path;
+};
+
+static void
+euroc_recorder_write_image(euroc_recorder *er, struct xrt_frame *frame, const string &img_path)
+{
+	assert(frame->format == XRT_FORMAT_L8 || frame->format == XRT_FORMAT_R8G8B8); // Only formats supported
+	auto img_type = frame->format == XRT_FORMAT_L8 ? CV_8UC1 : CV_8UC3;
+	cv::Mat img{(int)frame->height, (int)frame->width, img_type, frame->data, frame->stride};
+
+	if (er->defer_compression && !er->use_jpg) {
+		// zlib level 0 is a plain copy, the file gets compressed later.
+		cv::imwrite(img_path, img, {cv::IMWRITE_PNG_COMPRESSION, 0});
+
+		lock_guard lock{er->deferred_lock};
+		er->deferred_paths.push_back(img_path);
+	} else {
+		cv::imwrite(img_path, img);
+	}
+}
+
+static void
+euroc_recorder_encode_task(void *ptr)
+{
+	euroc_encode_task *task = (euroc_encode_task *)ptr;
+	euroc_recorder *er = task->er;
+
+	euroc_recorder_write_image(er, task->frame, task->img_path);
+	xrt_frame_reference(&task->frame, NULL);
+	delete task;
+
+	{
+		lock_guard lock{er->pending_lock};
+		er->pending--;
+		er->stats.encoded++;
+	}
+	er->pending_cv.notify_all();
+}
+
+static void
+euroc_recorder_recompress_task(void *ptr)
+{
+	euroc_recompress_task *task = (euroc_recompress_task *)ptr;
+
+	cv::Mat img = cv::imread(task->img_path, cv::IMREAD_UNCHANGED);
+	if (!img.empty()) {
+		cv::imwrite(task->img_path, img);
+	}
+
+	{
+		lock_guard lock{task->er->pending_lock};
+		task->er->stats.recompressed++;
+	}
+
+	delete task;
+}
+
+/*!
+ * Hands all uncompressed PNGs written so far over to the encoder pool, doesn't
+ * wait for them to be compressed.
+ */
+static void
+euroc_recorder_compress_deferred(euroc_recorder *er)
+{
+	vector<string> paths;
+	{
+		lock_guard lock{er->deferred_lock};
+		paths.swap(er->deferred_paths);
+	}
+
+	for (string &path : paths) {
+		euroc_recompress_task *task = new euroc_recompress_task{er, path};
+		if (er->encode_group == nullptr) {
+			euroc_recorder_recompress_task(task);
+		} else {
+			u_worker_group_push(er->encode_group, euroc_recorder_recompress_task, task);
+		}
+	}
+}
+
 static void
 euroc_recorder_save_frame(euroc_recorder *er, struct xrt_frame *frame, int cam_index)
 {
 	string cam_name = "cam" + to_string(cam_index);
 	uint64_t ts = frame->timestamp;
 
-	assert(frame->format == XRT_FORMAT_L8 || frame->format == XRT_FORMAT_R8G8B8); // Only formats supported
-	auto img_type = frame->format == XRT_FORMAT_L8 ? CV_8UC1 : CV_8UC3;
 	string file_extension = er->use_jpg ? ".jpg" : ".png";
 	string filename = std::to_string(ts) + file_extension;
 	string img_path = er->path + "/mav0/" + cam_name + "/data/" + filename;
-	cv::Mat img{(int)frame->height, (int)frame->width, img_type, frame->data, frame->stride};
-	cv::imwrite(img_path, img);
 
 	*er->cams_csv[cam_index] << ts << "," << filename << CSV_EOL;
+
+	if (er->encode_group == nullptr) {
+		euroc_recorder_write_image(er, frame, img_path);
+
+		lock_guard lock{er->pending_lock};
+		er->stats.encoded++;
+		return;
+	}
+
+	// Backpressure: wait for the encoders if too many frames are in flight.
+	{
+		unique_lock lock{er->pending_lock};
+		if (er->pending >= er->max_pending) {
+			uint64_t start_ns = os_monotonic_get_ns();
+			er->pending_cv.wait(lock, [er] { return er->pending < er->max_pending; });
+			er->stats.stall_count++;
+			er->stats.stall_total_ms += (os_monotonic_get_ns() - start_ns) / U_TIME_1MS_IN_NS;
+		}
+
+		er->pending++;
+		er->stats.max_pending = std::max(er->stats.max_pending, (uint64_t)er->pending);
+	}
+
+	euroc_encode_task *task = new euroc_encode_task{er, nullptr, img_path};
+	xrt_frame_reference(&task->frame, frame);
+	u_worker_group_push(er->encode_group, euroc_recorder_encode_task, task);
 }
 
 #define DEFINE_SAVE_CAM(cam_id)                                                                                        \
@@ -322,6 +472,23 @@ extern "C" void
 euroc_recorder_node_destroy(struct xrt_frame_node *node)
 {
 	struct euroc_recorder *er = container_of(node, struct euroc_recorder, node);
+
+	// All writer queues have been broken apart, no more frames will arrive.
+	if (er->encode_group != nullptr) {
+		u_worker_group_wait_all(er->encode_group);
+	}
+
+	// Torn down while still recording, the PNGs still need compressing.
+	if (er->defer_compression) {
+		euroc_recorder_compress_deferred(er);
+	}
+
+	if (er->encode_group != nullptr) {
+		u_worker_group_wait_all(er->encode_group);
+		u_worker_group_reference(&er->encode_group, NULL);
+		u_worker_thread_pool_reference(&er->encode_pool, NULL);
+	}
+
 	delete er->imu_csv;
 	delete er->gt_csv;
 	for (int i = 0; i < er->cam_count; i++) {
@@ -352,6 +519,23 @@ euroc_recorder_create(struct xrt_frame_context *xfctx, const char *record_path,
 	xrt_frame_context_add(xfctx, xfn);
 
 	er->use_jpg = debug_get_bool_option_euroc_recorder_use_jpg();
+	er->defer_compression = debug_get_bool_option_euroc_recorder_defer_compression();
+	er->max_pending = std::max(1, (int)debug_get_num_option_euroc_recorder_max_pending());
+
+	// Zero threads means encoding on the writer queue threads like before.
+	int encode_threads = (int)debug_get_num_option_euroc_recorder_encode_threads();
+	if (encode_threads >= U_WORKER_THREAD_POOL_MAX_THREADS) {
+		U_LOG_W("EUROC_RECORDER_ENCODE_THREADS %d is too many, using %d", encode_threads,
+		        U_WORKER_THREAD_POOL_MAX_THREADS - 1);
+		encode_threads = U_WORKER_THREAD_POOL_MAX_THREADS - 1;
+	}
+	if (encode_threads > 0) {
+		// The extra thread count is for the stop and destroy paths that wait on the group.
+		er->encode_pool = u_worker_thread_pool_create(encode_threads, encode_threads + 1, "EuRoC Encoder");
+	}
+	if (er->encode_pool != nullptr) {
+		er->encode_group = u_worker_group_create(er->encode_pool);
+	}
 
 	// Setup sink pipeline
 
@@ -430,6 +614,15 @@ euroc_recorder_stop(struct xrt_slam_sinks *er_sinks)
 	er->path = "";
 	er->recording = false;
 	euroc_recorder_flush(er);
+
+	// PNGs still being encoded would otherwise miss the compression below.
+	if (er->encode_group != nullptr) {
+		u_worker_group_wait_all(er->encode_group);
+	}
+
+	if (er->defer_compression) {
+		euroc_recorder_compress_deferred(er);
+	}
 }
 
 static void
@@ -456,4 +649,15 @@ euroc_recorder_add_ui(struct xrt_slam_sinks *er_sinks, void *root, const char *p
 	char tmp[256];
 	(void)snprintf(tmp, sizeof(tmp), "%s%s", prefix, er->recording ? "Stop recording" : "Record EuRoC dataset");
 	u_var_add_button(root, &er->recording_btn, tmp);
+
+	(void)snprintf(tmp, sizeof(tmp), "%sEncoded frames", prefix);
+	u_var_add_ro_u64(root, &er->stats.encoded, tmp);
+	(void)snprintf(tmp, sizeof(tmp), "%sMax pending frames", prefix);
+	u_var_add_ro_u64(root, &er->stats.max_pending, tmp);
+	(void)snprintf(tmp, sizeof(tmp), "%sEncoder stalls", prefix);
+	u_var_add_ro_u64(root, &er->stats.stall_count, tmp);
+	(void)snprintf(tmp, sizeof(tmp), "%sEncoder stall time (ms)", prefix);
+	u_var_add_ro_u64(root, &er->stats.stall_total_ms, tmp);
+	(void)snprintf(tmp, sizeof(tmp), "%sRecompressed frames", prefix);
+	u_var_add_ro_u64(root, &er->stats.recompressed, tmp);
 }
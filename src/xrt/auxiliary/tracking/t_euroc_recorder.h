@@ -22,6 +22,9 @@ extern "C" {
 /*!
  * Create SLAM sinks to record samples in EuRoC format.
  *
+ * Images are encoded on a small worker pool, see the `EUROC_RECORDER_ENCODE_THREADS`,
+ * `EUROC_RECORDER_MAX_PENDING_FRAMES` and `EUROC_RECORDER_DEFER_COMPRESSION` options.
+ *
  * @param xfctx Frame context for the sinks.
  * @param record_path Directory name to save the dataset or NULL for a default based on the current datetime.
  * @param cam_count Number of cameras to record
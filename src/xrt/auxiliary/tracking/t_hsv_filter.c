@@ -11,8 +11,9 @@
 #include "util/u_misc.h"
 #include "util/u_sink.h"
 #include "util/u_debug.h"
-#include "util/u_frame.h"
+#include "util/u_frame_pool.h"
 #include "util/u_format.h"
+#include "util/u_worker.h"
 #include "util/u_trace_marker.h"
 
 #include "tracking/t_tracking.h"
@@ -20,6 +21,15 @@
 #include <stdio.h>
 #include <assert.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define T_HSV_FILTER_HAVE_X86
+#include <immintrin.h>
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(__ARM_NEON)
+#define T_HSV_FILTER_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
 
 #define MOD_180(v) ((uint32_t)(v) % 180)
 
@@ -124,6 +134,21 @@ t_hsv_build_optimized_table(struct t_hsv_filter_params *params, struct t_hsv_fil
 
 #define NUM_CHANNELS 4
 
+//! Stripes smaller than this are not worth handing to another thread.
+#define MIN_STRIPE_ROWS 32
+
+
+DEBUG_GET_ONCE_NUM_OPTION(hsv_filter_workers, "T_HSV_FILTER_WORKERS", 0)
+DEBUG_GET_ONCE_BOOL_OPTION(hsv_filter_scalar, "T_HSV_FILTER_SCALAR", false)
+
+/*!
+ * Converts one row of @p width pixels into the four mask planes.
+ */
+typedef void (*hsv_row_func_t)(const struct t_hsv_filter_optimized_table *t,
+                               const uint8_t *src,
+                               uint8_t *const dst[NUM_CHANNELS],
+                               uint32_t width);
+
 /*!
  * An @ref xrt_frame_sink that splits the input based on hue.
  * @implements xrt_frame_sink
@@ -141,123 +166,433 @@ struct t_hsv_filter
 
 	struct xrt_frame *frames[NUM_CHANNELS];
 
+	//! Recycles the output frames, recreated if the input size changes.
+	struct u_frame_pool *pool;
+
+	//! Number of row stripes a frame is split into, 0 or 1 filters on the pushing thread.
+	uint32_t worker_count;
+
+	//! Own pool, only created if @ref worker_count is above one.
+	struct u_worker_thread_pool *worker_pool;
+
+	struct u_worker_group *group;
+
+	//! Use the vector kernels, if the CPU supports them.
+	bool use_simd;
+
 	struct u_sink_debug usds[NUM_CHANNELS];
 
 	struct t_hsv_filter_optimized_table table;
+
+	//! The gathers read a whole dword, keep the last entries of the table in bounds.
+	uint8_t table_pad[4];
 };
 
+/*!
+ * A stripe of rows, or with @p rows unused the whole frame as the base the
+ * worker stripes are offset from.
+ */
+struct hsv_stripe
+{
+	const struct t_hsv_filter_optimized_table *table;
+	hsv_row_func_t func;
+
+	const uint8_t *src;
+	size_t src_stride;
+
+	uint8_t *dst[NUM_CHANNELS];
+	size_t dst_stride;
+
+	uint32_t width;
+	uint32_t rows;
+};
+
+
+/*
+ *
+ * Scalar row kernels.
+ *
+ */
+
 static void
-process_sample(struct t_hsv_filter *f,
-               uint8_t y,
-               uint8_t cb,
-               uint8_t cr,
-               uint8_t *dst0,
-               uint8_t *dst1,
-               uint8_t *dst2,
-               uint8_t *dst3)
+hsv_row_yuv_scalar(const struct t_hsv_filter_optimized_table *t,
+                   const uint8_t *src,
+                   uint8_t *const dst[NUM_CHANNELS],
+                   uint32_t width)
 {
-	uint8_t bits = t_hsv_filter_sample(&f->table, y, cb, cr);
-	uint8_t v0 = (bits & (1 << 0)) ? 0xff : 0x00;
-	uint8_t v1 = (bits & (1 << 1)) ? 0xff : 0x00;
-	uint8_t v2 = (bits & (1 << 2)) ? 0xff : 0x00;
-	uint8_t v3 = (bits & (1 << 3)) ? 0xff : 0x00;
-
-	*dst0 = v0;
-	*dst1 = v1;
-	*dst2 = v2;
-	*dst3 = v3;
+	uint8_t *dst0 = dst[0];
+	uint8_t *dst1 = dst[1];
+	uint8_t *dst2 = dst[2];
+	uint8_t *dst3 = dst[3];
+
+	for (uint32_t x = 0; x < width; x += 1) {
+		uint8_t y = src[0];
+		uint8_t cb = src[1];
+		uint8_t cr = src[2];
+		src += 3;
+
+		uint8_t bits = t->v[y / T_HSV_STEP][cb / T_HSV_STEP][cr / T_HSV_STEP];
+
+		*dst0++ = (bits & (1 << 0)) ? 0xff : 0x00;
+		*dst1++ = (bits & (1 << 1)) ? 0xff : 0x00;
+		*dst2++ = (bits & (1 << 2)) ? 0xff : 0x00;
+		*dst3++ = (bits & (1 << 3)) ? 0xff : 0x00;
+	}
 }
 
-XRT_NO_INLINE static void
-hsv_process_frame_yuv(struct t_hsv_filter *f, struct xrt_frame *xf)
+static void
+hsv_row_yuyv_scalar(const struct t_hsv_filter_optimized_table *t,
+                    const uint8_t *src,
+                    uint8_t *const dst[NUM_CHANNELS],
+                    uint32_t width)
 {
-	SINK_TRACE_MARKER();
+	uint8_t *dst0 = dst[0];
+	uint8_t *dst1 = dst[1];
+	uint8_t *dst2 = dst[2];
+	uint8_t *dst3 = dst[3];
+
+	for (uint32_t x = 0; x < width; x += 2) {
+		uint8_t y1 = src[0];
+		uint8_t cb = src[1];
+		uint8_t y2 = src[2];
+		uint8_t cr = src[3];
+		src += 4;
+
+		uint8_t bits0 = t->v[y1 / T_HSV_STEP][cb / T_HSV_STEP][cr / T_HSV_STEP];
+		uint8_t bits1 = t->v[y2 / T_HSV_STEP][cb / T_HSV_STEP][cr / T_HSV_STEP];
+
+		uint8_t v0 = (bits0 & (1 << 0)) ? 0xff : 0x00;
+		uint8_t v1 = (bits0 & (1 << 1)) ? 0xff : 0x00;
+		uint8_t v2 = (bits0 & (1 << 2)) ? 0xff : 0x00;
+		uint8_t v3 = (bits0 & (1 << 3)) ? 0xff : 0x00;
+		uint8_t v4 = (bits1 & (1 << 0)) ? 0xff : 0x00;
+		uint8_t v5 = (bits1 & (1 << 1)) ? 0xff : 0x00;
+		uint8_t v6 = (bits1 & (1 << 2)) ? 0xff : 0x00;
+		uint8_t v7 = (bits1 & (1 << 3)) ? 0xff : 0x00;
+
+		*(uint16_t *)dst0 = v0 | v4 << 8;
+		*(uint16_t *)dst1 = v1 | v5 << 8;
+		*(uint16_t *)dst2 = v2 | v6 << 8;
+		*(uint16_t *)dst3 = v3 | v7 << 8;
+
+		dst0 += 2;
+		dst1 += 2;
+		dst2 += 2;
+		dst3 += 2;
+	}
+}
+
+
+/*
+ *
+ * AVX2 row kernels.
+ *
+ * Eight pixels at a time: the Y, U and V of every pixel are shuffled into their
+ * own dword, turned into a table index and looked up with a gather. The table
+ * bits are then expanded into one mask byte per plane and transposed so each
+ * plane gets a single eight byte store.
+ *
+ */
+
+#ifdef T_HSV_FILTER_HAVE_X86
+
+TARGET_AVX2 static inline void
+hsv_avx2_lookup_store(const struct t_hsv_filter_optimized_table *t,
+                      __m256i y,
+                      __m256i u,
+                      __m256i v,
+                      uint8_t *const dst[NUM_CHANNELS],
+                      uint32_t x)
+{
+	// T_HSV_SIZE is 32, so the index is five bits from each component.
+	__m256i idx = _mm256_or_si256(_mm256_slli_epi32(_mm256_srli_epi32(y, 3), 10),
+	                              _mm256_or_si256(_mm256_slli_epi32(_mm256_srli_epi32(u, 3), 5),
+	                                              _mm256_srli_epi32(v, 3)));
+
+	__m256i bits = _mm256_i32gather_epi32((const int *)&t->v[0][0][0], idx, 1);
+
+	// Replicate the low byte of every dword and compare byte k against bit k.
+	const __m256i rep = _mm256_setr_epi8(0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12, //
+	                                     0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12);
+	const __m256i bit = _mm256_set1_epi32(0x08040201);
+	bits = _mm256_shuffle_epi8(bits, rep);
+	__m256i mask = _mm256_cmpeq_epi8(_mm256_and_si256(bits, bit), bit);
+
+	// Transpose 4x4 bytes in each lane, dword k of a lane is then plane k.
+	const __m256i transpose = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15, //
+	                                           0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+	mask = _mm256_shuffle_epi8(mask, transpose);
+	mask = _mm256_permutevar8x32_epi32(mask, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+
+	_mm_storel_epi64((__m128i *)(dst[0] + x), _mm256_castsi256_si128(mask));
+	_mm_storeh_pd((double *)(dst[1] + x), _mm_castsi128_pd(_mm256_castsi256_si128(mask)));
+	_mm_storel_epi64((__m128i *)(dst[2] + x), _mm256_extracti128_si256(mask, 1));
+	_mm_storeh_pd((double *)(dst[3] + x), _mm_castsi128_pd(_mm256_extracti128_si256(mask, 1)));
+}
+
+TARGET_AVX2 static void
+hsv_row_yuv_avx2(const struct t_hsv_filter_optimized_table *t,
+                 const uint8_t *src,
+                 uint8_t *const dst[NUM_CHANNELS],
+                 uint32_t width)
+{
+	// Low lane holds pixels 0-3 from bytes 0-11, high lane pixels 4-7 from bytes 12-23.
+	const __m256i shuf_y = _mm256_setr_epi8(0, -1, -1, -1, 3, -1, -1, -1, 6, -1, -1, -1, 9, -1, -1, -1, //
+	                                        4, -1, -1, -1, 7, -1, -1, -1, 10, -1, -1, -1, 13, -1, -1, -1);
+	const __m256i shuf_u = _mm256_setr_epi8(1, -1, -1, -1, 4, -1, -1, -1, 7, -1, -1, -1, 10, -1, -1, -1, //
+	                                        5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1, 14, -1, -1, -1);
+	const __m256i shuf_v = _mm256_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1, //
+	                                        6, -1, -1, -1, 9, -1, -1, -1, 12, -1, -1, -1, 15, -1, -1, -1);
+
+	uint32_t x = 0;
+	for (; x + 8 <= width; x += 8) {
+		const uint8_t *p = src + x * 3;
+		// Exactly 24 bytes, the high lane starts at byte 8 so pixel 4 is at offset 4.
+		__m256i in = _mm256_setr_m128i(_mm_loadu_si128((const __m128i *)p),
+		                               _mm_loadu_si128((const __m128i *)(p + 8)));
+
+		hsv_avx2_lookup_store(t, _mm256_shuffle_epi8(in, shuf_y), _mm256_shuffle_epi8(in, shuf_u),
+		                      _mm256_shuffle_epi8(in, shuf_v), dst, x);
+	}
+
+	if (x < width) {
+		uint8_t *const tail[NUM_CHANNELS] = {dst[0] + x, dst[1] + x, dst[2] + x, dst[3] + x};
+		hsv_row_yuv_scalar(t, src + x * 3, tail, width - x);
+	}
+}
+
+TARGET_AVX2 static void
+hsv_row_yuyv_avx2(const struct t_hsv_filter_optimized_table *t,
+                  const uint8_t *src,
+                  uint8_t *const dst[NUM_CHANNELS],
+                  uint32_t width)
+{
+	// Both lanes hold all 16 bytes, low lane takes pixels 0-3 and high lane 4-7.
+	const __m256i shuf_y = _mm256_setr_epi8(0, -1, -1, -1, 2, -1, -1, -1, 4, -1, -1, -1, 6, -1, -1, -1, //
+	                                        8, -1, -1, -1, 10, -1, -1, -1, 12, -1, -1, -1, 14, -1, -1, -1);
+	const __m256i shuf_u = _mm256_setr_epi8(1, -1, -1, -1, 1, -1, -1, -1, 5, -1, -1, -1, 5, -1, -1, -1, //
+	                                        9, -1, -1, -1, 9, -1, -1, -1, 13, -1, -1, -1, 13, -1, -1, -1);
+	const __m256i shuf_v = _mm256_setr_epi8(3, -1, -1, -1, 3, -1, -1, -1, 7, -1, -1, -1, 7, -1, -1, -1, //
+	                                        11, -1, -1, -1, 11, -1, -1, -1, 15, -1, -1, -1, 15, -1, -1, -1);
+
+	uint32_t x = 0;
+	for (; x + 8 <= width; x += 8) {
+		__m256i in = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(src + x * 2)));
+
+		hsv_avx2_lookup_store(t, _mm256_shuffle_epi8(in, shuf_y), _mm256_shuffle_epi8(in, shuf_u),
+		                      _mm256_shuffle_epi8(in, shuf_v), dst, x);
+	}
+
+	if (x < width) {
+		uint8_t *const tail[NUM_CHANNELS] = {dst[0] + x, dst[1] + x, dst[2] + x, dst[3] + x};
+		hsv_row_yuyv_scalar(t, src + x * 2, tail, width - x);
+	}
+}
+
+#endif // T_HSV_FILTER_HAVE_X86
+
+
+/*
+ *
+ * NEON row kernels.
+ *
+ * There is no gather, the lookups stay scalar but the expansion into the four
+ * planes and the stores are done eight pixels at a time.
+ *
+ */
+
+#ifdef T_HSV_FILTER_HAVE_NEON
+
+static inline void
+hsv_neon_expand_store(uint8x8_t bits, uint8_t *const dst[NUM_CHANNELS], uint32_t x)
+{
+	vst1_u8(dst[0] + x, vtst_u8(bits, vdup_n_u8(1 << 0)));
+	vst1_u8(dst[1] + x, vtst_u8(bits, vdup_n_u8(1 << 1)));
+	vst1_u8(dst[2] + x, vtst_u8(bits, vdup_n_u8(1 << 2)));
+	vst1_u8(dst[3] + x, vtst_u8(bits, vdup_n_u8(1 << 3)));
+}
+
+static void
+hsv_row_yuv_neon(const struct t_hsv_filter_optimized_table *t,
+                 const uint8_t *src,
+                 uint8_t *const dst[NUM_CHANNELS],
+                 uint32_t width)
+{
+	uint32_t x = 0;
+	for (; x + 8 <= width; x += 8) {
+		uint8_t bits[8];
+		for (uint32_t i = 0; i < 8; i++) {
+			const uint8_t *p = src + (x + i) * 3;
+			bits[i] = t->v[p[0] / T_HSV_STEP][p[1] / T_HSV_STEP][p[2] / T_HSV_STEP];
+		}
+		hsv_neon_expand_store(vld1_u8(bits), dst, x);
+	}
 
-	struct xrt_frame *f0 = f->frames[0];
-	struct xrt_frame *f1 = f->frames[1];
-	struct xrt_frame *f2 = f->frames[2];
-	struct xrt_frame *f3 = f->frames[3];
-
-	for (uint32_t y = 0; y < xf->height; y++) {
-		uint8_t *src = (uint8_t *)xf->data + y * xf->stride;
-		uint8_t *dst0 = f0->data + y * f0->stride;
-		uint8_t *dst1 = f1->data + y * f1->stride;
-		uint8_t *dst2 = f2->data + y * f2->stride;
-		uint8_t *dst3 = f3->data + y * f3->stride;
-
-		for (uint32_t x = 0; x < xf->width; x += 1) {
-			uint8_t y = src[0];
-			uint8_t cb = src[1];
-			uint8_t cr = src[2];
-			src += 3;
-
-			process_sample(f, y, cb, cr, dst0, dst1, dst2, dst3);
-			dst0 += 1;
-			dst1 += 1;
-			dst2 += 1;
-			dst3 += 1;
+	if (x < width) {
+		uint8_t *const tail[NUM_CHANNELS] = {dst[0] + x, dst[1] + x, dst[2] + x, dst[3] + x};
+		hsv_row_yuv_scalar(t, src + x * 3, tail, width - x);
+	}
+}
+
+static void
+hsv_row_yuyv_neon(const struct t_hsv_filter_optimized_table *t,
+                  const uint8_t *src,
+                  uint8_t *const dst[NUM_CHANNELS],
+                  uint32_t width)
+{
+	uint32_t x = 0;
+	for (; x + 8 <= width; x += 8) {
+		uint8_t bits[8];
+		for (uint32_t i = 0; i < 8; i += 2) {
+			const uint8_t *p = src + (x + i) * 2;
+			bits[i + 0] = t->v[p[0] / T_HSV_STEP][p[1] / T_HSV_STEP][p[3] / T_HSV_STEP];
+			bits[i + 1] = t->v[p[2] / T_HSV_STEP][p[1] / T_HSV_STEP][p[3] / T_HSV_STEP];
 		}
+		hsv_neon_expand_store(vld1_u8(bits), dst, x);
+	}
+
+	if (x < width) {
+		uint8_t *const tail[NUM_CHANNELS] = {dst[0] + x, dst[1] + x, dst[2] + x, dst[3] + x};
+		hsv_row_yuyv_scalar(t, src + x * 2, tail, width - x);
 	}
 }
 
+#endif // T_HSV_FILTER_HAVE_NEON
+
+
+/*
+ *
+ * Frame processing.
+ *
+ */
+
+static bool
+have_avx2(void)
+{
+#ifdef T_HSV_FILTER_HAVE_X86
+	return __builtin_cpu_supports("avx2");
+#else
+	return false;
+#endif
+}
+
+static hsv_row_func_t
+select_row_func(struct t_hsv_filter *f, enum xrt_format format)
+{
+	bool yuv = format == XRT_FORMAT_YUV888;
+
+#ifdef T_HSV_FILTER_HAVE_X86
+	if (f->use_simd && have_avx2()) {
+		return yuv ? hsv_row_yuv_avx2 : hsv_row_yuyv_avx2;
+	}
+#endif
+#ifdef T_HSV_FILTER_HAVE_NEON
+	if (f->use_simd) {
+		return yuv ? hsv_row_yuv_neon : hsv_row_yuyv_neon;
+	}
+#endif
+
+	return yuv ? hsv_row_yuv_scalar : hsv_row_yuyv_scalar;
+}
+
+static void
+process_stripe(const struct hsv_stripe *stripe)
+{
+	const uint8_t *src = stripe->src;
+	uint8_t *dst[NUM_CHANNELS] = {stripe->dst[0], stripe->dst[1], stripe->dst[2], stripe->dst[3]};
+
+	for (uint32_t y = 0; y < stripe->rows; y++) {
+		stripe->func(stripe->table, src, dst, stripe->width);
+
+		src += stripe->src_stride;
+		for (size_t i = 0; i < NUM_CHANNELS; i++) {
+			dst[i] += stripe->dst_stride;
+		}
+	}
+}
+
+static void
+process_rows(void *ptr, uint32_t first_row, uint32_t row_count)
+{
+	SINK_TRACE_IDENT(hsv_stripe);
+
+	const struct hsv_stripe *base = (const struct hsv_stripe *)ptr;
+
+	struct hsv_stripe stripe = *base;
+	stripe.src = base->src + (size_t)first_row * base->src_stride;
+	for (size_t i = 0; i < NUM_CHANNELS; i++) {
+		stripe.dst[i] = base->dst[i] + (size_t)first_row * base->dst_stride;
+	}
+	stripe.rows = row_count;
+
+	process_stripe(&stripe);
+}
+
 XRT_NO_INLINE static void
-hsv_process_frame_yuyv(struct t_hsv_filter *f, struct xrt_frame *xf)
+hsv_process_frame(struct t_hsv_filter *f, struct xrt_frame *xf)
 {
 	SINK_TRACE_MARKER();
 
-	struct xrt_frame *f0 = f->frames[0];
-	struct xrt_frame *f1 = f->frames[1];
-	struct xrt_frame *f2 = f->frames[2];
-	struct xrt_frame *f3 = f->frames[3];
-
-	for (uint32_t y = 0; y < xf->height; y++) {
-		uint8_t *src = (uint8_t *)xf->data + y * xf->stride;
-		uint8_t *dst0 = f0->data + y * f0->stride;
-		uint8_t *dst1 = f1->data + y * f1->stride;
-		uint8_t *dst2 = f2->data + y * f2->stride;
-		uint8_t *dst3 = f3->data + y * f3->stride;
-
-		for (uint32_t x = 0; x < xf->width; x += 2) {
-			uint8_t y1 = src[0];
-			uint8_t cb = src[1];
-			uint8_t y2 = src[2];
-			uint8_t cr = src[3];
-			src += 4;
-
-			uint8_t bits0 = t_hsv_filter_sample(&f->table, y1, cb, cr);
-			uint8_t bits1 = t_hsv_filter_sample(&f->table, y2, cb, cr);
-
-			uint8_t v0 = (bits0 & (1 << 0)) ? 0xff : 0x00;
-			uint8_t v1 = (bits0 & (1 << 1)) ? 0xff : 0x00;
-			uint8_t v2 = (bits0 & (1 << 2)) ? 0xff : 0x00;
-			uint8_t v3 = (bits0 & (1 << 3)) ? 0xff : 0x00;
-			uint8_t v4 = (bits1 & (1 << 0)) ? 0xff : 0x00;
-			uint8_t v5 = (bits1 & (1 << 1)) ? 0xff : 0x00;
-			uint8_t v6 = (bits1 & (1 << 2)) ? 0xff : 0x00;
-			uint8_t v7 = (bits1 & (1 << 3)) ? 0xff : 0x00;
-
-			*(uint16_t *)dst0 = v0 | v4 << 8;
-			*(uint16_t *)dst1 = v1 | v5 << 8;
-			*(uint16_t *)dst2 = v2 | v6 << 8;
-			*(uint16_t *)dst3 = v3 | v7 << 8;
-
-			dst0 += 2;
-			dst1 += 2;
-			dst2 += 2;
-			dst3 += 2;
-		}
+	// All of the frames come from the same pool.
+	size_t dst_stride = f->frames[0]->stride;
+
+	struct hsv_stripe base = {
+	    .table = &f->table,
+	    .func = select_row_func(f, xf->format),
+	    .src = xf->data,
+	    .src_stride = xf->stride,
+	    .dst = {f->frames[0]->data, f->frames[1]->data, f->frames[2]->data, f->frames[3]->data},
+	    .dst_stride = dst_stride,
+	    .width = xf->width,
+	    .rows = xf->height,
+	};
+
+	if (f->group == NULL) {
+		process_stripe(&base);
+		return;
 	}
+
+	u_worker_group_run_rows(f->group, xf->height, f->worker_count, MIN_STRIPE_ROWS, process_rows, &base);
 }
 
 static void
+set_worker_count(struct t_hsv_filter *f, uint32_t worker_count)
+{
+	u_worker_group_reference(&f->group, NULL);
+	u_worker_thread_pool_reference(&f->worker_pool, NULL);
+
+	f->worker_count = worker_count > U_WORKER_ROWS_MAX_STRIPES ? U_WORKER_ROWS_MAX_STRIPES : worker_count;
+	if (f->worker_count > 1) {
+		// The pushing thread counts as one, see u_worker_group_wait_all.
+		f->worker_pool = u_worker_thread_pool_create(f->worker_count - 1, f->worker_count, "HSV Filter");
+		f->group = u_worker_group_create(f->worker_pool);
+	}
+}
+
+static bool
 ensure_buf_allocated(struct t_hsv_filter *f, struct xrt_frame *xf)
 {
 	uint32_t w = xf->width;
 	uint32_t h = xf->height;
 
+	if (f->pool == NULL || !u_frame_pool_matches(f->pool, XRT_FORMAT_L8, w, h)) {
+		u_frame_pool_destroy(&f->pool);
+		f->pool = u_frame_pool_create(XRT_FORMAT_L8, w, h, NUM_CHANNELS * 4, "HSV Filter frame pool");
+		if (f->pool == NULL) {
+			return false;
+		}
+	}
+
 	for (size_t i = 0; i < NUM_CHANNELS; i++) {
-		u_frame_create_one_off(XRT_FORMAT_L8, w, h, &f->frames[i]);
+		if (!u_frame_pool_get(f->pool, &f->frames[i])) {
+			for (size_t k = 0; k < i; k++) {
+				xrt_frame_reference(&f->frames[k], NULL);
+			}
+			return false;
+		}
 	}
+
+	return true;
 }
 
 static void
@@ -290,12 +625,12 @@ hsv_frame(struct xrt_frame_sink *xsink, struct xrt_frame *xf)
 
 	switch (xf->format) {
 	case XRT_FORMAT_YUV888:
-		ensure_buf_allocated(f, xf);
-		hsv_process_frame_yuv(f, xf);
-		break;
 	case XRT_FORMAT_YUYV422:
-		ensure_buf_allocated(f, xf);
-		hsv_process_frame_yuyv(f, xf);
+		if (!ensure_buf_allocated(f, xf)) {
+			U_LOG_E("Could not allocate the filtered frames, dropping frame");
+			return;
+		}
+		hsv_process_frame(f, xf);
 		break;
 	default: U_LOG_E("Bad format '%s'", u_format_str(xf->format)); return;
 	}
@@ -321,6 +656,9 @@ hsv_destroy(struct xrt_frame_node *node)
 		u_sink_debug_destroy(&f->usds[i]);
 	}
 
+	set_worker_count(f, 0);
+	u_frame_pool_destroy(&f->pool);
+
 	free(f);
 }
 
@@ -340,6 +678,9 @@ t_hsv_filter_create(struct xrt_frame_context *xfctx,
 	f->sinks[2] = sinks[2];
 	f->sinks[3] = sinks[3];
 
+	f->use_simd = !debug_get_bool_option_hsv_filter_scalar();
+	set_worker_count(f, (uint32_t)debug_get_num_option_hsv_filter_workers());
+
 	t_hsv_build_optimized_table(&f->params, &f->table);
 
 	xrt_frame_context_add(xfctx, &f->node);
@@ -357,3 +698,18 @@ t_hsv_filter_create(struct xrt_frame_context *xfctx,
 
 	return 0;
 }
+
+bool
+t_hsv_filter_set_worker_count(struct xrt_frame_sink *xsink, uint32_t worker_count)
+{
+	if (xsink->push_frame != hsv_frame) {
+		U_LOG_E("Not a HSV filter sink");
+		return false;
+	}
+
+	struct t_hsv_filter *f = (struct t_hsv_filter *)xsink;
+
+	set_worker_count(f, worker_count);
+
+	return true;
+}
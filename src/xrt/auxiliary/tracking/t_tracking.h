@@ -546,6 +546,24 @@ t_hsv_filter_create(struct xrt_frame_context *xfctx,
                     struct xrt_frame_sink *sinks[4],
                     struct xrt_frame_sink **out_sink);
 
+/*!
+ * Split the filtering of each frame into @p worker_count row stripes run on a
+ * pool owned by the filter. Zero or one filters on the thread pushing the
+ * frame, which is the default unless the `T_HSV_FILTER_WORKERS` environment
+ * variable says otherwise. Setting `T_HSV_FILTER_SCALAR` disables the vector
+ * kernels.
+ *
+ * Must not be called while frames are being pushed to the sink.
+ *
+ * @param xsink        A sink created by @ref t_hsv_filter_create.
+ * @param worker_count Number of stripes, at most 16.
+ * @return False if @p xsink is not a HSV filter sink.
+ *
+ * @public @memberof t_hsv_filter
+ */
+bool
+t_hsv_filter_set_worker_count(struct xrt_frame_sink *xsink, uint32_t worker_count);
+
 
 /*
  *
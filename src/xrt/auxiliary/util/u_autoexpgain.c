@@ -38,7 +38,7 @@ DEBUG_GET_ONCE_LOG_OPTION(aeg_log, "AEG_LOG", U_LOGGING_WARN)
 	} while (false);
 #define AEG_ASSERT_(predicate) AEG_ASSERT(predicate, "Assertion failed " #predicate)
 
-#define LEVELS 256 //!< Possible pixel intensity values, only 8-bit supported
+#define LEVELS U_AUTOEXPGAIN_LEVELS //!< Possible pixel intensity values, only 8-bit supported
 #define INITIAL_BRIGHTNESS 0.5
 #define INITIAL_MAX_BRIGHTNESS_STEP 0.1
 #define INITIAL_THRESHOLD 0.1
@@ -318,18 +318,15 @@ update_expgain(struct u_autoexpgain *aeg)
 	brightness_to_expgain(aeg, brightness, &aeg->exposure, &aeg->gain);
 }
 
-//! Returns a value in the range [-1, 1] describing how dark-bright the image
-//! is, 0 means it's alright.
-static float
-get_score(struct u_autoexpgain *aeg, struct xrt_frame *xf)
+//! Sample the frame on a grid to compute its histogram (PDF).
+static uint32_t
+compute_histogram(struct xrt_frame *xf, uint32_t histogram[LEVELS])
 {
 	uint32_t w = xf->width;
 	uint32_t h = xf->height;
-	uint32_t s = w / GRID_COLS; // Grid cell size
+	uint32_t s = u_autoexpgain_get_sample_step(w); // Grid cell size
 
-	// Compute histogram (PDF)
-	int histogram[LEVELS] = {0};
-	int samples_count = 0;
+	uint32_t samples_count = 0;
 	size_t pixel_size = u_format_block_size(xf->format);
 	for (uint32_t y = 0; y < h; y += s) {
 		for (uint32_t x = 0; x < w; x += s) {
@@ -340,6 +337,14 @@ get_score(struct u_autoexpgain *aeg, struct xrt_frame *xf)
 		}
 	}
 
+	return samples_count;
+}
+
+//! Returns a value in the range [-1, 1] describing how dark-bright the image
+//! is, 0 means it's alright.
+static float
+get_score(struct u_autoexpgain *aeg, const uint32_t histogram[LEVELS], uint32_t samples_count)
+{
 	// Draw histogram
 	for (int i = 0; i < LEVELS; i++) {
 		aeg->histogram[i] = histogram[i];
@@ -350,7 +355,7 @@ get_score(struct u_autoexpgain *aeg, struct xrt_frame *xf)
 	for (int i = 0; i < LEVELS; i++) {
 		mean += (float)i * histogram[i];
 	}
-	mean /= samples_count;
+	mean /= samples_count > 0 ? samples_count : 1;
 
 	float score = 0;
 
@@ -375,9 +380,9 @@ get_score(struct u_autoexpgain *aeg, struct xrt_frame *xf)
 }
 
 static void
-update_brightness(struct u_autoexpgain *aeg, struct xrt_frame *xf)
+update_brightness(struct u_autoexpgain *aeg, const uint32_t histogram[LEVELS], uint32_t samples_count)
 {
-	float score = get_score(aeg, xf);
+	float score = get_score(aeg, histogram, samples_count);
 	aeg->current_score = score;
 
 	if (!aeg->enable) {
@@ -494,10 +499,59 @@ u_autoexpgain_add_vars(struct u_autoexpgain *aeg, void *root, char *prefix)
 void
 u_autoexpgain_update(struct u_autoexpgain *aeg, struct xrt_frame *xf)
 {
-	update_brightness(aeg, xf);
+	uint32_t histogram[LEVELS] = {0};
+	uint32_t samples_count = compute_histogram(xf, histogram);
+
+	update_brightness(aeg, histogram, samples_count);
+	update_expgain(aeg);
+}
+
+void
+u_autoexpgain_update_histogram(struct u_autoexpgain *aeg,
+                               const uint32_t histogram[U_AUTOEXPGAIN_LEVELS],
+                               uint32_t samples_count)
+{
+	update_brightness(aeg, histogram, samples_count);
 	update_expgain(aeg);
 }
 
+uint32_t
+u_autoexpgain_get_sample_step(uint32_t width)
+{
+	uint32_t s = width / GRID_COLS;
+	return s > 0 ? s : 1;
+}
+
+void
+u_autoexpgain_histogram_init(struct u_autoexpgain_histogram *hist, uint32_t width)
+{
+	U_ZERO(hist);
+	hist->step = u_autoexpgain_get_sample_step(width);
+}
+
+void
+u_autoexpgain_histogram_sample_rows(struct u_autoexpgain_histogram *hist,
+                                    const uint8_t *data,
+                                    size_t size,
+                                    size_t stride,
+                                    const struct xrt_rect *roi)
+{
+	while (hist->next_row < (uint32_t)roi->extent.h) {
+		size_t row_start = (roi->offset.h + hist->next_row) * stride + roi->offset.w;
+		if (row_start + roi->extent.w > size) {
+			return;
+		}
+
+		const uint8_t *row = data + row_start;
+		for (uint32_t x = 0; x < (uint32_t)roi->extent.w; x += hist->step) {
+			hist->bins[row[x]]++;
+			hist->count++;
+		}
+
+		hist->next_row += hist->step;
+	}
+}
+
 float
 u_autoexpgain_get_exposure(struct u_autoexpgain *aeg)
 {
@@ -24,6 +24,9 @@ enum u_aeg_strategy
 	U_AEG_STRATEGY_COUNT
 };
 
+//! Possible pixel intensity values and so bins in a histogram, only 8-bit supported.
+#define U_AUTOEXPGAIN_LEVELS 256
+
 struct u_autoexpgain;
 
 /*!
@@ -45,6 +48,59 @@ u_autoexpgain_add_vars(struct u_autoexpgain *aeg, void *root, char *prefix);
 void
 u_autoexpgain_update(struct u_autoexpgain *aeg, struct xrt_frame *xf);
 
+/*!
+ * Update the AEG with a histogram gathered by the caller, for drivers that
+ * already walk over the pixels and can sample them on the way. To match
+ * @ref u_autoexpgain_update sample every @ref u_autoexpgain_get_sample_step
+ * pixels in both directions, starting at the top left.
+ *
+ * @param aeg           AEG object.
+ * @param histogram     Number of samples for each intensity.
+ * @param samples_count Total number of samples.
+ */
+void
+u_autoexpgain_update_histogram(struct u_autoexpgain *aeg,
+                               const uint32_t histogram[U_AUTOEXPGAIN_LEVELS],
+                               uint32_t samples_count);
+
+//! Distance in pixels between histogram samples for a frame @p width pixels wide.
+uint32_t
+u_autoexpgain_get_sample_step(uint32_t width);
+
+/*!
+ * A histogram gathered a few rows at a time, for drivers that get a frame in
+ * pieces. Samples the same grid as @ref u_autoexpgain_update would on an image
+ * that is just the sampled region.
+ */
+struct u_autoexpgain_histogram
+{
+	uint32_t bins[U_AUTOEXPGAIN_LEVELS];
+	uint32_t count;
+
+	//! Distance between samples in pixels.
+	uint32_t step;
+
+	//! Next row of the region to sample.
+	uint32_t next_row;
+};
+
+//! Start a new histogram for a region @p width pixels wide.
+void
+u_autoexpgain_histogram_init(struct u_autoexpgain_histogram *hist, uint32_t width);
+
+/*!
+ * Samples the rows of the region @p roi of an 8-bit image that are complete in
+ * the first @p size bytes of @p data, rows already sampled are skipped. Call
+ * again with a larger @p size as more of the image arrives, then pass the
+ * result to @ref u_autoexpgain_update_histogram.
+ */
+void
+u_autoexpgain_histogram_sample_rows(struct u_autoexpgain_histogram *hist,
+                                    const uint8_t *data,
+                                    size_t size,
+                                    size_t stride,
+                                    const struct xrt_rect *roi);
+
 //! Get currently computed exposure value in usecs.
 float
 u_autoexpgain_get_exposure(struct u_autoexpgain *aeg);
@@ -8,24 +8,121 @@
  * @ingroup aux_distortion
  */
 
+#include "xrt/xrt_config_os.h"
+
 #include "util/u_misc.h"
 #include "util/u_frame.h"
 #include "util/u_debug.h"
 #include "util/u_format.h"
 #include "util/u_distortion_mesh.h"
+#include "util/u_file.h"
+#include "util/u_logging.h"
+#include "util/u_worker.h"
 
 #include "math/m_vec2.h"
 #include "math/m_api.h"
+#include "math/m_matrix_2x2.h"
 
 #include <stdio.h>
 #include <assert.h>
+#include <inttypes.h>
+#include <string.h>
+
+#ifdef XRT_OS_LINUX
+#include <linux/limits.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 
 DEBUG_GET_ONCE_NUM_OPTION(mesh_size, "XRT_MESH_SIZE", 64)
+DEBUG_GET_ONCE_NUM_OPTION(mesh_threads, "XRT_MESH_THREADS", 1)
+DEBUG_GET_ONCE_BOOL_OPTION(mesh_cache, "XRT_MESH_CACHE", true)
+
+#ifdef XRT_OS_LINUX
+#define DISTORTION_CACHE_SUPPORTED
+#endif
+
+//! Rows given to each task, fewer is not worth the dispatch.
+#define MIN_ROWS_PER_TASK 8
+
+#define MAX_TASKS 16
+
+//! "MESH" in little endian, bump the version when the layout of any cached data changes.
+#define CACHE_MAGIC 0x4853454du
+#define CACHE_VERSION 2u
+
+//! Points per direction on the probe grid used to fingerprint the distortion.
+#define CACHE_PROBES 7
+
+//! Default size limit of the disk cache, in KiB.
+#define CACHE_MAX_KB_DEFAULT (16 * 1024)
 
 
 typedef bool (*func_calc)(struct xrt_device *xdev, uint32_t view, float u, float v, struct xrt_uv_triplet *result);
 
+//! Computes @p row_count rows starting at @p first_row, returns false on error.
+typedef bool (*func_rows)(void *ptr, uint32_t first_row, uint32_t row_count);
+
+struct rows_task
+{
+	func_rows func;
+	void *ptr;
+
+	uint32_t first_row;
+	uint32_t row_count;
+
+	bool ok;
+};
+
+/*!
+ * The vertex rows of all views, numbered one after the other as they are laid
+ * out in the vertex array.
+ */
+struct mesh_rows
+{
+	struct xrt_device *xdev;
+	func_calc calc;
+
+	float *verts;
+	uint32_t stride_in_floats;
+	uint32_t vert_cols;
+	uint32_t vert_rows;
+	uint32_t cells_cols;
+	uint32_t cells_rows;
+};
+
+//! The texel rows of the three images of one view.
+struct image_rows
+{
+	struct xrt_device *xdev;
+	uint32_t view;
+	struct xrt_matrix_2x2 rot;
+	uint32_t dim;
+
+	struct xrt_vec2 *r;
+	struct xrt_vec2 *g;
+	struct xrt_vec2 *b;
+};
+
+//! Header of a cached blob, followed by the data.
+struct cache_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint64_t size;
+};
+
+//! One of the buffers a cached blob is read into or written from, in order.
+struct cache_part
+{
+	void *data;
+	size_t size;
+};
+
 static int
 index_for(int row, int col, uint32_t stride, uint32_t offset)
 {
@@ -33,7 +130,393 @@ index_for(int row, int col, uint32_t stride, uint32_t offset)
 }
 
 static void
-run_func(struct xrt_device *xdev, func_calc calc, int view_count, struct xrt_hmd_parts *target, uint32_t num)
+rows_task_run(void *ptr)
+{
+	struct rows_task *t = (struct rows_task *)ptr;
+
+	t->ok = t->func(t->ptr, t->first_row, t->row_count);
+}
+
+/*!
+ * Calls @p func over all rows, spread over a thread pool when there are enough
+ * of them and `XRT_MESH_THREADS` allows it. Not every compute_distortion
+ * function is known to be safe to call from many threads, some call into
+ * third party code, so this is opt in.
+ */
+static bool
+run_rows(func_rows func, void *ptr, uint32_t total_rows)
+{
+	int64_t option = debug_get_num_option_mesh_threads();
+	uint32_t threads = option > 0 ? (uint32_t)option : 1;
+	uint32_t task_count = total_rows / MIN_ROWS_PER_TASK;
+	if (task_count > threads) {
+		task_count = threads;
+	}
+	if (task_count > MAX_TASKS) {
+		task_count = MAX_TASKS;
+	}
+
+	if (task_count <= 1) {
+		return func(ptr, 0, total_rows);
+	}
+
+	// The waiting thread counts as one, see u_worker_group_wait_all.
+	struct u_worker_thread_pool *pool = u_worker_thread_pool_create(task_count - 1, task_count, "Distortion");
+	struct u_worker_group *group = pool != NULL ? u_worker_group_create(pool) : NULL;
+	if (group == NULL) {
+		u_worker_thread_pool_reference(&pool, NULL);
+		return func(ptr, 0, total_rows);
+	}
+
+	struct rows_task tasks[MAX_TASKS];
+	uint32_t rows = (total_rows + task_count - 1) / task_count;
+
+	for (uint32_t i = 0; i < task_count; i++) {
+		uint32_t first_row = i * rows;
+
+		tasks[i].func = func;
+		tasks[i].ptr = ptr;
+		tasks[i].first_row = first_row;
+		tasks[i].row_count = total_rows - first_row < rows ? total_rows - first_row : rows;
+		tasks[i].ok = false;
+
+		u_worker_group_push(group, rows_task_run, &tasks[i]);
+	}
+
+	u_worker_group_wait_all(group);
+	u_worker_group_reference(&group, NULL);
+	u_worker_thread_pool_reference(&pool, NULL);
+
+	bool ok = true;
+	for (uint32_t i = 0; i < task_count; i++) {
+		ok = ok && tasks[i].ok;
+	}
+
+	return ok;
+}
+
+static bool
+mesh_rows(void *ptr, uint32_t first_row, uint32_t row_count)
+{
+	struct mesh_rows *m = (struct mesh_rows *)ptr;
+
+	for (uint32_t row = first_row; row < first_row + row_count; row++) {
+		uint32_t view = row / m->vert_rows;
+		uint32_t r = row % m->vert_rows;
+		float *vert = m->verts + (size_t)row * m->vert_cols * m->stride_in_floats;
+
+		// This goes from 0 to 1.0 inclusive.
+		float v = (float)r / (float)m->cells_rows;
+
+		for (uint32_t c = 0; c < m->vert_cols; c++) {
+			// This goes from 0 to 1.0 inclusive.
+			float u = (float)c / (float)m->cells_cols;
+
+			// Make the position in the range of [-1, 1]
+			vert[0] = u * 2.0f - 1.0f;
+			vert[1] = v * 2.0f - 1.0f;
+
+			if (!m->calc(m->xdev, view, u, v, (struct xrt_uv_triplet *)&vert[2])) {
+				return false;
+			}
+
+			vert += m->stride_in_floats;
+		}
+	}
+
+	return true;
+}
+
+static bool
+image_rows(void *ptr, uint32_t first_row, uint32_t row_count)
+{
+	struct image_rows *im = (struct image_rows *)ptr;
+
+	const double dim_minus_one_f64 = im->dim - 1;
+
+	for (uint32_t row = first_row; row < first_row + row_count; row++) {
+		// This goes from 0 to 1.0 inclusive.
+		float v = (float)(row / dim_minus_one_f64);
+
+		for (uint32_t col = 0; col < im->dim; col++) {
+			// This goes from 0 to 1.0 inclusive.
+			float u = (float)(col / dim_minus_one_f64);
+
+			// These need to go from -0.5 to 0.5 for the rotation
+			struct xrt_vec2 uv = {u - 0.5f, v - 0.5f};
+			m_mat2x2_transform_vec2(&im->rot, &uv, &uv);
+			uv.x += 0.5f;
+			uv.y += 0.5f;
+
+			struct xrt_uv_triplet result;
+			xrt_device_compute_distortion(im->xdev, im->view, uv.x, uv.y, &result);
+
+			size_t i = (size_t)row * im->dim + col;
+			im->r[i] = result.r;
+			im->g[i] = result.g;
+			im->b[i] = result.b;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ *
+ * Disk cache.
+ *
+ */
+
+#ifdef DISTORTION_CACHE_SUPPORTED
+
+static uint64_t
+fnv1a(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = (const uint8_t *)data;
+	for (size_t i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+/*!
+ * The distortion parameters are private to each driver, so they are hashed
+ * through the function itself: any change to the parameters moves the result
+ * on a small grid of points, that grid is off the mesh vertices and texels.
+ * The @p params are whatever else the cached data depends on.
+ */
+static bool
+compute_cache_key(struct xrt_device *xdev,
+                  func_calc calc,
+                  uint32_t first_view,
+                  uint32_t view_count,
+                  const void *params,
+                  size_t params_size,
+                  uint64_t *out_key)
+{
+	uint64_t key = 0xcbf29ce484222325ull;
+	uint32_t version = CACHE_VERSION;
+	key = fnv1a(key, &version, sizeof(version));
+	key = fnv1a(key, params, params_size);
+	key = fnv1a(key, xdev->str, strnlen(xdev->str, sizeof(xdev->str)));
+
+	for (uint32_t view = first_view; view < first_view + view_count; view++) {
+		for (uint32_t y = 0; y < CACHE_PROBES; y++) {
+			for (uint32_t x = 0; x < CACHE_PROBES; x++) {
+				float u = ((float)x + 0.37f) / (float)CACHE_PROBES;
+				float v = ((float)y + 0.61f) / (float)CACHE_PROBES;
+
+				struct xrt_uv_triplet result;
+				U_ZERO(&result);
+				if (!calc(xdev, view, u, v, &result)) {
+					return false;
+				}
+				key = fnv1a(key, &result, sizeof(result));
+			}
+		}
+	}
+
+	*out_key = key;
+	return true;
+}
+
+static void
+cache_filename(const char *kind, uint64_t key, const char *suffix, char *out, size_t size)
+{
+	snprintf(out, size, "%s_%016" PRIx64 ".bin%s", kind, key, suffix);
+}
+
+static size_t
+cache_parts_size(const struct cache_part *parts, uint32_t part_count)
+{
+	size_t size = 0;
+	for (uint32_t i = 0; i < part_count; i++) {
+		size += parts[i].size;
+	}
+	return size;
+}
+
+static bool
+cache_load(const char *kind, uint64_t key, const struct cache_part *parts, uint32_t part_count)
+{
+	char filename[64];
+	cache_filename(kind, key, "", filename, sizeof(filename));
+
+	FILE *file = u_file_open_file_in_cache_dir_subpath("distortion", filename, "rb");
+	if (file == NULL) {
+		return false;
+	}
+
+	struct cache_header header;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1 && header.magic == CACHE_MAGIC &&
+	          header.version == CACHE_VERSION && header.key == key &&
+	          header.size == cache_parts_size(parts, part_count);
+
+	// Straight into the callers buffers.
+	for (uint32_t i = 0; ok && i < part_count; i++) {
+		ok = fread(parts[i].data, 1, parts[i].size, file) == parts[i].size;
+	}
+
+	// Mark it as recently used, the oldest files are evicted first.
+	if (ok) {
+		futimens(fileno(file), NULL);
+	}
+
+	fclose(file);
+
+	return ok;
+}
+
+struct cache_entry
+{
+	struct timespec mtime;
+	off_t size;
+	char name[64];
+};
+
+static int
+cache_entry_cmp(const void *a, const void *b)
+{
+	const struct cache_entry *ea = (const struct cache_entry *)a;
+	const struct cache_entry *eb = (const struct cache_entry *)b;
+
+	if (ea->mtime.tv_sec != eb->mtime.tv_sec) {
+		return ea->mtime.tv_sec < eb->mtime.tv_sec ? -1 : 1;
+	}
+	if (ea->mtime.tv_nsec != eb->mtime.tv_nsec) {
+		return ea->mtime.tv_nsec < eb->mtime.tv_nsec ? -1 : 1;
+	}
+	return 0;
+}
+
+/*!
+ * Removes the least recently used files until the cache is within
+ * `XRT_MESH_CACHE_MAX_KB`, @p keep is never removed.
+ */
+static void
+cache_trim(const char *keep)
+{
+	int64_t max_kb = debug_get_num_option("XRT_MESH_CACHE_MAX_KB", CACHE_MAX_KB_DEFAULT);
+	int64_t max_size = max_kb > 0 ? max_kb * 1024 : 0;
+
+	char dir_path[PATH_MAX];
+	if (u_file_get_path_in_cache_dir("distortion", dir_path, sizeof(dir_path)) <= 0) {
+		return;
+	}
+
+	DIR *dir = opendir(dir_path);
+	if (dir == NULL) {
+		return;
+	}
+
+	struct cache_entry *entries = NULL;
+	size_t entry_count = 0;
+	int64_t total_size = 0;
+
+	struct dirent *dirent;
+	while ((dirent = readdir(dir)) != NULL) {
+		// Only our own files, skips temporary files being written.
+		size_t len = strnlen(dirent->d_name, sizeof(entries->name));
+		if (len >= sizeof(entries->name) || len < 4 || strcmp(dirent->d_name + len - 4, ".bin") != 0) {
+			continue;
+		}
+
+		struct stat st;
+		if (fstatat(dirfd(dir), dirent->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode)) {
+			continue;
+		}
+
+		U_ARRAY_REALLOC_OR_FREE(entries, struct cache_entry, entry_count + 1);
+		if (entries == NULL) {
+			closedir(dir);
+			return;
+		}
+
+		struct cache_entry *entry = &entries[entry_count++];
+		entry->mtime = st.st_mtim;
+		entry->size = st.st_size;
+		memcpy(entry->name, dirent->d_name, len + 1);
+		total_size += st.st_size;
+	}
+
+	if (total_size > max_size) {
+		qsort(entries, entry_count, sizeof(*entries), cache_entry_cmp);
+	}
+
+	for (size_t i = 0; i < entry_count && total_size > max_size; i++) {
+		if (strcmp(entries[i].name, keep) == 0) {
+			continue;
+		}
+		if (unlinkat(dirfd(dir), entries[i].name, 0) == 0) {
+			total_size -= entries[i].size;
+		}
+	}
+
+	closedir(dir);
+	free(entries);
+}
+
+static void
+cache_store(const char *kind, uint64_t key, const struct cache_part *parts, uint32_t part_count)
+{
+	char filename[64];
+	char tmp_filename[64];
+	cache_filename(kind, key, "", filename, sizeof(filename));
+	cache_filename(kind, key, ".tmp", tmp_filename, sizeof(tmp_filename));
+
+	// Written next to the final file and moved in place, so a reader never sees half of it.
+	FILE *file = u_file_open_file_in_cache_dir_subpath("distortion", tmp_filename, "wb");
+	if (file == NULL) {
+		return;
+	}
+
+	struct cache_header header = {
+	    .magic = CACHE_MAGIC,
+	    .version = CACHE_VERSION,
+	    .key = key,
+	    .size = cache_parts_size(parts, part_count),
+	};
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	for (uint32_t i = 0; ok && i < part_count; i++) {
+		ok = fwrite(parts[i].data, 1, parts[i].size, file) == parts[i].size;
+	}
+	ok = fclose(file) == 0 && ok;
+
+	char tmp_path[PATH_MAX];
+	char path[PATH_MAX];
+	char subpath[96];
+	snprintf(subpath, sizeof(subpath), "distortion/%s", tmp_filename);
+	ssize_t ret = u_file_get_path_in_cache_dir(subpath, tmp_path, sizeof(tmp_path));
+	snprintf(subpath, sizeof(subpath), "distortion/%s", filename);
+	ok = ok && ret > 0 && u_file_get_path_in_cache_dir(subpath, path, sizeof(path)) > 0;
+
+	if (!ok || rename(tmp_path, path) != 0) {
+		U_LOG_W("Failed to write distortion cache '%s'", filename);
+		if (ret > 0) {
+			remove(tmp_path);
+		}
+		return;
+	}
+
+	cache_trim(filename);
+}
+
+#endif // DISTORTION_CACHE_SUPPORTED
+
+/*!
+ * Generates the mesh, with @p use_cache it is loaded from and stored to the
+ * disk cache if possible.
+ */
+static void
+run_func(struct xrt_device *xdev,
+         func_calc calc,
+         int view_count,
+         struct xrt_hmd_parts *target,
+         uint32_t num,
+         bool use_cache)
 {
 	assert(calc != NULL);
 	assert(view_count == 2);
@@ -56,32 +539,45 @@ run_func(struct xrt_device *xdev, func_calc calc, int view_count, struct xrt_hmd
 
 	float *verts = U_TYPED_ARRAY_CALLOC(float, float_count);
 
-	// Setup the vertices for all views.
-	uint32_t i = 0;
+	// The vertices of each view follow each other.
 	for (int view = 0; view < view_count; view++) {
-		vertex_offsets[view] = i / stride_in_floats;
-
-		for (uint32_t r = 0; r < vert_rows; r++) {
-			// This goes from 0 to 1.0 inclusive.
-			float v = (float)r / (float)cells_rows;
-
-			for (uint32_t c = 0; c < vert_cols; c++) {
-				// This goes from 0 to 1.0 inclusive.
-				float u = (float)c / (float)cells_cols;
+		vertex_offsets[view] = vertex_count_per_view * view;
+	}
 
-				// Make the position in the range of [-1, 1]
-				verts[i + 0] = u * 2.0f - 1.0f;
-				verts[i + 1] = v * 2.0f - 1.0f;
+	bool loaded = false;
+#ifdef DISTORTION_CACHE_SUPPORTED
+	uint64_t key = 0;
+	struct cache_part part = {verts, float_count * sizeof(float)};
+	use_cache = use_cache && debug_get_bool_option_mesh_cache() &&
+	            compute_cache_key(xdev, calc, 0, view_count, &num, sizeof(num), &key);
+	loaded = use_cache && cache_load("mesh", key, &part, 1);
+#endif
+
+	if (!loaded) {
+		struct mesh_rows m = {
+		    .xdev = xdev,
+		    .calc = calc,
+		    .verts = verts,
+		    .stride_in_floats = stride_in_floats,
+		    .vert_cols = vert_cols,
+		    .vert_rows = vert_rows,
+		    .cells_cols = cells_cols,
+		    .cells_rows = cells_rows,
+		};
 
-				if (!calc(xdev, view, u, v, (struct xrt_uv_triplet *)&verts[i + 2])) {
-					// bail on error, without updating
-					// distortion.preferred
-					return;
-				}
+		// Setup the vertices for all views.
+		if (!run_rows(mesh_rows, &m, vert_rows * view_count)) {
+			// bail on error, without updating
+			// distortion.preferred
+			free(verts);
+			return;
+		}
 
-				i += stride_in_floats;
-			}
+#ifdef DISTORTION_CACHE_SUPPORTED
+		if (use_cache) {
+			cache_store("mesh", key, &part, 1);
 		}
+#endif
 	}
 
 	uint32_t index_count_per_view = cells_rows * (vert_cols * 2 + 2);
@@ -89,7 +585,7 @@ run_func(struct xrt_device *xdev, func_calc calc, int view_count, struct xrt_hmd
 	int *indices = U_TYPED_ARRAY_CALLOC(int, index_count_total);
 
 	// Set up indices for all views.
-	i = 0;
+	uint32_t i = 0;
 	for (int view = 0; view < view_count; view++) {
 		index_offsets[view] = i;
 
@@ -437,7 +933,7 @@ u_distortion_mesh_fill_in_none(struct xrt_device *xdev)
 	struct xrt_hmd_parts *target = xdev->hmd;
 
 	// Do the generation.
-	run_func(xdev, u_distortion_mesh_none, 2, target, 1);
+	run_func(xdev, u_distortion_mesh_none, 2, target, 1, false);
 
 	// Make the target mostly usable.
 	target->distortion.models |= XRT_DISTORTION_MODEL_NONE;
@@ -481,5 +977,85 @@ u_distortion_mesh_fill_in_compute(struct xrt_device *xdev)
 	struct xrt_hmd_parts *target = xdev->hmd;
 
 	uint32_t num = (uint32_t)debug_get_num_option_mesh_size();
-	run_func(xdev, calc, 2, target, num);
+	run_func(xdev, calc, 2, target, num, true);
+}
+
+
+/*
+ *
+ * Distortion images.
+ *
+ */
+
+bool
+u_distortion_images_bake(struct xrt_device *xdev,
+                         uint32_t view,
+                         bool pre_rotate,
+                         uint32_t dim,
+                         struct xrt_vec2 *out_r,
+                         struct xrt_vec2 *out_g,
+                         struct xrt_vec2 *out_b)
+{
+	struct xrt_matrix_2x2 rot = xdev->hmd->views[view].rot;
+
+	const struct xrt_matrix_2x2 rotation_90_cw = {{
+	    .vecs =
+	        {
+	            {0, 1},
+	            {-1, 0},
+	        },
+	}};
+
+	if (pre_rotate) {
+		m_mat2x2_multiply(&rot, &rotation_90_cw, &rot);
+	}
+
+	size_t image_size = (size_t)dim * dim * sizeof(struct xrt_vec2);
+
+#ifdef DISTORTION_CACHE_SUPPORTED
+	struct
+	{
+		struct xrt_matrix_2x2 rot;
+		uint32_t dim;
+		uint32_t view;
+	} params;
+	U_ZERO(&params);
+	params.rot = rot;
+	params.dim = dim;
+	params.view = view;
+
+	uint64_t key = 0;
+	bool use_cache = debug_get_bool_option_mesh_cache() && xdev->compute_distortion != NULL &&
+	                 compute_cache_key(xdev, xdev->compute_distortion, view, 1, &params, sizeof(params), &key);
+
+	// All three images in one file, read and written in place.
+	const struct cache_part parts[3] = {
+	    {out_r, image_size},
+	    {out_g, image_size},
+	    {out_b, image_size},
+	};
+	if (use_cache && cache_load("image", key, parts, ARRAY_SIZE(parts))) {
+		return true;
+	}
+#endif
+
+	struct image_rows im = {
+	    .xdev = xdev,
+	    .view = view,
+	    .rot = rot,
+	    .dim = dim,
+	    .r = out_r,
+	    .g = out_g,
+	    .b = out_b,
+	};
+
+	run_rows(image_rows, &im, dim);
+
+#ifdef DISTORTION_CACHE_SUPPORTED
+	if (use_cache) {
+		cache_store("image", key, parts, ARRAY_SIZE(parts));
+	}
+#endif
+
+	return false;
 }
@@ -192,6 +192,13 @@ u_distortion_mesh_none(struct xrt_device *xdev, uint32_t view, float u, float v,
  * xdev->compute_distortion(), populates `xdev->hmd_parts.distortion.mesh` &
  * `xdev->hmd_parts.distortion.models`.
  *
+ * Setting `XRT_MESH_THREADS` above the default of 1 computes the rows on that
+ * many threads, only do that when xdev->compute_distortion() is safe to call
+ * from many threads at once. The finished mesh is cached on disk keyed on the
+ * output of the function and the mesh size, set `XRT_MESH_CACHE=false` to
+ * always compute it. The least recently used files are removed once the cache
+ * grows past `XRT_MESH_CACHE_MAX_KB`.
+ *
  * @relatesalso xrt_device
  * @ingroup aux_distortion
  */
@@ -220,6 +227,51 @@ void
 u_distortion_mesh_set_none(struct xrt_device *xdev);
 
 
+/*
+ *
+ * Distortion image functions.
+ *
+ */
+
+/*!
+ * Width and height in texels of the distortion images the compositor uses,
+ * anything baking images for it has to use this size to share the cache.
+ *
+ * @ingroup aux_distortion
+ */
+#define U_DISTORTION_IMAGE_DIMENSIONS (128)
+
+/*!
+ * Bakes the distortion of @p view into three @p dim x @p dim images of UV
+ * coordinates, one per colour channel, as used by the compute distortion path.
+ * With @p pre_rotate the view is rotated 90 degrees clockwise first.
+ *
+ * Like @ref u_distortion_mesh_fill_in_compute the rows are computed on a
+ * thread pool and the images are cached on disk, so the same options apply.
+ *
+ * @param xdev      Device with xdev->compute_distortion() set.
+ * @param view      View to bake.
+ * @param pre_rotate  Whether the images should be rotated for the display.
+ * @param dim       Width and height of the images.
+ * @param[out] out_r  Red channel image, @p dim rows of @p dim texels.
+ * @param[out] out_g  Green channel image.
+ * @param[out] out_b  Blue channel image.
+ *
+ * @return true if the images were loaded from the cache.
+ *
+ * @relatesalso xrt_device
+ * @ingroup aux_distortion
+ */
+bool
+u_distortion_images_bake(struct xrt_device *xdev,
+                         uint32_t view,
+                         bool pre_rotate,
+                         uint32_t dim,
+                         struct xrt_vec2 *out_r,
+                         struct xrt_vec2 *out_g,
+                         struct xrt_vec2 *out_b);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -152,6 +152,65 @@ u_file_open_file_in_config_dir_subpath(const char *subpath, const char *filename
 	return fopen(file_str, mode);
 }
 
+ssize_t
+u_file_get_cache_dir(char *out_path, size_t out_path_size)
+{
+	const char *xdg_cache = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	if (xdg_cache != NULL) {
+		return snprintf(out_path, out_path_size, "%s/monado", xdg_cache);
+	}
+	if (home != NULL) {
+		return snprintf(out_path, out_path_size, "%s/.cache/monado", home);
+	}
+	return -1;
+}
+
+ssize_t
+u_file_get_path_in_cache_dir(const char *suffix, char *out_path, size_t out_path_size)
+{
+	char tmp[PATH_MAX];
+	ssize_t i = u_file_get_cache_dir(tmp, sizeof(tmp));
+	if (i <= 0) {
+		return -1;
+	}
+
+	return snprintf(out_path, out_path_size, "%s/%s", tmp, suffix);
+}
+
+FILE *
+u_file_open_file_in_cache_dir_subpath(const char *subpath, const char *filename, const char *mode)
+{
+	char tmp[PATH_MAX];
+	ssize_t i = u_file_get_cache_dir(tmp, sizeof(tmp));
+	if (i < 0 || i >= (ssize_t)sizeof(tmp)) {
+		return NULL;
+	}
+
+	char fullpath[PATH_MAX];
+	i = snprintf(fullpath, sizeof(fullpath), "%s/%s", tmp, subpath);
+	if (i < 0 || i >= (ssize_t)sizeof(fullpath)) {
+		return NULL;
+	}
+
+	char file_str[PATH_MAX + 15];
+	i = snprintf(file_str, sizeof(file_str), "%s/%s", fullpath, filename);
+	if (i < 0 || i >= (ssize_t)sizeof(file_str)) {
+		return NULL;
+	}
+
+	FILE *file = fopen(file_str, mode);
+	if (file != NULL || mode[0] == 'r') {
+		return file;
+	}
+
+	// Try creating the path.
+	mkpath(fullpath);
+
+	// Do not report error.
+	return fopen(file_str, mode);
+}
+
 ssize_t
 u_file_get_hand_tracking_models_dir(char *out_path, size_t out_path_size)
 {
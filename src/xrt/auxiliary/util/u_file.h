@@ -31,6 +31,23 @@ u_file_open_file_in_config_dir(const char *filename, const char *mode);
 FILE *
 u_file_open_file_in_config_dir_subpath(const char *subpath, const char *filename, const char *mode);
 
+/*!
+ * Directory for files that can be regenerated at any time, like baked
+ * distortion data, `$XDG_CACHE_HOME/monado` or `~/.cache/monado`.
+ */
+ssize_t
+u_file_get_cache_dir(char *out_path, size_t out_path_size);
+
+ssize_t
+u_file_get_path_in_cache_dir(const char *suffix, char *out_path, size_t out_path_size);
+
+/*!
+ * Opens a file in a sub directory of the cache dir, the directory is created
+ * if the file is opened for writing.
+ */
+FILE *
+u_file_open_file_in_cache_dir_subpath(const char *subpath, const char *filename, const char *mode);
+
 ssize_t
 u_file_get_hand_tracking_models_dir(char *out_path, size_t out_path_size);
 
@@ -0,0 +1,269 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Pool of recycled fixed format @ref xrt_frame.
+ * @ingroup aux_util
+ */
+
+#include "os/os_threading.h"
+
+#include "util/u_var.h"
+#include "util/u_misc.h"
+#include "util/u_format.h"
+#include "util/u_frame_pool.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+
+/*
+ *
+ * Structs.
+ *
+ */
+
+struct u_frame_pool_frame
+{
+	struct xrt_frame base;
+
+	//! Pool this frame belongs to, holds a reference while handed out.
+	struct u_frame_pool *pool;
+
+	//! Next free frame, only valid while on the free list.
+	struct u_frame_pool_frame *next;
+};
+
+struct u_frame_pool
+{
+	//! Owner plus one for every outstanding frame.
+	struct xrt_reference reference;
+
+	struct os_mutex mutex;
+
+	enum xrt_format format;
+	uint32_t width, height;
+	size_t stride;
+	size_t size;
+
+	struct u_frame_pool_frame *free_list;
+	uint32_t max_free;
+
+	//! Cleared when the owner destroys the pool, protected by the mutex.
+	bool owned;
+
+	//! Protected by the mutex, but read unlocked by the debug gui.
+	struct
+	{
+		uint64_t hits;
+		uint64_t misses;
+		uint32_t free;
+		uint32_t outstanding;
+	} stats;
+};
+
+
+//! Numbers the pools so their debug gui roots have unique names.
+static xrt_atomic_s32_t pool_serial;
+
+
+/*
+ *
+ * Helpers.
+ *
+ */
+
+static void
+free_frame(struct u_frame_pool_frame *pf)
+{
+	free(pf->base.data);
+	free(pf);
+}
+
+static void
+pool_unref(struct u_frame_pool *pool)
+{
+	if (!xrt_reference_dec_and_is_zero(&pool->reference)) {
+		return;
+	}
+
+	struct u_frame_pool_frame *pf = pool->free_list;
+	while (pf != NULL) {
+		struct u_frame_pool_frame *next = pf->next;
+		free_frame(pf);
+		pf = next;
+	}
+
+	os_mutex_destroy(&pool->mutex);
+	free(pool);
+}
+
+static void
+release_frame(struct xrt_frame *xf)
+{
+	assert(xf->reference.count == 0);
+
+	struct u_frame_pool_frame *pf = (struct u_frame_pool_frame *)xf;
+	struct u_frame_pool *pool = pf->pool;
+	pf->pool = NULL;
+
+	os_mutex_lock(&pool->mutex);
+	pool->stats.outstanding--;
+	// Only keep the frame if the owner is still around to hand it out again.
+	bool keep = pool->owned && pool->stats.free < pool->max_free;
+	if (keep) {
+		pf->next = pool->free_list;
+		pool->free_list = pf;
+		pool->stats.free++;
+	}
+	os_mutex_unlock(&pool->mutex);
+
+	if (!keep) {
+		free_frame(pf);
+	}
+
+	pool_unref(pool);
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+struct u_frame_pool *
+u_frame_pool_create(enum xrt_format f, uint32_t width, uint32_t height, uint32_t max_free, const char *name)
+{
+	assert(width > 0);
+	assert(height > 0);
+	assert(u_format_is_blocks(f));
+
+	struct u_frame_pool *pool = U_TYPED_CALLOC(struct u_frame_pool);
+	if (pool == NULL) {
+		return NULL;
+	}
+
+	int ret = os_mutex_init(&pool->mutex);
+	if (ret != 0) {
+		free(pool);
+		return NULL;
+	}
+
+	pool->reference.count = 1;
+	pool->owned = true;
+	pool->format = f;
+	pool->width = width;
+	pool->height = height;
+	pool->max_free = max_free;
+	u_format_size_for_dimensions(f, width, height, &pool->stride, &pool->size);
+
+	char root_name[128];
+	snprintf(root_name, sizeof(root_name), "%s %d (%s %ux%u)", name != NULL ? name : "Frame pool",
+	         xrt_atomic_s32_inc_return(&pool_serial), u_format_str(f), width, height);
+
+	u_var_add_root(pool, root_name, false);
+	u_var_add_ro_u64(pool, &pool->stats.hits, "Hits");
+	u_var_add_ro_u64(pool, &pool->stats.misses, "Misses");
+	u_var_add_ro_u32(pool, &pool->stats.free, "Free");
+	u_var_add_ro_u32(pool, &pool->stats.outstanding, "Outstanding");
+
+	return pool;
+}
+
+bool
+u_frame_pool_get(struct u_frame_pool *pool, struct xrt_frame **out_frame)
+{
+	os_mutex_lock(&pool->mutex);
+	struct u_frame_pool_frame *pf = pool->free_list;
+	if (pf != NULL) {
+		pool->free_list = pf->next;
+		pool->stats.free--;
+		pool->stats.hits++;
+	} else {
+		pool->stats.misses++;
+	}
+	pool->stats.outstanding++;
+	os_mutex_unlock(&pool->mutex);
+
+	uint8_t *data = NULL;
+	if (pf != NULL) {
+		data = pf->base.data;
+		U_ZERO(pf);
+	} else {
+		pf = U_TYPED_CALLOC(struct u_frame_pool_frame);
+		data = (uint8_t *)malloc(pool->size);
+		if (pf == NULL || data == NULL) {
+			free(pf);
+			free(data);
+
+			os_mutex_lock(&pool->mutex);
+			pool->stats.outstanding--;
+			os_mutex_unlock(&pool->mutex);
+			return false;
+		}
+	}
+
+	pf->base.format = pool->format;
+	pf->base.width = pool->width;
+	pf->base.height = pool->height;
+	pf->base.stride = pool->stride;
+	pf->base.size = pool->size;
+	pf->base.data = data;
+	pf->base.destroy = release_frame;
+
+	xrt_reference_inc(&pool->reference);
+	pf->pool = pool;
+
+	xrt_frame_reference(out_frame, &pf->base);
+
+	return true;
+}
+
+bool
+u_frame_pool_matches(struct u_frame_pool *pool, enum xrt_format f, uint32_t width, uint32_t height)
+{
+	return pool->format == f && pool->width == width && pool->height == height;
+}
+
+void
+u_frame_pool_get_stats(struct u_frame_pool *pool, uint64_t *out_hits, uint64_t *out_misses)
+{
+	os_mutex_lock(&pool->mutex);
+	if (out_hits != NULL) {
+		*out_hits = pool->stats.hits;
+	}
+	if (out_misses != NULL) {
+		*out_misses = pool->stats.misses;
+	}
+	os_mutex_unlock(&pool->mutex);
+}
+
+void
+u_frame_pool_destroy(struct u_frame_pool **pool_ptr)
+{
+	struct u_frame_pool *pool = *pool_ptr;
+	if (pool == NULL) {
+		return;
+	}
+	*pool_ptr = NULL;
+
+	// The stats might outlive the owner, stop showing them now.
+	u_var_remove_root(pool);
+
+	// Nobody can get frames anymore, no point in keeping the free ones.
+	os_mutex_lock(&pool->mutex);
+	struct u_frame_pool_frame *pf = pool->free_list;
+	pool->free_list = NULL;
+	pool->stats.free = 0;
+	pool->owned = false;
+	os_mutex_unlock(&pool->mutex);
+
+	while (pf != NULL) {
+		struct u_frame_pool_frame *next = pf->next;
+		free_frame(pf);
+		pf = next;
+	}
+
+	pool_unref(pool);
+}
@@ -0,0 +1,86 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Pool of recycled fixed format @ref xrt_frame.
+ * @ingroup aux_util
+ */
+
+#pragma once
+
+#include "xrt/xrt_frame.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*!
+ * A pool of frames that all share the same format and dimensions. When the
+ * reference of a frame handed out by the pool reaches zero it is put back into
+ * the pool instead of being freed, so steady state producers do no allocations.
+ *
+ * The pool is kept alive by the owner and every outstanding frame, frames may
+ * outlive the @ref u_frame_pool_destroy call of the owner.
+ *
+ * @ingroup aux_util
+ */
+struct u_frame_pool;
+
+/*!
+ * Create a frame pool, keeps at most @p max_free frames around when they are
+ * released, any extra frames are freed. Hit and miss counters are exposed with
+ * @ref u_var under @p name, followed by a number and the format and size of
+ * the frames so that every pool has its own entry. Returns NULL on failure.
+ *
+ * @public @memberof u_frame_pool
+ */
+struct u_frame_pool *
+u_frame_pool_create(enum xrt_format f, uint32_t width, uint32_t height, uint32_t max_free, const char *name);
+
+/*!
+ * Get a frame from the pool, allocating a new one if the pool is empty. All of
+ * the metadata of the frame is reset but the contents of the data is not.
+ *
+ * The holder may shrink the height and size of the frame, for example when the
+ * frame is used as a receive buffer larger than the image that ends up in it.
+ * They are reset the next time the frame is handed out.
+ *
+ * Returns false, and leaves @p out_frame alone, if a new frame could not be
+ * allocated.
+ *
+ * @public @memberof u_frame_pool
+ */
+bool
+u_frame_pool_get(struct u_frame_pool *pool, struct xrt_frame **out_frame);
+
+/*!
+ * Does this pool produce frames of the given format and dimensions.
+ *
+ * @public @memberof u_frame_pool
+ */
+bool
+u_frame_pool_matches(struct u_frame_pool *pool, enum xrt_format f, uint32_t width, uint32_t height);
+
+/*!
+ * Number of frames returned from the free list and number of frames that had to
+ * be allocated, either argument may be NULL.
+ *
+ * @public @memberof u_frame_pool
+ */
+void
+u_frame_pool_get_stats(struct u_frame_pool *pool, uint64_t *out_hits, uint64_t *out_misses);
+
+/*!
+ * Drop the owner reference of the pool and set the pointer to NULL, the pool is
+ * freed once all outstanding frames have been released.
+ *
+ * @public @memberof u_frame_pool
+ */
+void
+u_frame_pool_destroy(struct u_frame_pool **pool_ptr);
+
+
+#ifdef __cplusplus
+}
+#endif
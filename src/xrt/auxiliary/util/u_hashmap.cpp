@@ -9,8 +9,8 @@
  */
 
 #include "util/u_hashmap.h"
+#include "util/u_template_flat_hash.hpp"
 
-#include <unordered_map>
 #include <vector>
 
 
@@ -20,11 +20,33 @@
  *
  */
 
+using xrt::auxiliary::util::FlatHashTable;
+
+struct u_hashmap_int_entry
+{
+	uint64_t key;
+	void *value;
+};
+
 struct u_hashmap_int
 {
-	std::unordered_map<uint64_t, void *> map = {};
+	FlatHashTable<u_hashmap_int_entry> map = {};
 };
 
+/*!
+ * Keys are often pointers or small counters, a multiply mixes the low bits up
+ * into the high half, the rotate brings that down to the bits that pick the
+ * slot.
+ */
+static inline uint64_t
+hash_key(uint64_t key)
+{
+	uint64_t hash = key * 0x9e3779b97f4a7c15ULL;
+	return (hash >> 32) | (hash << 32);
+}
+
+#define KEY_EQ(KEY) [KEY](const u_hashmap_int_entry &e) { return e.key == KEY; }
+
 
 /*
  *
@@ -51,10 +73,10 @@ u_hashmap_int_destroy(struct u_hashmap_int **hmi)
 int
 u_hashmap_int_find(struct u_hashmap_int *hmi, uint64_t key, void **out_item)
 {
-	auto search = hmi->map.find(key);
+	const u_hashmap_int_entry *e = hmi->map.find(hash_key(key), KEY_EQ(key));
 
-	if (search != hmi->map.end()) {
-		*out_item = search->second;
+	if (e != nullptr) {
+		*out_item = e->value;
 		return 0;
 	}
 	return -1;
@@ -63,14 +85,14 @@ u_hashmap_int_find(struct u_hashmap_int *hmi, uint64_t key, void **out_item)
 extern "C" int
 u_hashmap_int_insert(struct u_hashmap_int *hmi, uint64_t key, void *value)
 {
-	hmi->map[key] = value;
+	hmi->map.insert_or_assign(hash_key(key), u_hashmap_int_entry{key, value}, KEY_EQ(key));
 	return 0;
 }
 
 extern "C" int
 u_hashmap_int_erase(struct u_hashmap_int *hmi, uint64_t key)
 {
-	hmi->map.erase(key);
+	hmi->map.erase(hash_key(key), KEY_EQ(key));
 	return 0;
 }
 
@@ -85,9 +107,7 @@ u_hashmap_int_for_each(const struct u_hashmap_int *hmi, u_hashmap_int_foreach_ca
 {
 	if (hmi == NULL || cb == NULL)
 		return;
-	for (const auto &keyval : hmi->map) {
-		cb(keyval.first, keyval.second, priv_ctx);
-	}
+	hmi->map.for_each([&](const u_hashmap_int_entry &e) { cb(e.key, e.value, priv_ctx); });
 }
 
 extern "C" void
@@ -96,9 +116,7 @@ u_hashmap_int_clear_and_call_for_each(struct u_hashmap_int *hmi, u_hashmap_int_c
 	std::vector<void *> tmp;
 	tmp.reserve(hmi->map.size());
 
-	for (auto &n : hmi->map) {
-		tmp.push_back(n.second);
-	}
+	hmi->map.for_each([&](const u_hashmap_int_entry &e) { tmp.push_back(e.value); });
 
 	hmi->map.clear();
 
@@ -21,7 +21,8 @@ extern "C" {
  * @struct u_hashmap_int
  * @ingroup aux_util
  *
- * A simple uint64_t key to a void pointer hashmap.
+ * A simple uint64_t key to a void pointer hashmap, the entries are kept in a
+ * flat open addressing table.
  */
 struct u_hashmap_int;
 
@@ -9,10 +9,9 @@
 
 #include "util/u_misc.h"
 #include "util/u_hashset.h"
+#include "util/u_template_flat_hash.hpp"
 
 #include <cstring>
-#include <string>
-#include <unordered_map>
 #include <vector>
 
 
@@ -22,11 +21,47 @@
  *
  */
 
+using xrt::auxiliary::util::FlatHashTable;
+
 struct u_hashset
 {
-	std::unordered_map<std::string, struct u_hashset_item *> map = {};
+	FlatHashTable<struct u_hashset_item *> map = {};
 };
 
+/*!
+ * Hashes eight bytes at a time with a multiply and fold, paths are often long
+ * and share long prefixes so all of the string needs to be mixed in quickly.
+ */
+static inline uint64_t
+hash_str(const char *str, size_t length)
+{
+	const uint64_t mul = 0xff51afd7ed558ccdULL;
+	uint64_t hash = 0x9e3779b97f4a7c15ULL ^ length;
+
+	for (; length >= 8; str += 8, length -= 8) {
+		uint64_t v;
+		memcpy(&v, str, sizeof(v));
+		hash = (hash ^ v) * mul;
+		hash ^= hash >> 32;
+	}
+
+	uint64_t v = 0;
+	for (size_t i = 0; i < length; i++) {
+		v |= (uint64_t)(uint8_t)str[i] << (i * 8);
+	}
+	hash = (hash ^ v) * mul;
+	hash ^= hash >> 29;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 32;
+
+	return hash;
+}
+
+#define STR_EQ(STR, LENGTH)                                                                                            \
+	[STR, LENGTH](struct u_hashset_item *item) {                                                                   \
+		return item->length == LENGTH && memcmp(item->c_str(), STR, LENGTH) == 0;                              \
+	}
+
 
 /*
  *
@@ -53,11 +88,10 @@ u_hashset_destroy(struct u_hashset **hs)
 extern "C" int
 u_hashset_find_str(struct u_hashset *hs, const char *str, size_t length, struct u_hashset_item **out_item)
 {
-	std::string key = std::string(str, length);
-	auto search = hs->map.find(key);
+	struct u_hashset_item *const *item = hs->map.find(hash_str(str, length), STR_EQ(str, length));
 
-	if (search != hs->map.end()) {
-		*out_item = search->second;
+	if (item != nullptr) {
+		*out_item = *item;
 		return 0;
 	}
 	return -1;
@@ -73,8 +107,12 @@ u_hashset_find_c_str(struct u_hashset *hs, const char *c_str, struct u_hashset_i
 extern "C" int
 u_hashset_insert_item(struct u_hashset *hs, struct u_hashset_item *item)
 {
-	std::string key = std::string(item->c_str(), item->length);
-	hs->map[key] = item;
+	const char *str = item->c_str();
+	size_t length = item->length;
+
+	uint64_t hash = hash_str(str, length);
+	item->hash = (size_t)hash;
+	hs->map.insert_or_assign(hash, item, STR_EQ(str, length));
 	return 0;
 }
 
@@ -109,8 +147,7 @@ u_hashset_create_and_insert_str(struct u_hashset *hs, const char *str, size_t le
 	}
 	store[length] = '\0';
 
-	std::string key = std::string(item->c_str(), item->length);
-	hs->map[key] = item;
+	u_hashset_insert_item(hs, item);
 
 	*out_item = item;
 
@@ -127,16 +164,13 @@ u_hashset_create_and_insert_str_c(struct u_hashset *hs, const char *c_str, struc
 extern "C" int
 u_hashset_erase_item(struct u_hashset *hs, struct u_hashset_item *item)
 {
-	std::string key = std::string(item->c_str(), item->length);
-	hs->map.erase(key);
-	return 0;
+	return u_hashset_erase_str(hs, item->c_str(), item->length);
 }
 
 extern "C" int
 u_hashset_erase_str(struct u_hashset *hs, const char *str, size_t length)
 {
-	std::string key = std::string(str, length);
-	hs->map.erase(key);
+	hs->map.erase(hash_str(str, length), STR_EQ(str, length));
 	return 0;
 }
 
@@ -153,9 +187,7 @@ u_hashset_clear_and_call_for_each(struct u_hashset *hs, u_hashset_callback cb, v
 	std::vector<struct u_hashset_item *> tmp;
 	tmp.reserve(hs->map.size());
 
-	for (auto &n : hs->map) {
-		tmp.push_back(n.second);
-	}
+	hs->map.for_each([&](struct u_hashset_item *item) { tmp.push_back(item); });
 
 	hs->map.clear();
 
@@ -21,7 +21,8 @@ extern "C" {
  * @ingroup aux_util
  *
  * Kind of bespoke hashset implementation, where the user is responsible for
- * allocating and freeing the items themselves.
+ * allocating and freeing the items themselves. The items are kept in a flat
+ * open addressing table, inserting only allocates when the table grows.
  *
  * This allows embedding the @ref u_hashset_item at the end of structs.
  */
@@ -35,6 +36,7 @@ struct u_hashset;
  */
 struct u_hashset_item
 {
+	//! Set by the hashset when the item is inserted.
 	size_t hash;
 	size_t length;
 
@@ -12,12 +12,16 @@
 #include "xrt/xrt_config_build.h"
 
 #include "util/u_debug.h"
-#include "u_json.h"
 #include "util/u_truncate_printf.h"
 
+#include "os/os_time.h"
+#include "os/os_threading.h"
+
 #include <assert.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdarg.h>
 
 
@@ -50,6 +54,16 @@
  */
 #define LOG_HEX_LINE_BUF_SIZE (128)
 
+/*
+ * Size of the ring that each thread stages its asynchronous log messages in.
+ */
+#define LOG_ASYNC_RING_SIZE (64 * 1024)
+
+/*
+ * How often the asynchronous logging thread writes out the staged messages.
+ */
+#define LOG_ASYNC_DRAIN_PERIOD_NS (5 * U_TIME_1MS_IN_NS)
+
 /*
  *
  * Global log level functions.
@@ -58,6 +72,9 @@
 
 DEBUG_GET_ONCE_LOG_OPTION(global_log, "XRT_LOG", U_LOGGING_WARN)
 DEBUG_GET_ONCE_BOOL_OPTION(json_log, "XRT_JSON_LOG", false)
+#ifdef XRT_OS_LINUX
+DEBUG_GET_ONCE_BOOL_OPTION(async_log, "XRT_LOG_ASYNC", false)
+#endif
 
 enum u_logging_level
 u_log_get_global_level(void)
@@ -227,6 +244,496 @@ u_log_convert_priority(enum u_logging_level level)
 #endif
 
 
+/*
+ *
+ * Asynchronous output.
+ *
+ */
+
+/*
+ * The messages are formatted on the calling thread and copied into a ring that
+ * belongs to that thread, the logging thread writes out all of the rings. So
+ * logging never takes a lock or waits on stderr, if the ring is full the
+ * message is dropped and counted. Every message gets a sequence number when it
+ * is published, the rings are merged on it so messages from different threads
+ * are written in the order they were logged.
+ */
+
+#ifdef XRT_OS_LINUX
+#define LOG_ASYNC_SUPPORTED
+#include <pthread.h>
+#endif
+
+enum log_async_state
+{
+	LOG_ASYNC_UNINITIALIZED = 0,
+	LOG_ASYNC_STARTING,
+	LOG_ASYNC_RUNNING,
+	LOG_ASYNC_DISABLED,
+};
+
+//! Precedes each message in a @ref log_ring.
+struct log_record_header
+{
+	int32_t size;
+	int32_t seq;
+};
+
+/*!
+ * Single producer single consumer ring of messages, written by its thread and
+ * read by the logging thread. Positions only ever grow and wrap around.
+ */
+struct log_ring
+{
+	char data[LOG_ASYNC_RING_SIZE];
+
+	//! End of the published messages, only written by the owning thread.
+	xrt_atomic_s32_t head;
+
+	//! End of the messages written out, only written by the logging thread.
+	xrt_atomic_s32_t tail;
+
+	//! Set while the owning thread is staging a message.
+	xrt_atomic_s32_t busy;
+
+	//! Set when the owning thread has exited, the ring is freed once empty.
+	xrt_atomic_s32_t orphaned;
+
+	//! Read position and end while merging, only used by the logging thread.
+	int32_t cursor;
+	int32_t drain_head;
+
+	//! Only touched with the drain mutex held.
+	struct log_ring *next;
+};
+
+static struct
+{
+	xrt_atomic_s32_t state;
+
+	//! Next sequence number to give a message.
+	xrt_atomic_s32_t seq;
+
+	//! Messages dropped because the ring of the thread was full.
+	xrt_atomic_s32_t dropped;
+
+	//! Drops that the logging thread has already reported.
+	int32_t reported_dropped;
+
+	/*!
+	 * Serialises the writing out and protects @ref rings, only held by the
+	 * logging thread, flushes and threads logging for the first time.
+	 */
+	struct os_mutex drain_mutex;
+
+	//! All rings, including the ones of exited threads that still have messages.
+	struct log_ring *rings;
+
+#ifdef LOG_ASYNC_SUPPORTED
+	//! Used to find out when a thread exits.
+	pthread_key_t ring_key;
+#endif
+
+	struct os_thread_helper thread;
+} g_async;
+
+#ifdef LOG_ASYNC_SUPPORTED
+//! The ring of this thread, created the first time it logs.
+static _Thread_local struct log_ring *tl_ring;
+#endif
+
+static int
+format_json(const char *file,
+            const char *func,
+            enum u_logging_level level,
+            const char *format,
+            va_list args,
+            char *buf,
+            int size);
+
+static int
+format_json_args(
+    const char *file, const char *func, enum u_logging_level level, char *buf, int size, const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	int ret = format_json(file, func, level, format, args, buf, size);
+	va_end(args);
+	return ret;
+}
+
+static void
+ring_write(struct log_ring *ring, int32_t pos, const void *src, int32_t size)
+{
+	uint32_t offset = (uint32_t)pos % LOG_ASYNC_RING_SIZE;
+	uint32_t first = LOG_ASYNC_RING_SIZE - offset;
+	if (first > (uint32_t)size) {
+		first = (uint32_t)size;
+	}
+
+	memcpy(&ring->data[offset], src, first);
+	memcpy(&ring->data[0], (const char *)src + first, size - first);
+}
+
+static void
+ring_read(const struct log_ring *ring, int32_t pos, void *dst, int32_t size)
+{
+	uint32_t offset = (uint32_t)pos % LOG_ASYNC_RING_SIZE;
+	uint32_t first = LOG_ASYNC_RING_SIZE - offset;
+	if (first > (uint32_t)size) {
+		first = (uint32_t)size;
+	}
+
+	memcpy(dst, &ring->data[offset], first);
+	memcpy((char *)dst + first, &ring->data[0], size - first);
+}
+
+static void
+ring_output(const struct log_ring *ring, int32_t pos, int32_t size)
+{
+	uint32_t offset = (uint32_t)pos % LOG_ASYNC_RING_SIZE;
+	uint32_t first = LOG_ASYNC_RING_SIZE - offset;
+	if (first > (uint32_t)size) {
+		first = (uint32_t)size;
+	}
+
+	fwrite(&ring->data[offset], first, 1, stderr);
+	if ((uint32_t)size > first) {
+		fwrite(&ring->data[0], size - first, 1, stderr);
+	}
+}
+
+/*!
+ * Only called with the drain mutex held. Writes out every message published so
+ * far, oldest first, and frees the rings of exited threads once they are empty.
+ */
+static void
+drain_rings_locked(void)
+{
+	// Only what is published now, threads keep logging while we write.
+	for (struct log_ring *ring = g_async.rings; ring != NULL; ring = ring->next) {
+		ring->cursor = xrt_atomic_s32_load(&ring->tail);
+		ring->drain_head = xrt_atomic_s32_load(&ring->head);
+	}
+
+	while (true) {
+		struct log_ring *oldest = NULL;
+		struct log_record_header oldest_header = {0};
+
+		for (struct log_ring *ring = g_async.rings; ring != NULL; ring = ring->next) {
+			if (ring->cursor == ring->drain_head) {
+				continue;
+			}
+
+			struct log_record_header header;
+			ring_read(ring, ring->cursor, &header, sizeof(header));
+			if (oldest == NULL || header.seq - oldest_header.seq < 0) {
+				oldest = ring;
+				oldest_header = header;
+			}
+		}
+
+		if (oldest == NULL) {
+			break;
+		}
+
+		ring_output(oldest, oldest->cursor + (int32_t)sizeof(oldest_header), oldest_header.size);
+		oldest->cursor += (int32_t)sizeof(oldest_header) + oldest_header.size;
+	}
+
+	// Give the space back, and get rid of the empty rings of exited threads.
+	struct log_ring **ring_ptr = &g_async.rings;
+	while (*ring_ptr != NULL) {
+		struct log_ring *ring = *ring_ptr;
+		xrt_atomic_s32_store(&ring->tail, ring->cursor);
+
+		if (xrt_atomic_s32_load(&ring->orphaned) != 0 && ring->cursor == xrt_atomic_s32_load(&ring->head)) {
+			*ring_ptr = ring->next;
+			free(ring);
+			continue;
+		}
+
+		ring_ptr = &ring->next;
+	}
+
+	int32_t dropped = xrt_atomic_s32_load(&g_async.dropped);
+	if (dropped == g_async.reported_dropped) {
+		return;
+	}
+
+	char tmp[LOG_BUFFER_SIZE];
+	int count = dropped - g_async.reported_dropped;
+	int printed = 0;
+	if (debug_get_bool_option_json_log()) {
+		printed = format_json_args(__FILE__, __func__, U_LOGGING_WARN, tmp, sizeof(tmp),
+		                           "Dropped %i log messages, the ring of the thread was full", count);
+	} else {
+		printed = u_truncate_snprintf(tmp, sizeof(tmp),
+		                              " WARN [%s] Dropped %i log messages, the ring of the thread was full\n",
+		                              __func__, count);
+	}
+	fwrite(tmp, printed, 1, stderr);
+
+	g_async.reported_dropped = dropped;
+}
+
+#ifdef LOG_ASYNC_SUPPORTED
+
+static void *
+log_thread(void *ptr)
+{
+	os_thread_helper_lock(&g_async.thread);
+	while (os_thread_helper_is_running_locked(&g_async.thread)) {
+		os_thread_helper_unlock(&g_async.thread);
+
+		os_mutex_lock(&g_async.drain_mutex);
+		drain_rings_locked();
+		os_mutex_unlock(&g_async.drain_mutex);
+
+		os_nanosleep(LOG_ASYNC_DRAIN_PERIOD_NS);
+
+		os_thread_helper_lock(&g_async.thread);
+	}
+	os_thread_helper_unlock(&g_async.thread);
+
+	return NULL;
+}
+
+static void
+ring_thread_exit(void *ptr)
+{
+	struct log_ring *ring = (struct log_ring *)ptr;
+
+	// Anything logged later on this thread gets a new ring.
+	tl_ring = NULL;
+
+	xrt_atomic_s32_store(&ring->orphaned, 1);
+}
+
+static struct log_ring *
+get_thread_ring(void)
+{
+	if (tl_ring != NULL) {
+		return tl_ring;
+	}
+
+	struct log_ring *ring = calloc(1, sizeof(*ring));
+	if (ring == NULL) {
+		return NULL;
+	}
+
+	// Only once per thread.
+	os_mutex_lock(&g_async.drain_mutex);
+
+	// The key is gone once async_stop has run.
+	if (xrt_atomic_s32_load(&g_async.state) != LOG_ASYNC_RUNNING) {
+		os_mutex_unlock(&g_async.drain_mutex);
+		free(ring);
+		return NULL;
+	}
+
+	ring->next = g_async.rings;
+	g_async.rings = ring;
+	pthread_setspecific(g_async.ring_key, ring);
+
+	os_mutex_unlock(&g_async.drain_mutex);
+
+	tl_ring = ring;
+
+	return ring;
+}
+
+/*!
+ * Called from any thread, copies the formatted message into the ring of the
+ * thread, drops it if the ring is full. Returns false if asynchronous output
+ * has been stopped and the message should be written out directly.
+ */
+static bool
+async_stage(const char *str, int32_t size)
+{
+	struct log_ring *ring = get_thread_ring();
+	if (ring == NULL) {
+		return false;
+	}
+
+	// Makes async_stop wait for this message, it must see the state after this.
+	xrt_atomic_s32_store(&ring->busy, 1);
+	if (xrt_atomic_s32_load(&g_async.state) != LOG_ASYNC_RUNNING) {
+		xrt_atomic_s32_store(&ring->busy, 0);
+		return false;
+	}
+
+	struct log_record_header header = {.size = size};
+	int32_t head = xrt_atomic_s32_load(&ring->head);
+	int32_t used = head - xrt_atomic_s32_load(&ring->tail);
+
+	if (used + (int32_t)sizeof(header) + size > LOG_ASYNC_RING_SIZE) {
+		xrt_atomic_s32_inc_return(&g_async.dropped);
+	} else {
+		ring_write(ring, head + (int32_t)sizeof(header), str, size);
+
+		header.seq = xrt_atomic_s32_inc_return(&g_async.seq);
+		ring_write(ring, head, &header, sizeof(header));
+
+		// Publishes the message to the logging thread.
+		xrt_atomic_s32_store(&ring->head, head + (int32_t)sizeof(header) + size);
+	}
+
+	xrt_atomic_s32_store(&ring->busy, 0);
+
+	return true;
+}
+
+static void
+async_stop(void)
+{
+	// Stop new messages before draining.
+	xrt_atomic_s32_store(&g_async.state, LOG_ASYNC_DISABLED);
+
+	// Writes out the last messages after the thread has stopped.
+	os_thread_helper_destroy(&g_async.thread);
+
+	os_mutex_lock(&g_async.drain_mutex);
+
+	// Messages that saw the old state are still being staged.
+	for (struct log_ring *ring = g_async.rings; ring != NULL; ring = ring->next) {
+		while (xrt_atomic_s32_load(&ring->busy) != 0) {
+			os_nanosleep(U_TIME_1MS_IN_NS / 10);
+		}
+	}
+
+	drain_rings_locked();
+
+	/*
+	 * Also runs when a driver library is unloaded, the destructor must not
+	 * be called after that. The rings are not freed, threads that are still
+	 * running keep a pointer to theirs.
+	 */
+	pthread_key_delete(g_async.ring_key);
+
+	os_mutex_unlock(&g_async.drain_mutex);
+
+	fflush(stderr);
+}
+
+static bool
+async_start(void)
+{
+	if (!debug_get_bool_option_async_log()) {
+		return false;
+	}
+
+	if (pthread_key_create(&g_async.ring_key, ring_thread_exit) != 0) {
+		return false;
+	}
+
+	if (os_mutex_init(&g_async.drain_mutex) < 0) {
+		goto err_key;
+	}
+
+	if (os_thread_helper_init(&g_async.thread) < 0) {
+		goto err_mutex;
+	}
+
+	if (os_thread_helper_start(&g_async.thread, log_thread, NULL) < 0) {
+		goto err_thread;
+	}
+
+	os_thread_helper_name(&g_async.thread, "Logging");
+
+	// Also runs when a driver library is unloaded.
+	atexit(async_stop);
+
+	return true;
+
+err_thread:
+	os_thread_helper_destroy(&g_async.thread);
+err_mutex:
+	os_mutex_destroy(&g_async.drain_mutex);
+err_key:
+	pthread_key_delete(g_async.ring_key);
+	return false;
+}
+
+#else // LOG_ASYNC_SUPPORTED
+
+static bool
+async_stage(const char *str, int32_t size)
+{
+	return false;
+}
+
+static bool
+async_start(void)
+{
+	// Joining the thread while a library is being unloaded isn't safe everywhere.
+	return false;
+}
+
+#endif // LOG_ASYNC_SUPPORTED
+
+/*!
+ * Is asynchronous output enabled and running, starts it on first use. Messages
+ * logged while it is starting are printed directly.
+ */
+static bool
+async_is_running(void)
+{
+	int32_t state = xrt_atomic_s32_load(&g_async.state);
+	if (state == LOG_ASYNC_RUNNING) {
+		return true;
+	}
+	if (state != LOG_ASYNC_UNINITIALIZED) {
+		return false;
+	}
+
+	// Only one thread gets to start it, reading the option may log.
+	if (xrt_atomic_s32_cmpxchg(&g_async.state, LOG_ASYNC_UNINITIALIZED, LOG_ASYNC_STARTING) !=
+	    LOG_ASYNC_UNINITIALIZED) {
+		return false;
+	}
+
+	bool running = async_start();
+	xrt_atomic_s32_store(&g_async.state, running ? LOG_ASYNC_RUNNING : LOG_ASYNC_DISABLED);
+
+	return running;
+}
+
+/*!
+ * Write out a formatted message, including the new-line, to stderr.
+ */
+static void
+output(enum u_logging_level level, const char *str, int size)
+{
+	if (!async_is_running()) {
+		goto direct;
+	}
+
+	if (level != U_LOGGING_ERROR) {
+		if (async_stage(str, size)) {
+			return;
+		}
+		goto direct;
+	}
+
+	// Errors might be the last thing before a crash, get them out now and never drop them.
+	os_mutex_lock(&g_async.drain_mutex);
+	drain_rings_locked();
+	fwrite(str, size, 1, stderr);
+	os_mutex_unlock(&g_async.drain_mutex);
+
+	fflush(stderr);
+	return;
+
+direct:
+#if defined XRT_OS_WINDOWS
+	// Visual Studio output needs the newline char
+	OutputDebugStringA(str);
+#endif
+	fwrite(str, size, 1, stderr);
+}
+
+
 /*
  *
  * Helper functions.
@@ -312,51 +819,171 @@ print_prefix(const char *func, enum u_logging_level level, char *buf, int remain
 	return printed;
 }
 
-static int
-log_as_json(const char *file, const char *func, enum u_logging_level level, const char *format, va_list args)
+static const char *
+level_to_json_string(enum u_logging_level level)
 {
-	cJSON *root = cJSON_CreateObject();
-
-	char *level_s;
 	switch (level) {
-	case U_LOGGING_TRACE: level_s = "trace"; break;
-	case U_LOGGING_DEBUG: level_s = "debug"; break;
-	case U_LOGGING_INFO: level_s = "info"; break;
-	case U_LOGGING_WARN: level_s = "warn"; break;
-	case U_LOGGING_ERROR: level_s = "error"; break;
-	default: level_s = "raw"; break;
+	case U_LOGGING_TRACE: return "trace";
+	case U_LOGGING_DEBUG: return "debug";
+	case U_LOGGING_INFO: return "info";
+	case U_LOGGING_WARN: return "warn";
+	case U_LOGGING_ERROR: return "error";
+	default: return "raw";
+	}
+}
+
+/*!
+ * Appends @p str as a quoted and escaped JSON string, escapes the same
+ * characters as cJSON. If it doesn't fit it returns false with nothing
+ * appended, or with @p truncate set cuts the string short instead, never in
+ * the middle of an escape or a UTF-8 character.
+ */
+static bool
+append_json_string(char *buf, int size, int *inout_pos, const char *str, bool truncate)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	if (str == NULL) {
+		str = "";
+	}
+
+	int pos = *inout_pos;
+
+	// Room for both of the quotes.
+	if (pos + 2 > size) {
+		return false;
+	}
+	buf[pos++] = '"';
+
+	// Where the current UTF-8 character started.
+	int char_start = pos;
+
+	for (const unsigned char *c = (const unsigned char *)str; *c != '\0'; c++) {
+		char esc = 0;
+		switch (*c) {
+		case '"': esc = '"'; break;
+		case '\\': esc = '\\'; break;
+		case '\b': esc = 'b'; break;
+		case '\f': esc = 'f'; break;
+		case '\n': esc = 'n'; break;
+		case '\r': esc = 'r'; break;
+		case '\t': esc = 't'; break;
+		default: break;
+		}
+
+		char tmp[6];
+		int len = 0;
+		if (esc != 0) {
+			tmp[len++] = '\\';
+			tmp[len++] = esc;
+		} else if (*c < 0x20) {
+			tmp[len++] = '\\';
+			tmp[len++] = 'u';
+			tmp[len++] = '0';
+			tmp[len++] = '0';
+			tmp[len++] = hex[*c >> 4];
+			tmp[len++] = hex[*c & 0xf];
+		} else {
+			tmp[len++] = (char)*c;
+		}
+
+		// Continuation bytes belong to the character before them.
+		if ((*c & 0xc0) != 0x80) {
+			char_start = pos;
+		}
+
+		// Keep room for the closing quote.
+		if (pos + len + 1 > size) {
+			if (!truncate) {
+				return false;
+			}
+			pos = char_start;
+			break;
+		}
+
+		memcpy(&buf[pos], tmp, len);
+		pos += len;
 	}
 
-	// Add metadata.
-	cJSON_AddItemToObject(root, "level", cJSON_CreateString(level_s));
-	cJSON_AddItemToObject(root, "file", cJSON_CreateString(file));
-	cJSON_AddItemToObject(root, "func", cJSON_CreateString(func));
+	buf[pos++] = '"';
 
-	// Add message.
+	*inout_pos = pos;
+	return true;
+}
+
+static bool
+append_raw(char *buf, int size, int *inout_pos, const char *str)
+{
+	int len = (int)strlen(str);
+	if (*inout_pos + len > size) {
+		return false;
+	}
+	memcpy(&buf[*inout_pos], str, len);
+	*inout_pos += len;
+	return true;
+}
+
+/*!
+ * Writes one JSON object, with a new-line, straight into @p buf without
+ * building a cJSON tree. The message is truncated if it doesn't fit, the
+ * object is always complete.
+ */
+static int
+format_json(const char *file,
+            const char *func,
+            enum u_logging_level level,
+            const char *format,
+            va_list args,
+            char *buf,
+            int size)
+{
 	char msg_buf[LOG_BUFFER_SIZE];
-	vsprintf(msg_buf, format, args);
-	cJSON_AddItemToObject(root, "message", cJSON_CreateString(msg_buf));
+	u_truncate_vsnprintf(msg_buf, sizeof(msg_buf), format, args);
+
+	// Room for the closing brace and the new-line.
+	int limit = size - 2;
+	int pos = 0;
+
+	// The message is cut to the space left, the rest has to fit whole.
+	bool ok = append_raw(buf, limit, &pos, "{\"level\":") &&                              //
+	          append_json_string(buf, limit, &pos, level_to_json_string(level), false) && //
+	          append_raw(buf, limit, &pos, ",\"file\":") &&                               //
+	          append_json_string(buf, limit, &pos, file, false) &&                        //
+	          append_raw(buf, limit, &pos, ",\"func\":") &&                               //
+	          append_json_string(buf, limit, &pos, func, false) &&                        //
+	          append_raw(buf, limit, &pos, ",\"message\":") &&                            //
+	          append_json_string(buf, limit, &pos, msg_buf, true);
+
+	if (!ok) {
+		// Very long file or function names, still write a valid object.
+		pos = 0;
+		ok = append_raw(buf, limit, &pos, "{\"level\":") &&                              //
+		     append_json_string(buf, limit, &pos, level_to_json_string(level), false) && //
+		     append_raw(buf, limit, &pos, ",\"message\":\"\"");
+	}
 
-	// Get string and print to stderr.
-	char *out = cJSON_PrintUnformatted(root);
-	int printed = fprintf(stderr, "%s\n", out);
+	if (!ok) {
+		pos = 0;
+		buf[pos++] = '{';
+	}
 
-	// Clean up after us.
-	cJSON_Delete(root);
-	cJSON_free(out);
+	buf[pos++] = '}';
+	buf[pos++] = '\n';
 
-	return printed;
+	return pos;
 }
 
 static int
 do_print(const char *file, int line, const char *func, enum u_logging_level level, const char *format, va_list args)
 {
+	char storage[LOG_BUFFER_SIZE];
+
 	if (debug_get_bool_option_json_log()) {
-		return log_as_json(file, func, level, format, args);
+		int printed = format_json(file, func, level, format, args, storage, sizeof(storage));
+		output(level, storage, printed);
+		return printed;
 	}
 
-	char storage[LOG_BUFFER_SIZE];
-
 	int remaining = sizeof(storage) - 2; // 2 for \n\0
 	int printed = 0;
 	char *buf = storage; // We update the pointer.
@@ -391,12 +1018,7 @@ do_print(const char *file, int line, const char *func, enum u_logging_level leve
 	storage[printed++] = '\n';
 	storage[printed] = '\0'; // Don't count zero termination as printed.
 
-#if defined XRT_OS_WINDOWS
-	// Visual Studio output needs the newline char
-	OutputDebugStringA(storage);
-#endif
-
-	fwrite(storage, printed, 1, stderr);
+	output(level, storage, printed);
 
 #else
 #error "Port needed for logging function"
@@ -437,3 +1059,23 @@ u_log_xdev(const char *file,
 	do_print(file, line, func, level, format, args);
 	va_end(args);
 }
+
+void
+u_log_flush(void)
+{
+	if (xrt_atomic_s32_load(&g_async.state) != LOG_ASYNC_RUNNING) {
+		return;
+	}
+
+	os_mutex_lock(&g_async.drain_mutex);
+	drain_rings_locked();
+	os_mutex_unlock(&g_async.drain_mutex);
+
+	fflush(stderr);
+}
+
+int32_t
+u_log_get_dropped_count(void)
+{
+	return xrt_atomic_s32_load(&g_async.dropped);
+}
@@ -269,6 +269,22 @@ u_log_xdev_hex(const char *file,
 void
 u_log_set_sink(u_log_sink_func_t func, void *data);
 
+/*!
+ * With `XRT_LOG_ASYNC` set messages are formatted on the calling thread but
+ * written to stderr by a logging thread, so logging never blocks on output.
+ * This writes out all messages logged so far, does nothing otherwise. Error
+ * messages are always flushed.
+ */
+void
+u_log_flush(void);
+
+/*!
+ * Number of messages dropped because they were logged faster than the logging
+ * thread could write them out, only with `XRT_LOG_ASYNC` set.
+ */
+int32_t
+u_log_get_dropped_count(void);
+
 /*!
  * @}
  */
@@ -7,24 +7,76 @@
  * @ingroup aux_util
  */
 
+#include "os/os_time.h"
 #include "os/os_threading.h"
 
+#include "util/u_var.h"
+#include "util/u_time.h"
 #include "util/u_metrics.h"
 #include "util/u_debug.h"
+#include "util/u_trace_marker.h"
 
 #include "monado_metrics.pb.h"
 #include "pb_encode.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
 
 #define VERSION_MAJOR 1
 #define VERSION_MINOR 1
 
+//! Size of each of the two staging buffers.
+#define STAGING_SIZE (256 * 1024)
+
+//! How often the writer thread drains the staging buffers.
+#define DRAIN_PERIOD_NS (10 * U_TIME_1MS_IN_NS)
+
+/*!
+ * The staging state packs which buffer is active and how much of it has been
+ * reserved into one atomic, so reserving space never takes a lock.
+ */
+#define STATE_INDEX_BIT ((int32_t)0x40000000)
+#define STATE_OFFSET_MASK ((int32_t)0x3fffffff)
+
+/*!
+ * One half of the double buffer that records are staged in before the writer
+ * thread puts them in the file.
+ */
+struct staging_buffer
+{
+	uint8_t data[STAGING_SIZE];
+
+	//! Bytes fully copied into @ref data.
+	xrt_atomic_s32_t committed;
+
+	//! Number of records in @ref data.
+	xrt_atomic_s32_t record_count;
+
+	//! When the first record in this buffer was staged.
+	uint64_t first_ns;
+};
+
 static FILE *g_file = NULL;
-static struct os_mutex g_file_mutex;
 static bool g_metrics_initialized = false;
 static bool g_metrics_early_flush = false;
 
+static struct staging_buffer g_staging[2];
+static xrt_atomic_s32_t g_staging_state = 0;
+static struct os_thread_helper g_writer_thread;
+
+static struct
+{
+	//! Records that made it to the file.
+	uint64_t written;
+
+	//! Records dropped because the staging buffer was full.
+	xrt_atomic_s32_t dropped;
+
+	//! Longest time a record spent staged before being written.
+	uint64_t max_latency_ns;
+} g_stats;
+
 DEBUG_GET_ONCE_OPTION(metrics_file, "XRT_METRICS_FILE", NULL)
 DEBUG_GET_ONCE_BOOL_OPTION(metrics_early_flush, "XRT_METRICS_EARLY_FLUSH", false)
 
@@ -36,6 +88,10 @@ DEBUG_GET_ONCE_BOOL_OPTION(metrics_early_flush, "XRT_METRICS_EARLY_FLUSH", false
  *
  */
 
+/*!
+ * Called from any thread, copies the encoded record into the active staging
+ * buffer, drops it if the buffer is full. Never blocks on file IO.
+ */
 static void
 write_record(monado_metrics_Record *r)
 {
@@ -49,15 +105,105 @@ write_record(monado_metrics_Record *r)
 		return;
 	}
 
-	os_mutex_lock(&g_file_mutex);
+	int32_t size = (int32_t)stream.bytes_written;
+
+	// Only reserve what fits, so a long burst can never carry into the index bit.
+	int32_t state = xrt_atomic_s32_load(&g_staging_state);
+	while (true) {
+		if ((state & STATE_OFFSET_MASK) + size > STAGING_SIZE) {
+			xrt_atomic_s32_inc_return(&g_stats.dropped);
+			return;
+		}
+
+		int32_t prev = xrt_atomic_s32_cmpxchg(&g_staging_state, state, state + size);
+		if (prev == state) {
+			break;
+		}
+		state = prev;
+	}
+
+	int32_t offset = state & STATE_OFFSET_MASK;
+	struct staging_buffer *sb = &g_staging[(state & STATE_INDEX_BIT) != 0 ? 1 : 0];
+
+	if (offset == 0) {
+		sb->first_ns = os_monotonic_get_ns();
+	}
+
+	memcpy(&sb->data[offset], buffer, size);
+	xrt_atomic_s32_inc_return(&sb->record_count);
+
+	// Publishes the copy to the writer thread.
+	xrt_atomic_s32_add_return(&sb->committed, size);
+}
+
+/*!
+ * Only called from the writer thread, or after it has stopped. Swaps the
+ * staging buffers and writes out the one that was active.
+ */
+static void
+drain_staging(void)
+{
+	int32_t old_state = xrt_atomic_s32_load(&g_staging_state);
+	if ((old_state & STATE_OFFSET_MASK) == 0) {
+		return;
+	}
+
+	// Make the other, empty, buffer active.
+	while (true) {
+		int32_t new_state = (old_state & STATE_INDEX_BIT) ^ STATE_INDEX_BIT;
+		int32_t prev = xrt_atomic_s32_cmpxchg(&g_staging_state, old_state, new_state);
+		if (prev == old_state) {
+			break;
+		}
+		old_state = prev;
+	}
 
-	fwrite(buffer, stream.bytes_written, 1, g_file);
+	struct staging_buffer *sb = &g_staging[(old_state & STATE_INDEX_BIT) != 0 ? 1 : 0];
+	int32_t reserved = old_state & STATE_OFFSET_MASK;
 
-	if (g_metrics_early_flush) {
-		fflush(g_file);
+	// Wait for writers that reserved space before the swap to finish copying.
+	while (xrt_atomic_s32_load(&sb->committed) != reserved) {
+		os_nanosleep(U_TIME_1MS_IN_NS / 10);
 	}
 
-	os_mutex_unlock(&g_file_mutex);
+	// Records that fit are always a prefix of the buffer.
+	int32_t committed = xrt_atomic_s32_load(&sb->committed);
+	if (committed > 0) {
+		fwrite(sb->data, committed, 1, g_file);
+
+		if (g_metrics_early_flush) {
+			fflush(g_file);
+		}
+
+		uint64_t latency_ns = os_monotonic_get_ns() - sb->first_ns;
+		if (latency_ns > g_stats.max_latency_ns) {
+			g_stats.max_latency_ns = latency_ns;
+		}
+	}
+
+	g_stats.written += xrt_atomic_s32_load(&sb->record_count);
+
+	xrt_atomic_s32_store(&sb->committed, 0);
+	xrt_atomic_s32_store(&sb->record_count, 0);
+}
+
+static void *
+writer_thread(void *ptr)
+{
+	U_TRACE_SET_THREAD_NAME("Metrics Writer");
+
+	os_thread_helper_lock(&g_writer_thread);
+	while (os_thread_helper_is_running_locked(&g_writer_thread)) {
+		os_thread_helper_unlock(&g_writer_thread);
+
+		drain_staging();
+		os_nanosleep(DRAIN_PERIOD_NS);
+
+		os_thread_helper_lock(&g_writer_thread);
+	}
+	os_thread_helper_unlock(&g_writer_thread);
+
+	return NULL;
 }
 
 static void
@@ -99,13 +245,36 @@ u_metrics_init(void)
 		return;
 	}
 
-	os_mutex_init(&g_file_mutex);
+	int ret = os_thread_helper_init(&g_writer_thread);
+	if (ret < 0) {
+		U_LOG_E("Failed to init metrics writer thread!");
+		fclose(g_file);
+		g_file = NULL;
+		return;
+	}
 
-	g_metrics_initialized = true;
 	g_metrics_early_flush = debug_get_bool_option_metrics_early_flush();
 
+	ret = os_thread_helper_start(&g_writer_thread, writer_thread, NULL);
+	if (ret < 0) {
+		U_LOG_E("Failed to start metrics writer thread!");
+		os_thread_helper_destroy(&g_writer_thread);
+		fclose(g_file);
+		g_file = NULL;
+		return;
+	}
+
+	os_thread_helper_name(&g_writer_thread, "Metrics Writer");
+
+	g_metrics_initialized = true;
+
 	write_version(VERSION_MAJOR, VERSION_MINOR);
 
+	u_var_add_root(&g_stats, "Metrics", false);
+	u_var_add_ro_u64(&g_stats, &g_stats.written, "Written records");
+	u_var_add_ro_i32(&g_stats, (int32_t *)&g_stats.dropped, "Dropped records");
+	u_var_add_ro_u64(&g_stats, &g_stats.max_latency_ns, "Max latency (ns)");
+
 	U_LOG_I("Opened metrics file: '%s'", str);
 }
 
@@ -118,16 +287,21 @@ u_metrics_close(void)
 
 	U_LOG_I("Closing metrics file: '%s'", debug_get_option_metrics_file());
 
-	// At least try to avoid races.
-	os_mutex_lock(&g_file_mutex);
+	// At least try to avoid races, stop new records before draining.
+	g_metrics_initialized = false;
+
+	u_var_remove_root(&g_stats);
+
+	// Drains the last records after the thread has stopped.
+	os_thread_helper_destroy(&g_writer_thread);
+	drain_staging();
+
+	U_LOG_I("Metrics: %" PRIu64 " records written, %i dropped, max latency %.2fms", g_stats.written,
+	        xrt_atomic_s32_load(&g_stats.dropped), (double)g_stats.max_latency_ns / U_TIME_1MS_IN_NS);
+
 	fflush(g_file);
 	fclose(g_file);
 	g_file = NULL;
-	os_mutex_unlock(&g_file_mutex);
-
-	os_mutex_destroy(&g_file_mutex);
-
-	g_metrics_initialized = false;
 }
 
 bool
@@ -84,6 +84,25 @@ u_sink_create_to_yuv_or_yuyv(struct xrt_frame_context *xfctx,
                              struct xrt_frame_sink *downstream,
                              struct xrt_frame_sink **out_xfs);
 
+/*!
+ * Sets how many row stripes a converter sink splits each frame into. The
+ * stripes run on a thread pool shared by all converter sinks, sized by the
+ * `U_SINK_CONVERTER_POOL_THREADS` environment variable. 0 or 1 converts on the
+ * thread pushing the frame, which is the default unless the
+ * `U_SINK_CONVERTER_WORKERS` environment variable says otherwise. MJPEG
+ * decoding is always done on the pushing thread.
+ *
+ * Must not be called while frames are being pushed to the sink.
+ *
+ * @param xfs          A sink created by one of the converter functions above.
+ * @param worker_count Number of stripes, at most 16.
+ * @return False if @p xfs is not a converter sink.
+ *
+ * @public @memberof xrt_frame_sink
+ */
+bool
+u_sink_converter_set_worker_count(struct xrt_frame_sink *xfs, uint32_t worker_count);
+
 /*!
  * @public @memberof xrt_frame_sink
  * @see xrt_frame_context
@@ -102,6 +121,21 @@ u_sink_deinterleaver_create(struct xrt_frame_context *xfctx,
                             struct xrt_frame_sink **out_xfs);
 
 /*!
+ * What a bounded @ref u_sink_queue does with a frame when it is full.
+ */
+enum u_sink_queue_drop_policy
+{
+	//! Drop the incoming frame, keeping the queued ones.
+	U_SINK_QUEUE_DROP_NEWEST = 0,
+	//! Drop the oldest queued frame to make room for the incoming frame.
+	U_SINK_QUEUE_DROP_OLDEST = 1,
+};
+
+/*!
+ * Creates a queue that pushes frames to @p downstream on its own thread,
+ * same as @ref u_sink_queue_create_with_drop_policy with
+ * @ref U_SINK_QUEUE_DROP_NEWEST.
+ *
  * @public @memberof xrt_frame_sink
  * @see xrt_frame_context
  */
@@ -111,6 +145,29 @@ u_sink_queue_create(struct xrt_frame_context *xfctx,
                     struct xrt_frame_sink *downstream,
                     struct xrt_frame_sink **out_xfs);
 
+/*!
+ * Creates a queue that pushes frames to @p downstream on its own thread.
+ *
+ * Queued frames are kept in a ring buffer, for bounded queues it is allocated
+ * up front with room for @p max_size frames so queueing never allocates, for
+ * unbounded queues (@p max_size of 0) it grows as needed.
+ *
+ * @param xfctx       Frame context the sink is added to.
+ * @param max_size    Max number of queued frames, 0 means unbounded.
+ * @param drop_policy What to do with frames when the queue is full.
+ * @param downstream  Consumer of the frames.
+ * @param out_xfs     The created sink.
+ *
+ * @public @memberof xrt_frame_sink
+ * @see xrt_frame_context
+ */
+bool
+u_sink_queue_create_with_drop_policy(struct xrt_frame_context *xfctx,
+                                     uint64_t max_size,
+                                     enum u_sink_queue_drop_policy drop_policy,
+                                     struct xrt_frame_sink *downstream,
+                                     struct xrt_frame_sink **out_xfs);
+
 
 /*!
  * @public @memberof xrt_frame_sink
@@ -15,8 +15,12 @@
 #include "util/u_frame.h"
 #include "util/u_format.h"
 #include "util/u_trace_marker.h"
+#include "util/u_debug.h"
+#include "util/u_worker.h"
+#include "util/u_yuv_convert.h"
 
 #include <stdio.h>
+#include <pthread.h>
 
 #ifdef XRT_HAVE_JPEG
 #include "jpeglib.h"
@@ -42,195 +46,205 @@ struct u_sink_converter
 	struct xrt_frame_sink *downstream;
 
 	enum xrt_format format;
-};
 
+	//! Number of row stripes a frame is split into, 0 or 1 converts on the pushing thread.
+	uint32_t worker_count;
 
-/*
- *
- * L8 functions.
- *
- */
+	//! Reference to the shared pool, only set if @ref worker_count is above one.
+	struct u_worker_thread_pool *pool;
 
-static void
-from_L8_to_R8G8B8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t stride, const uint8_t *data)
-{
-	SINK_TRACE_MARKER();
+	//! This sink's tasks on @ref pool.
+	struct u_worker_group *group;
+};
 
-	for (uint32_t y = 0; y < h; y++) {
-		for (uint32_t x = 0; x < w; x += 1) {
-			const uint8_t *src = data;
-			uint8_t *dst = dst_frame->data;
+//! Signature of all of the row based conversion functions below.
+typedef void (*convert_rows_func_t)(
+    struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t stride, const uint8_t *data);
 
-			src = src + (y * stride) + x;
-			dst = dst + (y * dst_frame->stride) + (x * 3);
-			dst[2] = dst[1] = dst[0] = src[0];
-		}
-	}
-}
+/*!
+ * Arguments of one @ref convert_rows call, shared by all of its stripes.
+ */
+struct convert_rows_args
+{
+	convert_rows_func_t func;
+	struct xrt_frame *dst_frame;
+	uint32_t w;
+	size_t stride;
+	const uint8_t *data;
+	uint32_t src_rows;
+};
 
 
 /*
  *
- * YUV functions.
+ * Shared pool.
  *
  */
 
-static inline int
-clamp_to_byte(int v)
-{
-	if (v < 0) {
-		return 0;
-	}
-	if (v >= 255) {
-		return 255;
-	}
-	return v;
-}
+DEBUG_GET_ONCE_NUM_OPTION(converter_workers, "U_SINK_CONVERTER_WORKERS", 0)
+DEBUG_GET_ONCE_NUM_OPTION(converter_pool_threads, "U_SINK_CONVERTER_POOL_THREADS", 4)
 
-static inline uint32_t
-YUV444_to_RGBX8888(int y, int u, int v)
+//! Stripes smaller than this are not worth the dispatch.
+#define MIN_STRIPE_ROWS 32
+
+static pthread_mutex_t g_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct u_worker_thread_pool *g_pool = NULL;
+static uint32_t g_pool_users = 0;
+
+static struct u_worker_thread_pool *
+shared_pool_get(void)
 {
-	int C = y - 16;
-	int D = u - 128;
-	int E = v - 128;
+	struct u_worker_thread_pool *pool = NULL;
 
-	int R = clamp_to_byte((298 * C + 409 * E + 128) >> 8);
-	int G = clamp_to_byte((298 * C - 100 * D - 209 * E + 128) >> 8);
-	int B = clamp_to_byte((298 * C + 516 * D + 128) >> 8);
+	pthread_mutex_lock(&g_pool_mutex);
+	if (g_pool == NULL) {
+		int64_t option = debug_get_num_option_converter_pool_threads();
+		uint32_t threads = option < 2 ? 2 : (uint32_t)option;
+		if (threads > U_WORKER_THREAD_POOL_MAX_THREADS) {
+			U_LOG_W("U_SINK_CONVERTER_POOL_THREADS %u is too many, using %u", threads,
+			        U_WORKER_THREAD_POOL_MAX_THREADS);
+			threads = U_WORKER_THREAD_POOL_MAX_THREADS;
+		}
+		// The waiting thread counts as one, see u_worker_group_wait_all.
+		g_pool = u_worker_thread_pool_create(threads - 1, threads, "Sink Converter");
+	}
+	// Callers convert on their own thread without a pool.
+	if (g_pool != NULL) {
+		g_pool_users++;
+		u_worker_thread_pool_reference(&pool, g_pool);
+	}
+	pthread_mutex_unlock(&g_pool_mutex);
 
-	return B << 16 | G << 8 | R;
+	return pool;
 }
 
-#undef USE_TABLE
-#ifdef USE_TABLE
-static uint32_t lookup_YUV_to_RGBX[256][256][256] = {0};
-
 static void
-generate_lookup_YUV_to_RGBX()
+shared_pool_put(struct u_worker_thread_pool **pool_ptr)
 {
-	if (lookup_YUV_to_RGBX[255][255][255] != 0) {
+	if (*pool_ptr == NULL) {
 		return;
 	}
 
-	int y;
-	int u;
-	int v;
-
-	for (y = 0; y < 256; y++) {
-		for (u = 0; u < 256; u++) {
-			for (v = 0; v < 256; v++) {
-				lookup_YUV_to_RGBX[y][u][v] = YUV444_to_RGBX8888(y, u, v);
-			}
-		}
+	pthread_mutex_lock(&g_pool_mutex);
+	u_worker_thread_pool_reference(pool_ptr, NULL);
+	if (--g_pool_users == 0) {
+		u_worker_thread_pool_reference(&g_pool, NULL);
 	}
+	pthread_mutex_unlock(&g_pool_mutex);
 }
-#endif
 
-XRT_MAYBE_UNUSED inline static void
-YUYV422_to_R8G8B8X8(const uint8_t *input, uint32_t *rgb1, uint32_t *rgb2)
+static void
+set_worker_count(struct u_sink_converter *s, uint32_t worker_count)
 {
-	uint8_t y0 = input[0];
-	uint8_t u = input[1];
-	uint8_t y1 = input[2];
-	uint8_t v = input[3];
+	u_worker_group_reference(&s->group, NULL);
+	shared_pool_put(&s->pool);
 
-#ifdef USE_TABLE
-	*rgb1 = lookup_YUV_to_RGBX[y0][u][v];
-	*rgb2 = lookup_YUV_to_RGBX[y1][u][v];
-#else
-	*rgb1 = YUV444_to_RGBX8888(y0, u, v);
-	*rgb2 = YUV444_to_RGBX8888(y1, u, v);
-#endif
+	s->worker_count = worker_count > U_WORKER_ROWS_MAX_STRIPES ? U_WORKER_ROWS_MAX_STRIPES : worker_count;
+	if (s->worker_count > 1) {
+		s->pool = shared_pool_get();
+	}
+	if (s->pool != NULL) {
+		s->group = u_worker_group_create(s->pool);
+	}
 }
 
-inline static void
-YUYV422_to_R8G8B8(const uint8_t *input, uint8_t *dst)
+static void
+convert_rows_stripe(void *ptr, uint32_t first_row, uint32_t row_count)
 {
-	uint8_t y0 = input[0];
-	uint8_t u = input[1];
-	uint8_t y1 = input[2];
-	uint8_t v = input[3];
+	const struct convert_rows_args *args = (const struct convert_rows_args *)ptr;
 
-#ifdef USE_TABLE
-	uint8_t *rgb1 = (uint8_t *)&lookup_YUV_to_RGBX[y0][u][v];
-	uint8_t *rgb2 = (uint8_t *)&lookup_YUV_to_RGBX[y1][u][v];
-#else
-	uint32_t rgb1v = YUV444_to_RGBX8888(y0, u, v);
-	uint32_t rgb2v = YUV444_to_RGBX8888(y1, u, v);
-	uint8_t *rgb1 = (uint8_t *)&rgb1v;
-	uint8_t *rgb2 = (uint8_t *)&rgb2v;
-#endif
+	// A view of the destination rows, only has the fields the conversion functions use.
+	struct xrt_frame dst;
+	U_ZERO(&dst);
+	dst.format = args->dst_frame->format;
+	dst.width = args->w;
+	dst.height = row_count;
+	dst.stride = args->dst_frame->stride;
+	dst.data = args->dst_frame->data + (size_t)first_row * dst.stride;
 
-	dst[0] = rgb1[0];
-	dst[1] = rgb1[1];
-	dst[2] = rgb1[2];
-	dst[3] = rgb2[0];
-	dst[4] = rgb2[1];
-	dst[5] = rgb2[2];
-}
-
-inline static void
-UYVY422_to_R8G8B8(const uint8_t *input, uint8_t *dst)
-{
-	uint8_t u = input[0];
-	uint8_t y0 = input[1];
-	uint8_t v = input[2];
-	uint8_t y1 = input[3];
-
-#ifdef USE_TABLE
-	uint8_t *rgb1 = (uint8_t *)&lookup_YUV_to_RGBX[y0][u][v];
-	uint8_t *rgb2 = (uint8_t *)&lookup_YUV_to_RGBX[y1][u][v];
-#else
-	uint32_t rgb1v = YUV444_to_RGBX8888(y0, u, v);
-	uint32_t rgb2v = YUV444_to_RGBX8888(y1, u, v);
-	uint8_t *rgb1 = (uint8_t *)&rgb1v;
-	uint8_t *rgb2 = (uint8_t *)&rgb2v;
-#endif
+	const uint8_t *data = args->data + (size_t)first_row * args->src_rows * args->stride;
 
-	dst[0] = rgb1[0];
-	dst[1] = rgb1[1];
-	dst[2] = rgb1[2];
-	dst[3] = rgb2[0];
-	dst[4] = rgb2[1];
-	dst[5] = rgb2[2];
+	args->func(&dst, args->w, row_count, args->stride, data);
 }
 
-inline static void
-YUV444_to_R8G8B8(const uint8_t *input, uint8_t *dst)
-{
-	uint8_t y = input[0];
-	uint8_t u = input[1];
-	uint8_t v = input[2];
+/*!
+ * Runs @p func over the frame, split into row stripes on the shared pool if
+ * this sink has workers. @p src_rows is the number of source rows per
+ * destination row, two for the Bayer conversion.
+ */
+static void
+convert_rows(struct u_sink_converter *s,
+             convert_rows_func_t func,
+             struct xrt_frame *dst_frame,
+             uint32_t w,
+             uint32_t h,
+             size_t stride,
+             const uint8_t *data,
+             uint32_t src_rows)
+{
+	if (s->group == NULL) {
+		func(dst_frame, w, h, stride, data);
+		return;
+	}
 
-#ifdef USE_TABLE
-	uint8_t *rgb = (uint8_t *)&lookup_YUV_to_RGBX[y][u][v];
-#else
-	uint32_t rgbv = YUV444_to_RGBX8888(y, u, v);
-	uint8_t *rgb = (uint8_t *)&rgbv;
-#endif
+	struct convert_rows_args args = {
+	    .func = func,
+	    .dst_frame = dst_frame,
+	    .w = w,
+	    .stride = stride,
+	    .data = data,
+	    .src_rows = src_rows,
+	};
 
-	dst[0] = rgb[0];
-	dst[1] = rgb[1];
-	dst[2] = rgb[2];
+	u_worker_group_run_rows(s->group, h, s->worker_count, MIN_STRIPE_ROWS, convert_rows_stripe, &args);
 }
 
+
+/*
+ *
+ * L8 functions.
+ *
+ */
+
 static void
-from_YUYV422_to_R8G8B8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t stride, const uint8_t *data)
+from_L8_to_R8G8B8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t stride, const uint8_t *data)
 {
 	SINK_TRACE_MARKER();
 
 	for (uint32_t y = 0; y < h; y++) {
-		for (uint32_t x = 0; x < w; x += 2) {
+		for (uint32_t x = 0; x < w; x += 1) {
 			const uint8_t *src = data;
 			uint8_t *dst = dst_frame->data;
 
-			src = src + (y * stride) + (x * 2);
+			src = src + (y * stride) + x;
 			dst = dst + (y * dst_frame->stride) + (x * 3);
-			YUYV422_to_R8G8B8(src, dst);
+			dst[2] = dst[1] = dst[0] = src[0];
 		}
 	}
 }
 
+
+/*
+ *
+ * YUV functions.
+ *
+ */
+
+static void
+from_YUYV422_to_R8G8B8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t stride, const uint8_t *data)
+{
+	SINK_TRACE_MARKER();
+
+	enum u_yuv_convert_impl impl = u_yuv_convert_best_impl();
+
+	for (uint32_t y = 0; y < h; y++) {
+		const uint8_t *src = data + (y * stride);
+		uint8_t *dst = dst_frame->data + (y * dst_frame->stride);
+
+		u_yuv_convert_yuyv422_to_r8g8b8(impl, src, dst, w);
+	}
+}
+
 static void
 from_YUYV422_to_L8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t stride, const uint8_t *data)
 {
@@ -251,33 +265,28 @@ from_UYVY422_to_R8G8B8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size
 {
 	SINK_TRACE_MARKER();
 
+	enum u_yuv_convert_impl impl = u_yuv_convert_best_impl();
+
 	for (uint32_t y = 0; y < h; y++) {
-		for (uint32_t x = 0; x < w; x += 2) {
-			const uint8_t *src = data;
-			uint8_t *dst = dst_frame->data;
+		const uint8_t *src = data + (y * stride);
+		uint8_t *dst = dst_frame->data + (y * dst_frame->stride);
 
-			src = src + (y * stride) + (x * 2);
-			dst = dst + (y * dst_frame->stride) + (x * 3);
-			UYVY422_to_R8G8B8(src, dst);
-		}
+		u_yuv_convert_uyvy422_to_r8g8b8(impl, src, dst, w);
 	}
 }
 
-
 static void
 from_YUV888_to_R8G8B8(struct xrt_frame *dst_frame, uint32_t w, uint32_t h, size_t stride, const uint8_t *data)
 {
 	SINK_TRACE_MARKER();
 
+	enum u_yuv_convert_impl impl = u_yuv_convert_best_impl();
+
 	for (uint32_t y = 0; y < h; y++) {
-		for (uint32_t x = 0; x < w; x++) {
-			const uint8_t *src = data;
-			uint8_t *dst = dst_frame->data;
+		const uint8_t *src = data + (y * stride);
+		uint8_t *dst = dst_frame->data + (y * dst_frame->stride);
 
-			src = src + (y * stride) + (x * 3);
-			dst = dst + (y * dst_frame->stride) + (x * 3);
-			YUV444_to_R8G8B8(src, dst);
-		}
+		u_yuv_convert_yuv888_to_r8g8b8(impl, src, dst, w);
 	}
 }
 
@@ -490,7 +499,7 @@ convert_frame_l8(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 		if (!create_frame_with_format(xf, XRT_FORMAT_L8, &converted)) {
 			return;
 		}
-		from_YUYV422_to_L8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_YUYV422_to_L8, converted, xf->width, xf->height, xf->stride, xf->data, 1);
 		break;
 	default: U_LOG_E("Cannot convert from '%s' to L8!", u_format_str(xf->format)); return;
 	}
@@ -519,25 +528,25 @@ convert_frame_r8g8b8_or_l8(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 		if (!create_frame_with_format_of_size(xf, w, h, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_BAYER_GR8_to_R8G8B8(converted, w, h, xf->stride, xf->data);
+		convert_rows(s, from_BAYER_GR8_to_R8G8B8, converted, w, h, xf->stride, xf->data, 2);
 		break;
 	case XRT_FORMAT_YUYV422:
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_YUYV422_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_YUYV422_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data, 1);
 		break;
 	case XRT_FORMAT_UYVY422:
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_UYVY422_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_UYVY422_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data, 1);
 		break;
 	case XRT_FORMAT_YUV888:
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_YUV888_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_YUV888_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data, 1);
 		break;
 #ifdef XRT_HAVE_JPEG
 	case XRT_FORMAT_MJPEG:
@@ -593,19 +602,19 @@ convert_frame_r8g8b8_bayer_or_l8(struct xrt_frame_sink *xs, struct xrt_frame *xf
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_YUYV422_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_YUYV422_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data, 1);
 		break;
 	case XRT_FORMAT_UYVY422:
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_UYVY422_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_UYVY422_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data, 1);
 		break;
 	case XRT_FORMAT_YUV888:
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_YUV888_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_YUV888_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data, 1);
 		break;
 #ifdef XRT_HAVE_JPEG
 	case XRT_FORMAT_MJPEG:
@@ -643,7 +652,7 @@ convert_frame_r8g8b8(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_L8_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_L8_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data, 1);
 		break;
 	case XRT_FORMAT_BAYER_GR8:;
 		uint32_t w = xf->width / 2;
@@ -651,25 +660,25 @@ convert_frame_r8g8b8(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 		if (!create_frame_with_format_of_size(xf, w, h, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_BAYER_GR8_to_R8G8B8(converted, w, h, xf->stride, xf->data);
+		convert_rows(s, from_BAYER_GR8_to_R8G8B8, converted, w, h, xf->stride, xf->data, 2);
 		break;
 	case XRT_FORMAT_YUYV422:
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_YUYV422_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_YUYV422_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data, 1);
 		break;
 	case XRT_FORMAT_UYVY422:
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_UYVY422_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_UYVY422_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data, 1);
 		break;
 	case XRT_FORMAT_YUV888:
 		if (!create_frame_with_format(xf, XRT_FORMAT_R8G8B8, &converted)) {
 			return;
 		}
-		from_YUV888_to_R8G8B8(converted, xf->width, xf->height, xf->stride, xf->data);
+		convert_rows(s, from_YUV888_to_R8G8B8, converted, xf->width, xf->height, xf->stride, xf->data, 1);
 		break;
 #ifdef XRT_HAVE_JPEG
 	case XRT_FORMAT_MJPEG:
@@ -812,7 +821,7 @@ convert_frame_bayer(struct xrt_frame_sink *xs, struct xrt_frame *xf)
 		return;
 	}
 
-	from_BAYER_GR8_to_R8G8B8(converted, w, h, xf->stride, xf->data);
+	convert_rows(s, from_BAYER_GR8_to_R8G8B8, converted, w, h, xf->stride, xf->data, 2);
 
 	s->downstream->push_frame(s->downstream, converted);
 
@@ -829,6 +838,8 @@ destroy(struct xrt_frame_node *node)
 {
 	struct u_sink_converter *s = container_of(node, struct u_sink_converter, node);
 
+	set_worker_count(s, 0);
+
 	free(s);
 }
 
@@ -855,15 +866,12 @@ u_sink_create_format_converter(struct xrt_frame_context *xfctx,
 	default: U_LOG_E("Format '%s' not supported", u_format_str(format)); return;
 	}
 
-#ifdef USE_TABLE
-	generate_lookup_YUV_to_RGBX();
-#endif
-
 	struct u_sink_converter *s = U_TYPED_CALLOC(struct u_sink_converter);
 	s->base.push_frame = func;
 	s->node.break_apart = break_apart;
 	s->node.destroy = destroy;
 	s->downstream = downstream;
+	set_worker_count(s, (uint32_t)debug_get_num_option_converter_workers());
 
 	xrt_frame_context_add(xfctx, &s->node);
 
@@ -882,10 +890,7 @@ u_sink_create_to_r8g8b8_or_l8(struct xrt_frame_context *xfctx,
 	s->node.break_apart = break_apart;
 	s->node.destroy = destroy;
 	s->downstream = downstream;
-
-#ifdef USE_TABLE
-	generate_lookup_YUV_to_RGBX();
-#endif
+	set_worker_count(s, (uint32_t)debug_get_num_option_converter_workers());
 
 	xrt_frame_context_add(xfctx, &s->node);
 
@@ -904,10 +909,7 @@ u_sink_create_to_r8g8b8_r8g8b8a8_r8g8b8x8_or_l8(struct xrt_frame_context *xfctx,
 	s->node.break_apart = break_apart;
 	s->node.destroy = destroy;
 	s->downstream = downstream;
-
-#ifdef USE_TABLE
-	generate_lookup_YUV_to_RGBX();
-#endif
+	set_worker_count(s, (uint32_t)debug_get_num_option_converter_workers());
 
 	xrt_frame_context_add(xfctx, &s->node);
 
@@ -926,6 +928,7 @@ u_sink_create_to_r8g8b8_bayer_or_l8(struct xrt_frame_context *xfctx,
 	s->node.break_apart = break_apart;
 	s->node.destroy = destroy;
 	s->downstream = downstream;
+	set_worker_count(s, (uint32_t)debug_get_num_option_converter_workers());
 
 	xrt_frame_context_add(xfctx, &s->node);
 
@@ -944,6 +947,7 @@ u_sink_create_to_rgb_yuv_yuyv_uyvy_or_l8(struct xrt_frame_context *xfctx,
 	s->node.break_apart = break_apart;
 	s->node.destroy = destroy;
 	s->downstream = downstream;
+	set_worker_count(s, (uint32_t)debug_get_num_option_converter_workers());
 
 	xrt_frame_context_add(xfctx, &s->node);
 
@@ -962,6 +966,7 @@ u_sink_create_to_yuv_yuyv_uyvy_or_l8(struct xrt_frame_context *xfctx,
 	s->node.break_apart = break_apart;
 	s->node.destroy = destroy;
 	s->downstream = downstream;
+	set_worker_count(s, (uint32_t)debug_get_num_option_converter_workers());
 
 	xrt_frame_context_add(xfctx, &s->node);
 
@@ -980,8 +985,33 @@ u_sink_create_to_yuv_or_yuyv(struct xrt_frame_context *xfctx,
 	s->node.break_apart = break_apart;
 	s->node.destroy = destroy;
 	s->downstream = downstream;
+	set_worker_count(s, (uint32_t)debug_get_num_option_converter_workers());
 
 	xrt_frame_context_add(xfctx, &s->node);
 
 	*out_xfs = &s->base;
 }
+
+bool
+u_sink_converter_set_worker_count(struct xrt_frame_sink *xfs, uint32_t worker_count)
+{
+	// Only the converter sinks can be cast to one.
+	bool is_converter = xfs->push_frame == convert_frame_r8g8b8 ||
+	                    xfs->push_frame == convert_frame_l8 ||
+	                    xfs->push_frame == convert_frame_r8g8b8_or_l8 ||
+	                    xfs->push_frame == convert_frame_r8g8b8_r8g8b8a8_r8g8b8x8_or_l8 ||
+	                    xfs->push_frame == convert_frame_r8g8b8_bayer_or_l8 ||
+	                    xfs->push_frame == convert_frame_rgb_yuv_yuyv_uyvy_or_l8 ||
+	                    xfs->push_frame == convert_frame_yuv_yuyv_uyvy_or_l8 ||
+	                    xfs->push_frame == convert_frame_yuv_or_yuyv;
+	if (!is_converter) {
+		U_LOG_E("Not a converter sink");
+		return false;
+	}
+
+	struct u_sink_converter *s = (struct u_sink_converter *)xfs;
+
+	set_worker_count(s, worker_count);
+
+	return true;
+}
@@ -14,17 +14,19 @@
 #include <stdio.h>
 #include <pthread.h>
 
-struct u_sink_queue_elem
-{
-	struct xrt_frame *frame;
-	struct u_sink_queue_elem *next;
-};
+/*!
+ * Initial capacity of the ring buffer for unbounded queues, it grows as needed.
+ */
+#define UNBOUNDED_INITIAL_CAPACITY (16)
 
 /*!
  * An @ref xrt_frame_sink queue, any frames received will be pushed to the
  * downstream consumer on the queue thread. Will drop frames should multiple
  * frames be queued up.
  *
+ * The frames are kept in a ring buffer, so queueing a frame does not allocate
+ * anything, only unbounded queues grows the ring when it is full.
+ *
  * @implements xrt_frame_sink
  * @implements xrt_frame_node
  */
@@ -38,18 +40,24 @@ struct u_sink_queue
 	//! The consumer of the frames that are queued.
 	struct xrt_frame_sink *consumer;
 
-	//! Front of the queue (oldest frame, first to be consumed)
-	struct u_sink_queue_elem *front;
+	//! Ring buffer of queued frames.
+	struct xrt_frame **frames;
 
-	//! Back of the queue (newest frame, back->next is always null)
-	struct u_sink_queue_elem *back;
+	//! Number of slots in @ref frames.
+	uint64_t capacity;
+
+	//! Index of the front of the queue (oldest frame, first to be consumed)
+	uint64_t front;
 
 	//! Number of currently enqueued frames
 	uint64_t size;
 
-	//! Max amount of frames before dropping new ones. 0 means unbounded.
+	//! Max amount of frames before dropping frames. 0 means unbounded.
 	uint64_t max_size;
 
+	//! Which frame to drop when full.
+	enum u_sink_queue_drop_policy drop_policy;
+
 	pthread_t thread;
 	pthread_mutex_t mutex;
 
@@ -81,35 +89,58 @@ static struct xrt_frame *
 queue_pop(struct u_sink_queue *q)
 {
 	assert(!queue_is_empty(q));
-	struct xrt_frame *frame = q->front->frame;
-	struct u_sink_queue_elem *old_front = q->front;
-	q->front = q->front->next;
-	free(old_front);
+	struct xrt_frame *frame = q->frames[q->front];
+	q->frames[q->front] = NULL;
+	q->front = (q->front + 1) % q->capacity;
 	q->size--;
-	if (q->front == NULL) {
-		assert(queue_is_empty(q));
-		q->back = NULL;
-	}
 	return frame;
 }
 
+//! Doubles the size of the ring buffer, only used for unbounded queues.
+//! Call with q->mutex locked.
+static bool
+queue_grow(struct u_sink_queue *q)
+{
+	uint64_t new_capacity = q->capacity * 2;
+	struct xrt_frame **frames = U_TYPED_ARRAY_CALLOC(struct xrt_frame *, new_capacity);
+	if (frames == NULL) {
+		return false;
+	}
+
+	// Unwrap the ring so the front ends up at index zero.
+	for (uint64_t i = 0; i < q->size; i++) {
+		frames[i] = q->frames[(q->front + i) % q->capacity];
+	}
+
+	free(q->frames);
+	q->frames = frames;
+	q->capacity = new_capacity;
+	q->front = 0;
+
+	return true;
+}
+
 //! Tries to push a frame and increases its reference count.
 //! Call with q->mutex locked.
 static bool
 queue_try_refpush(struct u_sink_queue *q, struct xrt_frame *xf)
 {
 	if (queue_is_full(q)) {
-		return false;
+		if (q->drop_policy != U_SINK_QUEUE_DROP_OLDEST) {
+			return false;
+		}
+
+		// Make room by dropping the oldest frame.
+		struct xrt_frame *old = queue_pop(q);
+		xrt_frame_reference(&old, NULL);
 	}
-	struct u_sink_queue_elem *elem = U_TYPED_CALLOC(struct u_sink_queue_elem);
-	xrt_frame_reference(&elem->frame, xf);
-	elem->next = NULL;
-	if (q->back == NULL) { // First frame
-		q->front = elem;
-	} else { // Next frame
-		q->back->next = elem;
+
+	if (q->size >= q->capacity && !queue_grow(q)) {
+		return false;
 	}
-	q->back = elem;
+
+	uint64_t back = (q->front + q->size) % q->capacity;
+	xrt_frame_reference(&q->frames[back], xf);
 	q->size++;
 	return true;
 }
@@ -120,7 +151,6 @@ static void
 queue_refclear(struct u_sink_queue *q)
 {
 	while (!queue_is_empty(q)) {
-		assert((q->size > 1) ^ (q->front == q->back));
 		struct xrt_frame *xf = queue_pop(q);
 		xrt_frame_reference(&xf, NULL);
 	}
@@ -240,6 +270,7 @@ queue_destroy(struct xrt_frame_node *node)
 	// Destroy resources.
 	pthread_mutex_destroy(&q->mutex);
 	pthread_cond_destroy(&q->cond);
+	free(q->frames);
 	free(q);
 }
 
@@ -255,6 +286,21 @@ u_sink_queue_create(struct xrt_frame_context *xfctx,
                     uint64_t max_size,
                     struct xrt_frame_sink *downstream,
                     struct xrt_frame_sink **out_xfs)
+{
+	return u_sink_queue_create_with_drop_policy( //
+	    xfctx,                                   //
+	    max_size,                                //
+	    U_SINK_QUEUE_DROP_NEWEST,                //
+	    downstream,                              //
+	    out_xfs);                                //
+}
+
+bool
+u_sink_queue_create_with_drop_policy(struct xrt_frame_context *xfctx,
+                                     uint64_t max_size,
+                                     enum u_sink_queue_drop_policy drop_policy,
+                                     struct xrt_frame_sink *downstream,
+                                     struct xrt_frame_sink **out_xfs)
 {
 	struct u_sink_queue *q = U_TYPED_CALLOC(struct u_sink_queue);
 	int ret = 0;
@@ -266,10 +312,21 @@ u_sink_queue_create(struct xrt_frame_context *xfctx,
 	q->running = true;
 
 	q->size = 0;
+	q->front = 0;
 	q->max_size = max_size;
+	q->drop_policy = drop_policy;
+
+	// Bounded queues never need to grow.
+	q->capacity = max_size != 0 ? max_size : UNBOUNDED_INITIAL_CAPACITY;
+	q->frames = U_TYPED_ARRAY_CALLOC(struct xrt_frame *, q->capacity);
+	if (q->frames == NULL) {
+		free(q);
+		return false;
+	}
 
 	ret = pthread_mutex_init(&q->mutex, NULL);
 	if (ret != 0) {
+		free(q->frames);
 		free(q);
 		return false;
 	}
@@ -277,6 +334,7 @@ u_sink_queue_create(struct xrt_frame_context *xfctx,
 	ret = pthread_cond_init(&q->cond, NULL);
 	if (ret) {
 		pthread_mutex_destroy(&q->mutex);
+		free(q->frames);
 		free(q);
 		return false;
 	}
@@ -285,6 +343,7 @@ u_sink_queue_create(struct xrt_frame_context *xfctx,
 	if (ret != 0) {
 		pthread_cond_destroy(&q->cond);
 		pthread_mutex_destroy(&q->mutex);
+		free(q->frames);
 		free(q);
 		return false;
 	}
@@ -18,6 +18,7 @@
 #include "math/m_space.h"
 
 #include "util/u_misc.h"
+#include "util/u_debug.h"
 #include "util/u_hashmap.h"
 #include "util/u_logging.h"
 #include "util/u_space_overseer.h"
@@ -32,6 +33,15 @@
  *
  */
 
+/*!
+ * How long a memoised device pose is used for, a new sample may have arrived
+ * after this. Zero turns the memo off.
+ */
+DEBUG_GET_ONCE_NUM_OPTION(pose_memo_ms, "XRT_SPACE_POSE_MEMO_MS", 2)
+
+//! Number of device poses remembered, a few devices times a few timestamps.
+#define U_SPACE_POSE_MEMO_SIZE 32
+
 /*!
  * Keeps track of what kind of space it is.
  */
@@ -75,6 +85,24 @@ struct u_space
 	};
 };
 
+/*!
+ * A device pose that has been queried, see @ref u_space_overseer::memo.
+ */
+struct u_space_pose_memo_entry
+{
+	struct xrt_device *xdev;
+	enum xrt_input_name xname;
+	uint64_t at_timestamp_ns;
+
+	//! When the device was queried, for the max age.
+	uint64_t queried_ns;
+
+	//! Only valid if it matches @ref u_space_overseer::memo::generation.
+	uint64_t generation;
+
+	struct xrt_space_relation relation;
+};
+
 /*!
  * Default implementation of the xrt_space_overseer object.
  */
@@ -109,6 +137,28 @@ struct u_space_overseer
 	 * spaces and that they share the same parent.
 	 */
 	bool can_do_local_spaces_recenter;
+
+	/*!
+	 * Device poses memoised on device, input and timestamp. Locating many
+	 * spaces for the same frame then only queries each device once, the
+	 * spaces themselves are cheap to walk. Has its own lock as locating
+	 * only takes the read lock of the graph.
+	 */
+	struct
+	{
+		pthread_mutex_t lock;
+
+		//! Bumped to drop all entries, when the graph changes.
+		uint64_t generation;
+
+		//! Entries older than this are not used, zero means never use.
+		uint64_t max_age_ns;
+
+		//! Next entry to replace.
+		uint32_t next;
+
+		struct u_space_pose_memo_entry entries[U_SPACE_POSE_MEMO_SIZE];
+	} memo;
 };
 
 
@@ -241,6 +291,67 @@ get_offset_or_ident_read_locked(const struct u_space *us, struct xrt_pose *offse
 }
 
 
+/*!
+ * Drops all memoised device poses, called with the write lock held when the
+ * graph changes.
+ */
+static void
+memo_invalidate(struct u_space_overseer *uso)
+{
+	pthread_mutex_lock(&uso->memo.lock);
+	uso->memo.generation++;
+	pthread_mutex_unlock(&uso->memo.lock);
+}
+
+/*!
+ * Gets the pose of a device, from the memo if the same device, input and
+ * timestamp was queried recently enough. The device is called without the memo
+ * lock held, so two threads may both query it, that is harmless.
+ */
+static void
+get_tracked_pose_memo(struct u_space_overseer *uso,
+                      struct xrt_device *xdev,
+                      enum xrt_input_name xname,
+                      uint64_t at_timestamp_ns,
+                      struct xrt_space_relation *out_relation)
+{
+	if (uso->memo.max_age_ns == 0) {
+		xrt_device_get_tracked_pose(xdev, xname, at_timestamp_ns, out_relation);
+		return;
+	}
+
+	uint64_t now_ns = os_monotonic_get_ns();
+
+	pthread_mutex_lock(&uso->memo.lock);
+	uint64_t generation = uso->memo.generation;
+	for (uint32_t i = 0; i < U_SPACE_POSE_MEMO_SIZE; i++) {
+		const struct u_space_pose_memo_entry *e = &uso->memo.entries[i];
+		if (e->xdev != xdev || e->xname != xname || e->at_timestamp_ns != at_timestamp_ns ||
+		    e->generation != generation || now_ns - e->queried_ns > uso->memo.max_age_ns) {
+			continue;
+		}
+
+		*out_relation = e->relation;
+		pthread_mutex_unlock(&uso->memo.lock);
+		return;
+	}
+	pthread_mutex_unlock(&uso->memo.lock);
+
+	xrt_device_get_tracked_pose(xdev, xname, at_timestamp_ns, out_relation);
+
+	pthread_mutex_lock(&uso->memo.lock);
+	struct u_space_pose_memo_entry *e = &uso->memo.entries[uso->memo.next];
+	uso->memo.next = (uso->memo.next + 1) % U_SPACE_POSE_MEMO_SIZE;
+	e->xdev = xdev;
+	e->xname = xname;
+	e->at_timestamp_ns = at_timestamp_ns;
+	e->queried_ns = now_ns;
+	e->generation = generation; // Stays invalid if the graph changed while querying.
+	e->relation = *out_relation;
+	pthread_mutex_unlock(&uso->memo.lock);
+}
+
+
 /*
  *
  * Reference space to device notification code.
@@ -287,7 +398,10 @@ notify_ref_space_usage_device(struct u_space_overseer *uso, enum xrt_reference_s
  * order.
  */
 static void
-push_then_traverse(struct xrt_relation_chain *xrc, struct u_space *space, uint64_t at_timestamp_ns)
+push_then_traverse(struct u_space_overseer *uso,
+                   struct xrt_relation_chain *xrc,
+                   struct u_space *space,
+                   uint64_t at_timestamp_ns)
 {
 	switch (space->type) {
 	case U_SPACE_TYPE_NULL: break; // No-op
@@ -296,7 +410,7 @@ push_then_traverse(struct xrt_relation_chain *xrc, struct u_space *space, uint64
 		assert(space->pose.xname != 0);
 
 		struct xrt_space_relation xsr;
-		xrt_device_get_tracked_pose(space->pose.xdev, space->pose.xname, at_timestamp_ns, &xsr);
+		get_tracked_pose_memo(uso, space->pose.xdev, space->pose.xname, at_timestamp_ns, &xsr);
 		m_relation_chain_push_relation(xrc, &xsr);
 	} break;
 	case U_SPACE_TYPE_OFFSET: m_relation_chain_push_pose_if_not_identity(xrc, &space->offset.pose); break;
@@ -305,7 +419,7 @@ push_then_traverse(struct xrt_relation_chain *xrc, struct u_space *space, uint64
 
 	// Please tail-call optimise this miss compiler.
 	assert(space->next != NULL);
-	push_then_traverse(xrc, space->next, at_timestamp_ns);
+	push_then_traverse(uso, xrc, space->next, at_timestamp_ns);
 }
 
 /*!
@@ -315,7 +429,10 @@ push_then_traverse(struct xrt_relation_chain *xrc, struct u_space *space, uint64
  * the reversed order.
  */
 static void
-traverse_then_push_inverse(struct xrt_relation_chain *xrc, struct u_space *space, uint64_t at_timestamp_ns)
+traverse_then_push_inverse(struct u_space_overseer *uso,
+                           struct xrt_relation_chain *xrc,
+                           struct u_space *space,
+                           uint64_t at_timestamp_ns)
 {
 	// Done traversing.
 	switch (space->type) {
@@ -327,7 +444,7 @@ traverse_then_push_inverse(struct xrt_relation_chain *xrc, struct u_space *space
 
 	// Can't tail-call optimise this one :(
 	assert(space->next != NULL);
-	traverse_then_push_inverse(xrc, space->next, at_timestamp_ns);
+	traverse_then_push_inverse(uso, xrc, space->next, at_timestamp_ns);
 
 	switch (space->type) {
 	case U_SPACE_TYPE_NULL: break; // No-op
@@ -336,7 +453,7 @@ traverse_then_push_inverse(struct xrt_relation_chain *xrc, struct u_space *space
 		assert(space->pose.xname != 0);
 
 		struct xrt_space_relation xsr;
-		xrt_device_get_tracked_pose(space->pose.xdev, space->pose.xname, at_timestamp_ns, &xsr);
+		get_tracked_pose_memo(uso, space->pose.xdev, space->pose.xname, at_timestamp_ns, &xsr);
 		m_relation_chain_push_inverted_relation(xrc, &xsr);
 	} break;
 	case U_SPACE_TYPE_OFFSET: m_relation_chain_push_inverted_pose_if_not_identity(xrc, &space->offset.pose); break;
@@ -355,8 +472,8 @@ build_relation_chain_read_locked(struct u_space_overseer *uso,
 	assert(base != NULL);
 	assert(target != NULL);
 
-	push_then_traverse(xrc, target, at_timestamp_ns);
-	traverse_then_push_inverse(xrc, base, at_timestamp_ns);
+	push_then_traverse(uso, xrc, target, at_timestamp_ns);
+	traverse_then_push_inverse(uso, xrc, base, at_timestamp_ns);
 }
 
 static void
@@ -683,6 +800,7 @@ recenter_local_spaces(struct xrt_space_overseer *xso)
 	// Update the offsets.
 	update_offset_write_locked(ulocal, &local_offset);
 	update_offset_write_locked(ulocal_floor, &local_floor_offset);
+	memo_invalidate(uso);
 
 	// Push the events.
 	union xrt_session_event xse = XRT_STRUCT_INIT;
@@ -733,6 +851,7 @@ destroy(struct xrt_space_overseer *xso)
 	u_hashmap_int_clear_and_call_for_each(uso->xdev_map, hashmap_unreference_space_items, uso);
 	u_hashmap_int_destroy(&uso->xdev_map);
 
+	pthread_mutex_destroy(&uso->memo.lock);
 	pthread_rwlock_destroy(&uso->lock);
 
 	free(uso);
@@ -764,6 +883,12 @@ u_space_overseer_create(struct xrt_session_event_sink *broadcast)
 	ret = pthread_rwlock_init(&uso->lock, NULL);
 	assert(ret == 0);
 
+	ret = pthread_mutex_init(&uso->memo.lock, NULL);
+	assert(ret == 0);
+	// A negative age would wrap around, treat it as disabled.
+	long memo_ms = debug_get_num_option_pose_memo_ms();
+	uso->memo.max_age_ns = memo_ms > 0 ? (uint64_t)memo_ms * U_TIME_1MS_IN_NS : 0;
+
 	ret = u_hashmap_int_create(&uso->xdev_map);
 	assert(ret == 0);
 
@@ -884,6 +1009,7 @@ u_space_overseer_link_space_to_device(struct u_space_overseer *uso, struct xrt_s
 	xrt_space_reference(&new_space, xs);
 
 	u_hashmap_int_insert(uso->xdev_map, (uint64_t)(intptr_t)xdev, new_space);
+	memo_invalidate(uso);
 
 	pthread_rwlock_unlock(&uso->lock);
 
@@ -0,0 +1,210 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Open addressing hash table used to implement the hashmap and hashset.
+ * @ingroup aux_util
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+
+namespace xrt::auxiliary::util {
+
+/*!
+ * A flat Robin Hood hash table, entries are stored in a single array and found
+ * by linear probing, where entries far away from their home slot take the
+ * place of those closer to theirs. Erasing shifts the following entries back
+ * so no tombstones are needed and lookups stay short.
+ *
+ * The table does not hash or compare keys itself, the user passes in the hash
+ * and an equality function, so the @p Entry can be anything that is cheap to
+ * copy. The hash should be well mixed, the low bits pick the home slot.
+ *
+ * @note Not safe for concurrent use, no locks built-in.
+ */
+template <typename Entry> class FlatHashTable
+{
+public:
+	//! How many entries are in the table?
+	size_t
+	size() const noexcept
+	{
+		return count;
+	}
+
+	//! Is the table empty?
+	bool
+	empty() const noexcept
+	{
+		return count == 0;
+	}
+
+	//! Find the entry with @p hash that @p eq returns true for.
+	template <typename Eq>
+	const Entry *
+	find(uint64_t hash, Eq &&eq) const
+	{
+		size_t i = 0;
+		return find_index(hash, eq, &i) ? &slots[i].entry : nullptr;
+	}
+
+	/*!
+	 * Insert @p entry, or replace the entry that @p eq returns true for.
+	 *
+	 * @return true if the entry was inserted.
+	 */
+	template <typename Eq>
+	bool
+	insert_or_assign(uint64_t hash, const Entry &entry, Eq &&eq)
+	{
+		size_t i = 0;
+		if (find_index(hash, eq, &i)) {
+			slots[i].entry = entry;
+			return false;
+		}
+
+		// Grow at 7/8 load, probes get long after that.
+		if ((count + 1) * 8 > slots.size() * 7) {
+			grow();
+		}
+
+		place(hash, entry);
+		count++;
+
+		return true;
+	}
+
+	/*!
+	 * Erase the entry that @p eq returns true for.
+	 *
+	 * @return true if an entry was erased.
+	 */
+	template <typename Eq>
+	bool
+	erase(uint64_t hash, Eq &&eq)
+	{
+		size_t i = 0;
+		if (!find_index(hash, eq, &i)) {
+			return false;
+		}
+
+		// Shift back the following entries that are not in their home slot.
+		size_t next = (i + 1) & mask;
+		while (slots[next].dist > 1) {
+			slots[i] = slots[next];
+			slots[i].dist--;
+			i = next;
+			next = (next + 1) & mask;
+		}
+		slots[i].dist = 0;
+		count--;
+
+		return true;
+	}
+
+	//! Call @p func with each entry, in no particular order.
+	template <typename Func>
+	void
+	for_each(Func &&func) const
+	{
+		for (const Slot &s : slots) {
+			if (s.dist != 0) {
+				func(s.entry);
+			}
+		}
+	}
+
+	//! Remove all entries, keeps the memory.
+	void
+	clear() noexcept
+	{
+		for (Slot &s : slots) {
+			s.dist = 0;
+		}
+		count = 0;
+	}
+
+
+private:
+	struct Slot
+	{
+		uint64_t hash;
+
+		//! Distance from the home slot plus one, zero means empty.
+		uint32_t dist;
+
+		Entry entry;
+	};
+
+	template <typename Eq>
+	bool
+	find_index(uint64_t hash, Eq &eq, size_t *out_index) const
+	{
+		if (count == 0) {
+			return false;
+		}
+
+		size_t i = hash & mask;
+		for (uint32_t dist = 1;; dist++, i = (i + 1) & mask) {
+			const Slot &s = slots[i];
+
+			// Would have taken this slot if it was in the table.
+			if (s.dist < dist) {
+				return false;
+			}
+			if (s.hash == hash && eq(s.entry)) {
+				*out_index = i;
+				return true;
+			}
+		}
+	}
+
+	//! Robin Hood placement of an entry known not to be in the table.
+	void
+	place(uint64_t hash, Entry entry)
+	{
+		Slot slot = {hash, 1, entry};
+
+		size_t i = hash & mask;
+		for (;; slot.dist++, i = (i + 1) & mask) {
+			Slot &s = slots[i];
+			if (s.dist == 0) {
+				s = slot;
+				return;
+			}
+			if (s.dist < slot.dist) {
+				std::swap(s, slot);
+			}
+		}
+	}
+
+	void
+	grow()
+	{
+		std::vector<Slot> old = std::move(slots);
+
+		size_t size = old.empty() ? 16 : old.size() * 2;
+		slots = std::vector<Slot>(size, Slot{0, 0, Entry{}});
+		mask = size - 1;
+
+		for (const Slot &s : old) {
+			if (s.dist != 0) {
+				place(s.hash, s.entry);
+			}
+		}
+	}
+
+
+private:
+	std::vector<Slot> slots = {};
+	size_t mask = 0;
+	size_t count = 0;
+};
+
+} // namespace xrt::auxiliary::util
@@ -2,14 +2,772 @@
 // SPDX-License-Identifier: BSL-1.0
 /*!
  * @file
- * @brief  C++ wrappers for workers.
+ * @brief  Work stealing worker pool and C++ wrappers for workers.
  * @author Jakob Bornecrantz <jakob@collabora.com>
  *
  * @ingroup aux_util
  */
 
+#include "os/os_threading.h"
+
+#include "util/u_logging.h"
+#include "util/u_worker.h"
 #include "util/u_worker.hpp"
+#include "util/u_trace_marker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <stdint.h>
+#include <stdio.h>
+
+
+#define MAX_TASK_COUNT (64)
+#define MAX_THREAD_COUNT (U_WORKER_THREAD_POOL_MAX_THREADS)
+#define SPIN_COUNT (16)
+
+static_assert((MAX_TASK_COUNT & (MAX_TASK_COUNT - 1)) == 0, "MAX_TASK_COUNT must be a power of two");
+
+struct group;
+struct pool;
+
+struct task
+{
+	//! Group this task was submitted from.
+	struct group *g;
+
+	//! Function.
+	u_worker_group_func_t func;
+
+	//! Function data.
+	void *data;
+};
+
+/*!
+ * Bounded lock-free multi-producer multi-consumer queue of tasks, this is
+ * Dmitry Vyukov's bounded MPMC queue. Each worker thread owns one, anybody
+ * may push to it and any worker thread may pop (steal) from it.
+ */
+struct task_queue
+{
+	struct cell
+	{
+		std::atomic<size_t> sequence;
+		struct task task;
+	};
+
+	struct cell cells[MAX_TASK_COUNT];
+
+	alignas(64) std::atomic<size_t> enqueue_pos;
+	alignas(64) std::atomic<size_t> dequeue_pos;
+};
+
+struct thread
+{
+	//! Pool this thread belongs to.
+	struct pool *p;
+
+	// Native thread.
+	struct os_thread thread;
+
+	//! Index in the pool, used to pick where to start stealing.
+	uint32_t index;
+
+	//! Thread name.
+	char name[64];
+
+	//! Tasks pushed to this thread, other threads may steal from it.
+	struct task_queue queue;
+};
+
+struct pool
+{
+	struct u_worker_thread_pool base;
+
+	//! Only used for threads going to sleep and being woken up.
+	struct os_mutex mutex;
+
+	struct
+	{
+		std::atomic<uint32_t> count;
+
+		//! Threads signalled but not yet running, avoids waking more threads than there are tasks.
+		std::atomic<uint32_t> waking;
+
+		struct os_cond cond;
+	} available; //!< For worker threads.
+
+	//! Number of tasks pushed to queues that has not been popped yet.
+	std::atomic<int64_t> queued_count;
+
+	//! Used to spread out tasks from non-worker threads over the queues.
+	std::atomic<uint32_t> submit_index;
+
+	//! Given at creation.
+	uint32_t initial_worker_limit;
+
+	//! Currently the number of works that can work, waiting increases this.
+	std::atomic<uint32_t> worker_limit;
+
+	//! Number of threads working on tasks.
+	std::atomic<uint32_t> working_count;
+
+	//! Number of created threads.
+	uint32_t thread_count;
+
+	//! The worker threads.
+	struct thread threads[MAX_THREAD_COUNT];
+
+	//! Is the pool up and running?
+	std::atomic<bool> running;
+
+	//! Prefix to use for thread names.
+	char prefix[32];
+};
+
+struct group
+{
+	//! Base struct has to come first.
+	struct u_worker_group base;
+
+	//! Pointer to poll of threads.
+	struct u_worker_thread_pool *uwtp;
+
+	//! Number of tasks that is pending or being worked on in this group.
+	std::atomic<int64_t> current_submitted_tasks_count;
+
+	//! Protects the waiting condition.
+	struct os_mutex mutex;
+
+	struct
+	{
+		std::atomic<uint32_t> count;
+		struct os_cond cond;
+	} waiting; //!< For wait_all
+};
+
+//! The worker thread the current thread is, if any.
+static thread_local struct thread *tl_thread = nullptr;
+
+
+/*
+ *
+ * Helper functions.
+ *
+ */
+
+static inline struct group *
+group(struct u_worker_group *uwg)
+{
+	return (struct group *)uwg;
+}
+
+static inline struct pool *
+pool(struct u_worker_thread_pool *uwtp)
+{
+	return (struct pool *)uwtp;
+}
+
+
+/*
+ *
+ * Task queue functions.
+ *
+ */
+
+static void
+queue_init(struct task_queue *q)
+{
+	for (size_t i = 0; i < MAX_TASK_COUNT; i++) {
+		q->cells[i].sequence.store(i, std::memory_order_relaxed);
+		q->cells[i].task = task{NULL, NULL, NULL};
+	}
+	q->enqueue_pos.store(0, std::memory_order_relaxed);
+	q->dequeue_pos.store(0, std::memory_order_relaxed);
+}
+
+static bool
+queue_push(struct task_queue *q, const struct task *t)
+{
+	struct task_queue::cell *cell;
+	size_t pos = q->enqueue_pos.load(std::memory_order_relaxed);
+
+	while (true) {
+		cell = &q->cells[pos & (MAX_TASK_COUNT - 1)];
+		size_t seq = cell->sequence.load(std::memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+		if (diff == 0) {
+			if (q->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			// Full.
+			return false;
+		} else {
+			pos = q->enqueue_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	cell->task = *t;
+	cell->sequence.store(pos + 1, std::memory_order_release);
+
+	return true;
+}
+
+static bool
+queue_pop(struct task_queue *q, struct task *out_task)
+{
+	struct task_queue::cell *cell;
+	size_t pos = q->dequeue_pos.load(std::memory_order_relaxed);
+
+	while (true) {
+		cell = &q->cells[pos & (MAX_TASK_COUNT - 1)];
+		size_t seq = cell->sequence.load(std::memory_order_acquire);
+		intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+		if (diff == 0) {
+			if (q->dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (diff < 0) {
+			// Empty.
+			return false;
+		} else {
+			pos = q->dequeue_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	*out_task = cell->task;
+	cell->sequence.store(pos + MAX_TASK_COUNT, std::memory_order_release);
+
+	return true;
+}
+
+
+/*
+ *
+ * Internal pool functions.
+ *
+ */
+
+static bool
+pool_has_work_for_thread(struct pool *p)
+{
+	// No tasks queued.
+	if (p->queued_count.load() <= 0) {
+		return false;
+	}
+
+	// The number of working threads is at the limit.
+	if (p->working_count.load() >= p->worker_limit.load()) {
+		return false;
+	}
+
+	return true;
+}
+
+static void
+pool_wake_worker_if_allowed(struct pool *p)
+{
+	// No waiting thread, checked without the lock, see pool_thread_wait_for_work.
+	if (p->available.count.load() == 0) {
+		return;
+	}
+
+	if (!pool_has_work_for_thread(p)) {
+		return;
+	}
+
+	// Enough threads are already on their way to pick up the work.
+	if (p->queued_count.load() <= (int64_t)p->available.waking.load()) {
+		return;
+	}
+
+	os_mutex_lock(&p->mutex);
+
+	/*
+	 * Only signal if there is a sleeping thread that has not already been
+	 * signalled, so every signal wakes a distinct thread and the waking
+	 * count can never be left higher than the threads actually waking up.
+	 */
+	if (p->available.count.load() > p->available.waking.load()) {
+		p->available.waking.fetch_add(1);
+		os_cond_signal(&p->available.cond);
+	}
+
+	os_mutex_unlock(&p->mutex);
+}
+
+static bool
+pool_push_task(struct pool *p, const struct task *t)
+{
+	uint32_t count = p->thread_count;
+	uint32_t start;
+
+	// Worker threads push to their own queue first for locality.
+	if (tl_thread != nullptr && tl_thread->p == p) {
+		start = tl_thread->index;
+	} else {
+		start = p->submit_index.fetch_add(1, std::memory_order_relaxed) % count;
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		struct thread *target = &p->threads[(start + i) % count];
+		if (queue_push(&target->queue, t)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool
+pool_pop_task(struct pool *p, struct thread *t, struct task *out_task)
+{
+	uint32_t count = p->thread_count;
+
+	// Own queue first, then steal from the others.
+	for (uint32_t i = 0; i < count; i++) {
+		struct thread *victim = &p->threads[(t->index + i) % count];
+		if (queue_pop(&victim->queue, out_task)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool
+pool_try_acquire_working_slot(struct pool *p)
+{
+	uint32_t working = p->working_count.load(std::memory_order_relaxed);
+
+	while (working < p->worker_limit.load()) {
+		if (p->working_count.compare_exchange_weak(working, working + 1)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void
+pool_release_working_slot(struct pool *p)
+{
+	p->working_count.fetch_sub(1);
+}
+
+
+/*
+ *
+ * Thread group functions.
+ *
+ */
+
+/*!
+ * The group may be destroyed as soon as a waiter sees the count reach zero,
+ * so only the last task touches the group after decrementing it, and it does
+ * so with the mutex held. Waiters only trust a zero count seen under the
+ * mutex, so they can't return before the last task is done with the group.
+ */
+static void
+group_task_done(struct group *g)
+{
+	int64_t count = g->current_submitted_tasks_count.load();
+	while (count > 1) {
+		if (g->current_submitted_tasks_count.compare_exchange_weak(count, count - 1)) {
+			return;
+		}
+	}
+
+	os_mutex_lock(&g->mutex);
+
+	// More tasks might have been pushed since the load above.
+	if (g->current_submitted_tasks_count.fetch_sub(1) == 1 && g->waiting.count.load() > 0) {
+		os_cond_broadcast(&g->waiting.cond);
+	}
+
+	os_mutex_unlock(&g->mutex);
+}
+
+static bool
+group_is_done(struct group *g)
+{
+	os_mutex_lock(&g->mutex);
+	bool done = g->current_submitted_tasks_count.load() == 0;
+	os_mutex_unlock(&g->mutex);
+
+	return done;
+}
+
+static void
+group_wait(struct group *g)
+{
+	// Tasks are usually short, give them a chance to finish before sleeping.
+	for (uint32_t i = 0; i < SPIN_COUNT; i++) {
+		if (g->current_submitted_tasks_count.load() == 0) {
+			break;
+		}
+		std::this_thread::yield();
+	}
+
+	os_mutex_lock(&g->mutex);
+
+	// Update tracking.
+	g->waiting.count.fetch_add(1);
+
+	while (g->current_submitted_tasks_count.load() > 0) {
+		// The wait, also unlocks the mutex.
+		os_cond_wait(&g->waiting.cond, &g->mutex);
+	}
+
+	// Update tracking.
+	g->waiting.count.fetch_sub(1);
+
+	os_mutex_unlock(&g->mutex);
+}
+
+
+/*
+ *
+ * Thread internal functions.
+ *
+ */
+
+static void
+pool_thread_wait_for_work(struct pool *p)
+{
+	// Work often comes in bursts, give it a chance to show up before sleeping.
+	for (uint32_t i = 0; i < SPIN_COUNT; i++) {
+		if (!p->running.load() || pool_has_work_for_thread(p)) {
+			return;
+		}
+		std::this_thread::yield();
+	}
+
+	os_mutex_lock(&p->mutex);
+
+	/*
+	 * Update tracking, this must be done before checking for work, any
+	 * thread adding work or raising the worker limit does so before
+	 * checking the count, so either we see the work or they see us.
+	 */
+	p->available.count.fetch_add(1);
+
+	if (p->running.load() && !pool_has_work_for_thread(p)) {
+		// The wait, also unlocks the mutex.
+		os_cond_wait(&p->available.cond, &p->mutex);
+
+		if (p->available.waking.load() > 0) {
+			p->available.waking.fetch_sub(1);
+		}
+	}
+
+	// Update tracking.
+	p->available.count.fetch_sub(1);
+
+	os_mutex_unlock(&p->mutex);
+}
+
+static void *
+run_func(void *ptr)
+{
+	struct thread *t = (struct thread *)ptr;
+	struct pool *p = t->p;
+
+	tl_thread = t;
+
+	snprintf(t->name, sizeof(t->name), "%s: Worker", p->prefix);
+	U_TRACE_SET_THREAD_NAME(t->name);
+
+	while (p->running.load()) {
+
+		if (!pool_try_acquire_working_slot(p)) {
+			pool_thread_wait_for_work(p);
+
+			// Check running first when woken up.
+			continue;
+		}
+
+		// Pop a task from our queue, or steal one from another thread.
+		struct task task = {NULL, NULL, NULL};
+		if (!pool_pop_task(p, t, &task)) {
+			pool_release_working_slot(p);
+			pool_thread_wait_for_work(p);
+
+			// Check running first when woken up.
+			continue;
+		}
+
+		p->queued_count.fetch_sub(1);
+
+		// Signal another thread if conditions are met.
+		pool_wake_worker_if_allowed(p);
+
+		// Do the actual work here.
+		task.func(task.data);
+
+		// No longer working.
+		pool_release_working_slot(p);
+
+		// Only now decrement the task count on the owning group, wakes up any waiter.
+		group_task_done(task.g);
+	}
+
+	tl_thread = nullptr;
+
+	return NULL;
+}
+
+
+/*
+ *
+ * 'Exported' thread pool functions.
+ *
+ */
+
+struct u_worker_thread_pool *
+u_worker_thread_pool_create(uint32_t starting_worker_count, uint32_t thread_count, const char *prefix)
+{
+	XRT_TRACE_MARKER();
+	int ret;
+
+	assert(starting_worker_count < thread_count);
+	if (starting_worker_count >= thread_count) {
+		return NULL;
+	}
+
+	assert(thread_count <= MAX_THREAD_COUNT);
+	if (thread_count > MAX_THREAD_COUNT) {
+		return NULL;
+	}
+
+	struct pool *p = new struct pool();
+	p->base.reference.count = 1;
+	p->initial_worker_limit = starting_worker_count;
+	p->worker_limit = starting_worker_count;
+	p->thread_count = thread_count;
+	p->running = true;
+	snprintf(p->prefix, sizeof(p->prefix), "%s", prefix);
+
+	ret = os_mutex_init(&p->mutex);
+	if (ret != 0) {
+		goto err_alloc;
+	}
+
+	ret = os_cond_init(&p->available.cond);
+	if (ret != 0) {
+		goto err_mutex;
+	}
+
+	for (uint32_t i = 0; i < thread_count; i++) {
+		p->threads[i].p = p;
+		p->threads[i].index = i;
+		queue_init(&p->threads[i].queue);
+	}
+
+	// Start the threads only once all queues are ready, they steal from each other.
+	for (uint32_t i = 0; i < thread_count; i++) {
+		os_thread_init(&p->threads[i].thread);
+		os_thread_start(&p->threads[i].thread, run_func, &p->threads[i]);
+	}
+
+	return (struct u_worker_thread_pool *)p;
+
+
+err_mutex:
+	os_mutex_destroy(&p->mutex);
+
+err_alloc:
+	delete p;
+
+	return NULL;
+}
+
+void
+u_worker_thread_pool_destroy(struct u_worker_thread_pool *uwtp)
+{
+	XRT_TRACE_MARKER();
+
+	struct pool *p = pool(uwtp);
+
+	p->running = false;
+
+	// Make sure all threads are woken up.
+	os_mutex_lock(&p->mutex);
+	os_cond_broadcast(&p->available.cond);
+	os_mutex_unlock(&p->mutex);
+
+	// Wait for all threads.
+	for (uint32_t i = 0; i < p->thread_count; i++) {
+		os_thread_join(&p->threads[i].thread);
+		os_thread_destroy(&p->threads[i].thread);
+	}
+
+	os_mutex_destroy(&p->mutex);
+	os_cond_destroy(&p->available.cond);
 
+	delete p;
+}
+
+
+/*
+ *
+ * 'Exported' group functions.
+ *
+ */
+
+struct u_worker_group *
+u_worker_group_create(struct u_worker_thread_pool *uwtp)
+{
+	XRT_TRACE_MARKER();
+
+	struct group *g = new struct group();
+	g->base.reference.count = 1;
+	u_worker_thread_pool_reference(&g->uwtp, uwtp);
+
+	os_mutex_init(&g->mutex);
+	os_cond_init(&g->waiting.cond);
+
+	return (struct u_worker_group *)g;
+}
+
+void
+u_worker_group_push(struct u_worker_group *uwg, u_worker_group_func_t f, void *data)
+{
+	XRT_TRACE_MARKER();
+
+	struct group *g = group(uwg);
+	struct pool *p = pool(g->uwtp);
+	struct task t = {g, f, data};
+
+	// Count the task before it can be popped and completed.
+	g->current_submitted_tasks_count.fetch_add(1);
+
+	while (!pool_push_task(p, &t)) {
+		group_task_done(g);
+
+		//! @todo Don't wait all, wait one.
+		u_worker_group_wait_all(uwg);
+
+		g->current_submitted_tasks_count.fetch_add(1);
+	}
+
+	p->queued_count.fetch_add(1);
+
+	// There are worker threads available, wake one up.
+	pool_wake_worker_if_allowed(p);
+}
+
+void
+u_worker_group_wait_all(struct u_worker_group *uwg)
+{
+	XRT_TRACE_MARKER();
+
+	struct group *g = group(uwg);
+	struct pool *p = pool(g->uwtp);
+
+	// Can we early out? Checked under the mutex, see group_task_done.
+	if (group_is_done(g)) {
+		return;
+	}
+
+	// "Donate" this thread, another worker can work while we wait.
+	p->worker_limit.fetch_add(1);
+	pool_wake_worker_if_allowed(p);
+
+	// Wait here until all work been started and completed.
+	group_wait(g);
+
+	// Remove the donation again.
+	assert(p->worker_limit.load() > p->initial_worker_limit);
+	p->worker_limit.fetch_sub(1);
+}
+
+namespace {
+
+struct rows_stripe
+{
+	u_worker_rows_func_t func;
+	void *data;
+	uint32_t first_row;
+	uint32_t row_count;
+};
+
+void
+rows_stripe_task(void *ptr)
+{
+	const rows_stripe *stripe = static_cast<const rows_stripe *>(ptr);
+
+	stripe->func(stripe->data, stripe->first_row, stripe->row_count);
+}
+
+} // namespace
+
+void
+u_worker_group_run_rows(struct u_worker_group *uwg,
+                        uint32_t row_count,
+                        uint32_t max_stripes,
+                        uint32_t min_stripe_rows,
+                        u_worker_rows_func_t func,
+                        void *data)
+{
+	uint32_t stripe_count = min_stripe_rows > 0 ? row_count / min_stripe_rows : row_count;
+	stripe_count = std::min(stripe_count, std::min(max_stripes, (uint32_t)U_WORKER_ROWS_MAX_STRIPES));
+
+	if (uwg == nullptr || stripe_count <= 1) {
+		func(data, 0, row_count);
+		return;
+	}
+
+	XRT_TRACE_MARKER();
+
+	rows_stripe stripes[U_WORKER_ROWS_MAX_STRIPES];
+	uint32_t rows = (row_count + stripe_count - 1) / stripe_count;
+
+	for (uint32_t i = 0; i < stripe_count; i++) {
+		uint32_t first_row = i * rows;
+		if (first_row >= row_count) {
+			// Rounding up the stripe size can leave nothing for the last ones.
+			break;
+		}
+
+		stripes[i].func = func;
+		stripes[i].data = data;
+		stripes[i].first_row = first_row;
+		stripes[i].row_count = std::min(rows, row_count - first_row);
+
+		u_worker_group_push(uwg, rows_stripe_task, &stripes[i]);
+	}
+
+	u_worker_group_wait_all(uwg);
+}
+
+void
+u_worker_group_destroy(struct u_worker_group *uwg)
+{
+	XRT_TRACE_MARKER();
+
+	struct group *g = group(uwg);
+	assert(g->base.reference.count == 0);
+
+	u_worker_group_wait_all(uwg);
+
+	u_worker_thread_pool_reference(&g->uwtp, NULL);
+
+	os_cond_destroy(&g->waiting.cond);
+	os_mutex_destroy(&g->mutex);
+
+	delete g;
+}
+
+
+/*
+ *
+ * C++ wrappers.
+ *
+ */
 
 void
 xrt::auxiliary::util::TaskCollection::cCallback(void *data_ptr)
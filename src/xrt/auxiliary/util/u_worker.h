@@ -24,9 +24,21 @@ extern "C" {
  *
  */
 
+/*!
+ * The most threads a pool can have, the @p thread_count given to
+ * @ref u_worker_thread_pool_create must not be larger.
+ *
+ * @ingroup aux_util
+ */
+#define U_WORKER_THREAD_POOL_MAX_THREADS (16)
+
 /*!
  * A worker pool, can shared between multiple groups worker pool.
  *
+ * Each thread in the pool has its own lock-free task queue, tasks are spread
+ * over the queues when pushed and idle threads steal tasks from the queues of
+ * other threads.
+ *
  * @ingroup aux_util
  */
 struct u_worker_thread_pool
@@ -121,6 +133,9 @@ u_worker_group_create(struct u_worker_thread_pool *uwtp);
 /*!
  * Push a new task to worker group.
  *
+ * Does not take any lock unless a sleeping worker thread needs waking up, or
+ * all queues are full in which case it waits for the group's tasks to finish.
+ *
  * @ingroup aux_util
  */
 void
@@ -135,6 +150,37 @@ u_worker_group_push(struct u_worker_group *uwg, u_worker_group_func_t f, void *d
 void
 u_worker_group_wait_all(struct u_worker_group *uwg);
 
+/*!
+ * Upper limit of stripes @ref u_worker_group_run_rows splits rows into.
+ *
+ * @ingroup aux_util
+ */
+#define U_WORKER_ROWS_MAX_STRIPES (16)
+
+/*!
+ * Function typedef for @ref u_worker_group_run_rows, handles @p row_count
+ * rows starting at @p first_row.
+ *
+ * @ingroup aux_util
+ */
+typedef void (*u_worker_rows_func_t)(void *data, uint32_t first_row, uint32_t row_count);
+
+/*!
+ * Splits @p row_count rows into at most @p max_stripes stripes of at least
+ * @p min_stripe_rows rows each, runs @p func on every stripe in the group and
+ * waits for them. If @p uwg is NULL or there would only be one stripe @p func
+ * is called once for all of the rows on this thread instead.
+ *
+ * @ingroup aux_util
+ */
+void
+u_worker_group_run_rows(struct u_worker_group *uwg,
+                        uint32_t row_count,
+                        uint32_t max_stripes,
+                        uint32_t min_stripe_rows,
+                        u_worker_rows_func_t func,
+                        void *data);
+
 /*!
  * Destroy a worker pool.
  *
@@ -0,0 +1,388 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Row kernels converting packed YUV formats to R8G8B8.
+ *
+ * The SIMD versions do the exact same integer math as the scalar code, only on
+ * 32-bit lanes, so the output is bit identical. The x86 kernels are compiled
+ * with function level target attributes and selected at runtime so the rest of
+ * the build does not need any special compiler flags.
+ *
+ * @ingroup aux_util
+ */
+
+#include "util/u_yuv_convert.h"
+#include "util/u_debug.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define U_YUV_CONVERT_HAVE_X86
+#include <immintrin.h>
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(__ARM_NEON)
+#define U_YUV_CONVERT_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+
+DEBUG_GET_ONCE_BOOL_OPTION(yuv_convert_scalar, "U_YUV_CONVERT_SCALAR", false)
+
+
+/*
+ *
+ * Layouts.
+ *
+ */
+
+/*!
+ * Where the components of a group of four pixels are, in bytes. For the 4:2:2
+ * formats the chroma of pixels 0/1 and 2/3 is shared.
+ */
+struct yuv_layout
+{
+	uint32_t bytes_per_pair; //!< Bytes per two pixels.
+	int8_t y[4];
+	int8_t u[4];
+	int8_t v[4];
+};
+
+static const struct yuv_layout layout_yuyv422 = {4, {0, 2, 4, 6}, {1, 1, 5, 5}, {3, 3, 7, 7}};
+static const struct yuv_layout layout_uyvy422 = {4, {1, 3, 5, 7}, {0, 0, 4, 4}, {2, 2, 6, 6}};
+static const struct yuv_layout layout_yuv888 = {6, {0, 3, 6, 9}, {1, 4, 7, 10}, {2, 5, 8, 11}};
+
+static inline size_t
+src_offset(const struct yuv_layout *l, uint32_t x)
+{
+	return (size_t)x * l->bytes_per_pair / 2;
+}
+
+
+/*
+ *
+ * Scalar.
+ *
+ */
+
+static inline uint8_t
+clamp_to_byte(int v)
+{
+	if (v < 0) {
+		return 0;
+	}
+	if (v >= 255) {
+		return 255;
+	}
+	return (uint8_t)v;
+}
+
+static inline void
+yuv_to_rgb(int y, int u, int v, uint8_t *dst)
+{
+	int C = y - 16;
+	int D = u - 128;
+	int E = v - 128;
+
+	dst[0] = clamp_to_byte((298 * C + 409 * E + 128) >> 8);
+	dst[1] = clamp_to_byte((298 * C - 100 * D - 209 * E + 128) >> 8);
+	dst[2] = clamp_to_byte((298 * C + 516 * D + 128) >> 8);
+}
+
+static void
+row_scalar(const struct yuv_layout *l, const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	if (l->bytes_per_pair == 6) {
+		for (uint32_t x = 0; x < width; x++, src += 3, dst += 3) {
+			yuv_to_rgb(src[l->y[0]], src[l->u[0]], src[l->v[0]], dst);
+		}
+		return;
+	}
+
+	// Odd widths have always converted a whole pair.
+	for (uint32_t x = 0; x < width; x += 2, src += 4, dst += 6) {
+		yuv_to_rgb(src[l->y[0]], src[l->u[0]], src[l->v[0]], dst);
+		yuv_to_rgb(src[l->y[1]], src[l->u[0]], src[l->v[0]], dst + 3);
+	}
+}
+
+
+/*
+ *
+ * SSE4.1 and AVX2, four pixels per 128-bit lane.
+ *
+ */
+
+#ifdef U_YUV_CONVERT_HAVE_X86
+
+//! Shuffle mask putting the four given bytes in the low byte of each 32-bit lane.
+TARGET_SSE41 static inline __m128i
+lane_mask(const int8_t idx[4])
+{
+	return _mm_setr_epi8(idx[0], -1, -1, -1, idx[1], -1, -1, -1, idx[2], -1, -1, -1, idx[3], -1, -1, -1);
+}
+
+//! Packs four R, G and B lanes into 12 bytes of R8G8B8, the last 4 bytes are garbage.
+TARGET_SSE41 static inline __m128i
+pack_rgb_sse41(__m128i r, __m128i g, __m128i b)
+{
+	// Saturating packs do the clamping: R0-3 G0-3 B0-3 B0-3.
+	__m128i bytes = _mm_packus_epi16(_mm_packs_epi32(r, g), _mm_packs_epi32(b, b));
+	return _mm_shuffle_epi8(bytes, _mm_setr_epi8(0, 4, 8, 1, 5, 9, 2, 6, 10, 3, 7, 11, -1, -1, -1, -1));
+}
+
+TARGET_SSE41 static uint32_t
+row_sse41(const struct yuv_layout *l, const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	const __m128i my = lane_mask(l->y);
+	const __m128i mu = lane_mask(l->u);
+	const __m128i mv = lane_mask(l->v);
+
+	uint32_t x = 0;
+
+	// Loads and stores 16 bytes for 4 pixels, keep enough of the row left.
+	for (; x + 8 <= width; x += 4) {
+		__m128i in = _mm_loadu_si128((const __m128i *)(src + src_offset(l, x)));
+
+		__m128i c = _mm_sub_epi32(_mm_shuffle_epi8(in, my), _mm_set1_epi32(16));
+		__m128i d = _mm_sub_epi32(_mm_shuffle_epi8(in, mu), _mm_set1_epi32(128));
+		__m128i e = _mm_sub_epi32(_mm_shuffle_epi8(in, mv), _mm_set1_epi32(128));
+
+		__m128i base = _mm_add_epi32(_mm_mullo_epi32(c, _mm_set1_epi32(298)), _mm_set1_epi32(128));
+		__m128i dg = _mm_mullo_epi32(d, _mm_set1_epi32(100));
+		__m128i eg = _mm_mullo_epi32(e, _mm_set1_epi32(209));
+
+		__m128i r = _mm_srai_epi32(_mm_add_epi32(base, _mm_mullo_epi32(e, _mm_set1_epi32(409))), 8);
+		__m128i g = _mm_srai_epi32(_mm_sub_epi32(_mm_sub_epi32(base, dg), eg), 8);
+		__m128i b = _mm_srai_epi32(_mm_add_epi32(base, _mm_mullo_epi32(d, _mm_set1_epi32(516))), 8);
+
+		_mm_storeu_si128((__m128i *)(dst + x * 3), pack_rgb_sse41(r, g, b));
+	}
+
+	return x;
+}
+
+TARGET_AVX2 static uint32_t
+row_avx2(const struct yuv_layout *l, const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	const __m256i my = _mm256_broadcastsi128_si256(lane_mask(l->y));
+	const __m256i mu = _mm256_broadcastsi128_si256(lane_mask(l->u));
+	const __m256i mv = _mm256_broadcastsi128_si256(lane_mask(l->v));
+	const size_t half = src_offset(l, 4);
+
+	uint32_t x = 0;
+
+	// Two groups of 4 pixels, one per lane, the second load and store go 12 pixels in.
+	for (; x + 12 <= width; x += 8) {
+		const uint8_t *s = src + src_offset(l, x);
+		__m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)s)),
+		                                     _mm_loadu_si128((const __m128i *)(s + half)), 1);
+
+		__m256i c = _mm256_sub_epi32(_mm256_shuffle_epi8(in, my), _mm256_set1_epi32(16));
+		__m256i d = _mm256_sub_epi32(_mm256_shuffle_epi8(in, mu), _mm256_set1_epi32(128));
+		__m256i e = _mm256_sub_epi32(_mm256_shuffle_epi8(in, mv), _mm256_set1_epi32(128));
+
+		__m256i base = _mm256_add_epi32(_mm256_mullo_epi32(c, _mm256_set1_epi32(298)), _mm256_set1_epi32(128));
+		__m256i dg = _mm256_mullo_epi32(d, _mm256_set1_epi32(100));
+		__m256i eg = _mm256_mullo_epi32(e, _mm256_set1_epi32(209));
+
+		__m256i r = _mm256_srai_epi32(_mm256_add_epi32(base, _mm256_mullo_epi32(e, _mm256_set1_epi32(409))), 8);
+		__m256i g = _mm256_srai_epi32(_mm256_sub_epi32(_mm256_sub_epi32(base, dg), eg), 8);
+		__m256i b = _mm256_srai_epi32(_mm256_add_epi32(base, _mm256_mullo_epi32(d, _mm256_set1_epi32(516))), 8);
+
+		// Packs work per lane, so each lane ends up with its own 12 bytes.
+		__m256i bytes = _mm256_packus_epi16(_mm256_packs_epi32(r, g), _mm256_packs_epi32(b, b));
+		bytes = _mm256_shuffle_epi8(bytes, _mm256_setr_epi8(0, 4, 8, 1, 5, 9, 2, 6, 10, 3, 7, 11, -1, -1, -1, -1, //
+		                                                    0, 4, 8, 1, 5, 9, 2, 6, 10, 3, 7, 11, -1, -1, -1, -1));
+
+		// The second store overwrites the garbage of the first.
+		_mm_storeu_si128((__m128i *)(dst + x * 3), _mm256_castsi256_si128(bytes));
+		_mm_storeu_si128((__m128i *)(dst + x * 3 + 12), _mm256_extracti128_si256(bytes, 1));
+	}
+
+	return x;
+}
+
+#endif // U_YUV_CONVERT_HAVE_X86
+
+
+/*
+ *
+ * NEON, eight pixels per conversion.
+ *
+ */
+
+#ifdef U_YUV_CONVERT_HAVE_NEON
+
+static inline void
+yuv8_to_rgb_neon(uint8x8_t y, uint8x8_t u, uint8x8_t v, uint8x8_t *out_r, uint8x8_t *out_g, uint8x8_t *out_b)
+{
+	int16x8_t c = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(y)), vdupq_n_s16(16));
+	int16x8_t d = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(u)), vdupq_n_s16(128));
+	int16x8_t e = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(v)), vdupq_n_s16(128));
+
+	int32x4_t base_lo = vmlal_n_s16(vdupq_n_s32(128), vget_low_s16(c), 298);
+	int32x4_t base_hi = vmlal_n_s16(vdupq_n_s32(128), vget_high_s16(c), 298);
+
+	int32x4_t r_lo = vmlal_n_s16(base_lo, vget_low_s16(e), 409);
+	int32x4_t r_hi = vmlal_n_s16(base_hi, vget_high_s16(e), 409);
+	int32x4_t g_lo = vmlsl_n_s16(vmlsl_n_s16(base_lo, vget_low_s16(d), 100), vget_low_s16(e), 209);
+	int32x4_t g_hi = vmlsl_n_s16(vmlsl_n_s16(base_hi, vget_high_s16(d), 100), vget_high_s16(e), 209);
+	int32x4_t b_lo = vmlal_n_s16(base_lo, vget_low_s16(d), 516);
+	int32x4_t b_hi = vmlal_n_s16(base_hi, vget_high_s16(d), 516);
+
+	// Arithmetic shift and saturating narrows do the clamping.
+	*out_r = vqmovun_s16(vcombine_s16(vqshrn_n_s32(r_lo, 8), vqshrn_n_s32(r_hi, 8)));
+	*out_g = vqmovun_s16(vcombine_s16(vqshrn_n_s32(g_lo, 8), vqshrn_n_s32(g_hi, 8)));
+	*out_b = vqmovun_s16(vcombine_s16(vqshrn_n_s32(b_lo, 8), vqshrn_n_s32(b_hi, 8)));
+}
+
+static uint32_t
+row_neon(const struct yuv_layout *l, const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	uint32_t x = 0;
+
+	if (l->bytes_per_pair == 6) {
+		for (; x + 8 <= width; x += 8) {
+			uint8x8x3_t in = vld3_u8(src + x * 3);
+			uint8x8x3_t out;
+			yuv8_to_rgb_neon(in.val[l->y[0]], in.val[l->u[0]], in.val[l->v[0]], &out.val[0], &out.val[1],
+			                 &out.val[2]);
+			vst3_u8(dst + x * 3, out);
+		}
+		return x;
+	}
+
+	// Sixteen pixels, de-interleaved into even luma, odd luma and the shared chroma.
+	for (; x + 16 <= width; x += 16) {
+		uint8x8x4_t in = vld4_u8(src + x * 2);
+		uint8x8_t u = in.val[l->u[0]];
+		uint8x8_t v = in.val[l->v[0]];
+
+		uint8x8x3_t even;
+		uint8x8x3_t odd;
+		yuv8_to_rgb_neon(in.val[l->y[0]], u, v, &even.val[0], &even.val[1], &even.val[2]);
+		yuv8_to_rgb_neon(in.val[l->y[1]], u, v, &odd.val[0], &odd.val[1], &odd.val[2]);
+
+		uint8x16x3_t out;
+		for (int i = 0; i < 3; i++) {
+			uint8x8x2_t z = vzip_u8(even.val[i], odd.val[i]);
+			out.val[i] = vcombine_u8(z.val[0], z.val[1]);
+		}
+		vst3q_u8(dst + x * 3, out);
+	}
+
+	return x;
+}
+
+#endif // U_YUV_CONVERT_HAVE_NEON
+
+
+/*
+ *
+ * Dispatch.
+ *
+ */
+
+static void
+convert_row(enum u_yuv_convert_impl impl,
+            const struct yuv_layout *l,
+            const uint8_t *src,
+            uint8_t *dst,
+            uint32_t width)
+{
+	uint32_t x = 0;
+
+	switch (impl) {
+#ifdef U_YUV_CONVERT_HAVE_X86
+	case U_YUV_CONVERT_IMPL_AVX2:
+		x = row_avx2(l, src, dst, width);
+		x += row_sse41(l, src + src_offset(l, x), dst + x * 3, width - x);
+		break;
+	case U_YUV_CONVERT_IMPL_SSE41: x = row_sse41(l, src, dst, width); break;
+#endif
+#ifdef U_YUV_CONVERT_HAVE_NEON
+	case U_YUV_CONVERT_IMPL_NEON: x = row_neon(l, src, dst, width); break;
+#endif
+	default: break;
+	}
+
+	// All kernels stop on an even pixel, so the tail is still whole pairs.
+	if (x < width) {
+		row_scalar(l, src + src_offset(l, x), dst + x * 3, width - x);
+	}
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+bool
+u_yuv_convert_impl_supported(enum u_yuv_convert_impl impl)
+{
+	switch (impl) {
+	case U_YUV_CONVERT_IMPL_SCALAR: return true;
+#ifdef U_YUV_CONVERT_HAVE_X86
+	case U_YUV_CONVERT_IMPL_SSE41: return __builtin_cpu_supports("sse4.1");
+	case U_YUV_CONVERT_IMPL_AVX2: return __builtin_cpu_supports("avx2");
+#endif
+#ifdef U_YUV_CONVERT_HAVE_NEON
+	case U_YUV_CONVERT_IMPL_NEON: return true;
+#endif
+	default: return false;
+	}
+}
+
+enum u_yuv_convert_impl
+u_yuv_convert_best_impl(void)
+{
+	static int best = -1;
+	if (best >= 0) {
+		return (enum u_yuv_convert_impl)best;
+	}
+
+	int impl = U_YUV_CONVERT_IMPL_SCALAR;
+	if (!debug_get_bool_option_yuv_convert_scalar()) {
+		for (int i = U_YUV_CONVERT_IMPL_COUNT - 1; i > U_YUV_CONVERT_IMPL_SCALAR; i--) {
+			if (u_yuv_convert_impl_supported((enum u_yuv_convert_impl)i)) {
+				impl = i;
+				break;
+			}
+		}
+	}
+
+	best = impl;
+	return (enum u_yuv_convert_impl)impl;
+}
+
+const char *
+u_yuv_convert_impl_str(enum u_yuv_convert_impl impl)
+{
+	switch (impl) {
+	case U_YUV_CONVERT_IMPL_SCALAR: return "scalar";
+	case U_YUV_CONVERT_IMPL_SSE41: return "sse4.1";
+	case U_YUV_CONVERT_IMPL_AVX2: return "avx2";
+	case U_YUV_CONVERT_IMPL_NEON: return "neon";
+	default: return "unknown";
+	}
+}
+
+void
+u_yuv_convert_yuyv422_to_r8g8b8(enum u_yuv_convert_impl impl, const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	convert_row(impl, &layout_yuyv422, src, dst, width);
+}
+
+void
+u_yuv_convert_uyvy422_to_r8g8b8(enum u_yuv_convert_impl impl, const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	convert_row(impl, &layout_uyvy422, src, dst, width);
+}
+
+void
+u_yuv_convert_yuv888_to_r8g8b8(enum u_yuv_convert_impl impl, const uint8_t *src, uint8_t *dst, uint32_t width)
+{
+	convert_row(impl, &layout_yuv888, src, dst, width);
+}
@@ -0,0 +1,88 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Row kernels converting packed YUV formats to R8G8B8.
+ * @ingroup aux_util
+ */
+
+#pragma once
+
+#include "xrt/xrt_compiler.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*!
+ * Implementations of the YUV to RGB row kernels, all of them produce exactly
+ * the same output as the scalar BT.601 integer formula.
+ *
+ * @ingroup aux_util
+ */
+enum u_yuv_convert_impl
+{
+	U_YUV_CONVERT_IMPL_SCALAR,
+	U_YUV_CONVERT_IMPL_SSE41,
+	U_YUV_CONVERT_IMPL_AVX2,
+	U_YUV_CONVERT_IMPL_NEON,
+
+	U_YUV_CONVERT_IMPL_COUNT,
+};
+
+/*!
+ * Is the given implementation built in and supported by the running CPU.
+ *
+ * @ingroup aux_util
+ */
+bool
+u_yuv_convert_impl_supported(enum u_yuv_convert_impl impl);
+
+/*!
+ * The fastest supported implementation, detected once. Setting the
+ * `U_YUV_CONVERT_SCALAR` environment variable forces the scalar one.
+ *
+ * @ingroup aux_util
+ */
+enum u_yuv_convert_impl
+u_yuv_convert_best_impl(void);
+
+/*!
+ * Name of the implementation, for logging and benchmarks.
+ *
+ * @ingroup aux_util
+ */
+const char *
+u_yuv_convert_impl_str(enum u_yuv_convert_impl impl);
+
+/*!
+ * Converts one row of @p width YUYV 4:2:2 pixels to R8G8B8, an odd width reads
+ * and writes one pixel extra just like the scalar code always has.
+ *
+ * @ingroup aux_util
+ */
+void
+u_yuv_convert_yuyv422_to_r8g8b8(enum u_yuv_convert_impl impl, const uint8_t *src, uint8_t *dst, uint32_t width);
+
+/*!
+ * Converts one row of @p width UYVY 4:2:2 pixels to R8G8B8, see
+ * @ref u_yuv_convert_yuyv422_to_r8g8b8.
+ *
+ * @ingroup aux_util
+ */
+void
+u_yuv_convert_uyvy422_to_r8g8b8(enum u_yuv_convert_impl impl, const uint8_t *src, uint8_t *dst, uint32_t width);
+
+/*!
+ * Converts one row of @p width YUV 4:4:4 pixels to R8G8B8.
+ *
+ * @ingroup aux_util
+ */
+void
+u_yuv_convert_yuv888_to_r8g8b8(enum u_yuv_convert_impl impl, const uint8_t *src, uint8_t *dst, uint32_t width);
+
+
+#ifdef __cplusplus
+}
+#endif
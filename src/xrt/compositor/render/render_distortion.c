@@ -10,9 +10,10 @@
 #include "xrt/xrt_device.h"
 
 #include "math/m_api.h"
-#include "math/m_matrix_2x2.h"
 #include "math/m_vec2.h"
 
+#include "util/u_distortion_mesh.h"
+
 #include "vk/vk_mini_helpers.h"
 
 #include "render/render_interface.h"
@@ -203,20 +204,6 @@ create_and_fill_in_distortion_buffer_for_view(struct vk_bundle *vk,
 	VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
 	VkResult ret;
 
-	struct xrt_matrix_2x2 rot = xdev->hmd->views[view].rot;
-
-	const struct xrt_matrix_2x2 rotation_90_cw = {{
-	    .vecs =
-	        {
-	            {0, 1},
-	            {-1, 0},
-	        },
-	}};
-
-	if (pre_rotate) {
-		m_mat2x2_multiply(&rot, &rotation_90_cw, &rot);
-	}
-
 	VkDeviceSize size = sizeof(struct texture);
 
 	ret = render_buffer_init(vk, r_buffer, usage_flags, properties, size);
@@ -240,30 +227,9 @@ create_and_fill_in_distortion_buffer_for_view(struct vk_bundle *vk,
 	struct texture *g = g_buffer->mapped;
 	struct texture *b = b_buffer->mapped;
 
-	const double dim_minus_one_f64 = RENDER_DISTORTION_IMAGE_DIMENSIONS - 1;
-
-	for (int row = 0; row < RENDER_DISTORTION_IMAGE_DIMENSIONS; row++) {
-		// This goes from 0 to 1.0 inclusive.
-		float v = (float)(row / dim_minus_one_f64);
-
-		for (int col = 0; col < RENDER_DISTORTION_IMAGE_DIMENSIONS; col++) {
-			// This goes from 0 to 1.0 inclusive.
-			float u = (float)(col / dim_minus_one_f64);
-
-			// These need to go from -0.5 to 0.5 for the rotation
-			struct xrt_vec2 uv = {u - 0.5f, v - 0.5f};
-			m_mat2x2_transform_vec2(&rot, &uv, &uv);
-			uv.x += 0.5f;
-			uv.y += 0.5f;
-
-			struct xrt_uv_triplet result;
-			xrt_device_compute_distortion(xdev, view, uv.x, uv.y, &result);
-
-			r->pixels[row][col] = result.r;
-			g->pixels[row][col] = result.g;
-			b->pixels[row][col] = result.b;
-		}
-	}
+	// Baked on a thread pool, or loaded from the disk cache.
+	u_distortion_images_bake(xdev, view, pre_rotate, RENDER_DISTORTION_IMAGE_DIMENSIONS, &r->pixels[0][0],
+	                         &g->pixels[0][0], &b->pixels[0][0]);
 
 	render_buffer_unmap(vk, r_buffer);
 	render_buffer_unmap(vk, g_buffer);
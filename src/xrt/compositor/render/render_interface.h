@@ -13,6 +13,8 @@
 #include "xrt/xrt_compiler.h"
 #include "xrt/xrt_defines.h"
 
+#include "util/u_distortion_mesh.h"
+
 #include "vk/vk_helpers.h"
 #include "vk/vk_cmd_pool.h"
 
@@ -73,7 +75,7 @@ extern "C" {
 #define RENDER_MAX_LAYER_RUNS (2)
 
 //! How large in pixels the distortion image is.
-#define RENDER_DISTORTION_IMAGE_DIMENSIONS (128)
+#define RENDER_DISTORTION_IMAGE_DIMENSIONS U_DISTORTION_IMAGE_DIMENSIONS
 
 //! How many distortion images we have, one for each channel (3 rgb) and per view, total 6.
 #define RENDER_DISTORTION_NUM_IMAGES (6)
@@ -108,6 +108,7 @@ euroc_create_auto_prober(void);
  * @param euroc_path Dataset path
  * @param slam_config Path to config file for the SLAM system
  * @param output_path Path to write resulting tracking data to
+ * @param print_progress Whether to print the playback progress, unless EUROC_PRINT_PROGRESS is set
  *
  * @ingroup drv_euroc
  */
@@ -115,6 +116,7 @@ void
 euroc_run_dataset(const char *euroc_path,
                   const char *slam_config,
                   const char *output_path,
+                  bool print_progress,
                   const volatile bool *should_exit);
 
 /*!
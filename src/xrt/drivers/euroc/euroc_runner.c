@@ -27,13 +27,14 @@ void
 euroc_run_dataset(const char *euroc_path,
                   const char *slam_config,
                   const char *output_path,
+                  bool print_progress,
                   const volatile bool *should_exit)
 {}
 
 #else
 
 static struct euroc_player_config *
-make_euroc_player_config(const char *euroc_path)
+make_euroc_player_config(const char *euroc_path, bool print_progress)
 {
 	struct euroc_player_config *ep_config = U_TYPED_CALLOC(struct euroc_player_config);
 	euroc_player_fill_default_config_for(ep_config, euroc_path);
@@ -46,7 +47,7 @@ make_euroc_player_config(const char *euroc_path)
 		ep_config->playback.play_from_start = true;
 	}
 	if (getenv("EUROC_PRINT_PROGRESS") == NULL) {
-		ep_config->playback.print_progress = true;
+		ep_config->playback.print_progress = print_progress;
 	}
 	if (getenv("EUROC_USE_SOURCE_TS") == NULL) {
 		ep_config->playback.use_source_ts = true;
@@ -88,9 +89,10 @@ void
 euroc_run_dataset(const char *euroc_path,
                   const char *slam_config,
                   const char *output_path,
+                  bool print_progress,
                   const volatile bool *should_exit)
 {
-	struct euroc_player_config *ep_config = make_euroc_player_config(euroc_path);
+	struct euroc_player_config *ep_config = make_euroc_player_config(euroc_path, print_progress);
 	struct t_slam_tracker_config *st_config = make_slam_tracker_config(slam_config, output_path);
 	st_config->cam_count = ep_config->dataset.cam_count;
 
@@ -56,7 +56,9 @@ r_device_update_inputs(struct xrt_device *xdev)
 	struct r_hub *r = rd->r;
 
 	uint64_t now = os_monotonic_get_ns();
-	struct r_remote_controller_data *latest = rd->is_left ? &r->latest.left : &r->latest.right;
+	struct r_remote_controller_data data;
+	r_hub_get_latest_controller(r, rd->is_left, &data);
+	const struct r_remote_controller_data *latest = &data;
 
 	if (!latest->active) {
 		for (uint32_t i = 0; i < 19; i++) {
@@ -107,27 +109,7 @@ r_device_get_tracked_pose(struct xrt_device *xdev,
 		return;
 	}
 
-	struct r_remote_controller_data *latest = rd->is_left ? &r->latest.left : &r->latest.right;
-
-	/*
-	 * It's easier to reason about angular velocity if it's controlled in
-	 * body space, but the angular velocity returned in the relation is in
-	 * the base space.
-	 */
-	math_quat_rotate_derivative(&latest->pose.orientation, &latest->angular_velocity,
-	                            &out_relation->angular_velocity);
-
-	out_relation->pose = latest->pose;
-	out_relation->linear_velocity = latest->linear_velocity;
-
-	if (latest->active) {
-		out_relation->relation_flags = (enum xrt_space_relation_flags)(
-		    XRT_SPACE_RELATION_ORIENTATION_VALID_BIT | XRT_SPACE_RELATION_POSITION_VALID_BIT |
-		    XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT | XRT_SPACE_RELATION_POSITION_TRACKED_BIT |
-		    XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT | XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT);
-	} else {
-		out_relation->relation_flags = 0;
-	}
+	r_hub_get_controller_relation(r, rd->is_left, at_timestamp_ns, out_relation);
 }
 
 static void
@@ -146,7 +128,9 @@ r_device_get_hand_tracking(struct xrt_device *xdev,
 		return;
 	}
 
-	struct r_remote_controller_data *latest = rd->is_left ? &r->latest.left : &r->latest.right;
+	struct r_remote_controller_data data;
+	r_hub_get_latest_controller(r, rd->is_left, &data);
+	const struct r_remote_controller_data *latest = &data;
 
 	struct u_hand_tracking_curl_values values = {
 	    .little = latest->hand_curl[0],
@@ -35,15 +35,6 @@ r_hmd(struct xrt_device *xdev)
 	return (struct r_hmd *)xdev;
 }
 
-static inline void
-copy_head_center_to_relation(struct r_hmd *rh, struct xrt_space_relation *out_relation)
-{
-	out_relation->pose = rh->r->latest.head.center;
-	out_relation->relation_flags = (enum xrt_space_relation_flags)(
-	    XRT_SPACE_RELATION_ORIENTATION_VALID_BIT | XRT_SPACE_RELATION_POSITION_VALID_BIT |
-	    XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT | XRT_SPACE_RELATION_POSITION_TRACKED_BIT);
-}
-
 static void
 r_hmd_destroy(struct xrt_device *xdev)
 {
@@ -65,7 +56,7 @@ r_hmd_get_tracked_pose(struct xrt_device *xdev,
 	struct r_hmd *rh = r_hmd(xdev);
 
 	switch (name) {
-	case XRT_INPUT_GENERIC_HEAD_POSE: copy_head_center_to_relation(rh, out_relation); break;
+	case XRT_INPUT_GENERIC_HEAD_POSE: r_hub_get_head_relation(rh->r, at_timestamp_ns, out_relation); break;
 	case XRT_INPUT_GENERIC_STAGE_SPACE_POSE:
 		// STAGE is implicitly defined as the space poses are returned in, therefore STAGE origin is (0, 0, 0).
 		*out_relation = (struct xrt_space_relation)XRT_SPACE_RELATION_ZERO;
@@ -97,7 +88,10 @@ r_hmd_get_view_poses(struct xrt_device *xdev,
 {
 	struct r_hmd *rh = r_hmd(xdev);
 
-	if (!rh->r->latest.head.per_view_data_valid) {
+	struct r_head_data head;
+	r_hub_get_latest_head(rh->r, &head);
+
+	if (!head.per_view_data_valid) {
 		u_device_get_view_poses(  //
 		    xdev,                 //
 		    default_eye_relation, //
@@ -111,16 +105,16 @@ r_hmd_get_view_poses(struct xrt_device *xdev,
 		return;
 	}
 
-	if (view_count > ARRAY_SIZE(rh->r->latest.head.views)) {
+	if (view_count > ARRAY_SIZE(head.views)) {
 		U_LOG_E("Asking for too many views!");
 		return;
 	}
 
-	copy_head_center_to_relation(rh, out_head_relation);
+	r_hub_get_head_relation(rh->r, at_timestamp_ns, out_head_relation);
 
 	for (uint32_t i = 0; i < view_count; i++) {
-		out_poses[i] = rh->r->latest.head.views[i].pose;
-		out_fovs[i] = rh->r->latest.head.views[i].fov;
+		out_poses[i] = head.views[i].pose;
+		out_fovs[i] = head.views[i].fov;
 	}
 }
 
@@ -7,17 +7,24 @@
  * @ingroup drv_remote
  */
 
+#include "os/os_time.h"
+
 #include "util/u_var.h"
 #include "util/u_misc.h"
 #include "util/u_debug.h"
 #include "util/u_space_overseer.h"
 
+#include "math/m_api.h"
+#include "math/m_clock_offset.h"
+#include "math/m_relation_history.h"
+
 #include "r_interface.h"
 #include "r_internal.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 
 #if defined(XRT_OS_WINDOWS)
 #include <winsock2.h>
@@ -55,6 +62,13 @@
  */
 
 DEBUG_GET_ONCE_LOG_OPTION(remote_log, "REMOTE_LOG", U_LOGGING_INFO)
+DEBUG_GET_ONCE_BOOL_OPTION(remote_udp, "REMOTE_UDP", false)
+
+/*!
+ * About how often data is sent, only used to pick how quickly the clock offset
+ * estimate follows new samples, the GUI sends at frame rate, test clients faster.
+ */
+#define R_CLOCK_OFFSET_FREQ (1000.0f)
 
 #define R_TRACE(R, ...) U_LOG_IFL_T((R)->rc.log_level, __VA_ARGS__)
 #define R_DEBUG(R, ...) U_LOG_IFL_D((R)->rc.log_level, __VA_ARGS__)
@@ -89,6 +103,12 @@ socket_create(void)
 	return socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
 }
 
+static inline SOCKET
+socket_create_udp(void)
+{
+	return socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+}
+
 static inline int
 socket_set_opt(SOCKET id, int flag)
 {
@@ -121,6 +141,12 @@ socket_create(void)
 	return socket(AF_INET, SOCK_STREAM, 0);
 }
 
+static inline SOCKET
+socket_create_udp(void)
+{
+	return socket(AF_INET, SOCK_DGRAM, 0);
+}
+
 static inline int
 socket_set_opt(SOCKET id, int flag)
 {
@@ -204,7 +230,7 @@ cleanup:
 }
 
 static bool
-wait_for_read_and_to_continue(struct r_hub *r, SOCKET socket)
+wait_for_read_and_to_continue(struct r_hub *r, struct os_thread_helper *oth, SOCKET socket)
 {
 	fd_set set;
 	int ret = 0;
@@ -214,7 +240,7 @@ wait_for_read_and_to_continue(struct r_hub *r, SOCKET socket)
 		return false;
 	}
 
-	while (os_thread_helper_is_running(&r->oth) && ret == 0) {
+	while (os_thread_helper_is_running(oth) && ret == 0) {
 		// Select can modify timeout, reset each loop.
 		struct timeval timeout = {.tv_sec = 1, .tv_usec = 0};
 
@@ -240,7 +266,7 @@ do_accept(struct r_hub *r)
 {
 	struct sockaddr_in addr = {0};
 	int ret = 0;
-	if (!wait_for_read_and_to_continue(r, r->accept_fd)) {
+	if (!wait_for_read_and_to_continue(r, &r->oth, r->accept_fd)) {
 		R_ERROR(r, "Failed to wait for id %d", r->accept_fd);
 		return -1;
 	}
@@ -270,36 +296,200 @@ do_accept(struct r_hub *r)
 }
 
 static int
-read_one(struct r_hub *r, struct r_remote_data *data)
+setup_udp_fd(struct r_hub *r)
 {
-	struct r_remote_connection *rc = &r->rc;
+	struct sockaddr_in server_address = {0};
+#if defined(XRT_OS_WINDOWS)
+	// Initialize Winsock, each thread sets up its own socket.
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+		int error = WSAGetLastError();
+		R_ERROR(r, "Failed to do WSAStartup %ld", error);
+		return error;
+	}
+#endif
+	SOCKET ret = socket_create_udp();
+	if (ret < 0) {
+		R_ERROR(r, "socket: %i", ret);
+		return ret;
+	}
 
-	const size_t size = sizeof(*data);
-	size_t current = 0;
+	r->udp_fd = ret;
 
-	while (current < size) {
-		void *ptr = (uint8_t *)data + current;
+	server_address.sin_family = AF_INET;
+	server_address.sin_addr.s_addr = htonl(INADDR_ANY);
+	server_address.sin_port = htons(r->port);
+
+	ret = bind(r->udp_fd, (struct sockaddr *)&server_address, sizeof(server_address));
+	if (ret < 0) {
+		R_ERROR(r, "bind: %i", ret);
+		socket_close(r->udp_fd);
+		r->udp_fd = -1;
+		return ret;
+	}
+
+	R_INFO(r, "Receiving UDP batches on port %d", r->port);
+
+	return 0;
+}
+
+static void
+controller_data_to_relation(const struct r_remote_controller_data *data, struct xrt_space_relation *out_relation)
+{
+	/*
+	 * It's easier to reason about angular velocity if it's controlled in
+	 * body space, but the angular velocity returned in the relation is in
+	 * the base space.
+	 */
+	math_quat_rotate_derivative(&data->pose.orientation, &data->angular_velocity, &out_relation->angular_velocity);
+
+	out_relation->pose = data->pose;
+	out_relation->linear_velocity = data->linear_velocity;
+
+	if (data->active) {
+		out_relation->relation_flags = (enum xrt_space_relation_flags)(
+		    XRT_SPACE_RELATION_ORIENTATION_VALID_BIT | XRT_SPACE_RELATION_POSITION_VALID_BIT |
+		    XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT | XRT_SPACE_RELATION_POSITION_TRACKED_BIT |
+		    XRT_SPACE_RELATION_LINEAR_VELOCITY_VALID_BIT | XRT_SPACE_RELATION_ANGULAR_VELOCITY_VALID_BIT);
+	} else {
+		out_relation->relation_flags = 0;
+	}
+}
+
+static void
+head_data_to_relation(const struct r_head_data *data, struct xrt_space_relation *out_relation)
+{
+	*out_relation = (struct xrt_space_relation)XRT_SPACE_RELATION_ZERO;
+	out_relation->pose = data->center;
+	out_relation->relation_flags = (enum xrt_space_relation_flags)(
+	    XRT_SPACE_RELATION_ORIENTATION_VALID_BIT | XRT_SPACE_RELATION_POSITION_VALID_BIT |
+	    XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT | XRT_SPACE_RELATION_POSITION_TRACKED_BIT);
+}
+
+/*!
+ * Makes @p data the latest and adds the poses to the histories, at the time it
+ * was sampled if the sender gave one.
+ */
+static void
+push_data(struct r_hub *r, const struct r_remote_data *data, timepoint_ns received_ns)
+{
+	os_mutex_lock(&r->data_mutex);
 
-		if (!wait_for_read_and_to_continue(r, rc->fd)) {
+	timepoint_ns timestamp_ns = received_ns;
+	if (data->timestamp_ns != 0) {
+		timestamp_ns = m_clock_offset_a2b(R_CLOCK_OFFSET_FREQ, (timepoint_ns)data->timestamp_ns, received_ns,
+		                                  &r->sender_to_local_ns);
+	}
+
+	// Don't interpolate with the poses from before it was inactive.
+	if (r->latest.left.active && !data->left.active) {
+		m_relation_history_clear(r->history.left);
+	}
+	if (r->latest.right.active && !data->right.active) {
+		m_relation_history_clear(r->history.right);
+	}
+
+	r->latest = *data;
+
+	// The head has no velocities in the data, get them from the previous pose.
+	struct xrt_space_relation relation;
+	head_data_to_relation(&data->head, &relation);
+	m_relation_history_estimate_motion(r->history.head, &relation, timestamp_ns, &relation);
+	m_relation_history_push(r->history.head, &relation, timestamp_ns);
+
+	// Inactive controllers are not tracked at all, no need to keep them.
+	if (data->left.active) {
+		controller_data_to_relation(&data->left, &relation);
+		m_relation_history_push(r->history.left, &relation, timestamp_ns);
+	}
+	if (data->right.active) {
+		controller_data_to_relation(&data->right, &relation);
+		m_relation_history_push(r->history.right, &relation, timestamp_ns);
+	}
+
+	os_mutex_unlock(&r->data_mutex);
+}
+
+/*!
+ * Pushes all whole data in @p data, @p size is in bytes.
+ */
+static int
+push_batch(struct r_hub *r, const struct r_remote_data *data, size_t size)
+{
+	timepoint_ns now_ns = (timepoint_ns)os_monotonic_get_ns();
+	size_t count = size / sizeof(*data);
+	size_t no_timestamps = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		if (data[i].header != R_HEADER_VALUE) {
+			R_ERROR(r, "Bad header 0x%016" PRIx64 ", is the sender using the same version?", data[i].header);
 			return -1;
 		}
 
-		ssize_t ret = socket_read(rc->fd, ptr, size, current);
-		if (ret < 0) {
+		if (data[i].timestamp_ns == 0) {
+			no_timestamps++;
+		}
+
+		push_data(r, &data[i], now_ns);
+	}
+
+	// They all get the same time, the histories only keep the first of them.
+	if (no_timestamps > 1) {
+		os_mutex_lock(&r->data_mutex);
+		bool warn = !r->warned_no_timestamps;
+		r->warned_no_timestamps = true;
+		os_mutex_unlock(&r->data_mutex);
+
+		if (warn) {
+			R_WARN(r, "Got %zu data without timestamps at once, only the first is used, set timestamp_ns",
+			       no_timestamps);
+		}
+	}
+
+	return 0;
+}
+
+/*!
+ * Reads as much as is available, the connection can have sent many data since
+ * the last read. Whole data are pushed and the rest is kept in @p batch.
+ */
+static int
+read_batch(struct r_hub *r, struct r_remote_data batch[R_REMOTE_BATCH_MAX], size_t *inout_filled)
+{
+	struct r_remote_connection *rc = &r->rc;
+
+	const size_t size = sizeof(*batch) * R_REMOTE_BATCH_MAX;
+	size_t current = *inout_filled;
+
+	if (!wait_for_read_and_to_continue(r, &r->oth, rc->fd)) {
+		return -1;
+	}
+
+	void *ptr = (uint8_t *)batch + current;
+	ssize_t ret = socket_read(rc->fd, ptr, size, current);
+	if (ret < 0) {
 #if defined(XRT_OS_WINDOWS)
-			RC_ERROR(rc, "recv: %zi", WSAGetLastError());
+		RC_ERROR(rc, "recv: %zi", WSAGetLastError());
 #else
-			RC_ERROR(rc, "read: %zi", ret);
+		RC_ERROR(rc, "read: %zi", ret);
 #endif
-			return ret;
-		} else if (ret > 0) {
-			current += (size_t)ret;
-		} else {
-			R_INFO(r, "Disconnected!");
-			return -1;
-		}
+		return ret;
+	} else if (ret == 0) {
+		R_INFO(r, "Disconnected!");
+		return -1;
+	}
+
+	current += (size_t)ret;
+
+	size_t whole = current - current % sizeof(*batch);
+	if (push_batch(r, batch, whole) < 0) {
+		return -1;
 	}
 
+	// Keep the start of a partially read data.
+	memmove(batch, (uint8_t *)batch + whole, current - whole);
+	*inout_filled = current - whole;
+
 	return 0;
 }
 
@@ -324,19 +514,36 @@ run_thread(void *ptr)
 			return NULL;
 		}
 
+		// Without the timestamp, it is from the last sender's clock.
+		os_mutex_lock(&r->data_mutex);
+		struct r_remote_data latest = r->latest;
+		os_mutex_unlock(&r->data_mutex);
+		latest.timestamp_ns = 0;
+
 		r_remote_connection_write_one(&r->rc, &r->reset);
-		r_remote_connection_write_one(&r->rc, &r->latest);
+		r_remote_connection_write_one(&r->rc, &latest);
 
-		while (true) {
-			struct r_remote_data data;
+		// A new sender, its clock is unrelated to the last one.
+		os_mutex_lock(&r->data_mutex);
+		r->sender_to_local_ns = 0;
+		r->warned_no_timestamps = false;
+		m_relation_history_clear(r->history.head);
+		m_relation_history_clear(r->history.left);
+		m_relation_history_clear(r->history.right);
+		os_mutex_unlock(&r->data_mutex);
+
+		struct r_remote_data batch[R_REMOTE_BATCH_MAX];
+		size_t filled = 0;
 
-			ret = read_one(r, &data);
+		while (true) {
+			ret = read_batch(r, batch, &filled);
 			if (ret < 0) {
 				break;
 			}
-
-			r->latest = data;
 		}
+
+		socket_close(r->rc.fd);
+		r->rc.fd = -1;
 	}
 
 	R_INFO(r, "Leaving thread");
@@ -344,6 +551,40 @@ run_thread(void *ptr)
 	return NULL;
 }
 
+static void *
+run_udp_thread(void *ptr)
+{
+	struct r_hub *r = (struct r_hub *)ptr;
+	int ret;
+
+	ret = setup_udp_fd(r);
+	if (ret < 0) {
+		R_INFO(r, "Leaving UDP thread");
+		return NULL;
+	}
+
+	struct r_remote_data batch[R_REMOTE_BATCH_MAX];
+
+	while (wait_for_read_and_to_continue(r, &r->udp_oth, r->udp_fd)) {
+		// One datagram is one batch of whole data.
+		ssize_t size = socket_read(r->udp_fd, batch, sizeof(batch), 0);
+		if (size < 0) {
+			R_ERROR(r, "recv: %zi", size);
+			continue;
+		}
+		if ((size_t)size % sizeof(*batch) != 0) {
+			R_WARN(r, "Ignoring datagram of %zi bytes, not whole data", size);
+			continue;
+		}
+
+		push_batch(r, batch, (size_t)size);
+	}
+
+	R_INFO(r, "Leaving UDP thread");
+
+	return NULL;
+}
+
 static xrt_result_t
 r_hub_system_devices_get_roles(struct xrt_system_devices *xsysd, struct xrt_system_roles *out_roles)
 {
@@ -366,8 +607,9 @@ r_hub_system_devices_destroy(struct xrt_system_devices *xsysd)
 
 	R_DEBUG(r, "Destroying");
 
-	// Stop the thread first.
+	// Stop the threads first.
 	os_thread_helper_stop_and_wait(&r->oth);
+	os_thread_helper_stop_and_wait(&r->udp_oth);
 
 	// Destroy all of the devices now.
 	for (uint32_t i = 0; i < ARRAY_SIZE(r->base.xdevs); i++) {
@@ -385,6 +627,20 @@ r_hub_system_devices_destroy(struct xrt_system_devices *xsysd)
 		r->rc.fd = -1;
 	}
 
+	if (r->udp_fd >= 0) {
+		socket_close(r->udp_fd);
+		r->udp_fd = -1;
+#if defined(XRT_OS_WINDOWS)
+		// The UDP thread did its own startup.
+		WSACleanup();
+#endif
+	}
+
+	m_relation_history_destroy(&r->history.head);
+	m_relation_history_destroy(&r->history.left);
+	m_relation_history_destroy(&r->history.right);
+	os_mutex_destroy(&r->data_mutex);
+
 	free(r);
 
 #if defined(XRT_OS_WINDOWS)
@@ -394,6 +650,65 @@ r_hub_system_devices_destroy(struct xrt_system_devices *xsysd)
 }
 
 
+/*
+ *
+ * 'Exported' device functions.
+ *
+ */
+
+void
+r_hub_get_latest_head(struct r_hub *r, struct r_head_data *out_head)
+{
+	os_mutex_lock(&r->data_mutex);
+	*out_head = r->latest.head;
+	os_mutex_unlock(&r->data_mutex);
+}
+
+void
+r_hub_get_latest_controller(struct r_hub *r, bool is_left, struct r_remote_controller_data *out_data)
+{
+	os_mutex_lock(&r->data_mutex);
+	*out_data = is_left ? r->latest.left : r->latest.right;
+	os_mutex_unlock(&r->data_mutex);
+}
+
+void
+r_hub_get_head_relation(struct r_hub *r, uint64_t at_timestamp_ns, struct xrt_space_relation *out_relation)
+{
+	enum m_relation_history_result result =
+	    m_relation_history_get(r->history.head, at_timestamp_ns, out_relation);
+
+	// Nothing received yet on this connection.
+	if (result == M_RELATION_HISTORY_RESULT_INVALID) {
+		struct r_head_data head;
+		r_hub_get_latest_head(r, &head);
+		head_data_to_relation(&head, out_relation);
+	}
+}
+
+void
+r_hub_get_controller_relation(struct r_hub *r,
+                              bool is_left,
+                              uint64_t at_timestamp_ns,
+                              struct xrt_space_relation *out_relation)
+{
+	struct r_remote_controller_data latest;
+	r_hub_get_latest_controller(r, is_left, &latest);
+	struct m_relation_history *history = is_left ? r->history.left : r->history.right;
+
+	// Only the latest data says if it is still active.
+	if (!latest.active) {
+		controller_data_to_relation(&latest, out_relation);
+		return;
+	}
+
+	enum m_relation_history_result result = m_relation_history_get(history, at_timestamp_ns, out_relation);
+	if (result == M_RELATION_HISTORY_RESULT_INVALID) {
+		controller_data_to_relation(&latest, out_relation);
+	}
+}
+
+
 /*
  *
  * 'Exported' create function.
@@ -411,6 +726,7 @@ r_create_devices(uint16_t port,
 
 	r->base.destroy = r_hub_system_devices_destroy;
 	r->base.get_roles = r_hub_system_devices_get_roles;
+	r->reset.header = R_HEADER_VALUE;
 	r->origin.type = XRT_TRACKING_TYPE_RGB;
 	r->origin.offset = (struct xrt_pose)XRT_POSE_IDENTITY;
 	r->reset.head.center = (struct xrt_pose)XRT_POSE_IDENTITY;
@@ -435,11 +751,18 @@ r_create_devices(uint16_t port,
 	r->gui.right = true;
 	r->port = port;
 	r->accept_fd = -1;
+	r->udp_fd = -1;
 	r->rc.fd = -1;
 
 	snprintf(r->origin.name, sizeof(r->origin.name), "Remote Simulator");
 
+	m_relation_history_create(&r->history.head);
+	m_relation_history_create(&r->history.left);
+	m_relation_history_create(&r->history.right);
+
 	ret = os_thread_helper_init(&r->oth);
+	ret |= os_thread_helper_init(&r->udp_oth);
+	ret |= os_mutex_init(&r->data_mutex);
 	if (ret != 0) {
 		R_ERROR(r, "Failed to init threading!");
 		r_hub_system_devices_destroy(&r->base);
@@ -453,6 +776,15 @@ r_create_devices(uint16_t port,
 		return XRT_ERROR_ALLOCATION;
 	}
 
+	if (debug_get_bool_option_remote_udp()) {
+		ret = os_thread_helper_start(&r->udp_oth, run_udp_thread, r);
+		if (ret != 0) {
+			R_ERROR(r, "Failed to start UDP thread!");
+			r_hub_system_devices_destroy(&r->base);
+			return XRT_ERROR_ALLOCATION;
+		}
+	}
+
 
 	/*
 	 * Setup system devices.
@@ -610,6 +942,71 @@ r_remote_connection_init(struct r_remote_connection *rc, const char *ip_addr, ui
 	}
 
 	rc->fd = conn_fd;
+	rc->is_udp = false;
+
+	return 0;
+
+cleanup:
+#if defined(XRT_OS_WINDOWS)
+	WSACleanup();
+#endif
+	return ret;
+}
+
+int
+r_remote_connection_init_udp(struct r_remote_connection *rc, const char *ip_addr, uint16_t port)
+{
+	struct sockaddr_in addr = {0};
+	int conn_fd;
+	int ret;
+
+	// Set log level.
+	rc->log_level = debug_get_log_option_remote_log();
+
+#if defined(XRT_OS_WINDOWS)
+	// Initialize Winsock.
+	WSADATA wsaData;
+	ret = WSAStartup(MAKEWORD(2, 2), &wsaData);
+	if (ret != 0) {
+		RC_ERROR(rc, "Failed to do WSAStartup %ld", WSAGetLastError());
+		return ret;
+	}
+#endif
+
+	// Address
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+
+	// Same as for TCP, see above.
+	if (strcmp("localhost", ip_addr) == 0) {
+		ret = inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+	} else {
+		ret = inet_pton(AF_INET, ip_addr, &addr.sin_addr);
+	}
+	if (ret < 0) {
+		RC_ERROR(rc, "Failed to do inet pton for %s: %i", ip_addr, ret);
+		goto cleanup;
+	}
+
+	ret = socket_create_udp();
+	if (ret < 0) {
+		RC_ERROR(rc, "Failed to create socket: %i", ret);
+		goto cleanup;
+	}
+
+	conn_fd = ret;
+
+	// Only sets the default destination, nothing is sent.
+	ret = connect(conn_fd, (struct sockaddr *)&addr, sizeof(addr));
+	if (ret != 0) {
+		RC_ERROR(rc, "Failed to connect id %d and addr %s with failure %d", conn_fd, inet_ntoa(addr.sin_addr),
+		         ret);
+		socket_close(conn_fd);
+		goto cleanup;
+	}
+
+	rc->fd = conn_fd;
+	rc->is_udp = true;
 
 	return 0;
 
@@ -647,7 +1044,30 @@ r_remote_connection_read_one(struct r_remote_connection *rc, struct r_remote_dat
 int
 r_remote_connection_write_one(struct r_remote_connection *rc, const struct r_remote_data *data)
 {
-	const size_t size = sizeof(*data);
+	return r_remote_connection_write_batch(rc, data, 1);
+}
+
+int
+r_remote_connection_write_batch(struct r_remote_connection *rc, const struct r_remote_data *data, uint32_t count)
+{
+	const size_t size = sizeof(*data) * count;
+
+	if (rc->is_udp) {
+		if (count > R_REMOTE_BATCH_MAX) {
+			RC_ERROR(rc, "Too many data for one datagram: %u", count);
+			return -1;
+		}
+
+		// A datagram is sent whole or not at all.
+		ssize_t ret = socket_write(rc->fd, (void *)data, size, 0);
+		if (ret < 0) {
+			RC_ERROR(rc, "write: %zi", ret);
+			return (int)ret;
+		}
+
+		return 0;
+	}
+
 	size_t current = 0;
 
 	while (current < size) {
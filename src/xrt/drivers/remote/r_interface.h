@@ -40,7 +40,15 @@ struct xrt_session_event_sink;
  *
  * @ingroup drv_remote
  */
-#define R_HEADER_VALUE (*(uint64_t *)"mndrmt3\0")
+#define R_HEADER_VALUE (*(uint64_t *)"mndrmt4\0")
+
+/*!
+ * The most @ref r_remote_data that can be sent in one batch, a UDP datagram
+ * carrying a batch must fit in the 64KiB limit.
+ *
+ * @ingroup drv_remote
+ */
+#define R_REMOTE_BATCH_MAX (64)
 
 /*!
  * Data per controller.
@@ -113,6 +121,13 @@ struct r_remote_data
 {
 	uint64_t header;
 
+	/*!
+	 * When the data was sampled, in the sender's monotonic clock. The hub
+	 * estimates the offset to its own clock, zero means use the time the
+	 * data was received at.
+	 */
+	uint64_t timestamp_ns;
+
 	struct r_head_data head;
 
 	struct r_remote_controller_data left, right;
@@ -130,6 +145,9 @@ struct r_remote_connection
 
 	//! Socket.
 	int fd;
+
+	//! Is the socket a connected UDP socket, only for sending.
+	bool is_udp;
 };
 
 /*!
@@ -151,12 +169,32 @@ r_create_devices(uint16_t port,
 int
 r_remote_connection_init(struct r_remote_connection *rc, const char *addr, uint16_t port);
 
+/*!
+ * Initializes a UDP connection that only sends, for streaming data at a high
+ * rate when the hub has UDP enabled, see the REMOTE_UDP option. Datagrams that
+ * are lost are not resent, the reset data can not be read over it.
+ *
+ * @ingroup drv_remote
+ */
+int
+r_remote_connection_init_udp(struct r_remote_connection *rc, const char *addr, uint16_t port);
+
 int
 r_remote_connection_read_one(struct r_remote_connection *rc, struct r_remote_data *data);
 
 int
 r_remote_connection_write_one(struct r_remote_connection *rc, const struct r_remote_data *data);
 
+/*!
+ * Writes @p count data in one go, on UDP as a single datagram so @p count
+ * must not be more than @ref R_REMOTE_BATCH_MAX. Each should have its own
+ * @ref r_remote_data::timestamp_ns so the hub can tell them apart.
+ *
+ * @ingroup drv_remote
+ */
+int
+r_remote_connection_write_batch(struct r_remote_connection *rc, const struct r_remote_data *data, uint32_t count);
+
 
 #ifdef __cplusplus
 }
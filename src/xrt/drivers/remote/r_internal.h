@@ -16,6 +16,7 @@
 #include "os/os_threading.h"
 
 #include "util/u_hand_tracking.h"
+#include "util/u_time.h"
 
 #include "r_interface.h"
 
@@ -25,6 +26,8 @@ extern "C" {
 #endif
 
 
+struct m_relation_history;
+
 /*!
  * Central object remote object.
  *
@@ -47,13 +50,37 @@ struct r_hub
 	//! The latest data received.
 	struct r_remote_data latest;
 
+	/*!
+	 * Poses of the head and controllers at the time they were sampled, so
+	 * they can be interpolated or predicted to the requested time.
+	 */
+	struct
+	{
+		struct m_relation_history *head, *left, *right;
+	} history;
+
+	//! Protects latest and the histories between the receiving threads and the devices.
+	struct os_mutex data_mutex;
+
+	//! Estimated offset from the sender's clock to ours, zero when unknown.
+	time_duration_ns sender_to_local_ns;
+
+	//! Have we warned that the sender batches data without timestamps.
+	bool warned_no_timestamps;
+
 	//! Incoming connection socket.
 	int accept_fd;
 
+	//! Socket for batches sent over UDP, -1 if not enabled.
+	int udp_fd;
+
 	uint16_t port;
 
 	struct os_thread_helper oth;
 
+	//! Receives the UDP batches.
+	struct os_thread_helper udp_oth;
+
 	//! Index to the left controller.
 	int32_t left_index;
 
@@ -95,6 +122,43 @@ struct r_device
 };
 
 
+/*!
+ * Copy of the head in the latest received data.
+ *
+ * @ingroup drv_remote
+ */
+void
+r_hub_get_latest_head(struct r_hub *r, struct r_head_data *out_head);
+
+/*!
+ * Copy of a controller in the latest received data.
+ *
+ * @ingroup drv_remote
+ */
+void
+r_hub_get_latest_controller(struct r_hub *r, bool is_left, struct r_remote_controller_data *out_data);
+
+/*!
+ * The head pose at @p at_timestamp_ns, interpolated or predicted from the
+ * received data.
+ *
+ * @ingroup drv_remote
+ */
+void
+r_hub_get_head_relation(struct r_hub *r, uint64_t at_timestamp_ns, struct xrt_space_relation *out_relation);
+
+/*!
+ * The controller pose at @p at_timestamp_ns, interpolated or predicted from
+ * the received data.
+ *
+ * @ingroup drv_remote
+ */
+void
+r_hub_get_controller_relation(struct r_hub *r,
+                              bool is_left,
+                              uint64_t at_timestamp_ns,
+                              struct xrt_space_relation *out_relation);
+
 struct xrt_device *
 r_hmd_create(struct r_hub *r);
 
@@ -21,8 +21,10 @@
 #include "util/u_autoexpgain.h"
 #include "util/u_debug.h"
 #include "util/u_var.h"
+#include "util/u_misc.h"
 #include "util/u_sink.h"
 #include "util/u_frame.h"
+#include "util/u_frame_pool.h"
 #include "util/u_trace_marker.h"
 
 #include "wmr_config.h"
@@ -36,7 +38,7 @@ DEBUG_GET_ONCE_BOOL_OPTION(wmr_autoexposure, "WMR_AUTOEXPOSURE", true)
 DEBUG_GET_ONCE_BOOL_OPTION(wmr_unify_expgain, "WMR_UNIFY_EXPGAIN", false)
 
 static int
-update_expgain(struct wmr_camera *cam, struct xrt_frame **frames);
+update_expgain(struct wmr_camera *cam, struct u_autoexpgain_histogram *hists);
 
 /*
  *
@@ -109,6 +111,16 @@ struct wmr_camera
 
 	struct libusb_transfer *xfers[NUM_XFERS];
 
+	/*!
+	 * Recycles the transfer buffers, the frame is assembled in place in the
+	 * buffer and handed downstream, the buffer only goes back to the pool
+	 * once every consumer has released the frame.
+	 */
+	struct u_frame_pool *frame_pool;
+
+	//! The pooled frame each transfer is currently receiving into.
+	struct xrt_frame *xfer_frames[NUM_XFERS];
+
 	struct wmr_camera_expgain
 	{
 		bool manual_control; //!< Whether to control exp/gain manually or with aeg
@@ -276,6 +288,50 @@ set_active(struct wmr_camera *cam, bool active)
 	return send_buffer_to_device(cam, (uint8_t *)&cmd, sizeof(cmd));
 }
 
+/*!
+ * Removes the slice headers from a transfer in place, moving each slice down
+ * over the headers before it, so the transfer buffer becomes the frame. While a
+ * slice is still in the cache the rows it completed are sampled for the
+ * histograms, if any are given.
+ */
+static void
+assemble_frame(struct wmr_camera *cam,
+               uint8_t *data,
+               size_t frame_size,
+               struct u_autoexpgain_histogram *hists,
+               int hist_count)
+{
+	const uint8_t *src = data;
+	uint8_t *dst = data;
+	size_t done = 0;
+	const size_t chunk_size = 0x6000 - 32;
+
+	while (done < frame_size) {
+		const size_t to_copy = frame_size - done > chunk_size ? chunk_size : frame_size - done;
+
+		/* 32 byte header seems to contain:
+		 *   __be32 magic = "Dlo+"
+		 *   __le32 frame_ctr;
+		 *   __le32 slice_ctr;
+		 *   __u8 unknown[20]; - binary block where all bytes are different each slice,
+		 *                       but repeat every 8 slices. They're different each boot
+		 *                       of the headset. Might just be uninitialised memory?
+		 */
+		src += 0x20;
+
+		// Overlaps with the slice itself, dst is always behind src.
+		memmove(dst, src, to_copy);
+		src += to_copy;
+		dst += to_copy;
+		done += to_copy;
+
+		for (int i = 0; i < hist_count; i++) {
+			u_autoexpgain_histogram_sample_rows(&hists[i], data, done, cam->frame_width,
+			                                    &cam->tcam_confs[i].roi);
+		}
+	}
+}
+
 static void LIBUSB_CALL
 img_xfer_cb(struct libusb_transfer *xfer)
 {
@@ -296,43 +352,13 @@ img_xfer_cb(struct libusb_transfer *xfer)
 
 	WMR_CAM_TRACE(cam, "Camera transfer complete - %d bytes of %d", xfer->actual_length, xfer->length);
 
-	/* Convert the output into frames and send them off to debug / tracking */
-	struct xrt_frame *xf = NULL;
-
-	/* There's always one extra line of pixels with exposure info */
-	u_frame_create_one_off(XRT_FORMAT_L8, cam->frame_width, cam->frame_height + 1, &xf);
-
-	const uint8_t *src = xfer->buffer;
-
-	uint8_t *dst = xf->data;
-	size_t dst_remain = xf->size;
-	const size_t chunk_size = 0x6000 - 32;
-
-	DRV_TRACE_BEGIN(copy_to_frame);
-	while (dst_remain > 0) {
-		const size_t to_copy = dst_remain > chunk_size ? chunk_size : dst_remain;
-
-		/* 32 byte header seems to contain:
-		 *   __be32 magic = "Dlo+"
-		 *   __le32 frame_ctr;
-		 *   __le32 slice_ctr;
-		 *   __u8 unknown[20]; - binary block where all bytes are different each slice,
-		 *                       but repeat every 8 slices. They're different each boot
-		 *                       of the headset. Might just be uninitialised memory?
-		 */
-		src += 0x20;
-
-		memcpy(dst, src, to_copy);
-		src += to_copy;
-		dst += to_copy;
-		dst_remain -= to_copy;
+	int xfer_index = 0;
+	while (xfer_index < NUM_XFERS && cam->xfers[xfer_index] != xfer) {
+		xfer_index++;
 	}
-	DRV_TRACE_END(copy_to_frame);
-
-	/* There should be exactly a 26 byte footer left over */
-	assert(xfer->buffer + xfer->length - src == 26);
+	assert(xfer_index < NUM_XFERS);
 
-	/* Footer contains:
+	/* Footer is the last 26 bytes and contains:
 	 * __le64 start_ts; - 100ns unit timestamp, from same clock as video_timestamps on the IMU feed
 	 * __le64 end_ts;   - 100ns unit timestamp, always about 111000 * 100ns later than start_ts ~= 90Hz
 	 * __le16 ctr1;     - Counter that increments by 88, but sometimes by 96, and wraps at 16384
@@ -340,6 +366,7 @@ img_xfer_cb(struct libusb_transfer *xfer)
 	 * __be32 magic     - "Dlo+"
 	 * __le16 frametype?- either 0x00 or 0x02. Every 3rd frame is 0x0, others are 0x2. Might be SLAM vs controllers?
 	 */
+	const uint8_t *src = xfer->buffer + xfer->length - 26;
 	uint64_t frame_start_ts = read64(&src) * WMR_MS_HOLOLENS_NS_PER_TICK;
 	uint64_t frame_end_ts = read64(&src) * WMR_MS_HOLOLENS_NS_PER_TICK;
 	int64_t delta = frame_end_ts - frame_start_ts;
@@ -357,6 +384,36 @@ img_xfer_cb(struct libusb_transfer *xfer)
 	              frame_start_ts, frame_start_ts - cam->last_frame_ts, frame_end_ts, delta, unknown16, unknown16_2,
 	              frametype);
 
+	/*
+	 * Take the filled buffer, the transfer gets a recycled one. The frame
+	 * goes back to the pool when every consumer has released it. Without a
+	 * new buffer the transfer keeps the old one and the frame is dropped.
+	 */
+	struct xrt_frame *recycled = NULL;
+	if (!u_frame_pool_get(cam->frame_pool, &recycled)) {
+		WMR_CAM_ERROR(cam, "Could not allocate a transfer buffer, dropping frame");
+		goto out;
+	}
+
+	struct xrt_frame *xf = cam->xfer_frames[xfer_index];
+	cam->xfer_frames[xfer_index] = recycled;
+	xfer->buffer = recycled->data;
+
+	/* There's always one extra line of pixels with exposure info, see wmr_camera_start */
+	xf->height = cam->frame_height + 1;
+	xf->size = xf->stride * xf->height;
+
+	// Only the SLAM frames are used for auto exposure.
+	struct u_autoexpgain_histogram hists[WMR_MAX_CAMERAS];
+	int hist_count = slam_tracking_frame ? cam->slam_cam_count : 0;
+	for (int i = 0; i < hist_count; i++) {
+		u_autoexpgain_histogram_init(&hists[i], cam->tcam_confs[i].roi.extent.w);
+	}
+
+	DRV_TRACE_BEGIN(assemble_frame);
+	assemble_frame(cam, xf->data, xf->size, hists, hist_count);
+	DRV_TRACE_END(assemble_frame);
+
 	/* Read values from the pixel header */
 	uint16_t exposure = xf->data[6] << 8 | xf->data[7];
 	uint8_t seq = xf->data[89];
@@ -385,14 +442,14 @@ img_xfer_cb(struct libusb_transfer *xfer)
 	if (slam_tracking_frame) {
 		DRV_TRACE_IDENT(push_to_sinks);
 
+		update_expgain(cam, hists);
+
 		// Tracking frames usually come at ~30fps
 		struct xrt_frame *frames[WMR_MAX_CAMERAS] = {NULL};
 		for (int i = 0; i < cam->slam_cam_count; i++) {
 			u_frame_create_roi(xf, cam->tcam_confs[i].roi, &frames[i]);
 		}
 
-		update_expgain(cam, frames);
-
 		for (int i = 0; i < cam->slam_cam_count; i++) {
 			xrt_sink_push_frame(cam->cam_sinks[i], frames[i]);
 		}
@@ -562,10 +619,18 @@ wmr_camera_free(struct wmr_camera *cam)
 			cam->xfers[i] = NULL;
 		}
 
+		// The transfers are gone, nothing receives into these anymore.
+		for (i = 0; i < NUM_XFERS; i++) {
+			xrt_frame_reference(&cam->xfer_frames[i], NULL);
+		}
+
 		libusb_exit(cam->ctx);
 		cam->ctx = NULL;
 	}
 
+	// Frames still held downstream keep the pool alive until released.
+	u_frame_pool_destroy(&cam->frame_pool);
+
 	// Tidy the variable tracking.
 	u_var_remove_root(cam);
 	u_sink_debug_destroy(&cam->debug_sinks[WMR_DEBUG_SINK_SLAM]);
@@ -601,12 +666,36 @@ wmr_camera_start(struct wmr_camera *cam)
 		goto fail;
 	}
 
+	/*
+	 * The frames are the transfer buffers, so they have as many rows as
+	 * needed to hold a whole transfer with the slice headers and footer,
+	 * they are shrunk to the image once it has been assembled.
+	 */
+	uint32_t xfer_rows = (uint32_t)((cam->xfer_size + cam->frame_width - 1) / cam->frame_width);
+	if (cam->frame_pool == NULL ||
+	    !u_frame_pool_matches(cam->frame_pool, XRT_FORMAT_L8, cam->frame_width, xfer_rows)) {
+		// Recycled from the last start, too small or too large for the new size.
+		for (int i = 0; i < NUM_XFERS; i++) {
+			xrt_frame_reference(&cam->xfer_frames[i], NULL);
+		}
+		u_frame_pool_destroy(&cam->frame_pool);
+		cam->frame_pool = u_frame_pool_create(XRT_FORMAT_L8, cam->frame_width, xfer_rows, NUM_XFERS * 2,
+		                                      "WMR Camera frame pool");
+		if (cam->frame_pool == NULL) {
+			WMR_CAM_ERROR(cam, "Could not create the transfer buffer pool");
+			goto fail;
+		}
+	}
+
 	for (int i = 0; i < NUM_XFERS; i++) {
-		uint8_t *recv_buf = malloc(cam->xfer_size);
+		if (cam->xfer_frames[i] == NULL && !u_frame_pool_get(cam->frame_pool, &cam->xfer_frames[i])) {
+			WMR_CAM_ERROR(cam, "Could not allocate transfer buffers");
+			goto fail;
+		}
+		uint8_t *recv_buf = cam->xfer_frames[i]->data;
 
 		libusb_fill_bulk_transfer(cam->xfers[i], cam->dev, LIBUSB_ENDPOINT_IN | 5, recv_buf, cam->xfer_size,
 		                          img_xfer_cb, cam, 0);
-		cam->xfers[i]->flags |= LIBUSB_TRANSFER_FREE_BUFFER;
 
 		res = libusb_submit_transfer(cam->xfers[i]);
 		if (res < 0) {
@@ -667,7 +756,7 @@ fail:
 }
 
 static int
-update_expgain(struct wmr_camera *cam, struct xrt_frame **frames)
+update_expgain(struct wmr_camera *cam, struct u_autoexpgain_histogram *hists)
 {
 	int res = 0;
 	for (int i = 0; i < cam->tcam_count; i++) {
@@ -675,9 +764,9 @@ update_expgain(struct wmr_camera *cam, struct xrt_frame **frames)
 
 		struct wmr_camera_expgain *ceg = &cam->ceg[i];
 
-		if (!ceg->manual_control && frames != NULL && frames[i] != NULL) {
+		if (!ceg->manual_control && hists != NULL && i < cam->slam_cam_count) {
 			if (!cam->unify_expgains || i == 0) {
-				u_autoexpgain_update(ceg->aeg, frames[i]);
+				u_autoexpgain_update_histogram(ceg->aeg, hists[i].bins, hists[i].count);
 				ceg->exposure = (uint16_t)u_autoexpgain_get_exposure(ceg->aeg);
 				ceg->gain = (uint8_t)u_autoexpgain_get_gain(ceg->aeg);
 			} else {
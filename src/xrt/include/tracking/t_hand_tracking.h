@@ -128,6 +128,35 @@ struct t_hand_tracking_sync
 	                struct xrt_hand_joint_set *out_right_hand,
 	                uint64_t *out_timestamp_ns);
 
+	/*!
+	 * Optional, @ref process split into two stages so that the inference of
+	 * one frame can run at the same time as the optimisation of the frame
+	 * before it. Frames are put through @ref infer and then @ref optimize in
+	 * the same order, each stage is only called from one thread at a time.
+	 *
+	 * @p slot is in the range [0, @ref pipeline_depth) and is where the
+	 * tracker keeps the state of the frame between the two stages, a slot is
+	 * not reused until the frame in it has been optimised. The frames only
+	 * need to be valid during @ref infer.
+	 */
+	void (*infer)(struct t_hand_tracking_sync *ht_sync,
+	              uint32_t slot,
+	              struct xrt_frame *left_frame,
+	              struct xrt_frame *right_frame);
+
+	/*!
+	 * Second stage of the split, see @ref infer, gets back the result of the
+	 * frame put in @p slot.
+	 */
+	void (*optimize)(struct t_hand_tracking_sync *ht_sync,
+	                 uint32_t slot,
+	                 struct xrt_hand_joint_set *out_left_hand,
+	                 struct xrt_hand_joint_set *out_right_hand,
+	                 uint64_t *out_timestamp_ns);
+
+	//! Number of slots for @ref infer and @ref optimize, zero if not split.
+	uint32_t pipeline_depth;
+
 	/*!
 	 * Destroy this hand tracker sync object.
 	 */
@@ -150,6 +179,35 @@ t_ht_sync_process(struct t_hand_tracking_sync *ht_sync,
 	ht_sync->process(ht_sync, left_frame, right_frame, out_left_hand, out_right_hand, out_timestamp_ns);
 }
 
+/*!
+ * @copydoc t_hand_tracking_sync::infer
+ *
+ * @public @memberof t_hand_tracking_sync
+ */
+static inline void
+t_ht_sync_infer(struct t_hand_tracking_sync *ht_sync,
+                uint32_t slot,
+                struct xrt_frame *left_frame,
+                struct xrt_frame *right_frame)
+{
+	ht_sync->infer(ht_sync, slot, left_frame, right_frame);
+}
+
+/*!
+ * @copydoc t_hand_tracking_sync::optimize
+ *
+ * @public @memberof t_hand_tracking_sync
+ */
+static inline void
+t_ht_sync_optimize(struct t_hand_tracking_sync *ht_sync,
+                   uint32_t slot,
+                   struct xrt_hand_joint_set *out_left_hand,
+                   struct xrt_hand_joint_set *out_right_hand,
+                   uint64_t *out_timestamp_ns)
+{
+	ht_sync->optimize(ht_sync, slot, out_left_hand, out_right_hand, out_timestamp_ns);
+}
+
 /*!
  * @copydoc t_hand_tracking_sync::destroy
  *
@@ -159,6 +159,13 @@ struct ipc_connection
 	struct ipc_shared_memory *ism;
 	xrt_shmem_handle_t ism_handle;
 
+	//! Shared memory only this client and the service can see.
+	struct ipc_client_shared_memory *icsm;
+	xrt_shmem_handle_t icsm_handle;
+
+	//! Command ring in @ref icsm for the calls that can use it, NULL if not available.
+	struct ipc_command_ring *ring;
+
 	struct os_mutex mutex;
 
 #ifdef XRT_OS_ANDROID
@@ -242,6 +249,20 @@ ipc_client_hmd_create(struct ipc_connection *ipc_c, struct xrt_tracking_origin *
 struct xrt_device *
 ipc_client_device_create(struct ipc_connection *ipc_c, struct xrt_tracking_origin *xtrack, uint32_t device_id);
 
+/*!
+ * Tries to answer a @ref xrt_device_get_tracked_pose call from the pose
+ * histories the service publishes in shared memory, without a round trip.
+ *
+ * @return false if the caller needs to ask the service.
+ */
+bool
+ipc_client_device_try_get_tracked_pose_shm(struct ipc_connection *ipc_c,
+                                           struct xrt_device *xdev,
+                                           uint32_t device_id,
+                                           enum xrt_input_name name,
+                                           uint64_t at_timestamp_ns,
+                                           struct xrt_space_relation *out_relation);
+
 struct xrt_system *
 ipc_client_system_create(struct ipc_connection *ipc_c, struct xrt_system_compositor *xsysc);
 
@@ -27,6 +27,7 @@
 #include "util/u_system_helpers.h"
 
 #include "shared/ipc_utils.h"
+#include "shared/ipc_shmem.h"
 #include "shared/ipc_protocol.h"
 #include "client/ipc_client_connection.h"
 
@@ -56,6 +57,7 @@
 #endif // XRT_OS_ANDROID
 
 DEBUG_GET_ONCE_BOOL_OPTION(ipc_ignore_version, "IPC_IGNORE_VERSION", false)
+DEBUG_GET_ONCE_BOOL_OPTION(ipc_command_ring, "IPC_COMMAND_RING", true)
 
 #ifdef XRT_OS_ANDROID
 
@@ -329,6 +331,40 @@ ipc_client_describe_client(struct ipc_connection *ipc_c, const struct xrt_instan
 	return XRT_SUCCESS;
 }
 
+static xrt_result_t
+ipc_client_setup_client_shm(struct ipc_connection *ipc_c)
+{
+	xrt_result_t xret = ipc_call_instance_get_client_shm_fd(ipc_c, &ipc_c->icsm_handle, 1);
+	if (xret != XRT_SUCCESS) {
+		IPC_ERROR(ipc_c, "Failed to retrieve client shm fd!");
+		return xret;
+	}
+
+	xret = ipc_shmem_map(ipc_c->icsm_handle, sizeof(struct ipc_client_shared_memory), (void **)&ipc_c->icsm);
+	if (xret != XRT_SUCCESS) {
+		IPC_ERROR(ipc_c, "Failed to mmap client shm!");
+		return xret;
+	}
+
+	return XRT_SUCCESS;
+}
+
+static void
+ipc_client_setup_command_ring(struct ipc_connection *ipc_c)
+{
+	if (!debug_get_bool_option_ipc_command_ring()) {
+		return;
+	}
+
+	xrt_result_t xret = ipc_call_instance_start_command_ring(ipc_c);
+	if (xret != XRT_SUCCESS) {
+		// Not an error, all calls still work over the socket.
+		IPC_INFO(ipc_c, "No command ring from the service, using the socket for all calls.");
+		return;
+	}
+
+	ipc_c->ring = &ipc_c->icsm->ring;
+}
 
 /*
  *
@@ -347,6 +383,7 @@ ipc_client_connection_init(struct ipc_connection *ipc_c,
 	ipc_c->imc.ipc_handle = XRT_IPC_HANDLE_INVALID;
 	ipc_c->imc.log_level = log_level;
 	ipc_c->ism_handle = XRT_SHMEM_HANDLE_INVALID;
+	ipc_c->icsm_handle = XRT_SHMEM_HANDLE_INVALID;
 
 	// Must be done first.
 	int ret = os_mutex_init(&ipc_c->mutex);
@@ -384,12 +421,21 @@ ipc_client_connection_init(struct ipc_connection *ipc_c,
 		goto err_fini; // Already logged.
 	}
 
+	// Requires a service of the same version.
+	xret = ipc_client_setup_client_shm(ipc_c);
+	if (xret != XRT_SUCCESS) {
+		goto err_fini; // Already logged.
+	}
+
 	// Do this last.
 	xret = ipc_client_describe_client(ipc_c, i_info);
 	if (xret != XRT_SUCCESS) {
 		goto err_fini; // Already logged.
 	}
 
+	// Optional, only speeds up some calls.
+	ipc_client_setup_command_ring(ipc_c);
+
 	return XRT_SUCCESS;
 
 err_fini:
@@ -404,7 +450,11 @@ ipc_client_connection_fini(struct ipc_connection *ipc_c)
 	if (ipc_c->ism_handle != XRT_SHMEM_HANDLE_INVALID) {
 		/// @todo how to tear down the shared memory?
 	}
+	ipc_c->ring = NULL;
 	ipc_message_channel_close(&ipc_c->imc);
+
+	// Checks for NULL and invalid handles.
+	ipc_shmem_destroy(&ipc_c->icsm_handle, (void **)&ipc_c->icsm, sizeof(struct ipc_client_shared_memory));
 	os_mutex_destroy(&ipc_c->mutex);
 
 #ifdef XRT_OS_ANDROID
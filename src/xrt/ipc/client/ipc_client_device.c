@@ -18,6 +18,7 @@
 #include "util/u_debug.h"
 #include "util/u_device.h"
 
+#include "shared/ipc_pose_history.h"
 #include "client/ipc_client.h"
 #include "ipc_client_generated.h"
 
@@ -89,6 +90,11 @@ ipc_client_device_get_tracked_pose(struct xrt_device *xdev,
 {
 	ipc_client_device_t *icd = ipc_client_device(xdev);
 
+	if (ipc_client_device_try_get_tracked_pose_shm(icd->ipc_c, xdev, icd->device_id, name, at_timestamp_ns,
+	                                               out_relation)) {
+		return;
+	}
+
 	xrt_result_t xret = ipc_call_device_get_tracked_pose( //
 	    icd->ipc_c,                                       //
 	    icd->device_id,                                   //
@@ -229,3 +235,51 @@ ipc_client_device_create(struct ipc_connection *ipc_c, struct xrt_tracking_origi
 	icd->base.device_type = isdev->device_type;
 	return &icd->base;
 }
+
+bool
+ipc_client_device_try_get_tracked_pose_shm(struct ipc_connection *ipc_c,
+                                           struct xrt_device *xdev,
+                                           uint32_t device_id,
+                                           enum xrt_input_name name,
+                                           uint64_t at_timestamp_ns,
+                                           struct xrt_space_relation *out_relation)
+{
+	struct ipc_shared_memory *ism = ipc_c->ism;
+	if (!ism->pose_histories.enabled || device_id >= XRT_SYSTEM_MAX_DEVICES) {
+		return false;
+	}
+
+	// Suppressed IO for this client, the service knows how to handle it.
+	if (xrt_atomic_s32_load(&ipc_c->icsm->io_active) == 0) {
+		return false;
+	}
+
+	/*
+	 * The service has the final say on inactive inputs, the inputs point
+	 * into the shared memory so this is up to date with the last
+	 * update_inputs call.
+	 */
+	bool active = false;
+	for (uint32_t i = 0; i < xdev->input_count; i++) {
+		if (xdev->inputs[i].name == name) {
+			active = xdev->inputs[i].active;
+			break;
+		}
+	}
+	if (!active) {
+		return false;
+	}
+
+	struct ipc_shared_device_poses *isdp = &ism->pose_histories.devices[device_id];
+	for (uint32_t i = 0; i < isdp->history_count && i < IPC_SHARED_MAX_POSE_INPUTS; i++) {
+		struct ipc_shared_pose_history *iph = &isdp->histories[i];
+		if (iph->name != name) {
+			continue;
+		}
+
+		return ipc_pose_history_get(iph, at_timestamp_ns, ism->pose_histories.max_prediction_ns,
+		                            out_relation);
+	}
+
+	return false;
+}
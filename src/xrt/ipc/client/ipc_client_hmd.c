@@ -157,6 +157,11 @@ ipc_client_hmd_get_tracked_pose(struct xrt_device *xdev,
 	ipc_client_hmd_t *ich = ipc_client_hmd(xdev);
 	xrt_result_t xret;
 
+	if (ipc_client_device_try_get_tracked_pose_shm(ich->ipc_c, xdev, ich->device_id, name, at_timestamp_ns,
+	                                               out_relation)) {
+		return;
+	}
+
 	xret = ipc_call_device_get_tracked_pose( //
 	    ich->ipc_c,                          //
 	    ich->device_id,                      //
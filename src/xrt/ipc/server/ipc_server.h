@@ -126,6 +126,30 @@ struct ipc_client_state
 	//! Socket fd used for client comms
 	struct ipc_message_channel imc;
 
+	/*!
+	 * Held while dispatching a call, the socket thread and the command ring
+	 * thread must never run handlers at the same time.
+	 */
+	struct os_mutex dispatch_lock;
+
+	//! Serves the command ring, see @ref ipc_server_client_start_command_ring.
+	struct
+	{
+		struct os_thread thread;
+
+		//! The ring in @ref icsm, NULL if not started.
+		struct ipc_command_ring *ring;
+
+		//! Cleared to stop the thread.
+		xrt_atomic_s32_t running;
+	} command_ring;
+
+	//! Shared memory only shared with this client.
+	struct ipc_client_shared_memory *icsm;
+
+	//! Handle for @ref icsm, handed out by instance_get_client_shm_fd.
+	xrt_shmem_handle_t icsm_handle;
+
 	struct ipc_app_state client_state;
 
 	int server_thread_index;
@@ -340,6 +364,15 @@ struct ipc_server
 
 	struct ipc_server_mainloop ml;
 
+	//! Publishes device poses into @ref ipc_shared_memory::pose_histories.
+	struct
+	{
+		struct os_thread_helper oth;
+
+		//! Time between two samples.
+		uint64_t period_ns;
+	} pose_publisher;
+
 	// Is the mainloop supposed to run.
 	volatile bool running;
 
@@ -428,6 +461,15 @@ ipc_server_client_thread(void *_ics);
 void
 ipc_server_client_destroy_session_and_compositor(volatile struct ipc_client_state *ics);
 
+/*!
+ * Starts serving the command ring in the client's own shared memory on its own
+ * thread, calls marked as ring calls in the protocol then skip the socket.
+ *
+ * @ingroup ipc_server
+ */
+xrt_result_t
+ipc_server_client_start_command_ring(volatile struct ipc_client_state *ics);
+
 /*!
  * @defgroup ipc_server_internals Server Internals
  * @brief These are only called by the platform-specific mainloop polling code.
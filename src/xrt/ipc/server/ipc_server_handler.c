@@ -212,6 +212,30 @@ ipc_handle_instance_describe_client(volatile struct ipc_client_state *ics,
 	return XRT_SUCCESS;
 }
 
+xrt_result_t
+ipc_handle_instance_get_client_shm_fd(volatile struct ipc_client_state *ics,
+                                      uint32_t max_handle_capacity,
+                                      xrt_shmem_handle_t *out_handles,
+                                      uint32_t *out_handle_count)
+{
+	IPC_TRACE_MARKER();
+
+	assert(max_handle_capacity >= 1);
+
+	out_handles[0] = ics->icsm_handle;
+	*out_handle_count = 1;
+
+	return XRT_SUCCESS;
+}
+
+xrt_result_t
+ipc_handle_instance_start_command_ring(volatile struct ipc_client_state *ics)
+{
+	IPC_TRACE_MARKER();
+
+	return ipc_server_client_start_command_ring(ics);
+}
+
 xrt_result_t
 ipc_handle_system_compositor_get_info(volatile struct ipc_client_state *ics,
                                       struct xrt_system_compositor_info *out_info)
@@ -1188,9 +1212,13 @@ ipc_handle_system_toggle_io_device(volatile struct ipc_client_state *ics, uint32
 		return XRT_ERROR_IPC_FAILURE;
 	}
 
-	struct ipc_device *idev = &ics->server->idevs[device_id];
+	struct ipc_server *s = ics->server;
+	struct ipc_device *idev = &s->idevs[device_id];
 
+	// The pose publisher reads it from its own thread.
+	os_mutex_lock(&s->global_state.lock);
 	idev->io_active = !idev->io_active;
+	os_mutex_unlock(&s->global_state.lock);
 
 	return XRT_SUCCESS;
 }
@@ -12,6 +12,8 @@
 #include "util/u_trace_marker.h"
 
 #include "shared/ipc_utils.h"
+#include "shared/ipc_shmem.h"
+#include "shared/ipc_command_ring.h"
 #include "server/ipc_server.h"
 #include "ipc_server_generated.h"
 
@@ -23,7 +25,7 @@
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
-#include <sys/epoll.h>
+#include <sys/time.h>
 #include <sys/socket.h>
 
 #endif // XRT_OS_WINDOWS
@@ -35,9 +37,29 @@
  *
  */
 
+static void
+stop_command_ring(volatile struct ipc_client_state *ics)
+{
+	if (ics->command_ring.ring == NULL) {
+		return;
+	}
+
+	// Also wakes the thread up if it is waiting on the client.
+	xrt_atomic_s32_store(&ics->command_ring.running, 0);
+	ipc_command_ring_close(ics->command_ring.ring);
+
+	// Cast away volatile.
+	os_thread_join((struct os_thread *)&ics->command_ring.thread);
+	os_thread_destroy((struct os_thread *)&ics->command_ring.thread);
+	ics->command_ring.ring = NULL;
+}
+
 static void
 common_shutdown(volatile struct ipc_client_state *ics)
 {
+	// Handlers must not run while we tear the client down.
+	stop_command_ring(ics);
+
 	/*
 	 * Remove the thread from the server.
 	 */
@@ -51,6 +73,10 @@ common_shutdown(volatile struct ipc_client_state *ics)
 	ics->server_thread_index = -1;
 	memset((void *)&ics->client_state, 0, sizeof(struct ipc_app_state));
 
+	// The ring thread is gone, the client keeps its own mapping. Cast away volatile.
+	ipc_shmem_destroy((xrt_shmem_handle_t *)&ics->icsm_handle, (void **)&ics->icsm,
+	                  sizeof(struct ipc_client_shared_memory));
+
 	os_mutex_unlock(&ics->server->global_state.lock);
 
 
@@ -95,32 +121,6 @@ common_shutdown(volatile struct ipc_client_state *ics)
 
 #ifndef XRT_OS_WINDOWS // Linux & Android
 
-static int
-setup_epoll(volatile struct ipc_client_state *ics)
-{
-	int listen_socket = ics->imc.ipc_handle;
-	assert(listen_socket >= 0);
-
-	int ret = epoll_create1(EPOLL_CLOEXEC);
-	if (ret < 0) {
-		return ret;
-	}
-
-	int epoll_fd = ret;
-
-	struct epoll_event ev = XRT_STRUCT_INIT;
-
-	ev.events = EPOLLIN;
-	ev.data.fd = listen_socket;
-	ret = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_socket, &ev);
-	if (ret < 0) {
-		IPC_ERROR(ics->server, "Error epoll_ctl(listen_socket) failed '%i'.", ret);
-		return ret;
-	}
-
-	return epoll_fd;
-}
-
 static void
 client_loop(volatile struct ipc_client_state *ics)
 {
@@ -128,68 +128,71 @@ client_loop(volatile struct ipc_client_state *ics)
 
 	IPC_INFO(ics->server, "Client %u connected", ics->client_state.id);
 
-	// Claim the client fd.
-	int epoll_fd = setup_epoll(ics);
-	if (epoll_fd < 0) {
+	// Cast away volatile, nothing else touches the channel while we run.
+	struct ipc_message_channel *imc = (struct ipc_message_channel *)&ics->imc;
+
+	/*
+	 * Instead of waiting with epoll, peeking the command and then reading
+	 * it, a single receive reads whole framed commands (and anything the
+	 * client sent after them) into the read ahead buffer. The timeout lets
+	 * us check if the server is still running.
+	 */
+	struct timeval timeout = {.tv_sec = 0, .tv_usec = 500 * 1000};
+	int ret = setsockopt(imc->ipc_handle, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	if (ret < 0) {
+		IPC_ERROR(ics->server, "Error setsockopt(SO_RCVTIMEO) failed '%i'.", errno);
 		return;
 	}
 
+	struct ipc_frame_reader *reader = U_TYPED_CALLOC(struct ipc_frame_reader);
+	imc->reader = reader;
+	imc->running = &ics->server->running;
+
 	while (ics->server->running) {
-		const int half_a_second_ms = 500;
-		struct epoll_event event = XRT_STRUCT_INIT;
-		int ret = 0;
-
-		// On temporary failures retry.
-		do {
-			// We use epoll here to be able to timeout.
-			ret = epoll_wait(epoll_fd, &event, 1, half_a_second_ms);
-		} while (ret == -1 && errno == EINTR);
-
-		if (ret < 0) {
-			IPC_ERROR(ics->server, "Failed epoll_wait '%i', disconnecting client.", ret);
-			break;
-		}
+		uint8_t buf[IPC_BUF_SIZE] = {0};
+		size_t len = 0;
 
-		// Timed out, loop again.
-		if (ret == 0) {
+		xrt_result_t xret = ipc_receive_command(imc, buf, sizeof(buf), &len);
+		if (xret == XRT_TIMEOUT) {
+			// Timed out, loop again.
 			continue;
 		}
 
+		if (xret != XRT_SUCCESS) {
+			IPC_ERROR(ics->server, "Invalid command received, disconnecting client.");
+			break;
+		}
+
 		// Detect clients disconnecting gracefully.
-		if (ret > 0 && (event.events & EPOLLHUP) != 0) {
+		if (len == 0) {
 			IPC_INFO(ics->server, "Client disconnected.");
 			break;
 		}
 
-		// Peek the first 4 bytes to get the command type
-		enum ipc_command cmd;
-		ssize_t len = recv(ics->imc.ipc_handle, &cmd, sizeof(cmd), MSG_PEEK);
-		if (len != sizeof(cmd)) {
+		if (len < sizeof(enum ipc_command)) {
 			IPC_ERROR(ics->server, "Invalid command received.");
 			break;
 		}
 
-		size_t cmd_size = ipc_command_size(cmd);
+		// Check the first 4 bytes of the message and dispatch.
+		ipc_command_t *ipc_command = (ipc_command_t *)buf;
+
+		size_t cmd_size = ipc_command_size(*ipc_command);
 		if (cmd_size == 0) {
 			IPC_ERROR(ics->server, "Invalid command size.");
 			break;
 		}
 
-		// Read the whole command now that we know its size
-		uint8_t buf[IPC_BUF_SIZE] = {0};
-
-		len = recv(ics->imc.ipc_handle, &buf, cmd_size, 0);
-		if (len != (ssize_t)cmd_size) {
+		if (len != cmd_size) {
 			IPC_ERROR(ics->server, "Invalid packet received, disconnecting client.");
 			break;
 		}
 
-		// Check the first 4 bytes of the message and dispatch.
-		ipc_command_t *ipc_command = (ipc_command_t *)buf;
-
+		os_mutex_lock((struct os_mutex *)&ics->dispatch_lock);
 		IPC_TRACE_BEGIN(ipc_dispatch);
 		xrt_result_t result = ipc_dispatch(ics, ipc_command);
 		IPC_TRACE_END(ipc_dispatch);
+		os_mutex_unlock((struct os_mutex *)&ics->dispatch_lock);
 
 		if (result != XRT_SUCCESS) {
 			IPC_ERROR(ics->server, "During packet handling, disconnecting client.");
@@ -197,13 +200,77 @@ client_loop(volatile struct ipc_client_state *ics)
 		}
 	}
 
-	close(epoll_fd);
-	epoll_fd = -1;
+	imc->reader = NULL;
+	imc->running = NULL;
+	free(reader);
 
 	// Following code is same for all platforms.
 	common_shutdown(ics);
 }
 
+#ifdef IPC_COMMAND_RING_SUPPORTED
+
+static void *
+command_ring_thread(void *ptr)
+{
+	volatile struct ipc_client_state *ics = (volatile struct ipc_client_state *)ptr;
+	struct ipc_command_ring *ring = ics->command_ring.ring;
+
+	U_TRACE_SET_THREAD_NAME("IPC Ring");
+
+	int32_t seq = 0;
+
+	while (xrt_atomic_s32_load(&ics->command_ring.running) != 0 && ics->server->running) {
+		uint8_t buf[IPC_BUF_SIZE] = {0};
+		size_t len = 0;
+
+		// The timeout lets us check if we should stop.
+		xrt_result_t xret = ipc_command_ring_wait_request(ring, seq, 500, &seq, buf, sizeof(buf), &len);
+		if (xret == XRT_TIMEOUT) {
+			continue;
+		}
+
+		if (xret != XRT_SUCCESS) {
+			IPC_ERROR(ics->server, "Invalid request in the command ring, closing it.");
+			break;
+		}
+
+		if (len < sizeof(enum ipc_command)) {
+			IPC_ERROR(ics->server, "Invalid command in the command ring, closing it.");
+			break;
+		}
+
+		ipc_command_t *ipc_command = (ipc_command_t *)buf;
+		if (ipc_command_size(*ipc_command) != len) {
+			IPC_ERROR(ics->server, "Invalid command size in the command ring, closing it.");
+			break;
+		}
+
+		uint8_t reply[IPC_BUF_SIZE];
+		size_t reply_size = 0;
+
+		os_mutex_lock((struct os_mutex *)&ics->dispatch_lock);
+		IPC_TRACE_BEGIN(ipc_dispatch_ring);
+		xret = ipc_dispatch_ring(ics, ipc_command, reply, &reply_size);
+		IPC_TRACE_END(ipc_dispatch_ring);
+		os_mutex_unlock((struct os_mutex *)&ics->dispatch_lock);
+
+		if (xret != XRT_SUCCESS) {
+			IPC_ERROR(ics->server, "During command ring handling, closing it.");
+			break;
+		}
+
+		ipc_command_ring_reply(ring, seq, reply, reply_size);
+	}
+
+	// Fails the call the client might be waiting on and any new ones.
+	ipc_command_ring_close(ring);
+
+	return NULL;
+}
+
+#endif // IPC_COMMAND_RING_SUPPORTED
+
 #else // XRT_OS_WINDOWS
 
 static void
@@ -324,12 +391,49 @@ ipc_server_client_destroy_session_and_compositor(volatile struct ipc_client_stat
 	xrt_session_destroy((struct xrt_session **)&ics->xs);
 }
 
+xrt_result_t
+ipc_server_client_start_command_ring(volatile struct ipc_client_state *ics)
+{
+#ifdef IPC_COMMAND_RING_SUPPORTED
+	if (ics->command_ring.ring == NULL) {
+		struct ipc_command_ring *ring = &ics->icsm->ring;
+		ipc_command_ring_open(ring);
+
+		ics->command_ring.ring = ring;
+		xrt_atomic_s32_store(&ics->command_ring.running, 1);
+
+		// Cast away volatile.
+		struct os_thread *thread = (struct os_thread *)&ics->command_ring.thread;
+		int ret = os_thread_init(thread);
+		if (ret == 0) {
+			ret = os_thread_start(thread, command_ring_thread, (void *)ics);
+		}
+		if (ret != 0) {
+			IPC_ERROR(ics->server, "Failed to start command ring thread '%i'.", ret);
+			ipc_command_ring_close(ring);
+			ics->command_ring.ring = NULL;
+			return XRT_ERROR_IPC_FAILURE;
+		}
+	}
+
+	return XRT_SUCCESS;
+#else
+	// Not supported, the client keeps using the socket.
+	return XRT_ERROR_IPC_FAILURE;
+#endif
+}
+
 void *
 ipc_server_client_thread(void *_ics)
 {
 	volatile struct ipc_client_state *ics = (volatile struct ipc_client_state *)_ics;
 
+	// Cast away volatile.
+	os_mutex_init((struct os_mutex *)&ics->dispatch_lock);
+
 	client_loop(ics);
 
+	os_mutex_destroy((struct os_mutex *)&ics->dispatch_lock);
+
 	return NULL;
 }
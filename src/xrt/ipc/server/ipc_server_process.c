@@ -19,6 +19,7 @@
 #include "os/os_time.h"
 #include "util/u_var.h"
 #include "util/u_misc.h"
+#include "util/u_time.h"
 #include "util/u_debug.h"
 #include "util/u_trace_marker.h"
 #include "util/u_verify.h"
@@ -29,6 +30,7 @@
 #include "util/u_git_tag.h"
 
 #include "shared/ipc_shmem.h"
+#include "shared/ipc_pose_history.h"
 #include "server/ipc_server.h"
 #include "server/ipc_server_interface.h"
 
@@ -57,6 +59,9 @@
 
 DEBUG_GET_ONCE_BOOL_OPTION(exit_on_disconnect, "IPC_EXIT_ON_DISCONNECT", false)
 DEBUG_GET_ONCE_LOG_OPTION(ipc_log, "IPC_LOG", U_LOGGING_INFO)
+DEBUG_GET_ONCE_BOOL_OPTION(publish_poses, "IPC_PUBLISH_POSES", false)
+DEBUG_GET_ONCE_NUM_OPTION(publish_poses_hz, "IPC_PUBLISH_POSES_HZ", 1000)
+DEBUG_GET_ONCE_NUM_OPTION(publish_poses_max_prediction_ms, "IPC_PUBLISH_POSES_MAX_PREDICTION_MS", 50)
 
 
 /*
@@ -189,11 +194,29 @@ print_linux_end_user_started_information(enum u_logging_level log_level)
 	U_LOG_IFL_I(log_level, "%s", sink.buffer);
 }
 
+static void
+teardown_pose_publisher(struct ipc_server *s)
+{
+	// Safe to call more than once, and before it was initialized.
+	if (!s->pose_publisher.oth.initialized) {
+		return;
+	}
+
+	os_thread_helper_destroy(&s->pose_publisher.oth);
+
+	if (s->ism != NULL) {
+		s->ism->pose_histories.enabled = false;
+	}
+}
+
 static void
 teardown_all(struct ipc_server *s)
 {
 	u_var_remove_root(s);
 
+	// Uses the devices and the shared memory, stop it first.
+	teardown_pose_publisher(s);
+
 	xrt_syscomp_destroy(&s->xsysc);
 
 	teardown_idevs(s);
@@ -421,6 +444,17 @@ init_shm(struct ipc_server *s)
 			isdev->output_count = output_index - output_start;
 			isdev->first_output_index = output_start;
 		}
+
+		// Which pose inputs get published, if the publisher is started.
+		struct ipc_shared_device_poses *isdp = &ism->pose_histories.devices[count - 1];
+		for (size_t k = 0; k < xdev->input_count && isdp->history_count < IPC_SHARED_MAX_POSE_INPUTS; k++) {
+			enum xrt_input_name name = xdev->inputs[k].name;
+			if (XRT_GET_INPUT_TYPE(name) != XRT_INPUT_TYPE_POSE) {
+				continue;
+			}
+
+			isdp->histories[isdp->history_count++].name = name;
+		}
 	}
 
 	// Finally tell the client how many devices we have.
@@ -438,6 +472,112 @@ init_shm(struct ipc_server *s)
 	return 0;
 }
 
+static void
+publish_poses(struct ipc_server *s)
+{
+	struct ipc_shared_memory *ism = s->ism;
+	uint64_t now_ns = os_monotonic_get_ns();
+
+	// Toggled by clients, take a consistent copy.
+	bool io_active[IPC_MAX_DEVICES];
+	os_mutex_lock(&s->global_state.lock);
+	for (uint32_t i = 0; i < ism->isdev_count; i++) {
+		io_active[i] = s->idevs[i].io_active;
+	}
+	os_mutex_unlock(&s->global_state.lock);
+
+	for (uint32_t i = 0; i < ism->isdev_count; i++) {
+		struct ipc_device *idev = &s->idevs[i];
+		struct ipc_shared_device_poses *isdp = &ism->pose_histories.devices[i];
+
+		for (uint32_t k = 0; k < isdp->history_count; k++) {
+			struct ipc_shared_pose_history *iph = &isdp->histories[k];
+
+			/*
+			 * Suppressed IO, empty the history so clients go through
+			 * the service which knows how to handle it. Clients with
+			 * their own IO suppressed see it in their own shared memory.
+			 */
+			if (!io_active[i] && iph->name != XRT_INPUT_GENERIC_HEAD_POSE) {
+				if (iph->sample_count > 0) {
+					ipc_pose_history_clear(iph);
+				}
+				continue;
+			}
+
+			struct xrt_space_relation relation = XRT_SPACE_RELATION_ZERO;
+			xrt_device_get_tracked_pose(idev->xdev, iph->name, now_ns, &relation);
+			ipc_pose_history_push(iph, &relation, now_ns);
+		}
+	}
+}
+
+static void *
+pose_publisher_thread(void *ptr)
+{
+	U_TRACE_SET_THREAD_NAME("IPC Pose Publisher");
+
+	struct ipc_server *s = (struct ipc_server *)ptr;
+	struct os_thread_helper *oth = &s->pose_publisher.oth;
+
+	struct os_precise_sleeper sleeper;
+	os_precise_sleeper_init(&sleeper);
+
+	os_thread_helper_lock(oth);
+	while (os_thread_helper_is_running_locked(oth)) {
+		os_thread_helper_unlock(oth);
+
+		uint64_t start_ns = os_monotonic_get_ns();
+		publish_poses(s);
+
+		uint64_t elapsed_ns = os_monotonic_get_ns() - start_ns;
+		if (elapsed_ns < s->pose_publisher.period_ns) {
+			os_precise_sleeper_nanosleep(&sleeper, (int32_t)(s->pose_publisher.period_ns - elapsed_ns));
+		}
+
+		os_thread_helper_lock(oth);
+	}
+	os_thread_helper_unlock(oth);
+
+	os_precise_sleeper_deinit(&sleeper);
+
+	return NULL;
+}
+
+static int
+init_pose_publisher(struct ipc_server *s)
+{
+	if (!debug_get_bool_option_publish_poses()) {
+		return 0;
+	}
+
+	int64_t hz = debug_get_num_option_publish_poses_hz();
+	int64_t max_prediction_ms = debug_get_num_option_publish_poses_max_prediction_ms();
+	if (hz <= 0 || max_prediction_ms < 0) {
+		IPC_ERROR(s, "Invalid pose publishing options, rate %" PRIi64 "hz max prediction %" PRIi64 "ms", hz,
+		          max_prediction_ms);
+		return -1;
+	}
+
+	s->pose_publisher.period_ns = U_TIME_1S_IN_NS / (uint64_t)hz;
+	s->ism->pose_histories.max_prediction_ns = (uint64_t)max_prediction_ms * U_TIME_1MS_IN_NS;
+
+	// Only used by clients, doesn't need to be set before the thread starts.
+	s->ism->pose_histories.enabled = true;
+
+	int ret = os_thread_helper_start(&s->pose_publisher.oth, pose_publisher_thread, s);
+	if (ret < 0) {
+		teardown_pose_publisher(s);
+		return ret;
+	}
+
+	os_thread_helper_name(&s->pose_publisher.oth, "IPC: Poses");
+
+	IPC_INFO(s, "Publishing poses at %" PRIi64 "hz.", hz);
+
+	return 0;
+}
+
 static void
 init_server_state(struct ipc_server *s)
 {
@@ -471,6 +611,14 @@ init_all(struct ipc_server *s, enum u_logging_level log_level)
 		return ret;
 	}
 
+	// Destroyed in teardown_all, so needs to be early.
+	ret = os_thread_helper_init(&s->pose_publisher.oth);
+	if (ret < 0) {
+		IPC_ERROR(s, "Pose publisher thread helper failed to init!");
+		os_mutex_destroy(&s->global_state.lock);
+		return ret;
+	}
+
 	s->process = u_process_create_if_not_running();
 
 	if (!s->process) {
@@ -518,6 +666,13 @@ init_all(struct ipc_server *s, enum u_logging_level log_level)
 		return ret;
 	}
 
+	ret = init_pose_publisher(s);
+	if (ret < 0) {
+		IPC_ERROR(s, "Failed to start pose publisher!");
+		teardown_all(s);
+		return ret;
+	}
+
 	ret = ipc_server_mainloop_init(&s->ml);
 	if (ret < 0) {
 		IPC_ERROR(s, "Failed to init ipc main loop!");
@@ -783,6 +938,7 @@ toggle_io_client_locked(struct ipc_server *s, uint32_t client_id)
 	}
 
 	ics->io_active = !ics->io_active;
+	xrt_atomic_s32_store(&ics->icsm->io_active, ics->io_active ? 1 : 0);
 
 	return XRT_SUCCESS;
 }
@@ -952,12 +1108,30 @@ ipc_server_handle_client_connected(struct ipc_server *vs, xrt_ipc_handle_t ipc_h
 	// Reset everything.
 	U_ZERO((struct ipc_client_state *)ics);
 
+	// Only this client gets the handle, over its own connection.
+	xrt_shmem_handle_t icsm_handle = XRT_SHMEM_HANDLE_INVALID;
+	void *icsm = NULL;
+	xrt_result_t xret = ipc_shmem_create(sizeof(struct ipc_client_shared_memory), &icsm_handle, &icsm);
+	if (xret != XRT_SUCCESS) {
+		xrt_ipc_handle_close(ipc_handle);
+		it->state = IPC_THREAD_READY;
+
+		// Unlock when we are done.
+		os_mutex_unlock(&vs->global_state.lock);
+
+		U_LOG_E("Failed to create client shared memory!");
+		return;
+	}
+
 	// Set state.
 	ics->client_state.id = id;
 	ics->imc.ipc_handle = ipc_handle;
 	ics->server = vs;
 	ics->server_thread_index = cs_index;
 	ics->io_active = true;
+	ics->icsm = (struct ipc_client_shared_memory *)icsm;
+	ics->icsm_handle = icsm_handle;
+	xrt_atomic_s32_store(&ics->icsm->io_active, 1);
 
 	os_thread_start(&it->thread, ipc_server_client_thread, (void *)ics);
 
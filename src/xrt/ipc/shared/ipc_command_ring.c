@@ -0,0 +1,282 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Shared memory request/reply ring for small fixed size calls.
+ * @ingroup ipc_shared
+ */
+
+#include "util/u_logging.h"
+
+#include "shared/ipc_command_ring.h"
+
+#include <assert.h>
+#include <string.h>
+
+#ifdef IPC_COMMAND_RING_SUPPORTED
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+
+#ifdef IPC_COMMAND_RING_SUPPORTED
+
+/*!
+ * How often a waiting client checks that the service is still there, a
+ * service that crashed will never write the reply.
+ */
+#define CLIENT_CHECK_MS 500
+
+
+/*
+ *
+ * Helpers.
+ *
+ */
+
+/*!
+ * The ring lives in memory shared between processes, so these are not the
+ * private futex operations.
+ */
+static int
+futex_wait(xrt_atomic_s32_t *word, int32_t expected, uint32_t timeout_ms)
+{
+	struct timespec ts = {
+	    .tv_sec = timeout_ms / 1000,
+	    .tv_nsec = (long)(timeout_ms % 1000) * 1000 * 1000,
+	};
+
+	long ret = syscall(SYS_futex, (int32_t *)word, FUTEX_WAIT, expected, &ts, NULL, 0);
+	if (ret < 0) {
+		return errno;
+	}
+
+	return 0;
+}
+
+static void
+futex_wake(xrt_atomic_s32_t *word)
+{
+	syscall(SYS_futex, (int32_t *)word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static int32_t
+next_seq(int32_t seq)
+{
+	// Wraps around, only ever compared for equality.
+	return (int32_t)((uint32_t)seq + 1);
+}
+
+static bool
+service_gone(struct ipc_command_ring *ring, struct ipc_message_channel *imc)
+{
+	if (xrt_atomic_s32_load(&ring->active) == 0) {
+		return true;
+	}
+
+	// The service closing the socket is the only sign of a crash.
+	struct pollfd pfd = {.fd = imc->ipc_handle, .events = 0};
+	int ret = poll(&pfd, 1, 0);
+
+	return ret > 0 && (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)) != 0;
+}
+
+
+/*
+ *
+ * 'Exported' client functions.
+ *
+ */
+
+xrt_result_t
+ipc_command_ring_call(struct ipc_command_ring *ring,
+                      struct ipc_message_channel *imc,
+                      const void *msg,
+                      size_t msg_size,
+                      void *out_reply,
+                      size_t reply_size)
+{
+	if (msg_size > sizeof(ring->request) || reply_size > sizeof(ring->reply)) {
+		U_LOG_IFL_E(imc->log_level, "Message of %u bytes or reply of %u bytes too large for the ring!",
+		            (uint32_t)msg_size, (uint32_t)reply_size);
+		return XRT_ERROR_IPC_FAILURE;
+	}
+
+	if (xrt_atomic_s32_load(&ring->active) == 0) {
+		U_LOG_IFL_E(imc->log_level, "Command ring is not served!");
+		return XRT_ERROR_IPC_FAILURE;
+	}
+
+	// Only we write the request side, the service only reads it after the bump.
+	memcpy(ring->request, msg, msg_size);
+	ring->request_size = (uint32_t)msg_size;
+
+	int32_t seq = next_seq(xrt_atomic_s32_load(&ring->request_seq));
+	xrt_atomic_thread_fence();
+	xrt_atomic_s32_store(&ring->request_seq, seq);
+	futex_wake(&ring->request_seq);
+
+	while (true) {
+		int32_t current = xrt_atomic_s32_load(&ring->reply_seq);
+		if (current == seq) {
+			break;
+		}
+
+		int ret = futex_wait(&ring->reply_seq, current, CLIENT_CHECK_MS);
+		if (ret == ETIMEDOUT && service_gone(ring, imc)) {
+			U_LOG_IFL_E(imc->log_level, "Service went away while waiting on the command ring!");
+			return XRT_ERROR_IPC_FAILURE;
+		}
+	}
+
+	xrt_atomic_thread_fence();
+
+	// A closed ring replies with nothing.
+	if (ring->reply_size != reply_size) {
+		U_LOG_IFL_E(imc->log_level, "Got a reply of %u bytes from the command ring, expected %u!",
+		            ring->reply_size, (uint32_t)reply_size);
+		return XRT_ERROR_IPC_FAILURE;
+	}
+
+	memcpy(out_reply, ring->reply, reply_size);
+
+	return XRT_SUCCESS;
+}
+
+
+/*
+ *
+ * 'Exported' service functions.
+ *
+ */
+
+void
+ipc_command_ring_open(struct ipc_command_ring *ring)
+{
+	ring->request_size = 0;
+	ring->reply_size = 0;
+	xrt_atomic_s32_store(&ring->request_seq, 0);
+	xrt_atomic_s32_store(&ring->reply_seq, 0);
+	xrt_atomic_thread_fence();
+	xrt_atomic_s32_store(&ring->active, 1);
+}
+
+void
+ipc_command_ring_close(struct ipc_command_ring *ring)
+{
+	xrt_atomic_s32_store(&ring->active, 0);
+
+	// Fail the call the client might be waiting on.
+	ring->reply_size = 0;
+	xrt_atomic_thread_fence();
+	xrt_atomic_s32_store(&ring->reply_seq, xrt_atomic_s32_load(&ring->request_seq));
+
+	futex_wake(&ring->reply_seq);
+	futex_wake(&ring->request_seq);
+}
+
+xrt_result_t
+ipc_command_ring_wait_request(struct ipc_command_ring *ring,
+                              int32_t last_seq,
+                              uint32_t timeout_ms,
+                              int32_t *out_seq,
+                              void *out_msg,
+                              size_t max_size,
+                              size_t *out_size)
+{
+	int32_t seq = xrt_atomic_s32_load(&ring->request_seq);
+	if (seq == last_seq) {
+		// Woken up or timed out, either way let the caller check if it should stop.
+		futex_wait(&ring->request_seq, last_seq, timeout_ms);
+
+		seq = xrt_atomic_s32_load(&ring->request_seq);
+		if (seq == last_seq) {
+			return XRT_TIMEOUT;
+		}
+	}
+
+	xrt_atomic_thread_fence();
+
+	// The client can write at any time, copy it out before looking at it.
+	uint32_t size = ring->request_size;
+	if (size > max_size || size > sizeof(ring->request)) {
+		U_LOG_E("Request of %u bytes in the command ring is too large!", size);
+		return XRT_ERROR_IPC_FAILURE;
+	}
+
+	memcpy(out_msg, ring->request, size);
+	*out_size = size;
+	*out_seq = seq;
+
+	return XRT_SUCCESS;
+}
+
+void
+ipc_command_ring_reply(struct ipc_command_ring *ring, int32_t seq, const void *reply, size_t size)
+{
+	assert(size <= sizeof(ring->reply));
+
+	memcpy(ring->reply, reply, size);
+	ring->reply_size = (uint32_t)size;
+
+	xrt_atomic_thread_fence();
+	xrt_atomic_s32_store(&ring->reply_seq, seq);
+	futex_wake(&ring->reply_seq);
+}
+
+
+#else // IPC_COMMAND_RING_SUPPORTED
+
+
+/*
+ *
+ * Not supported, clients never get a ring and keep using the socket.
+ *
+ */
+
+xrt_result_t
+ipc_command_ring_call(struct ipc_command_ring *ring,
+                      struct ipc_message_channel *imc,
+                      const void *msg,
+                      size_t msg_size,
+                      void *out_reply,
+                      size_t reply_size)
+{
+	return XRT_ERROR_IPC_FAILURE;
+}
+
+void
+ipc_command_ring_open(struct ipc_command_ring *ring)
+{
+	// Noop
+}
+
+void
+ipc_command_ring_close(struct ipc_command_ring *ring)
+{
+	// Noop
+}
+
+xrt_result_t
+ipc_command_ring_wait_request(struct ipc_command_ring *ring,
+                              int32_t last_seq,
+                              uint32_t timeout_ms,
+                              int32_t *out_seq,
+                              void *out_msg,
+                              size_t max_size,
+                              size_t *out_size)
+{
+	return XRT_ERROR_IPC_FAILURE;
+}
+
+void
+ipc_command_ring_reply(struct ipc_command_ring *ring, int32_t seq, const void *reply, size_t size)
+{
+	// Noop
+}
+
+#endif // IPC_COMMAND_RING_SUPPORTED
@@ -0,0 +1,121 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Shared memory request/reply ring for small fixed size calls.
+ * @ingroup ipc_shared
+ */
+
+#pragma once
+
+#include "xrt/xrt_config_os.h"
+
+#include "shared/ipc_protocol.h"
+#include "shared/ipc_message_channel.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(XRT_OS_LINUX) || defined(XRT_DOXYGEN)
+/*!
+ * Defined if @ref ipc_command_ring can be used on this platform, it needs
+ * futexes to wait without going through the socket.
+ *
+ * @ingroup ipc_shared
+ */
+#define IPC_COMMAND_RING_SUPPORTED
+#endif
+
+
+/*
+ *
+ * Client side.
+ *
+ */
+
+/*!
+ * Make a call through the ring: writes the command message, wakes the service
+ * and waits for the reply. The caller must serialise calls on the ring, the
+ * generated client code does so with @ref ipc_connection::mutex.
+ *
+ * While waiting the channel is checked now and then, so a service that went
+ * away is noticed without a reply ever arriving.
+ *
+ * @param ring          Ring in shared memory given to this client.
+ * @param imc           Socket of the connection, only checked for hang up.
+ * @param[in] msg       Command message, one of the `ipc_*_msg` structs.
+ * @param[in] msg_size  Size of @p msg, at most @ref IPC_BUF_SIZE.
+ * @param[out] out_reply  Reply struct to fill out.
+ * @param[in] reply_size  Size of @p out_reply, must match what the service sends.
+ *
+ * @ingroup ipc_shared
+ */
+xrt_result_t
+ipc_command_ring_call(struct ipc_command_ring *ring,
+                      struct ipc_message_channel *imc,
+                      const void *msg,
+                      size_t msg_size,
+                      void *out_reply,
+                      size_t reply_size);
+
+
+/*
+ *
+ * Service side.
+ *
+ */
+
+/*!
+ * Resets the ring and marks it as served, done before handing it to a client.
+ *
+ * @ingroup ipc_shared
+ */
+void
+ipc_command_ring_open(struct ipc_command_ring *ring);
+
+/*!
+ * Marks the ring as no longer served and fails any call the client is waiting
+ * on, then wakes anybody sleeping in @ref ipc_command_ring_wait_request.
+ *
+ * @ingroup ipc_shared
+ */
+void
+ipc_command_ring_close(struct ipc_command_ring *ring);
+
+/*!
+ * Waits for the client to write a request newer than @p last_seq and copies
+ * it out, nothing in the ring is touched by the service until it replies.
+ *
+ * @param ring          Ring to wait on.
+ * @param last_seq      Sequence number of the last request replied to.
+ * @param timeout_ms    How long to wait before returning @ref XRT_TIMEOUT.
+ * @param[out] out_seq  Sequence number of the request, pass to @ref ipc_command_ring_reply.
+ * @param[out] out_msg  Buffer for the command message.
+ * @param[in] max_size  Size of @p out_msg, larger requests are an error.
+ * @param[out] out_size Size of the command message.
+ *
+ * @ingroup ipc_shared
+ */
+xrt_result_t
+ipc_command_ring_wait_request(struct ipc_command_ring *ring,
+                              int32_t last_seq,
+                              uint32_t timeout_ms,
+                              int32_t *out_seq,
+                              void *out_msg,
+                              size_t max_size,
+                              size_t *out_size);
+
+/*!
+ * Writes the reply to request @p seq and wakes the client.
+ *
+ * @ingroup ipc_shared
+ */
+void
+ipc_command_ring_reply(struct ipc_command_ring *ring, int32_t seq, const void *reply, size_t size);
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -23,6 +23,36 @@
 extern "C" {
 #endif
 
+//! Size of the read ahead buffer of @ref ipc_frame_reader.
+#define IPC_FRAME_READER_SIZE 4096
+
+/*!
+ * On stream sockets every command message sent with @ref ipc_send_command is
+ * prefixed with this header, so the receiving side can read whole messages,
+ * or several pipelined ones, with a single receive call.
+ */
+struct ipc_frame_header
+{
+	//! Size in bytes of the command message following the header.
+	uint32_t size;
+};
+
+/*!
+ * Read ahead buffer used by @ref ipc_receive_command, bytes that have been
+ * received but not yet consumed are handed out to the other receive functions
+ * before anything is read from the socket.
+ */
+struct ipc_frame_reader
+{
+	uint8_t buf[IPC_FRAME_READER_SIZE];
+
+	//! First byte not yet consumed.
+	size_t start;
+
+	//! One past the last received byte.
+	size_t end;
+};
+
 /*!
  * Wrapper for a socket and flags.
  */
@@ -30,6 +60,15 @@ struct ipc_message_channel
 {
 	xrt_ipc_handle_t ipc_handle;
 	enum u_logging_level log_level;
+
+	//! Only set on the receiving side of framed commands, the server.
+	struct ipc_frame_reader *reader;
+
+	/*!
+	 * Only set on the server, receives that time out in the middle of a
+	 * message are retried while this is true.
+	 */
+	const volatile bool *running;
 };
 
 /*!
@@ -72,6 +111,44 @@ ipc_send(struct ipc_message_channel *imc, const void *data, size_t size);
 xrt_result_t
 ipc_receive(struct ipc_message_channel *imc, void *out_data, size_t size);
 
+/*!
+ * Send a command message, one of the `ipc_*_msg` structs, framed so that the
+ * other side can use @ref ipc_receive_command. Done with a single send call.
+ *
+ * On Windows the pipes are in message mode and already keep the boundaries,
+ * so no header is added there.
+ *
+ * @param imc Message channel to use
+ * @param[in] data Pointer to the command message, must not be null.
+ * @param[in] size Size of the command message, must be greater than 0.
+ *
+ * @public @memberof ipc_message_channel
+ */
+xrt_result_t
+ipc_send_command(struct ipc_message_channel *imc, const void *data, size_t size);
+
+#ifdef XRT_OS_UNIX
+/*!
+ * Receive the next command message sent with @ref ipc_send_command. Reads as
+ * much as is available into the read ahead buffer of the channel with a single
+ * receive call, and only calls it again if no complete message is buffered.
+ *
+ * The channel must have a @ref ipc_frame_reader set. If the socket has a
+ * receive timeout and it expires @ref XRT_TIMEOUT is returned, any partially
+ * received message is kept for the next call.
+ *
+ * @param imc           Message channel to use
+ * @param[out] out_data Buffer for the command message.
+ * @param[in] max_size  Size of @p out_data, larger messages are an error.
+ * @param[out] out_size Size of the command message, zero if the other side
+ *                      closed the connection between messages.
+ *
+ * @public @memberof ipc_message_channel
+ */
+xrt_result_t
+ipc_receive_command(struct ipc_message_channel *imc, void *out_data, size_t max_size, size_t *out_size);
+#endif
+
 /*!
  * @name File Descriptor or HANDLE utilities
  * @brief These are typically called from within the send/receive_handles
@@ -15,6 +15,8 @@
 #error "This file shouldn't be compiled on Windows!"
 #endif
 
+#include "xrt/xrt_compiler.h"
+
 #include "util/u_logging.h"
 #include "util/u_pretty_print.h"
 
@@ -55,6 +57,55 @@ union imcontrol_buf {
 };
 
 
+/*
+ *
+ * Helpers.
+ *
+ */
+
+static inline size_t
+reader_pending(const struct ipc_message_channel *imc)
+{
+	return imc->reader != NULL ? imc->reader->end - imc->reader->start : 0;
+}
+
+/*!
+ * Hand out bytes that @ref ipc_receive_command already read past the end of the
+ * last command, like variable length data following it.
+ */
+static size_t
+reader_take(struct ipc_message_channel *imc, void *out_data, size_t size)
+{
+	size_t pending = reader_pending(imc);
+	if (pending == 0) {
+		return 0;
+	}
+
+	size_t to_copy = pending < size ? pending : size;
+	memcpy(out_data, imc->reader->buf + imc->reader->start, to_copy);
+	imc->reader->start += to_copy;
+
+	return to_copy;
+}
+
+/*!
+ * The server side sockets have a receive timeout so the command loop can check
+ * if it should exit, once in the middle of a message keep waiting for the rest
+ * of it as long as the server is running.
+ */
+static inline bool
+should_retry(struct ipc_message_channel *imc, int code)
+{
+	if (code == EINTR) {
+		return true;
+	}
+	if (code != EAGAIN && code != EWOULDBLOCK) {
+		return false;
+	}
+	return imc->reader != NULL && imc->running != NULL && *imc->running;
+}
+
+
 /*
  *
  * 'Exported' functions.
@@ -96,9 +147,44 @@ ipc_send(struct ipc_message_channel *imc, const void *data, size_t size)
 	return XRT_SUCCESS;
 }
 
+/*!
+ * Receive exactly @p size bytes, first from the read ahead buffer then from the
+ * socket, used on channels that receive framed commands.
+ */
+static xrt_result_t
+ipc_receive_all(struct ipc_message_channel *imc, void *out_data, size_t size)
+{
+	uint8_t *dst = (uint8_t *)out_data;
+	size_t got = reader_take(imc, dst, size);
+
+	while (got < size) {
+		ssize_t len = recv(imc->ipc_handle, dst + got, size - got, MSG_NOSIGNAL);
+		if (len < 0) {
+			int code = errno;
+			if (should_retry(imc, code)) {
+				continue;
+			}
+			IPC_ERROR(imc, "recv(%i) failed: '%i' '%s'!", (int)imc->ipc_handle, code, strerror(code));
+			return XRT_ERROR_IPC_FAILURE;
+		}
+		if (len == 0) {
+			IPC_ERROR(imc, "recv(%i) failed: connection closed after '%i' of '%i' bytes!",
+			          (int)imc->ipc_handle, (int)got, (int)size);
+			return XRT_ERROR_IPC_FAILURE;
+		}
+		got += (size_t)len;
+	}
+
+	return XRT_SUCCESS;
+}
+
 xrt_result_t
 ipc_receive(struct ipc_message_channel *imc, void *out_data, size_t size)
 {
+	if (imc->reader != NULL) {
+		return ipc_receive_all(imc, out_data, size);
+	}
+
 	// wait for the response
 	struct iovec iov = {0};
 	struct msghdr msg = {0};
@@ -129,6 +215,100 @@ ipc_receive(struct ipc_message_channel *imc, void *out_data, size_t size)
 	return XRT_SUCCESS;
 }
 
+xrt_result_t
+ipc_send_command(struct ipc_message_channel *imc, const void *data, size_t size)
+{
+	assert(size > 0 && size <= UINT32_MAX);
+
+	struct ipc_frame_header header = {.size = (uint32_t)size};
+
+	// Header and message in one call, so they can't be split by other senders.
+	struct iovec iov[2] = {
+	    {.iov_base = &header, .iov_len = sizeof(header)},
+	    {.iov_base = (void *)data, .iov_len = size},
+	};
+
+	struct msghdr msg = {0};
+	msg.msg_iov = iov;
+	msg.msg_iovlen = ARRAY_SIZE(iov);
+
+	ssize_t ret = sendmsg(imc->ipc_handle, &msg, MSG_NOSIGNAL);
+	if (ret < 0) {
+		int code = errno;
+		IPC_ERROR(imc, "sendmsg(%i) failed: '%i' '%s'!", imc->ipc_handle, code, strerror(code));
+		return XRT_ERROR_IPC_FAILURE;
+	}
+
+	if ((size_t)ret != sizeof(header) + size) {
+		IPC_ERROR(imc, "sendmsg(%i) failed: short write '%i'!", imc->ipc_handle, (int)ret);
+		return XRT_ERROR_IPC_FAILURE;
+	}
+
+	return XRT_SUCCESS;
+}
+
+xrt_result_t
+ipc_receive_command(struct ipc_message_channel *imc, void *out_data, size_t max_size, size_t *out_size)
+{
+	struct ipc_frame_reader *r = imc->reader;
+	assert(r != NULL);
+
+	while (true) {
+		size_t pending = r->end - r->start;
+
+		// Is there a whole message in the buffer already.
+		if (pending >= sizeof(struct ipc_frame_header)) {
+			struct ipc_frame_header header;
+			memcpy(&header, r->buf + r->start, sizeof(header));
+
+			if (header.size == 0 || header.size > max_size ||
+			    header.size > sizeof(r->buf) - sizeof(struct ipc_frame_header)) {
+				IPC_ERROR(imc, "Invalid command size '%u' (max %u)!", header.size, (uint32_t)max_size);
+				return XRT_ERROR_IPC_FAILURE;
+			}
+
+			size_t frame_size = sizeof(header) + header.size;
+			if (pending >= frame_size) {
+				memcpy(out_data, r->buf + r->start + sizeof(header), header.size);
+				r->start += frame_size;
+				*out_size = header.size;
+				return XRT_SUCCESS;
+			}
+		}
+
+		// Move what we have to the front to make room, only ever a partial message.
+		if (r->start > 0) {
+			memmove(r->buf, r->buf + r->start, pending);
+			r->start = 0;
+			r->end = pending;
+		}
+
+		ssize_t len = recv(imc->ipc_handle, r->buf + r->end, sizeof(r->buf) - r->end, MSG_NOSIGNAL);
+		if (len < 0) {
+			int code = errno;
+			if (code == EINTR) {
+				continue;
+			}
+			if (code == EAGAIN || code == EWOULDBLOCK) {
+				return XRT_TIMEOUT;
+			}
+			IPC_ERROR(imc, "recv(%i) failed: '%i' '%s'!", imc->ipc_handle, code, strerror(code));
+			return XRT_ERROR_IPC_FAILURE;
+		}
+
+		if (len == 0) {
+			if (pending == 0) {
+				*out_size = 0;
+				return XRT_SUCCESS;
+			}
+			IPC_ERROR(imc, "recv(%i) failed: connection closed in the middle of a command!", imc->ipc_handle);
+			return XRT_ERROR_IPC_FAILURE;
+		}
+
+		r->end += (size_t)len;
+	}
+}
+
 xrt_result_t
 ipc_receive_fds(struct ipc_message_channel *imc, void *out_data, size_t size, int *out_handles, uint32_t handle_count)
 {
@@ -153,7 +333,18 @@ ipc_receive_fds(struct ipc_message_channel *imc, void *out_data, size_t size, in
 	msg.msg_control = u.buf;
 	msg.msg_controllen = cmsg_size;
 
-	ssize_t len = recvmsg(imc->ipc_handle, &msg, MSG_NOSIGNAL);
+	// Handles are only sent when the other side has been told to, never read ahead.
+	if (reader_pending(imc) != 0) {
+		IPC_ERROR(imc, "recvmsg(%i) failed: '%i' unexpected bytes before handles!", imc->ipc_handle,
+		          (int)reader_pending(imc));
+		return XRT_ERROR_IPC_FAILURE;
+	}
+
+	ssize_t len;
+	do {
+		len = recvmsg(imc->ipc_handle, &msg, MSG_NOSIGNAL);
+	} while (len < 0 && should_retry(imc, errno));
+
 	if (len < 0) {
 		IPC_ERROR(imc, "recvmsg(%i) failed: '%s'!", imc->ipc_handle, strerror(errno));
 		return XRT_ERROR_IPC_FAILURE;
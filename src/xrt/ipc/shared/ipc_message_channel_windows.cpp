@@ -127,6 +127,13 @@ ipc_receive(struct ipc_message_channel *imc, void *out_data, size_t size)
 	return XRT_SUCCESS;
 }
 
+xrt_result_t
+ipc_send_command(struct ipc_message_channel *imc, const void *data, size_t size)
+{
+	// The pipe is in message mode, it already keeps the boundaries for us.
+	return ipc_send(imc, data, size);
+}
+
 
 /*
  *
@@ -0,0 +1,153 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Helpers for the pose histories published in shared memory.
+ * @ingroup ipc_shared
+ */
+
+#include "shared/ipc_pose_history.h"
+
+#include "math/m_relation_history.h"
+
+
+/*!
+ * How many times a reader retries before giving up, the writer only holds the
+ * sequence odd for a few stores, so hitting this means the service is gone.
+ */
+#define MAX_READ_ATTEMPTS 64
+
+
+/*
+ *
+ * Helpers.
+ *
+ */
+
+static inline void
+write_begin(struct ipc_shared_pose_history *iph)
+{
+	xrt_atomic_s32_store(&iph->seq, xrt_atomic_s32_load(&iph->seq) + 1);
+	xrt_atomic_thread_fence();
+}
+
+static inline void
+write_end(struct ipc_shared_pose_history *iph)
+{
+	xrt_atomic_thread_fence();
+	xrt_atomic_s32_store(&iph->seq, xrt_atomic_s32_load(&iph->seq) + 1);
+}
+
+/*!
+ * Copies the samples out oldest first, returns false if it raced with the
+ * writer or the history is empty.
+ */
+static bool
+try_read(struct ipc_shared_pose_history *iph,
+         struct xrt_space_relation relations[IPC_SHARED_POSE_HISTORY_COUNT],
+         uint64_t timestamps[IPC_SHARED_POSE_HISTORY_COUNT],
+         uint32_t *out_count)
+{
+	int32_t before = xrt_atomic_s32_load(&iph->seq);
+	if ((before & 1) != 0) {
+		return false;
+	}
+
+	uint32_t count = iph->sample_count;
+	uint32_t latest = iph->latest_index;
+	if (count == 0 || count > IPC_SHARED_POSE_HISTORY_COUNT || latest >= IPC_SHARED_POSE_HISTORY_COUNT) {
+		return false;
+	}
+
+	uint32_t first = (latest + IPC_SHARED_POSE_HISTORY_COUNT + 1 - count) % IPC_SHARED_POSE_HISTORY_COUNT;
+	for (uint32_t i = 0; i < count; i++) {
+		const struct ipc_shared_pose_sample *s = &iph->samples[(first + i) % IPC_SHARED_POSE_HISTORY_COUNT];
+		relations[i] = s->relation;
+		timestamps[i] = s->timestamp_ns;
+	}
+
+	xrt_atomic_thread_fence();
+	if (xrt_atomic_s32_load(&iph->seq) != before) {
+		return false;
+	}
+
+	*out_count = count;
+
+	return true;
+}
+
+
+/*
+ *
+ * 'Exported' functions.
+ *
+ */
+
+void
+ipc_pose_history_clear(struct ipc_shared_pose_history *iph)
+{
+	write_begin(iph);
+	iph->sample_count = 0;
+	iph->latest_index = 0;
+	write_end(iph);
+}
+
+bool
+ipc_pose_history_push(struct ipc_shared_pose_history *iph,
+                      const struct xrt_space_relation *relation,
+                      uint64_t timestamp_ns)
+{
+	// Only the service writes, so no need for the read side of the lock here.
+	if (iph->sample_count > 0 && iph->samples[iph->latest_index].timestamp_ns >= timestamp_ns) {
+		return false;
+	}
+
+	uint32_t index = iph->sample_count == 0 ? 0 : (iph->latest_index + 1) % IPC_SHARED_POSE_HISTORY_COUNT;
+
+	write_begin(iph);
+	iph->samples[index].timestamp_ns = timestamp_ns;
+	iph->samples[index].relation = *relation;
+	iph->latest_index = index;
+	if (iph->sample_count < IPC_SHARED_POSE_HISTORY_COUNT) {
+		iph->sample_count++;
+	}
+	write_end(iph);
+
+	return true;
+}
+
+bool
+ipc_pose_history_get(struct ipc_shared_pose_history *iph,
+                     uint64_t at_timestamp_ns,
+                     uint64_t max_prediction_ns,
+                     struct xrt_space_relation *out_relation)
+{
+	struct xrt_space_relation relations[IPC_SHARED_POSE_HISTORY_COUNT];
+	uint64_t timestamps[IPC_SHARED_POSE_HISTORY_COUNT];
+	uint32_t count = 0;
+
+	bool read = false;
+	for (int i = 0; i < MAX_READ_ATTEMPTS && !read; i++) {
+		read = try_read(iph, relations, timestamps, &count);
+	}
+	if (!read) {
+		return false;
+	}
+
+	// Too far into the future, let the driver do the prediction.
+	if (at_timestamp_ns > timestamps[count - 1] + max_prediction_ns) {
+		return false;
+	}
+
+	enum m_relation_history_result res =
+	    m_relation_history_resolve(relations, timestamps, count, at_timestamp_ns, out_relation);
+
+	switch (res) {
+	case M_RELATION_HISTORY_RESULT_EXACT:
+	case M_RELATION_HISTORY_RESULT_INTERPOLATED:
+	case M_RELATION_HISTORY_RESULT_PREDICTED: return true;
+	default:
+		// Older than what we have or nothing usable, the driver might know better.
+		return false;
+	}
+}
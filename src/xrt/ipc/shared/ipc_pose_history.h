@@ -0,0 +1,64 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Helpers for the pose histories published in shared memory.
+ * @ingroup ipc_shared
+ */
+
+#pragma once
+
+#include "shared/ipc_protocol.h"
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/*!
+ * Empties the history, clients will go to the service until new samples are
+ * pushed. Only called by the service.
+ *
+ * @ingroup ipc_shared
+ */
+void
+ipc_pose_history_clear(struct ipc_shared_pose_history *iph);
+
+/*!
+ * Pushes a new sample into the history, overwriting the oldest one if full.
+ * Only called by the service.
+ *
+ * @return false if the timestamp is not newer than the latest sample.
+ *
+ * @ingroup ipc_shared
+ */
+bool
+ipc_pose_history_push(struct ipc_shared_pose_history *iph,
+                      const struct xrt_space_relation *relation,
+                      uint64_t timestamp_ns);
+
+/*!
+ * Interpolates or predicts from the history without taking any locks, using
+ * the same math as @ref m_relation_history_get.
+ *
+ * @param iph               History to read from, lives in shared memory.
+ * @param at_timestamp_ns   Time to get the relation at.
+ * @param max_prediction_ns How far past the latest sample to predict.
+ * @param out_relation      Relation to fill out.
+ *
+ * @return false if the history could not answer the request, in which case
+ *         the caller should ask the service instead.
+ *
+ * @ingroup ipc_shared
+ */
+bool
+ipc_pose_history_get(struct ipc_shared_pose_history *iph,
+                     uint64_t at_timestamp_ns,
+                     uint64_t max_prediction_ns,
+                     struct xrt_space_relation *out_relation);
+
+
+#ifdef __cplusplus
+}
+#endif
@@ -41,6 +41,8 @@
 #define IPC_SHARED_MAX_INPUTS 1024
 #define IPC_SHARED_MAX_OUTPUTS 128
 #define IPC_SHARED_MAX_BINDINGS 64
+#define IPC_SHARED_MAX_POSE_INPUTS 4     // max pose inputs per device published in shared memory
+#define IPC_SHARED_POSE_HISTORY_COUNT 16 // samples kept per published pose input
 
 // example: v21.0.0-560-g586d33b5
 #define IPC_VERSION_NAME_LEN 64
@@ -136,6 +138,57 @@ struct ipc_shared_device
 	bool stage_supported;
 };
 
+/*!
+ * A single sampled pose, see @ref ipc_shared_pose_history.
+ *
+ * @ingroup ipc
+ */
+struct ipc_shared_pose_sample
+{
+	uint64_t timestamp_ns;
+	struct xrt_space_relation relation;
+};
+
+/*!
+ * Ring of the latest sampled relations of one pose input on a device, written
+ * by the service and read lock-free by clients.
+ *
+ * Protected by a sequence lock: the service bumps @ref seq to an odd value
+ * before touching the samples and back to an even value after, clients copy
+ * the samples out and retry if @ref seq changed while they were copying.
+ *
+ * @ingroup ipc
+ */
+struct ipc_shared_pose_history
+{
+	//! Which input this is the history of, constant after startup.
+	enum xrt_input_name name;
+
+	//! Sequence counter, odd while the service is writing.
+	xrt_atomic_s32_t seq;
+
+	//! Number of valid samples, at most @ref IPC_SHARED_POSE_HISTORY_COUNT.
+	uint32_t sample_count;
+
+	//! Index of the newest sample in @ref samples.
+	uint32_t latest_index;
+
+	struct ipc_shared_pose_sample samples[IPC_SHARED_POSE_HISTORY_COUNT];
+};
+
+/*!
+ * All of the published pose histories of a single device.
+ *
+ * @ingroup ipc
+ */
+struct ipc_shared_device_poses
+{
+	//! Number of elements in @ref histories that are populated/valid.
+	uint32_t history_count;
+
+	struct ipc_shared_pose_history histories[IPC_SHARED_MAX_POSE_INPUTS];
+};
+
 /*!
  * Data for a single composition layer.
  *
@@ -174,6 +227,58 @@ struct ipc_layer_slot
 	struct ipc_layer_entry layers[IPC_MAX_LAYERS];
 };
 
+/*!
+ * Request and reply area shared between a client and its thread in the
+ * service, used instead of the socket for the small fixed size calls marked
+ * with `"ring"` in the protocol. Calls on a connection are serialised by the
+ * client so a single entry is enough.
+ *
+ * The client writes @ref request and bumps @ref request_seq, the service writes
+ * @ref reply and sets @ref reply_seq to the same value. Both sequence numbers
+ * are also used as futex words to wait on, see @ref ipc_command_ring_call.
+ *
+ * @ingroup ipc
+ */
+struct ipc_command_ring
+{
+	//! Bumped by the client after it has written a request.
+	xrt_atomic_s32_t request_seq;
+
+	//! Set to @ref request_seq by the service after it has written the reply.
+	xrt_atomic_s32_t reply_seq;
+
+	//! Non-zero while the service is serving this ring.
+	xrt_atomic_s32_t active;
+
+	uint32_t request_size;
+	uint32_t reply_size;
+
+	uint8_t request[IPC_BUF_SIZE];
+	uint8_t reply[IPC_BUF_SIZE];
+};
+
+/*!
+ * Shared memory that only the service and a single client can see, the service
+ * creates one for every client and hands it out over that client's own
+ * connection with instance_get_client_shm_fd. Unlike @ref ipc_shared_memory no
+ * other client can map it, so it can hold state that must not be touched by
+ * other clients.
+ *
+ * @ingroup ipc
+ */
+struct ipc_client_shared_memory
+{
+	//! Served once the client has called instance_start_command_ring.
+	struct ipc_command_ring ring;
+
+	/*!
+	 * Non-zero while the IO of this client is active, written by the
+	 * service whenever it toggles it. Shared memory readers like the pose
+	 * histories must go through the service while it is zero.
+	 */
+	xrt_atomic_s32_t io_active;
+};
+
 /*!
  * A big struct that contains all data that is shared to a client, no pointers
  * allowed in this. To get the inputs of a device you go:
@@ -220,6 +325,25 @@ struct ipc_shared_memory
 	 */
 	struct ipc_shared_device isdevs[XRT_SYSTEM_MAX_DEVICES];
 
+	/*!
+	 * Pose histories published by the service, lets clients answer
+	 * @ref xrt_device_get_tracked_pose without a round trip to the service.
+	 */
+	struct
+	{
+		//! Set by the service if it is publishing poses at all.
+		bool enabled;
+
+		/*!
+		 * How far past the latest sample a client may predict on its
+		 * own, anything further out goes to the service.
+		 */
+		uint64_t max_prediction_ns;
+
+		//! Indexed the same as @ref isdevs.
+		struct ipc_shared_device_poses devices[XRT_SYSTEM_MAX_DEVICES];
+	} pose_histories;
+
 	/*!
 	 * Various roles for the devices.
 	 */
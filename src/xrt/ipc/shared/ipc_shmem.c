@@ -10,6 +10,7 @@
  */
 
 #include <xrt/xrt_config_os.h>
+#include <xrt/xrt_compiler.h>
 
 #include "shared/ipc_shmem.h"
 
@@ -24,6 +25,7 @@
 // non-android unix
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <stdio.h>
 #endif
 
 #if defined(XRT_OS_ANDROID)
@@ -56,24 +58,35 @@ ipc_shmem_create(size_t size, xrt_shmem_handle_t *out_handle, void **out_map)
 xrt_result_t
 ipc_shmem_create(size_t size, xrt_shmem_handle_t *out_handle, void **out_map)
 {
+	static xrt_atomic_s32_t counter = 0;
+
+	/*
+	 * Every client gets its own region, so the name must be unique and
+	 * never refer to an already existing region somebody else can map.
+	 */
+	char name[64];
+	snprintf(name, sizeof(name), MONADO_SHMEM_NAME "_%i_%i", (int)getpid(), xrt_atomic_s32_inc_return(&counter));
+
 	*out_handle = -1;
-	int fd = shm_open(MONADO_SHMEM_NAME, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+	int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
 	if (fd < 0) {
 		return XRT_ERROR_IPC_FAILURE;
 	}
 
 	if (ftruncate(fd, size) < 0) {
+		shm_unlink(name);
 		close(fd);
 		return XRT_ERROR_IPC_FAILURE;
 	}
 	xrt_result_t result = ipc_shmem_map(fd, size, out_map);
 	if (result != XRT_SUCCESS) {
+		shm_unlink(name);
 		close(fd);
 		return result;
 	}
 
 	// Don't need the name entry anymore, we can share the FD.
-	shm_unlink(MONADO_SHMEM_NAME);
+	shm_unlink(name);
 	*out_handle = fd;
 	return XRT_SUCCESS;
 }
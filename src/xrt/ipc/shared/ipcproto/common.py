@@ -94,8 +94,8 @@ def write_reply_struct(f, call, ident):
 
 
 def write_msg_send(f, ret, indent):
-    # Prepare initial sending
-    func = 'ipc_send'
+    # Prepare initial sending, framed so the server can read it in one go
+    func = 'ipc_send_command'
     args = ['&ipc_c->imc', '&_msg', 'sizeof(_msg)']
 
     f.write("\n" + indent + "// Send our request")
@@ -296,6 +296,7 @@ class Call:
         self.in_handles = None
         self.out_handles = None
         self.varlen = False
+        self.ring = False
         for key, val in data.items():
             if key == 'id':
                 self.id = val
@@ -309,12 +310,16 @@ class Call:
                 self.in_handles = HandleType(val)
             elif key == 'varlen':
                 self.varlen = val
+            elif key == 'ring':
+                self.ring = val
             else:
                 raise RuntimeError("Unrecognized key")
         if not self.id:
             self.id = "IPC_" + name.upper()
         if self.varlen and (self.in_handles or self.out_handles):
             raise Exception("Can not have handles with varlen functions")
+        if self.ring and (self.varlen or self.in_handles or self.out_handles):
+            raise Exception("Can not use the command ring with handles or varlen functions")
 
 
 class Proto:
@@ -55,6 +55,31 @@ def write_receive_definition(f, call):
     f.write("\n\treturn _reply.result;\n}\n")
 
 
+def write_ring_call(f, call, cleanup):
+    """Write the command ring path of a ipc_call_CALLNAME function."""
+    f.write("\n\t// No socket round trip if the service gave us a ring\n")
+    f.write("\tif (ipc_c->ring != NULL) {")
+    write_invocation(
+        f,
+        'xrt_result_t ring_ret',
+        'ipc_command_ring_call',
+        (
+            'ipc_c->ring',
+            '&ipc_c->imc',
+            '&_msg',
+            'sizeof(_msg)',
+            '&_reply',
+            'sizeof(_reply)'
+        ),
+        indent="\t\t"
+    )
+    f.write(';\n\t\t' + cleanup)
+    write_result_handler(f, 'ring_ret', None, indent="\t\t")
+    for arg in call.out_args:
+        f.write("\t\t*out_" + arg.name + " = _reply." + arg.name + ";\n")
+    f.write("\t\treturn _reply.result;\n\t}\n")
+
+
 def write_call_definition(f, call):
     """Write a ipc_call_CALLNAME function."""
     call.write_call_decl(f)
@@ -71,6 +96,9 @@ def write_call_definition(f, call):
 """)
     cleanup = "os_mutex_unlock(&ipc_c->mutex);"
 
+    if call.ring:
+        write_ring_call(f, call, cleanup)
+
     # Prepare initial sending
     write_msg_send(f, 'xrt_result_t ret', indent="\t")
     write_result_handler(f, 'ret', cleanup, indent="\t")
@@ -206,6 +234,18 @@ struct ipc_result_reply
 
     f.write('#pragma pack (pop)\n')
 
+    f.write('''
+/*!
+ * Every command message, the server receive buffer must fit the largest one.
+ */
+union ipc_command_msg_any
+{
+\tstruct ipc_command_msg command;''')
+    for call in p.calls:
+        if call.needs_msg_struct:
+            f.write('\n\tstruct ipc_' + call.name + '_msg ' + call.name + ';')
+    f.write('\n};\n')
+
     write_cpp_header_guard_end(f)
     f.close()
 
@@ -216,6 +256,7 @@ def generate_client_c(file, p):
     f.write(header.format(brief='Generated IPC client code', suffix='_client'))
     f.write('''
 #include "client/ipc_client.h"
+#include "shared/ipc_command_ring.h"
 #include "ipc_protocol_generated.h"
 
 
@@ -263,6 +304,64 @@ def generate_client_h(file, p):
     f.close()
 
 
+def write_ring_dispatch(f, p):
+    """Write ipc_dispatch_ring, only handles calls marked as ring calls."""
+    for call in p.calls:
+        if call.ring and call.out_args:
+            f.write("static_assert(sizeof(struct ipc_%s_reply) <= IPC_BUF_SIZE, "
+                    "\"Reply too large for the command ring\");\n" % call.name)
+
+    f.write('''
+xrt_result_t
+ipc_dispatch_ring(volatile struct ipc_client_state *ics,
+                  ipc_command_t *ipc_command,
+                  void *out_reply,
+                  size_t *out_reply_size)
+{
+\tswitch (*ipc_command) {
+''')
+
+    for call in p.calls:
+        if not call.ring:
+            continue
+
+        f.write("\tcase " + call.id + ": {\n")
+        f.write("\t\tIPC_TRACE(ics->server, \"Dispatching " + call.name +
+                " from the command ring\");\n\n")
+
+        if call.needs_msg_struct:
+            f.write("\t\tstruct ipc_{}_msg *msg = ".format(call.name))
+            f.write("(struct ipc_{}_msg *)ipc_command;\n".format(call.name))
+
+        if call.out_args:
+            f.write("\t\tstruct ipc_%s_reply reply = {0};\n" % call.name)
+        else:
+            f.write("\t\tstruct ipc_result_reply reply = {0};\n")
+
+        args = ["ics"]
+        for arg in call.in_args:
+            args.append(("&msg->" + arg.name)
+                        if arg.is_aggregate
+                        else ("msg->" + arg.name))
+        args.extend("&reply." + arg.name for arg in call.out_args)
+        write_invocation(f, 'reply.result', 'ipc_handle_' + call.name,
+                         args, indent="\t\t")
+        f.write(";\n\n")
+
+        f.write("\t\tmemcpy(out_reply, &reply, sizeof(reply));\n")
+        f.write("\t\t*out_reply_size = sizeof(reply);\n")
+        f.write("\t\treturn XRT_SUCCESS;\n")
+        f.write("\t}\n")
+
+    f.write('''\tdefault:
+\t\tU_LOG_E("IPC COMMAND %d CAN NOT BE USED WITH THE COMMAND RING!", *ipc_command);
+\t\treturn XRT_ERROR_IPC_FAILURE;
+\t}
+}
+
+''')
+
+
 def generate_server_c(file, p):
     """Generate IPC server stub/dispatch source."""
     f = open(file, "w")
@@ -277,9 +376,14 @@ def generate_server_c(file, p):
 
 #include "ipc_server_generated.h"
 
+#include <assert.h>
+#include <string.h>
+
 ''')
 
     f.write('''
+static_assert(sizeof(union ipc_command_msg_any) <= IPC_BUF_SIZE, "IPC_BUF_SIZE too small for the largest command");
+
 xrt_result_t
 ipc_dispatch(volatile struct ipc_client_state *ics, ipc_command_t *ipc_command)
 {
@@ -414,6 +518,8 @@ ipc_dispatch(volatile struct ipc_client_state *ics, ipc_command_t *ipc_command)
 
 ''')
 
+    write_ring_dispatch(f, p)
+
     f.write('''
 size_t
 ipc_command_size(const enum ipc_command cmd)
@@ -472,6 +578,19 @@ def generate_server_header(file, p):
     )
     f.write(";\n")
 
+    write_decl(
+        f,
+        "xrt_result_t",
+        "ipc_dispatch_ring",
+        [
+            "volatile struct ipc_client_state *ics",
+            "ipc_command_t *ipc_command",
+            "void *out_reply",
+            "size_t *out_reply_size"
+        ]
+    )
+    f.write(";\n")
+
     write_decl(
         f,
         "size_t",
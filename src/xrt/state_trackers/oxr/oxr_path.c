@@ -11,7 +11,6 @@
 #include <string.h>
 #include <stdlib.h>
 
-#include "math/m_api.h"
 #include "util/u_misc.h"
 
 #include "oxr_objects.h"
@@ -109,7 +108,6 @@ oxr_allocate_path(
 
 	// Setup the item.
 	item = get_item(path);
-	item->hash = math_hash_string(str, length);
 	item->length = length;
 
 	// Yes a const cast! D:
@@ -0,0 +1,120 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief  Bakes the distortion images of the head device into the disk cache.
+ */
+
+#include "xrt/xrt_config_os.h"
+#include "xrt/xrt_space.h"
+#include "xrt/xrt_system.h"
+#include "xrt/xrt_device.h"
+#include "xrt/xrt_instance.h"
+
+#include "os/os_time.h"
+
+#include "util/u_misc.h"
+#include "util/u_file.h"
+#include "util/u_distortion_mesh.h"
+
+#include "cli_common.h"
+
+#include <string.h>
+#include <stdio.h>
+
+
+static int
+do_exit(struct xrt_instance **xi_ptr, int ret)
+{
+	xrt_instance_destroy(xi_ptr);
+
+	printf(" :: Exiting '%i'\n", ret);
+
+	return ret;
+}
+
+static void
+bake_views(struct xrt_device *head, bool pre_rotate)
+{
+	const uint32_t dim = U_DISTORTION_IMAGE_DIMENSIONS;
+	struct xrt_vec2 *r = U_TYPED_ARRAY_CALLOC(struct xrt_vec2, dim * dim);
+	struct xrt_vec2 *g = U_TYPED_ARRAY_CALLOC(struct xrt_vec2, dim * dim);
+	struct xrt_vec2 *b = U_TYPED_ARRAY_CALLOC(struct xrt_vec2, dim * dim);
+
+	for (uint32_t view = 0; view < 2; view++) {
+		uint64_t start_ns = os_monotonic_get_ns();
+		bool cached = u_distortion_images_bake(head, view, pre_rotate, dim, r, g, b);
+		uint64_t duration_ns = os_monotonic_get_ns() - start_ns;
+
+		printf("\tView %u%s: %s in %.2fms\n", view, pre_rotate ? " (pre-rotated)" : "",
+		       cached ? "already cached, loaded" : "baked", (double)duration_ns / 1000000.0);
+	}
+
+	free(r);
+	free(g);
+	free(b);
+}
+
+int
+cli_cmd_bake_distortion(int argc, const char **argv)
+{
+	struct xrt_instance *xi = NULL;
+	xrt_result_t xret = XRT_SUCCESS;
+	int ret = 0;
+
+	bool pre_rotate = argc >= 3 && strcmp(argv[2], "--pre-rotate") == 0;
+
+	// Initialize the prober.
+	printf(" :: Creating instance!\n");
+
+	ret = xrt_instance_create(NULL, &xi);
+	if (ret != 0) {
+		return do_exit(&xi, 0);
+	}
+
+	printf(" :: Creating system devices!\n");
+
+	struct xrt_system *xsys = NULL;
+	struct xrt_system_devices *xsysd = NULL;
+	struct xrt_space_overseer *xso = NULL;
+	xret = xrt_instance_create_system( //
+	    xi,                            // Instance
+	    &xsys,                         // System
+	    &xsysd,                        // System devices.
+	    &xso,                          // Space overseer.
+	    NULL);                         // System compositor.
+	if (xret != XRT_SUCCESS) {
+		printf("\tCall to xrt_instance_create_system failed! '%i'\n", xret);
+		return do_exit(&xi, -1);
+	}
+	if (xsysd == NULL) {
+		printf("\tNo xrt_system_devices returned!\n");
+		return do_exit(&xi, -1);
+	}
+
+	struct xrt_device *head = xsysd->static_roles.head;
+	if (head == NULL || head->hmd == NULL || head->compute_distortion == NULL) {
+		printf("\tNo head device with a distortion function!\n");
+		ret = -1;
+	} else {
+		printf(" :: Baking distortion of '%s'\n", head->str);
+#ifdef XRT_OS_LINUX
+		char path[1024];
+		if (u_file_get_path_in_cache_dir("distortion", path, sizeof(path)) > 0) {
+			printf("\tCache: '%s'\n", path);
+		}
+#endif
+
+		// Only the images, the mesh is cached by whatever creates it first.
+		bake_views(head, pre_rotate);
+	}
+
+	printf(" :: Destroying probed devices\n");
+
+	xrt_space_overseer_destroy(&xso);
+	xrt_system_devices_destroy(&xsysd);
+	xrt_system_destroy(&xsys);
+
+	// Finally done
+	return do_exit(&xi, ret);
+}
@@ -7,13 +7,20 @@
  */
 
 #include "euroc/euroc_interface.h"
+#include "math/m_trajectory.h"
 #include "os/os_threading.h"
 #include "util/u_logging.h"
+#include "util/u_misc.h"
+#include "util/u_time.h"
 #include "xrt/xrt_config_build.h"
 #include "xrt/xrt_config_have.h"
 #include "xrt/xrt_config_drivers.h"
 
+#include <inttypes.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define P(...) fprintf(stderr, __VA_ARGS__)
 #define I(...) U_LOG(U_LOGGING_INFO, __VA_ARGS__)
@@ -29,6 +36,292 @@ wait_for_exit_key(void *ptr)
 	should_exit = true;
 	return NULL;
 }
+
+
+/*
+ *
+ * Trajectory evaluation.
+ *
+ */
+
+//! A trajectory loaded from a EuRoC style CSV, only positions are used.
+struct trajectory
+{
+	uint64_t *timestamps;
+	struct xrt_vec3_f64 *positions;
+	size_t count;
+};
+
+//! Results of a single dataset run.
+struct run_result
+{
+	bool ran;                   //!< False if the run was skipped because of an exit request
+	uint64_t duration_ns;       //!< Wall time of the run
+	size_t pose_count;          //!< Number of poses in the tracking output
+	double dataset_duration_s;  //!< Time span of the tracking output
+	bool has_ate;               //!< Whether groundtruth was found and @ref ate_rmse_m is valid
+	double ate_rmse_m;          //!< Absolute trajectory error, RMSE after alignment
+	size_t ate_matched;         //!< Number of poses matched against the groundtruth
+};
+
+static void
+trajectory_free(struct trajectory *t)
+{
+	free(t->timestamps);
+	free(t->positions);
+	U_ZERO(t);
+}
+
+/*!
+ * Reads `ts,px,py,pz,...` rows, skipping the `#` header, this matches both the
+ * EuRoC groundtruth files and the CSVs written by the SLAM tracker.
+ */
+static bool
+trajectory_load(const char *path, struct trajectory *t)
+{
+	FILE *f = fopen(path, "r");
+	if (f == NULL) {
+		return false;
+	}
+
+	size_t capacity = 0;
+	char line[512];
+	while (fgets(line, sizeof(line), f) != NULL) {
+		uint64_t ts = 0;
+		struct xrt_vec3_f64 p = {0};
+		if (line[0] == '#' || sscanf(line, "%" SCNu64 ",%lf,%lf,%lf", &ts, &p.x, &p.y, &p.z) != 4) {
+			continue;
+		}
+
+		if (t->count == capacity) {
+			capacity = capacity == 0 ? 4096 : capacity * 2;
+			U_ARRAY_REALLOC_OR_FREE(t->timestamps, uint64_t, capacity);
+			U_ARRAY_REALLOC_OR_FREE(t->positions, struct xrt_vec3_f64, capacity);
+		}
+
+		t->timestamps[t->count] = ts;
+		t->positions[t->count] = p;
+		t->count++;
+	}
+
+	fclose(f);
+	return t->count > 0;
+}
+
+//! Linearly interpolated position at @p ts, false if outside the trajectory.
+static bool
+trajectory_position_at(const struct trajectory *t, uint64_t ts, struct xrt_vec3_f64 *out)
+{
+	if (t->count == 0 || ts < t->timestamps[0] || ts > t->timestamps[t->count - 1]) {
+		return false;
+	}
+
+	// First entry with a timestamp >= ts.
+	size_t lo = 0;
+	size_t hi = t->count - 1;
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
+		if (t->timestamps[mid] < ts) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if (t->timestamps[lo] == ts || lo == 0) {
+		*out = t->positions[lo];
+		return true;
+	}
+
+	const struct xrt_vec3_f64 *a = &t->positions[lo - 1];
+	const struct xrt_vec3_f64 *b = &t->positions[lo];
+	double k = (double)(ts - t->timestamps[lo - 1]) / (double)(t->timestamps[lo] - t->timestamps[lo - 1]);
+	out->x = a->x + (b->x - a->x) * k;
+	out->y = a->y + (b->y - a->y) * k;
+	out->z = a->z + (b->z - a->z) * k;
+	return true;
+}
+
+/*!
+ * Absolute trajectory error of @p est against @p gt, the groundtruth is
+ * interpolated at the timestamps of the estimate.
+ */
+static bool
+compute_ate(const struct trajectory *est, const struct trajectory *gt, double *out_rmse, size_t *out_matched)
+{
+	struct xrt_vec3_f64 *e = U_TYPED_ARRAY_CALLOC(struct xrt_vec3_f64, est->count);
+	struct xrt_vec3_f64 *g = U_TYPED_ARRAY_CALLOC(struct xrt_vec3_f64, est->count);
+	size_t n = 0;
+
+	for (size_t i = 0; i < est->count; i++) {
+		if (!trajectory_position_at(gt, est->timestamps[i], &g[n])) {
+			continue;
+		}
+		e[n++] = est->positions[i];
+	}
+
+	bool ok = m_trajectory_ate_rmse(e, g, n, out_rmse);
+	*out_matched = n;
+
+	free(e);
+	free(g);
+	return ok;
+}
+
+//! Groundtruth file of a dataset, same search order as the EuRoC player.
+static bool
+load_groundtruth(const char *dataset_path, struct trajectory *gt)
+{
+	const char *devices[] = {"vicon0", "mocap0", "state_groundtruth_estimate0", "leica0"};
+	for (size_t i = 0; i < ARRAY_SIZE(devices); i++) {
+		char path[1024];
+		snprintf(path, sizeof(path), "%s/mav0/%s/data.csv", dataset_path, devices[i]);
+		if (trajectory_load(path, gt)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void
+evaluate_run(const char *dataset_path, const char *output_path, struct run_result *res)
+{
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/tracking.csv", output_path);
+
+	struct trajectory est = {0};
+	if (!trajectory_load(path, &est)) {
+		trajectory_free(&est);
+		return;
+	}
+
+	res->pose_count = est.count;
+	res->dataset_duration_s = (double)(est.timestamps[est.count - 1] - est.timestamps[0]) / U_TIME_1S_IN_NS;
+
+	struct trajectory gt = {0};
+	if (load_groundtruth(dataset_path, &gt)) {
+		res->has_ate = compute_ate(&est, &gt, &res->ate_rmse_m, &res->ate_matched);
+	}
+
+	trajectory_free(&gt);
+	trajectory_free(&est);
+}
+
+
+/*
+ *
+ * Running.
+ *
+ */
+
+struct batch_job
+{
+	const char *dataset_path;
+	const char *slam_config;
+	const char *output_path;
+	int index;
+	int total;
+	struct run_result result;
+};
+
+//! Shared by the threads running jobs, each takes the next job that hasn't been started.
+struct batch
+{
+	struct batch_job *jobs;
+	int count;
+	bool print_progress;
+	xrt_atomic_s32_t next;
+};
+
+static void
+run_job(struct batch_job *job, bool print_progress)
+{
+	if (should_exit) {
+		return;
+	}
+
+	I("Running dataset %d out of %d", job->index + 1, job->total);
+	I("Dataset path: %s", job->dataset_path);
+	I("SLAM config path: %s", job->slam_config);
+	I("Output path: %s", job->output_path);
+
+	// Each run creates and destroys its own frame context, so runs are independent.
+	timepoint_ns start = os_monotonic_get_ns();
+	euroc_run_dataset(job->dataset_path, job->slam_config, job->output_path, print_progress, &should_exit);
+	job->result.duration_ns = os_monotonic_get_ns() - start;
+	job->result.ran = true;
+
+	evaluate_run(job->dataset_path, job->output_path, &job->result);
+
+	I("Finished dataset %d out of %d in %.2fs", job->index + 1, job->total,
+	  (double)job->result.duration_ns / U_TIME_1S_IN_NS);
+}
+
+static void *
+run_jobs_thread(void *ptr)
+{
+	struct batch *b = (struct batch *)ptr;
+
+	while (!should_exit) {
+		int index = xrt_atomic_s32_inc_return(&b->next) - 1;
+		if (index >= b->count) {
+			break;
+		}
+		run_job(&b->jobs[index], b->print_progress);
+	}
+
+	return NULL;
+}
+
+static void
+print_summary(const struct batch_job *jobs, int count, int job_count, uint64_t total_ns)
+{
+	uint64_t sum_ns = 0;
+	double ate_sum_sq = 0;
+	int ate_count = 0;
+	int ran = 0;
+
+	printf("\n%-4s %-10s %10s %8s %8s %10s  %s\n", "#", "status", "wall [s]", "rt [x]", "poses", "ATE [m]",
+	       "dataset");
+	for (int i = 0; i < count; i++) {
+		const struct run_result *r = &jobs[i].result;
+		double wall_s = (double)r->duration_ns / U_TIME_1S_IN_NS;
+		double realtime = wall_s > 0 ? r->dataset_duration_s / wall_s : 0;
+
+		char ate[32] = "-";
+		if (r->has_ate) {
+			snprintf(ate, sizeof(ate), "%.4f", r->ate_rmse_m);
+			ate_sum_sq += r->ate_rmse_m * r->ate_rmse_m;
+			ate_count++;
+		}
+
+		const char *status = !r->ran ? "skipped" : r->pose_count == 0 ? "no-output" : "done";
+		printf("%-4d %-10s %10.2f %8.2f %8zu %10s  %s\n", i + 1, status, wall_s, realtime, r->pose_count,
+		       ate, jobs[i].dataset_path);
+
+		if (r->ran) {
+			sum_ns += r->duration_ns;
+			ran++;
+		}
+	}
+
+	double total_s = (double)total_ns / U_TIME_1S_IN_NS;
+	printf("\nRan %d of %d datasets with %d job(s), %.2fs of runs, %.2fx speedup.\n", ran, count, job_count,
+	       (double)sum_ns / U_TIME_1S_IN_NS, total_s > 0 ? (double)sum_ns / total_ns : 0);
+	if (ate_count > 0) {
+		printf("ATE RMSE over %d datasets with groundtruth: %.4fm.\n", ate_count,
+		       sqrt(ate_sum_sq / ate_count));
+	}
+}
+
+static void
+print_usage(const char *argv0, const char *argv1)
+{
+	P("Batch evaluator of SLAM datasets.\n");
+	P("Usage: %s %s [--jobs <N>] [<euroc_path> <slam_config> <output_path>]...\n", argv0, argv1);
+	P("  --jobs, -j <N>  Run up to N datasets concurrently (default 1).\n");
+}
+
 #endif
 
 int
@@ -46,31 +339,74 @@ cli_cmd_slambatch(int argc, const char **argv)
 	int nof_args = argc - 2;
 	const char **args = &argv[2];
 
-	if (nof_args == 0 || nof_args % 3 != 0) {
-		P("Batch evaluator of SLAM datasets.\n");
-		P("Usage: %s %s [<euroc_path> <slam_config> <output_path>]...\n", argv[0], argv[1]);
+	int job_count = 1;
+	if (nof_args >= 2 && (strcmp(args[0], "--jobs") == 0 || strcmp(args[0], "-j") == 0)) {
+		job_count = atoi(args[1]);
+		nof_args -= 2;
+		args += 2;
+	}
+
+	if (nof_args == 0 || nof_args % 3 != 0 || job_count < 1) {
+		print_usage(argv[0], argv[1]);
 		return EXIT_FAILURE;
 	}
 
+	int nof_datasets = nof_args / 3;
+	if (job_count > nof_datasets) {
+		job_count = nof_datasets;
+	}
+
+	struct batch_job *jobs = U_TYPED_ARRAY_CALLOC(struct batch_job, nof_datasets);
+	for (int i = 0; i < nof_datasets; i++) {
+		jobs[i].dataset_path = args[i * 3];
+		jobs[i].slam_config = args[i * 3 + 1];
+		jobs[i].output_path = args[i * 3 + 2];
+		jobs[i].index = i;
+		jobs[i].total = nof_datasets;
+	}
+
 	// Allow pressing enter to quit the program by launching a new thread
 	struct os_thread_helper wfk_thread;
 	os_thread_helper_init(&wfk_thread);
 	os_thread_helper_start(&wfk_thread, wait_for_exit_key, NULL);
 
+	struct batch b = {
+	    .jobs = jobs,
+	    .count = nof_datasets,
+	    // Interleaved progress bars from several players are unreadable.
+	    .print_progress = job_count == 1,
+	    .next = 0,
+	};
+
+	// Each job is mostly waiting on its own player and tracker threads, so one plain thread per job.
+	struct os_thread *threads = U_TYPED_ARRAY_CALLOC(struct os_thread, job_count);
+	int thread_count = 0;
+
 	timepoint_ns start_time = os_monotonic_get_ns();
-	int nof_datasets = nof_args / 3;
-	for (int i = 0; i < nof_datasets && !should_exit; i++) {
-		const char *dataset_path = args[i * 3];
-		const char *slam_config = args[i * 3 + 1];
-		const char *output_path = args[i * 3 + 2];
 
-		I("Running dataset %d out of %d", i + 1, nof_datasets);
-		I("Dataset path: %s", dataset_path);
-		I("SLAM config path: %s", slam_config);
-		I("Output path: %s", output_path);
+	// This thread runs jobs as well.
+	for (int i = 1; i < job_count; i++) {
+		if (os_thread_init(&threads[thread_count]) != 0) {
+			break;
+		}
+		if (os_thread_start(&threads[thread_count], run_jobs_thread, &b) != 0) {
+			os_thread_destroy(&threads[thread_count]);
+			break;
+		}
+		thread_count++;
+	}
+	if (thread_count + 1 < job_count) {
+		P("Could only start %d of %d jobs at the same time.\n", thread_count + 1, job_count);
+	}
+
+	run_jobs_thread(&b);
 
-		euroc_run_dataset(dataset_path, slam_config, output_path, &should_exit);
+	for (int i = 0; i < thread_count; i++) {
+		os_thread_join(&threads[i]);
+		os_thread_destroy(&threads[i]);
 	}
+	free(threads);
+
 	timepoint_ns end_time = os_monotonic_get_ns();
 
 	pthread_cancel(wfk_thread.thread);
@@ -78,6 +414,9 @@ cli_cmd_slambatch(int argc, const char **argv)
 	// Destroy also stops the thread.
 	os_thread_helper_destroy(&wfk_thread);
 
+	print_summary(jobs, nof_datasets, job_count, end_time - start_time);
+	free(jobs);
+
 	printf("Done in %.2fs.\n", (double)(end_time - start_time) / U_TIME_1S_IN_NS);
 #endif
 	return EXIT_SUCCESS;
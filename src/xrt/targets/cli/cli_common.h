@@ -14,6 +14,9 @@ extern "C" {
 #endif
 
 
+int
+cli_cmd_bake_distortion(int argc, const char **argv);
+
 int
 cli_cmd_calibrate(int argc, const char **argv);
 
@@ -30,6 +30,7 @@ namespace xrt::tracking::hand::mercury {
 DEBUG_GET_ONCE_LOG_OPTION(mercury_log, "MERCURY_LOG", U_LOGGING_WARN)
 DEBUG_GET_ONCE_BOOL_OPTION(mercury_optimize_hand_size, "MERCURY_optimize_hand_size", true)
 DEBUG_GET_ONCE_FLOAT_OPTION(mercury_min_detection_confidence, "MERCURY_MIN_DETECTION_CONFIDENCE", 0.3)
+DEBUG_GET_ONCE_OPTION(mercury_lm_record, "MERCURY_LM_RECORD", NULL)
 
 // Flags to tell state tracker that these are indeed valid joints
 static const enum xrt_space_relation_flags valid_flags_ht = (enum xrt_space_relation_flags)(
@@ -693,6 +694,10 @@ HandTracking::~HandTracking()
 	lm::optimizer_destroy(&this->kinematic_hands[0]);
 	lm::optimizer_destroy(&this->kinematic_hands[1]);
 
+	if (this->lm_record_file != NULL) {
+		fclose(this->lm_record_file);
+	}
+
 	u_var_remove_root((void *)&this->base);
 	u_frame_times_widget_teardown(&this->ft_widget);
 }
@@ -943,6 +948,19 @@ HandTracking::cCallbackProcess(struct t_hand_tracking_sync *ht_sync,
 
 		float out_hand_size;
 
+		if (hgt->lm_record_file != NULL) {
+			lm::replay_frame frame = {};
+			frame.is_right = hand_idx == 1;
+			frame.hand_was_untracked_last_frame = !hgt->last_frame_hand_detected[hand_idx];
+			frame.optimize_hand_size = optimize_hand_size;
+			frame.smoothing_factor = smoothing_factor;
+			frame.target_hand_size = hgt->target_hand_size;
+			frame.hand_size_err_mul = hgt->refinement.hand_size_refinement_schedule_y;
+			frame.amt_use_depth = hgt->tuneable_values.amt_use_depth.val;
+			frame.observation = hgt->keypoint_outputs[hand_idx];
+			lm::replay_write_frame(hgt->lm_record_file, frame);
+		}
+
 		//!@todo optimize: We can have one of these on each thread
 		float reprojection_error;
 		lm::optimizer_run(hand,                                     //
@@ -1141,6 +1159,16 @@ t_hand_tracking_sync_mercury_create(struct t_stereo_camera_calibration *calib,
 	lm::optimizer_create(hgt->left_in_right, false, hgt->log_level, &hgt->kinematic_hands[0]);
 	lm::optimizer_create(hgt->left_in_right, true, hgt->log_level, &hgt->kinematic_hands[1]);
 
+	const char *lm_record_path = debug_get_option_mercury_lm_record();
+	if (lm_record_path != NULL) {
+		hgt->lm_record_file = fopen(lm_record_path, "wb");
+		if (hgt->lm_record_file == NULL) {
+			HG_ERROR(hgt, "Could not open '%s' to record optimizer inputs", lm_record_path);
+		} else {
+			lm::replay_write_header(hgt->lm_record_file, hgt->left_in_right);
+		}
+	}
+
 	u_frame_times_widget_init(&hgt->ft_widget, 10.0f, 10.0f);
 
 	u_var_add_root(hgt, "Camera-based Hand Tracker", true);
@@ -47,6 +47,7 @@
 
 #include "kine_common.hpp"
 #include "kine_lm/lm_interface.hpp"
+#include "kine_lm/lm_replay.hpp"
 
 
 namespace xrt::tracking::hand::mercury {
@@ -288,6 +289,9 @@ public:
 
 	lm::KinematicHandLM *kinematic_hands[2];
 
+	// If set, every optimizer input is written here for replaying offline.
+	FILE *lm_record_file = NULL;
+
 	// These are produced by the keypoint estimator and consumed by the nonlinear optimizer
 	// left hand, right hand THEN left view, right view
 	struct one_frame_input keypoint_outputs[2];
@@ -13,6 +13,7 @@
 #include "math/m_eigen_interop.hpp"
 #include "util/u_logging.h"
 #include "../kine_common.hpp"
+#include "lm_interface.hpp"
 
 namespace xrt::tracking::hand::mercury::lm {
 
@@ -53,6 +54,15 @@ static constexpr size_t kNumOrientationsInFinger = 4;
 
 #undef RESIDUALS_HACKING
 
+// Hand written derivatives of the kinematic chain instead of Jets for everything, much faster. Turn off to compare.
+#define USE_ANALYTIC_JACOBIAN
+
+#if defined(USE_ANALYTIC_JACOBIAN) &&                                                                                  \
+    !(defined(USE_HAND_SIZE) && defined(USE_HAND_TRANSLATION) && defined(USE_HAND_ORIENTATION) &&                     \
+      defined(USE_EVERYTHING_ELSE))
+#error "The analytic Jacobian expects all of the parameters to be optimized, undef USE_ANALYTIC_JACOBIAN"
+#endif
+
 static constexpr size_t kMetacarpalBoneDim = 3;
 static constexpr size_t kProximalBoneDim = 2;
 static constexpr size_t kFingerDim = kProximalBoneDim + 2;
@@ -558,6 +568,8 @@ struct KinematicHandLM
 	Quat<HandScalar> left_in_right_orientation = {};
 
 	Eigen::Matrix<HandScalar, calc_input_size(true), 1> TinyOptimizerInput = {};
+
+	optimizer_stats last_stats = {};
 };
 
 template <typename T> struct Translations55
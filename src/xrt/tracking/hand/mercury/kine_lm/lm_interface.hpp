@@ -19,6 +19,21 @@ namespace xrt::tracking::hand::mercury::lm {
 // Opaque struct.
 struct KinematicHandLM;
 
+// What the solver did during the last optimizer_run, for benchmarks and debugging.
+struct optimizer_stats
+{
+	int iterations;
+
+	// Stopped by a termination condition before the iteration limit.
+	bool converged;
+
+	// Half the squared norm of the residuals, before and after solving.
+	float initial_cost;
+	float final_cost;
+
+	uint64_t solve_ns;
+};
+
 // Constructor
 void
 optimizer_create(xrt_pose left_in_right,
@@ -57,6 +72,9 @@ optimizer_run(KinematicHandLM *hand,
               float &out_hand_size,
               float &out_reprojection_error);
 
+void
+optimizer_get_last_stats(const KinematicHandLM *hand, optimizer_stats &out_stats);
+
 // Destructor
 void
 optimizer_destroy(KinematicHandLM **hand);
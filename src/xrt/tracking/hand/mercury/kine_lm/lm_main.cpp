@@ -22,6 +22,7 @@
 #include <cmath>
 #include <random>
 #include "lm_interface.hpp"
+#include "lm_test_hooks.hpp"
 #include "lm_optimizer_params_packer.inl"
 #include "lm_defines.hpp"
 
@@ -723,6 +724,380 @@ CostFunctor<optimize_hand_size>::operator()(const T *const x, T *residual) const
 	return true;
 }
 
+
+/*
+ *
+ * Analytic Jacobian.
+ *
+ * The kinematic chain and the projections are differentiated by hand: a joint
+ * parameter turns everything after it in the finger around an axis, so the
+ * derivative of a joint position is that axis crossed with the joint's offset
+ * from the pivot. Only the small rotation conversions and the stability
+ * residuals, which do not touch the chain, still go through Jets.
+ *
+ */
+
+template <int N>
+static inline void
+quat_jet_to_angular_velocities(const Quat<ceres::Jet<HandScalar, N>> &q, Vec3<HandScalar> out_omega[N])
+{
+	// The derivative of a unit quaternion is turning around 2 * vec(dq * conj(q)).
+	for (int i = 0; i < N; i++) {
+		const HandScalar dw = q.w.v[i];
+		const HandScalar dx = q.x.v[i];
+		const HandScalar dy = q.y.v[i];
+		const HandScalar dz = q.z.v[i];
+		const HandScalar w = q.w.a;
+		const HandScalar x = -q.x.a;
+		const HandScalar y = -q.y.a;
+		const HandScalar z = -q.z.a;
+
+		out_omega[i].x = 2 * (dw * x + dx * w + dy * z - dz * y);
+		out_omega[i].y = 2 * (dw * y - dx * z + dy * w + dz * x);
+		out_omega[i].z = 2 * (dw * z + dx * y - dy * x + dz * w);
+	}
+}
+
+static inline HandScalar
+lm_to_model_derivative(HandScalar lm, minmax mm)
+{
+	return cos(lm) * (mm.max - mm.min) * HandScalar(0.5);
+}
+
+static inline Eigen::Matrix<HandScalar, 3, 3>
+quat_to_matrix(const Quat<HandScalar> &q)
+{
+	return Eigen::Quaternion<HandScalar>(q.w, q.x, q.y, q.z).toRotationMatrix();
+}
+
+static inline Eigen::Matrix<HandScalar, 3, 1>
+to_eigen(const Vec3<HandScalar> &v)
+{
+	return {v.x, v.y, v.z};
+}
+
+/*!
+ * The 21 joint positions, like @ref cjrc before the camera transforms, and
+ * their derivatives with respect to the parameter vector @p x.
+ */
+template <int N>
+static void
+eval_joints_with_derivatives(const KinematicHandLM &state,
+                             const OptimizerHand<HandScalar> &hand,
+                             const HandScalar *x,
+                             Eigen::Matrix<HandScalar, 3, 1> out_positions[kNumNNJoints],
+                             Eigen::Matrix<HandScalar, 3, N> out_derivatives[kNumNNJoints])
+{
+	using Jet1 = ceres::Jet<HandScalar, 1>;
+	using Jet2 = ceres::Jet<HandScalar, 2>;
+	using Jet3 = ceres::Jet<HandScalar, 3>;
+
+	Translations55<HandScalar> rel_translations = {};
+	Orientations54<HandScalar> rel_orientations = {};
+	eval_hand_set_rel_translations(hand, rel_translations);
+	eval_hand_set_rel_orientations(hand, rel_orientations);
+
+	// Angular velocity of each rotation parameter, in the space of the bone it turns, and what it turns.
+	Vec3<HandScalar> omega_local[N] = {};
+	int omega_finger[N];
+	int omega_bone[N];
+	for (int i = 0; i < N; i++) {
+		omega_finger[i] = -1;
+		omega_bone[i] = -1;
+	}
+
+	size_t idx = kHandTranslationDim;
+
+	{
+		Vec3<Jet3> aax(Jet3(x[idx], 0), Jet3(x[idx + 1], 1), Jet3(x[idx + 2], 2));
+		Quat<Jet3> post;
+		AngleAxisToQuaternion(aax, post);
+		quat_jet_to_angular_velocities(post, &omega_local[idx]);
+		idx += kHandOrientationDim;
+	}
+
+	{
+		Vec2<Jet3> swing(LMToModel(Jet3(x[idx], 0), the_limit.thumb_mcp_swing_x),
+		                 LMToModel(Jet3(x[idx + 1], 1), the_limit.thumb_mcp_swing_y));
+		Jet3 twist = LMToModel(Jet3(x[idx + 2], 2), the_limit.thumb_mcp_twist);
+		Quat<Jet3> q;
+		SwingTwistToQuaternion(swing, twist, q);
+		quat_jet_to_angular_velocities(q, &omega_local[idx]);
+		for (int i = 0; i < 3; i++) {
+			omega_finger[idx + i] = 0;
+			omega_bone[idx + i] = 1;
+		}
+		idx += kMetacarpalBoneDim;
+
+		for (int i = 0; i < 2; i++) {
+			Quat<Jet1> curl;
+			CurlToQuaternion(LMToModel(Jet1(x[idx], 0), the_limit.thumb_curls[i]), curl);
+			quat_jet_to_angular_velocities(curl, &omega_local[idx]);
+			omega_finger[idx] = 0;
+			omega_bone[idx] = 2 + i;
+			idx++;
+		}
+	}
+
+	for (int finger_idx = 0; finger_idx < 4; finger_idx++) {
+		const FingerLimit &limit = the_limit.fingers[finger_idx];
+
+		Vec2<Jet2> swing(LMToModel(Jet2(x[idx], 0), limit.pxm_swing_x),
+		                 LMToModel(Jet2(x[idx + 1], 1), limit.pxm_swing_y));
+		Quat<Jet2> q;
+		SwingToQuaternion(swing, q);
+		quat_jet_to_angular_velocities(q, &omega_local[idx]);
+		for (int i = 0; i < 2; i++) {
+			omega_finger[idx + i] = finger_idx + 1;
+			omega_bone[idx + i] = 1;
+		}
+		idx += kProximalBoneDim;
+
+		for (int i = 0; i < 2; i++) {
+			Quat<Jet1> curl;
+			CurlToQuaternion(LMToModel(Jet1(x[idx], 0), limit.curls[i]), curl);
+			quat_jet_to_angular_velocities(curl, &omega_local[idx]);
+			omega_finger[idx] = finger_idx + 1;
+			omega_bone[idx] = 2 + i;
+			idx++;
+		}
+	}
+
+	// Only set if the hand size is a parameter.
+	HandScalar hand_size_derivative = 0;
+	if (state.optimize_hand_size) {
+		hand_size_derivative = lm_to_model_derivative(x[idx], the_limit.hand_size) / hand.hand_size;
+	}
+
+	const Eigen::Matrix<HandScalar, 3, 1> wrist = to_eigen(hand.wrist_final_location);
+	const Eigen::Matrix<HandScalar, 3, 1> mirror(state.is_right ? -1 : 1, 1, 1);
+
+	// The wrist only moves with the translation.
+	out_positions[0] = wrist;
+	out_derivatives[0].setZero();
+	out_derivatives[0].template leftCols<3>().setIdentity();
+
+	Vec3<HandScalar> omega_wrist[kHandOrientationDim];
+	for (size_t i = 0; i < kHandOrientationDim; i++) {
+		const Quat<HandScalar> pre(state.this_frame_pre_rotation);
+		UnitQuaternionRotatePoint(pre, omega_local[kHandTranslationDim + i], omega_wrist[i]);
+	}
+
+	for (size_t finger = 0; finger < kNumFingers; finger++) {
+		// Offsets from the wrist before mirroring, and the orientation each bone is turned by.
+		Vec3<HandScalar> offsets[kNumJointsInFinger];
+		Quat<HandScalar> orientations[kNumOrientationsInFinger];
+
+		const Quat<HandScalar> *last_orientation = &hand.wrist_final_orientation;
+		Vec3<HandScalar> last_offset = Vec3<HandScalar>::Zero();
+		for (size_t bone = 0; bone < kNumJointsInFinger; bone++) {
+			Vec3<HandScalar> step;
+			UnitQuaternionRotateAndScalePoint(*last_orientation, rel_translations.t[finger][bone],
+			                                  hand.hand_size, step);
+			offsets[bone] = Vec3<HandScalar>(last_offset.x + step.x, last_offset.y + step.y,
+			                                 last_offset.z + step.z);
+			last_offset = offsets[bone];
+
+			if (bone < kNumOrientationsInFinger) {
+				QuaternionProduct(*last_orientation, rel_orientations.q[finger][bone], orientations[bone]);
+				last_orientation = &orientations[bone];
+			}
+		}
+
+		for (size_t joint = 1; joint < kNumJointsInFinger; joint++) {
+			const size_t out_idx = 1 + finger * 4 + (joint - 1);
+			const Eigen::Matrix<HandScalar, 3, 1> offset = to_eigen(offsets[joint]);
+
+			out_positions[out_idx] = wrist + mirror.cwiseProduct(offset);
+
+			Eigen::Matrix<HandScalar, 3, N> &d = out_derivatives[out_idx];
+			d.setZero();
+			d.template leftCols<3>().setIdentity();
+
+			for (size_t i = 0; i < kHandOrientationDim; i++) {
+				d.col(kHandTranslationDim + i) = mirror.cwiseProduct(to_eigen(omega_wrist[i]).cross(offset));
+			}
+
+			for (int i = 0; i < N; i++) {
+				if (omega_finger[i] != (int)finger || omega_bone[i] >= (int)joint) {
+					continue;
+				}
+
+				// Turns around the joint at the start of the bone, in the space of its parent.
+				int bone = omega_bone[i];
+				Vec3<HandScalar> omega;
+				UnitQuaternionRotatePoint(orientations[bone - 1], omega_local[i], omega);
+
+				Eigen::Matrix<HandScalar, 3, 1> arm = offset - to_eigen(offsets[bone]);
+				d.col(i) = mirror.cwiseProduct(to_eigen(omega).cross(arm));
+			}
+
+			if (state.optimize_hand_size) {
+				d.col(N - 1) = mirror.cwiseProduct(offset) * hand_size_derivative;
+			}
+		}
+	}
+}
+
+template <bool optimize_hand_size> struct AnalyticCostFunction
+{
+	using Scalar = HandScalar;
+	static constexpr int kNumParameters = calc_input_size(optimize_hand_size);
+	enum
+	{
+		NUM_RESIDUALS = Eigen::Dynamic,
+		NUM_PARAMETERS = kNumParameters,
+	};
+
+	KinematicHandLM &parent;
+	size_t num_residuals_;
+	CostFunctor<optimize_hand_size> cf;
+
+	AnalyticCostFunction(KinematicHandLM &in_last_hand, size_t const &num_residuals)
+	    : parent(in_last_hand), num_residuals_(num_residuals), cf(in_last_hand, num_residuals)
+	{}
+
+	int
+	NumResiduals() const
+	{
+		return (int)num_residuals_;
+	}
+
+	bool
+	operator()(const Scalar *x, Scalar *residual, Scalar *jacobian) const;
+};
+
+template <bool optimize_hand_size>
+bool
+AnalyticCostFunction<optimize_hand_size>::operator()(const Scalar *x, Scalar *residual, Scalar *jacobian) const
+{
+	XRT_TRACE_MARKER();
+
+	constexpr int N = kNumParameters;
+
+	// Plain floats are cheap, and this way the residuals always match the autodiff version.
+	cf(x, residual);
+
+	if (jacobian == nullptr) {
+		return true;
+	}
+
+	KinematicHandLM &state = this->parent;
+
+	Eigen::Map<Eigen::Matrix<Scalar, Eigen::Dynamic, N>> J(jacobian, num_residuals_, N);
+	J.setZero();
+
+	OptimizerHand<Scalar> hand = {};
+	Quat<Scalar> tmp = state.this_frame_pre_rotation;
+	OptimizerHandInit<Scalar>(hand, tmp);
+	OptimizerHandUnpackFromVector(x, state, hand);
+
+	Eigen::Matrix<Scalar, 3, 1> positions[kNumNNJoints];
+	Eigen::Matrix<Scalar, 3, N> derivatives[kNumNNJoints];
+	eval_joints_with_derivatives<N>(state, hand, x, positions, derivatives);
+
+	HandScalar hand_size_derivative = 0;
+	if constexpr (optimize_hand_size) {
+		hand_size_derivative = lm_to_model_derivative(x[N - 1], the_limit.hand_size);
+	}
+
+	size_t row = 0;
+
+	for (int view = 0; view < 2; view++) {
+		const one_frame_one_view &obs = state.observation->views[view];
+		if (!obs.active) {
+			continue;
+		}
+
+		// Same transforms as cjrc.
+		Eigen::Matrix<Scalar, 3, 3> to_camera = Eigen::Matrix<Scalar, 3, 3>::Identity();
+		Eigen::Matrix<Scalar, 3, 1> move = Eigen::Matrix<Scalar, 3, 1>::Zero();
+		if (view == 1) {
+			to_camera = quat_to_matrix(state.left_in_right_orientation);
+			move = to_eigen(state.left_in_right_translation);
+		}
+		xrt_quat after = obs.look_dir;
+		math_quat_invert(&after, &after);
+		const Eigen::Matrix<Scalar, 3, 3> after_m =
+		    Eigen::Quaternion<Scalar>(after.w, after.x, after.y, after.z).toRotationMatrix();
+		const Eigen::Matrix<Scalar, 3, 1> rel_move = after_m * move;
+		to_camera = after_m * to_camera;
+
+		Eigen::Matrix<Scalar, 3, 1> in_camera[kNumNNJoints];
+		Scalar dist[kNumNNJoints];
+		for (size_t i = 0; i < kNumNNJoints; i++) {
+			in_camera[i] = to_camera * positions[i] + rel_move;
+			dist[i] = in_camera[i].norm();
+		}
+
+		const size_t pxm = Joint21::INDX_PXM;
+		const Eigen::Matrix<Scalar, 1, 3> pxm_dir = (in_camera[pxm] / dist[pxm]).transpose();
+		const Eigen::Matrix<Scalar, 1, N> d_pxm_dist = pxm_dir * to_camera * derivatives[pxm];
+
+		for (size_t i = 0; i < kNumNNJoints; i++) {
+			const Eigen::Matrix<Scalar, 3, 1> n = in_camera[i] / dist[i];
+			const Scalar conf = obs.keypoints_in_scaled_stereographic[i].confidence_xy;
+
+			if (dist[i] > FLT_EPSILON) {
+				// d/dc of x / (1 - z) of the normalized vector, the chain through the normalization.
+				Eigen::Matrix<Scalar, 2, 3> d_sg_d_n;
+				Scalar inv = 1 / (1 - n.z());
+				d_sg_d_n << inv, 0, n.x() * inv * inv, //
+				    0, inv, n.y() * inv * inv;
+				Eigen::Matrix<Scalar, 3, 3> d_n_d_c =
+				    (Eigen::Matrix<Scalar, 3, 3>::Identity() - n * n.transpose()) / dist[i];
+
+				J.template block<2, N>(row, 0) = (conf * d_sg_d_n * d_n_d_c * to_camera) * derivatives[i];
+			}
+			row += 2;
+
+			if (i == Joint21::MIDL_PXM) {
+				continue;
+			}
+
+			if (!state.first_frame) {
+				const Scalar mul = Scalar(pow(obs.keypoints_in_scaled_stereographic[i].confidence_depth, 3)) *
+				                   Scalar(1.0f) * state.depth_err_mul;
+				const Eigen::Matrix<Scalar, 1, N> d_dist = n.transpose() * to_camera * derivatives[i];
+
+				J.row(row) = (d_dist - d_pxm_dist) * (mul / hand.hand_size);
+				if constexpr (optimize_hand_size) {
+					J(row, N - 1) -=
+					    mul * (dist[i] - dist[pxm]) / (hand.hand_size * hand.hand_size) * hand_size_derivative;
+				}
+			}
+			row++;
+		}
+	}
+
+	// The rest are simple functions of the parameters, not worth doing by hand.
+	using Jet = ceres::Jet<Scalar, N>;
+	Jet x_jet[N];
+	for (int i = 0; i < N; i++) {
+		x_jet[i] = Jet(x[i], i);
+	}
+
+	OptimizerHand<Jet> hand_jet = {};
+	Quat<Jet> tmp_jet = state.this_frame_pre_rotation;
+	OptimizerHandInit<Jet>(hand_jet, tmp_jet);
+	OptimizerHandUnpackFromVector(x_jet, state, hand_jet);
+
+	Jet rest[kHRTC_HandSize + kHandResidualTemporalConsistencySize + kHandResidualOneSideMatchCurls * 2];
+	ResidualHelper<Jet> helper(rest);
+	computeResidualStability<optimize_hand_size, Jet>(hand_jet, state.last_frame, state, helper);
+#ifdef USE_HAND_CURLS
+	CostFunctor_MatchCurls<Jet>(hand_jet, state, helper);
+#endif
+
+	for (size_t i = 0; i < helper.out_residual_idx; i++) {
+		J.row(row + i) = rest[i].v.transpose();
+	}
+
+	assert(row + helper.out_residual_idx == num_residuals_);
+
+	return true;
+}
+
 // look at tests_quat_change_of_basis
 #if 0
 template <typename T>
@@ -851,34 +1226,47 @@ opt_run(KinematicHandLM &state, one_frame_input &observation, xrt_hand_joint_set
 	LM_DEBUG(state, "Running with %zu inputs and %zu residuals, viewed in %d cameras", input_size, residual_size,
 	         state.num_observation_views);
 
+#ifdef USE_ANALYTIC_JACOBIAN
+	using CostFunction = AnalyticCostFunction<optimize_hand_size>;
+
+	CostFunction f(state, residual_size);
+#else
 	CostFunctor<optimize_hand_size> cf(state, residual_size);
 
-	using AutoDiffCostFunctor =
+	using CostFunction =
 	    ceres::TinySolverAutoDiffFunction<CostFunctor<optimize_hand_size>, Eigen::Dynamic, input_size, HandScalar>;
 
-	AutoDiffCostFunctor f(cf);
+	CostFunction f(cf);
+#endif
 
-	ceres::TinySolver<AutoDiffCostFunctor> solver = {};
+	ceres::TinySolver<CostFunction> solver = {};
 	solver.options.max_num_iterations = 30;
 
-	//!@todo We don't yet know what "good" termination conditions are.
-	// Instead of trying to guess without good offline datasets, just disable _all_ termination conditions and have
-	// it run for 30 iterations no matter what.
+	// Stop once the cost or the step stops changing at float precision, picked with the synthetic sequence in
+	// tests_levenbergmarquardt "[benchmark]". A tighter function tolerance only chases rounding noise and ends up
+	// with a worse fit. The gradient test stays off, with the stability residuals it stops too early.
+	//!@todo Check these against recordings of live sessions, see MERCURY_LM_RECORD.
 	solver.options.gradient_tolerance = 0;
-	solver.options.function_tolerance = 0;
-	solver.options.parameter_tolerance = 0;
+	solver.options.function_tolerance = 1e-7;
+	solver.options.parameter_tolerance = 1e-6;
 
 	//!@todo We need to do a parameter sweep on initial_trust_region_radius.
 
 	Eigen::Matrix<HandScalar, input_size, 1> inp = state.TinyOptimizerInput.head<input_size>();
 
-	XRT_MAYBE_UNUSED uint64_t start = os_monotonic_get_ns();
-	XRT_MAYBE_UNUSED auto summary = solver.Solve(f, &inp);
-	XRT_MAYBE_UNUSED uint64_t end = os_monotonic_get_ns();
+	uint64_t start = os_monotonic_get_ns();
+	auto summary = solver.Solve(f, &inp);
+	uint64_t end = os_monotonic_get_ns();
 
 	//!@todo Is there a zero-copy way of doing this?
 	state.TinyOptimizerInput.head<input_size>() = inp;
 
+	state.last_stats.iterations = summary.iterations;
+	state.last_stats.converged = summary.status != ceres::TinySolver<CostFunction>::HIT_MAX_ITERATIONS;
+	state.last_stats.initial_cost = summary.initial_cost;
+	state.last_stats.final_cost = summary.final_cost;
+	state.last_stats.solve_ns = end - start;
+
 	if (state.log_level <= U_LOGGING_DEBUG) {
 
 		uint64_t diff = end - start;
@@ -1118,6 +1506,60 @@ optimizer_create(xrt_pose left_in_right, bool is_right, u_logging_level log_leve
 	*out_kinematic_hand = hand;
 }
 
+void
+optimizer_get_last_stats(const KinematicHandLM *hand, optimizer_stats &out_stats)
+{
+	out_stats = hand->last_stats;
+}
+
+template <bool optimize_hand_size>
+static float
+jacobian_difference(KinematicHandLM &state, const HandScalar *x)
+{
+	constexpr int input_size = calc_input_size(optimize_hand_size);
+	size_t residual_size = calc_residual_size(state.use_stability, optimize_hand_size, state.num_observation_views);
+
+	CostFunctor<optimize_hand_size> cf(state, residual_size);
+	ceres::TinySolverAutoDiffFunction<CostFunctor<optimize_hand_size>, Eigen::Dynamic, input_size, HandScalar> autodiff(
+	    cf);
+	AnalyticCostFunction<optimize_hand_size> analytic(state, residual_size);
+
+	Eigen::Matrix<HandScalar, Eigen::Dynamic, 1> residual(residual_size);
+	Eigen::Matrix<HandScalar, Eigen::Dynamic, input_size> expected(residual_size, input_size);
+	Eigen::Matrix<HandScalar, Eigen::Dynamic, input_size> got(residual_size, input_size);
+
+	autodiff(x, residual.data(), expected.data());
+	analytic(x, residual.data(), got.data());
+
+	// Relative to each column, the parameters have quite different scales.
+	HandScalar worst = 0;
+	for (int i = 0; i < input_size; i++) {
+		HandScalar scale = std::max(expected.col(i).cwiseAbs().maxCoeff(), HandScalar(1e-3));
+		worst = std::max(worst, (got.col(i) - expected.col(i)).cwiseAbs().maxCoeff() / scale);
+	}
+	return worst;
+}
+
+float
+optimizer_jacobian_difference(const KinematicHandLM *hand)
+{
+	KinematicHandLM state = *hand;
+
+	// optimizer_run has cleared first_frame, so the residuals need to match that.
+	state.use_stability = !state.first_frame;
+
+	// Away from the identity post rotation and the middle of the joint limits, where things are simplest.
+	HandScalar x[calc_input_size(true)];
+	for (size_t i = 0; i < calc_input_size(true); i++) {
+		x[i] = state.TinyOptimizerInput[i] + HandScalar(0.1) * sin(HandScalar(i + 1));
+	}
+
+	if (state.optimize_hand_size) {
+		return jacobian_difference<true>(state, x);
+	}
+	return jacobian_difference<false>(state, x);
+}
+
 void
 optimizer_destroy(KinematicHandLM **hand)
 {
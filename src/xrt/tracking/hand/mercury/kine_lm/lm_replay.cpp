@@ -0,0 +1,78 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Recording and replaying of kinematic optimizer inputs.
+ * @ingroup tracking
+ */
+
+#include "lm_replay.hpp"
+
+#include <stdint.h>
+#include <string.h>
+
+
+namespace xrt::tracking::hand::mercury::lm {
+
+namespace {
+
+	constexpr char kMagic[4] = {'M', 'L', 'M', 'R'};
+	constexpr uint32_t kVersion = 1;
+
+	struct replay_header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t frame_size;
+		xrt_pose left_in_right;
+	};
+
+} // namespace
+
+bool
+replay_write_header(FILE *file, const xrt_pose &left_in_right)
+{
+	replay_header header = {};
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.frame_size = sizeof(replay_frame);
+	header.left_in_right = left_in_right;
+
+	return fwrite(&header, sizeof(header), 1, file) == 1;
+}
+
+bool
+replay_write_frame(FILE *file, const replay_frame &frame)
+{
+	return fwrite(&frame, sizeof(frame), 1, file) == 1;
+}
+
+bool
+replay_read_file(const char *path, xrt_pose &out_left_in_right, std::vector<replay_frame> &out_frames)
+{
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		return false;
+	}
+
+	replay_header header = {};
+	if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+	    header.version != kVersion || header.frame_size != sizeof(replay_frame)) {
+		fclose(file);
+		return false;
+	}
+
+	out_left_in_right = header.left_in_right;
+	out_frames.clear();
+
+	replay_frame frame = {};
+	while (fread(&frame, sizeof(frame), 1, file) == 1) {
+		out_frames.push_back(frame);
+	}
+
+	fclose(file);
+
+	return true;
+}
+
+} // namespace xrt::tracking::hand::mercury::lm
@@ -0,0 +1,54 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Recording and replaying of kinematic optimizer inputs.
+ * @ingroup tracking
+ */
+#pragma once
+
+#include "xrt/xrt_defines.h"
+#include "../kine_common.hpp"
+
+#include <stdio.h>
+#include <vector>
+
+
+namespace xrt::tracking::hand::mercury::lm {
+
+/*!
+ * The arguments of one optimizer_run call, so that a live session can be fed
+ * through the optimizer again offline.
+ */
+struct replay_frame
+{
+	bool is_right;
+	bool hand_was_untracked_last_frame;
+	bool optimize_hand_size;
+	float smoothing_factor;
+	float target_hand_size;
+	float hand_size_err_mul;
+	float amt_use_depth;
+
+	//! Before optimizer_run mutates it.
+	one_frame_input observation;
+};
+
+/*!
+ * Start a recording, @p left_in_right is what the optimizers were created
+ * with. The file is just the structs, only meant to be read by the same build.
+ */
+bool
+replay_write_header(FILE *file, const xrt_pose &left_in_right);
+
+bool
+replay_write_frame(FILE *file, const replay_frame &frame);
+
+/*!
+ * Read a whole recording, fails if it was written by a build with a different
+ * layout of @ref replay_frame.
+ */
+bool
+replay_read_file(const char *path, xrt_pose &out_left_in_right, std::vector<replay_frame> &out_frames);
+
+} // namespace xrt::tracking::hand::mercury::lm
@@ -0,0 +1,23 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Hooks into the kinematic optimizer that only the tests use.
+ * @ingroup tracking
+ */
+#pragma once
+
+#include "lm_interface.hpp"
+
+namespace xrt::tracking::hand::mercury::lm {
+
+/*!
+ * Largest difference between the analytic and the automatically differentiated
+ * Jacobian of the last optimizer_run problem, relative to the largest entry of
+ * each column. Works on a copy of @p hand, the observation passed to
+ * optimizer_run must still be alive.
+ */
+float
+optimizer_jacobian_difference(const KinematicHandLM *hand);
+
+} // namespace xrt::tracking::hand::mercury::lm
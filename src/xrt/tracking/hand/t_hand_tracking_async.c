@@ -24,10 +24,30 @@
 DEBUG_GET_ONCE_BOOL_OPTION(hta_prediction_disable, "HTA_PREDICTION_DISABLE", false)
 DEBUG_GET_ONCE_FLOAT_OPTION(hta_prediction_offset_ms, "HTA_PREDICTION_OFFSET_MS", -40.0f)
 
+//! Number of samples plotted for each stage.
+#define HT_ASYNC_TIMING_COUNT 128
+
+
+/*!
+ * Plotted durations of one stage of the hand-tracking.
+ *
+ * @ingroup drv_ht
+ */
+struct ht_async_timing
+{
+	float dur_ms[HT_ASYNC_TIMING_COUNT];
+	int idx;
+	struct u_var_timing ui;
+};
 
 /*!
  * A synchronous to asynchronous wrapper around the hand-tracker code.
  *
+ * If the provider splits the processing in an inference and an optimisation
+ * stage they are run on two threads, so the next frame is inferred while the
+ * current one is optimised, up to the pipeline depth of the provider frames
+ * are in flight. Otherwise one frame at a time is processed.
+ *
  * @ingroup drv_ht
  */
 struct ht_async_impl
@@ -36,8 +56,46 @@ struct ht_async_impl
 
 	struct t_hand_tracking_sync *provider;
 
+	//! Frames handed from the sinks to the mainloop, valid when frames_ready.
 	struct xrt_frame *frames[2];
 
+	struct
+	{
+		//! Is the provider split into two stages.
+		bool split;
+
+		//! Max number of frames in flight, one if not split.
+		uint32_t depth;
+
+		//! Frames accepted but not yet done, read by the sinks without a lock.
+		xrt_atomic_s32_t in_flight;
+
+		//! Frames inferred waiting for the optimise thread, protected by its lock.
+		uint32_t inferred;
+
+		//! Only touched by the mainloop and the optimise thread respectively.
+		uint32_t next_infer_slot;
+		uint32_t next_optimize_slot;
+
+		//! Runs the optimize stage when split.
+		struct os_thread_helper optimize_thread;
+
+		//! Frames thrown away because the pipeline was full.
+		uint32_t dropped;
+	} pipeline;
+
+	struct
+	{
+		//! Whole processing, or the inference stage when split.
+		struct ht_async_timing infer;
+
+		//! Optimisation stage, only when split.
+		struct ht_async_timing optimize;
+
+		//! From the frame timestamp to the hands being available.
+		struct ht_async_timing latency;
+	} timing;
+
 	bool use_prediction;
 	struct u_var_draggable_f32 prediction_offset_ms;
 
@@ -61,7 +119,8 @@ struct ht_async_impl
 	// running is so we can stop the thread when Monado exits
 	struct os_thread_helper mainloop;
 
-	volatile bool hand_tracking_work_active;
+	//! Set by the right sink when both frames are in, cleared by the mainloop when it is done with them.
+	xrt_atomic_s32_t frames_ready;
 };
 
 
@@ -77,6 +136,127 @@ ht_async_impl(struct t_hand_tracking_async *base)
 	return (struct ht_async_impl *)base;
 }
 
+static void
+timing_init(struct ht_async_timing *timing, float reference_ms)
+{
+	timing->ui.values.data = timing->dur_ms;
+	timing->ui.values.length = HT_ASYNC_TIMING_COUNT;
+	timing->ui.values.index_ptr = &timing->idx;
+	timing->ui.reference_timing = reference_ms;
+	timing->ui.center_reference_timing = false;
+	timing->ui.range = reference_ms;
+	timing->ui.dynamic_rescale = true;
+	timing->ui.unit = "ms";
+}
+
+static void
+timing_push(struct ht_async_timing *timing, uint64_t start_ns, uint64_t end_ns)
+{
+	int idx = (timing->idx + 1) % HT_ASYNC_TIMING_COUNT;
+	timing->dur_ms[idx] = (float)time_ns_to_ms_f((int64_t)(end_ns - start_ns));
+	timing->idx = idx;
+}
+
+/*!
+ * Makes the hands in working the present ones, called from the thread that
+ * produced them.
+ */
+static void
+post_process(struct ht_async_impl *hta)
+{
+	os_mutex_lock(&hta->present.mutex);
+
+	hta->present.timestamp = hta->working.timestamp;
+
+	for (int i = 0; i < 2; i++) {
+		hta->present.hands[i] = hta->working.hands[i];
+	}
+
+	os_mutex_unlock(&hta->present.mutex);
+
+	for (int i = 0; i < 2; i++) {
+		struct xrt_space_relation wrist_rel =
+		    hta->working.hands[i].values.hand_joint_set_default[XRT_HAND_JOINT_WRIST].relation;
+
+		m_relation_history_estimate_motion( //
+		    hta->present.relation_hist[i],  //
+		    &wrist_rel,                     //
+		    hta->working.timestamp,         //
+		    &wrist_rel);                    //
+
+		m_relation_history_push(           //
+		    hta->present.relation_hist[i], //
+		    &wrist_rel,                    //
+		    hta->working.timestamp);       //
+	}
+
+	timing_push(&hta->timing.latency, hta->working.timestamp, os_monotonic_get_ns());
+}
+
+//! A frame has gone all the way through, room for a new one.
+static void
+frame_done(struct ht_async_impl *hta)
+{
+	xrt_atomic_s32_dec_return(&hta->pipeline.in_flight);
+}
+
+//! Can the sinks take a new pair of frames.
+static bool
+can_take_frames(struct ht_async_impl *hta)
+{
+	return xrt_atomic_s32_load(&hta->frames_ready) == 0 &&
+	       xrt_atomic_s32_load(&hta->pipeline.in_flight) < (int32_t)hta->pipeline.depth;
+}
+
+static void *
+ht_async_optimize_loop(void *ptr)
+{
+	U_TRACE_SET_THREAD_NAME("Hand Tracking: Optimize");
+
+	struct ht_async_impl *hta = (struct ht_async_impl *)ptr;
+
+	os_thread_helper_lock(&hta->pipeline.optimize_thread);
+
+	while (os_thread_helper_is_running_locked(&hta->pipeline.optimize_thread)) {
+
+		// Nothing inferred, wait.
+		if (hta->pipeline.inferred == 0) {
+			os_thread_helper_wait_locked(&hta->pipeline.optimize_thread);
+
+			// Loop back to the top to check if we should stop.
+			continue;
+		}
+
+		os_thread_helper_unlock(&hta->pipeline.optimize_thread);
+
+		uint32_t slot = hta->pipeline.next_optimize_slot;
+		hta->pipeline.next_optimize_slot = (slot + 1) % hta->pipeline.depth;
+
+		uint64_t start_ns = os_monotonic_get_ns();
+
+		t_ht_sync_optimize(           //
+		    hta->provider,            //
+		    slot,                     //
+		    &hta->working.hands[0],   //
+		    &hta->working.hands[1],   //
+		    &hta->working.timestamp); //
+
+		timing_push(&hta->timing.optimize, start_ns, os_monotonic_get_ns());
+
+		post_process(hta);
+
+		frame_done(hta);
+
+		// Have to lock it again.
+		os_thread_helper_lock(&hta->pipeline.optimize_thread);
+		hta->pipeline.inferred--;
+	}
+
+	os_thread_helper_unlock(&hta->pipeline.optimize_thread);
+
+	return NULL;
+}
+
 static void *
 ht_async_mainloop(void *ptr)
 {
@@ -89,7 +269,7 @@ ht_async_mainloop(void *ptr)
 	while (os_thread_helper_is_running_locked(&hta->mainloop)) {
 
 		// No new frame, wait.
-		if (hta->frames[0] == NULL && hta->frames[1] == NULL) {
+		if (xrt_atomic_s32_load(&hta->frames_ready) == 0) {
 			os_thread_helper_wait_locked(&hta->mainloop);
 
 			/*
@@ -104,53 +284,49 @@ ht_async_mainloop(void *ptr)
 
 
 		/*
-		 * Do the hand-tracking now.
+		 * Do the hand-tracking now, or only the first half of it.
 		 */
 
-		t_ht_sync_process(            //
-		    hta->provider,            //
-		    hta->frames[0],           //
-		    hta->frames[1],           //
-		    &hta->working.hands[0],   //
-		    &hta->working.hands[1],   //
-		    &hta->working.timestamp); //
+		uint64_t start_ns = os_monotonic_get_ns();
+
+		if (hta->pipeline.split) {
+			uint32_t slot = hta->pipeline.next_infer_slot;
+			hta->pipeline.next_infer_slot = (slot + 1) % hta->pipeline.depth;
+
+			t_ht_sync_infer(hta->provider, slot, hta->frames[0], hta->frames[1]);
+		} else {
+			t_ht_sync_process(            //
+			    hta->provider,            //
+			    hta->frames[0],           //
+			    hta->frames[1],           //
+			    &hta->working.hands[0],   //
+			    &hta->working.hands[1],   //
+			    &hta->working.timestamp); //
+		}
+
+		timing_push(&hta->timing.infer, start_ns, os_monotonic_get_ns());
 
 		xrt_frame_reference(&hta->frames[0], NULL);
 		xrt_frame_reference(&hta->frames[1], NULL);
 
+		// The sinks can give us new frames now.
+		xrt_atomic_s32_store(&hta->frames_ready, 0);
+
 
 		/*
-		 * Post process.
+		 * Hand over to the optimise thread or post process.
 		 */
 
-		os_mutex_lock(&hta->present.mutex);
-
-		hta->present.timestamp = hta->working.timestamp;
-
-		for (int i = 0; i < 2; i++) {
-			hta->present.hands[i] = hta->working.hands[i];
+		if (hta->pipeline.split) {
+			os_thread_helper_lock(&hta->pipeline.optimize_thread);
+			hta->pipeline.inferred++;
+			os_thread_helper_signal_locked(&hta->pipeline.optimize_thread);
+			os_thread_helper_unlock(&hta->pipeline.optimize_thread);
+		} else {
+			post_process(hta);
+			frame_done(hta);
 		}
 
-		os_mutex_unlock(&hta->present.mutex);
-
-		for (int i = 0; i < 2; i++) {
-			struct xrt_space_relation wrist_rel =
-			    hta->working.hands[i].values.hand_joint_set_default[XRT_HAND_JOINT_WRIST].relation;
-
-			m_relation_history_estimate_motion( //
-			    hta->present.relation_hist[i],  //
-			    &wrist_rel,                     //
-			    hta->working.timestamp,         //
-			    &wrist_rel);                    //
-
-			m_relation_history_push(           //
-			    hta->present.relation_hist[i], //
-			    &wrist_rel,                    //
-			    hta->working.timestamp);       //
-		}
-
-		hta->hand_tracking_work_active = false;
-
 		// Have to lock it again.
 		os_thread_helper_lock(&hta->mainloop);
 	}
@@ -173,8 +349,9 @@ ht_async_receive_left(struct xrt_frame_sink *sink, struct xrt_frame *frame)
 	struct ht_async_impl *hta = ht_async_impl(container_of(sink, struct t_hand_tracking_async, left));
 
 	// See comment in ht_async_receive_right.
-	if (hta->hand_tracking_work_active) {
+	if (!can_take_frames(hta)) {
 		// Throw away this frame
+		hta->pipeline.dropped++;
 		return;
 	}
 
@@ -191,12 +368,12 @@ ht_async_receive_right(struct xrt_frame_sink *sink, struct xrt_frame *frame)
 	struct ht_async_impl *hta = ht_async_impl(container_of(sink, struct t_hand_tracking_async, right));
 
 	/*
-	 * Throw away this frame - either the hand tracking work is running now,
-	 * or it was a very short time ago, and ht_async_receive_left threw away
-	 * its frame or there's some other bug where left isn't pushed before
-	 * right.
+	 * Throw away this frame - either the pipeline is full now, or it was a
+	 * very short time ago, and ht_async_receive_left threw away its frame
+	 * or there's some other bug where left isn't pushed before right. The
+	 * pipeline only empties between the two, so if left was kept so is right.
 	 */
-	if (hta->hand_tracking_work_active || hta->frames[0] == NULL) {
+	if (!can_take_frames(hta) || hta->frames[0] == NULL) {
 		return;
 	}
 
@@ -207,11 +384,10 @@ ht_async_receive_right(struct xrt_frame_sink *sink, struct xrt_frame *frame)
 	// Keep onto this frame.
 	xrt_frame_reference(&hta->frames[1], frame);
 
-	// We have both frames, now work is active.
-	hta->hand_tracking_work_active = true;
-
-	// Wake up the worker thread.
+	// We have both frames, hand them over and wake up the worker thread.
 	os_thread_helper_lock(&hta->mainloop);
+	xrt_atomic_s32_inc_return(&hta->pipeline.in_flight);
+	xrt_atomic_s32_store(&hta->frames_ready, 1);
 	os_thread_helper_signal_locked(&hta->mainloop);
 	os_thread_helper_unlock(&hta->mainloop);
 }
@@ -228,8 +404,9 @@ ht_async_break_apart(struct xrt_frame_node *node)
 {
 	struct ht_async_impl *hta = ht_async_impl(container_of(node, struct t_hand_tracking_async, node));
 
-	// Stop the thread, unsure nothing else is pushed into the tracker.
+	// Stop the threads, unsure nothing else is pushed into the tracker.
 	os_thread_helper_stop_and_wait(&hta->mainloop);
+	os_thread_helper_stop_and_wait(&hta->pipeline.optimize_thread);
 }
 
 static void
@@ -238,8 +415,12 @@ ht_async_destroy(struct xrt_frame_node *node)
 	struct ht_async_impl *hta = ht_async_impl(container_of(node, struct t_hand_tracking_async, node));
 
 	os_thread_helper_destroy(&hta->mainloop);
+	os_thread_helper_destroy(&hta->pipeline.optimize_thread);
 	os_mutex_destroy(&hta->present.mutex);
 
+	xrt_frame_reference(&hta->frames[0], NULL);
+	xrt_frame_reference(&hta->frames[1], NULL);
+
 	t_ht_sync_destroy(&hta->provider);
 
 	for (int i = 0; i < 2; i++) {
@@ -332,6 +513,9 @@ t_hand_tracking_async_default_create(struct xrt_frame_context *xfctx, struct t_h
 	hta->base.get_hand = ht_async_get_hand;
 	hta->provider = sync;
 
+	hta->pipeline.split = sync->infer != NULL && sync->optimize != NULL && sync->pipeline_depth > 0;
+	hta->pipeline.depth = hta->pipeline.split ? sync->pipeline_depth : 1;
+
 	for (int i = 0; i < 2; i++) {
 		m_relation_history_create(&hta->present.relation_hist[i]);
 	}
@@ -357,9 +541,17 @@ t_hand_tracking_async_default_create(struct xrt_frame_context *xfctx, struct t_h
 	    .max = 1000000,
 	};
 
+	timing_init(&hta->timing.infer, 16.6f);
+	timing_init(&hta->timing.optimize, 16.6f);
+	timing_init(&hta->timing.latency, 40.0f);
+
 	// In reality never fails.
 	os_mutex_init(&hta->present.mutex);
 	os_thread_helper_init(&hta->mainloop);
+	os_thread_helper_init(&hta->pipeline.optimize_thread);
+	if (hta->pipeline.split) {
+		os_thread_helper_start(&hta->pipeline.optimize_thread, ht_async_optimize_loop, hta);
+	}
 	os_thread_helper_start(&hta->mainloop, ht_async_mainloop, hta);
 
 	// Everything setup, add to frame context.
@@ -369,6 +561,15 @@ t_hand_tracking_async_default_create(struct xrt_frame_context *xfctx, struct t_h
 	u_var_add_root(hta, "Hand-tracking async shim!", 0);
 	u_var_add_bool(hta, &hta->use_prediction, "Predict wrist movement");
 	u_var_add_draggable_f32(hta, &hta->prediction_offset_ms, "Amount to time-travel (ms)");
+	u_var_add_ro_u32(hta, &hta->pipeline.depth, "Max frames in flight");
+	u_var_add_ro_u32(hta, &hta->pipeline.dropped, "Frames dropped");
+	if (hta->pipeline.split) {
+		u_var_add_f32_timing(hta, &hta->timing.infer.ui, "Inference (ms)");
+		u_var_add_f32_timing(hta, &hta->timing.optimize.ui, "Optimization (ms)");
+	} else {
+		u_var_add_f32_timing(hta, &hta->timing.infer.ui, "Processing (ms)");
+	}
+	u_var_add_f32_timing(hta, &hta->timing.latency.ui, "Frame to hands latency (ms)");
 
 	return &hta->base;
 }
@@ -0,0 +1,125 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Auto exposure and gain tests.
+ */
+
+#include <util/u_autoexpgain.h>
+#include <util/u_frame.h>
+
+#include "catch/catch.hpp"
+
+#include <cstring>
+
+
+namespace {
+
+//! Gradient that gets brighter with @p level, dark enough at 0 to make the AEG react.
+void
+fill(struct xrt_frame *xf, uint32_t level)
+{
+	for (uint32_t y = 0; y < xf->height; y++) {
+		for (uint32_t x = 0; x < xf->width; x++) {
+			xf->data[y * xf->stride + x] = (uint8_t)((x + y + level * 16) % 64);
+		}
+	}
+}
+
+/*!
+ * Samples the region with the helper, growing the available size a slice at a
+ * time like the WMR driver does while it assembles the frame.
+ */
+void
+sample(struct xrt_frame *xf, const struct xrt_rect &roi, struct u_autoexpgain_histogram *hist)
+{
+	const size_t slice = 0x6000 - 32;
+
+	u_autoexpgain_histogram_init(hist, roi.extent.w);
+	for (size_t done = 0; done < xf->size;) {
+		done = done + slice > xf->size ? xf->size : done + slice;
+		u_autoexpgain_histogram_sample_rows(hist, xf->data, done, xf->stride, &roi);
+	}
+}
+
+} // namespace
+
+
+TEST_CASE("u_autoexpgain_histogram_matches_frame")
+{
+	struct u_autoexpgain *from_frame = u_autoexpgain_create(U_AEG_STRATEGY_TRACKING, true, 0);
+	struct u_autoexpgain *from_histogram = u_autoexpgain_create(U_AEG_STRATEGY_TRACKING, true, 0);
+
+	struct xrt_frame *xf = nullptr;
+	u_frame_create_one_off(XRT_FORMAT_L8, 640, 480, &xf);
+	REQUIRE(xf != nullptr);
+
+	struct xrt_rect roi = {{0, 0}, {(int)xf->width, (int)xf->height}};
+
+	bool same = true;
+	for (uint32_t i = 0; i < 20; i++) {
+		fill(xf, i);
+
+		struct u_autoexpgain_histogram hist;
+		sample(xf, roi, &hist);
+
+		u_autoexpgain_update(from_frame, xf);
+		u_autoexpgain_update_histogram(from_histogram, hist.bins, hist.count);
+
+		same = same && u_autoexpgain_get_exposure(from_frame) == u_autoexpgain_get_exposure(from_histogram);
+		same = same && u_autoexpgain_get_gain(from_frame) == u_autoexpgain_get_gain(from_histogram);
+	}
+	CHECK(same);
+
+	xrt_frame_reference(&xf, nullptr);
+	u_autoexpgain_destroy(&from_frame);
+	u_autoexpgain_destroy(&from_histogram);
+}
+
+TEST_CASE("u_autoexpgain_histogram_roi")
+{
+	// Two cameras side by side after a metadata row, like the WMR frames.
+	const uint32_t w = 320;
+	const uint32_t h = 240;
+	struct xrt_frame *xf = nullptr;
+	struct xrt_frame *cam = nullptr;
+	u_frame_create_one_off(XRT_FORMAT_L8, w * 2, h + 1, &xf);
+	u_frame_create_one_off(XRT_FORMAT_L8, w, h, &cam);
+	REQUIRE(xf != nullptr);
+	REQUIRE(cam != nullptr);
+
+	fill(xf, 3);
+	struct xrt_rect roi = {{(int)w, 1}, {(int)w, (int)h}};
+	for (uint32_t y = 0; y < h; y++) {
+		memcpy(cam->data + y * cam->stride, xf->data + (y + 1) * xf->stride + w, w);
+	}
+
+	// Sampling in slices is the same as sampling the whole camera at once.
+	struct u_autoexpgain_histogram sliced;
+	sample(xf, roi, &sliced);
+
+	struct u_autoexpgain_histogram whole;
+	struct xrt_rect whole_roi = {{0, 0}, {(int)w, (int)h}};
+	u_autoexpgain_histogram_init(&whole, w);
+	u_autoexpgain_histogram_sample_rows(&whole, cam->data, cam->size, cam->stride, &whole_roi);
+
+	CHECK(sliced.count == whole.count);
+	CHECK(memcmp(sliced.bins, whole.bins, sizeof(whole.bins)) == 0);
+
+	// Nothing is sampled before the first row of the region is complete.
+	struct u_autoexpgain_histogram partial;
+	u_autoexpgain_histogram_init(&partial, w);
+	u_autoexpgain_histogram_sample_rows(&partial, xf->data, xf->stride + w * 2 - 1, xf->stride, &roi);
+	CHECK(partial.count == 0);
+
+	xrt_frame_reference(&xf, nullptr);
+	xrt_frame_reference(&cam, nullptr);
+}
+
+TEST_CASE("u_autoexpgain_sample_step")
+{
+	CHECK(u_autoexpgain_get_sample_step(640) > 0);
+	// Never zero, small frames still get sampled.
+	CHECK(u_autoexpgain_get_sample_step(1) == 1);
+	CHECK(u_autoexpgain_get_sample_step(0) == 1);
+}
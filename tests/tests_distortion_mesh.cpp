@@ -0,0 +1,204 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Distortion mesh and image generation and cache tests.
+ */
+
+#include <util/u_distortion_mesh.h>
+
+#include "catch/catch.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+
+namespace {
+
+std::atomic<uint32_t> g_calls{0};
+float g_strength = 0.2f;
+
+bool
+barrel(struct xrt_device *xdev, uint32_t view, float u, float v, struct xrt_uv_triplet *result)
+{
+	g_calls++;
+
+	float x = u * 2.0f - 1.0f;
+	float y = v * 2.0f - 1.0f;
+	float k = 1.0f + g_strength * (x * x + y * y) + (float)view * 0.01f;
+
+	result->r.x = (x * k * 0.98f + 1.0f) * 0.5f;
+	result->r.y = (y * k * 0.98f + 1.0f) * 0.5f;
+	result->g.x = (x * k + 1.0f) * 0.5f;
+	result->g.y = (y * k + 1.0f) * 0.5f;
+	result->b.x = (x * k * 1.02f + 1.0f) * 0.5f;
+	result->b.y = (y * k * 1.02f + 1.0f) * 0.5f;
+	return true;
+}
+
+//! Every vertex must hold what the function returns for its position.
+bool
+mesh_matches(struct xrt_hmd_parts *hmd)
+{
+	uint32_t floats = hmd->distortion.mesh.stride / sizeof(float);
+	for (uint32_t i = 0; i < hmd->distortion.mesh.vertex_count; i++) {
+		const float *vert = hmd->distortion.mesh.vertices + i * floats;
+		uint32_t view = i < hmd->distortion.mesh.vertex_count / 2 ? 0 : 1;
+
+		struct xrt_uv_triplet expected = {};
+		barrel(nullptr, view, (vert[0] + 1.0f) * 0.5f, (vert[1] + 1.0f) * 0.5f, &expected);
+		if (std::fabs(vert[2] - expected.r.x) > 1e-5f || std::fabs(vert[5] - expected.g.y) > 1e-5f ||
+		    std::fabs(vert[7] - expected.b.y) > 1e-5f) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void
+free_mesh(struct xrt_hmd_parts *hmd)
+{
+	free(hmd->distortion.mesh.vertices);
+	free(hmd->distortion.mesh.indices);
+	hmd->distortion.mesh.vertices = nullptr;
+	hmd->distortion.mesh.indices = nullptr;
+}
+
+} // namespace
+
+
+TEST_CASE("u_distortion_mesh_compute_and_cache")
+{
+	char dir[] = "/tmp/monado-mesh-XXXXXX";
+	REQUIRE(mkdtemp(dir) != nullptr);
+	setenv("XDG_CACHE_HOME", dir, 1);
+
+	struct xrt_hmd_parts hmd = {};
+	struct xrt_device xdev = {};
+	snprintf(xdev.str, sizeof(xdev.str), "Test HMD");
+	xdev.hmd = &hmd;
+	xdev.compute_distortion = barrel;
+
+	// First run computes every vertex.
+	g_calls = 0;
+	u_distortion_mesh_fill_in_compute(&xdev);
+	REQUIRE(hmd.distortion.mesh.vertices != nullptr);
+	CHECK((hmd.distortion.models & XRT_DISTORTION_MODEL_MESHUV) != 0);
+	uint32_t vertex_count = hmd.distortion.mesh.vertex_count;
+	CHECK(g_calls > vertex_count);
+	CHECK(mesh_matches(&hmd));
+	free_mesh(&hmd);
+
+	// Second run only probes the function for the key.
+	g_calls = 0;
+	u_distortion_mesh_fill_in_compute(&xdev);
+	REQUIRE(hmd.distortion.mesh.vertices != nullptr);
+	CHECK(hmd.distortion.mesh.vertex_count == vertex_count);
+	CHECK(g_calls < vertex_count);
+	CHECK(mesh_matches(&hmd));
+	free_mesh(&hmd);
+
+	// Different parameters, different key.
+	g_strength = 0.3f;
+	g_calls = 0;
+	u_distortion_mesh_fill_in_compute(&xdev);
+	CHECK(g_calls > vertex_count);
+	CHECK(mesh_matches(&hmd));
+	free_mesh(&hmd);
+
+	std::string cmd = std::string("rm -rf ") + dir;
+	CHECK(system(cmd.c_str()) == 0);
+	unsetenv("XDG_CACHE_HOME");
+}
+
+TEST_CASE("u_distortion_images_bake_and_cache")
+{
+	char dir[] = "/tmp/monado-images-XXXXXX";
+	REQUIRE(mkdtemp(dir) != nullptr);
+	setenv("XDG_CACHE_HOME", dir, 1);
+
+	struct xrt_hmd_parts hmd = {};
+	struct xrt_device xdev = {};
+	snprintf(xdev.str, sizeof(xdev.str), "Test HMD");
+	xdev.hmd = &hmd;
+	xdev.compute_distortion = barrel;
+	for (auto &view : hmd.views) {
+		view.rot.v[0] = 1.0f;
+		view.rot.v[3] = 1.0f;
+	}
+
+	constexpr uint32_t dim = 32;
+	std::vector<xrt_vec2> r(dim * dim), g(dim * dim), b(dim * dim);
+
+	// Baked the first time, every texel matches the function.
+	CHECK_FALSE(u_distortion_images_bake(&xdev, 1, false, dim, r.data(), g.data(), b.data()));
+
+	bool same = true;
+	for (uint32_t row = 0; row < dim; row++) {
+		for (uint32_t col = 0; col < dim; col++) {
+			struct xrt_uv_triplet expected = {};
+			barrel(nullptr, 1, (float)col / (dim - 1), (float)row / (dim - 1), &expected);
+			const xrt_vec2 &texel = g[row * dim + col];
+			same = same && std::fabs(texel.x - expected.g.x) < 1e-5f && std::fabs(texel.y - expected.g.y) < 1e-5f;
+		}
+	}
+	CHECK(same);
+
+	// Loaded the second time, but not for the other rotation.
+	std::vector<xrt_vec2> r2(dim * dim), g2(dim * dim), b2(dim * dim);
+	CHECK(u_distortion_images_bake(&xdev, 1, false, dim, r2.data(), g2.data(), b2.data()));
+	CHECK(memcmp(b.data(), b2.data(), b.size() * sizeof(xrt_vec2)) == 0);
+	CHECK_FALSE(u_distortion_images_bake(&xdev, 1, true, dim, r2.data(), g2.data(), b2.data()));
+
+	std::string cmd = std::string("rm -rf ") + dir;
+	CHECK(system(cmd.c_str()) == 0);
+	unsetenv("XDG_CACHE_HOME");
+}
+
+TEST_CASE("u_distortion_cache_evicts_least_recently_used")
+{
+	char dir[] = "/tmp/monado-evict-XXXXXX";
+	REQUIRE(mkdtemp(dir) != nullptr);
+	setenv("XDG_CACHE_HOME", dir, 1);
+
+	struct xrt_hmd_parts hmd = {};
+	struct xrt_device xdev = {};
+	snprintf(xdev.str, sizeof(xdev.str), "Test HMD");
+	xdev.hmd = &hmd;
+	xdev.compute_distortion = barrel;
+	for (auto &view : hmd.views) {
+		view.rot.v[0] = 1.0f;
+		view.rot.v[3] = 1.0f;
+	}
+
+	// Room for two sets of 32x32 images, each is a little over 24 KiB.
+	setenv("XRT_MESH_CACHE_MAX_KB", "60", 1);
+
+	constexpr uint32_t dim = 32;
+	std::vector<xrt_vec2> r(dim * dim), g(dim * dim), b(dim * dim);
+
+	CHECK_FALSE(u_distortion_images_bake(&xdev, 0, false, dim, r.data(), g.data(), b.data()));
+	CHECK_FALSE(u_distortion_images_bake(&xdev, 1, false, dim, r.data(), g.data(), b.data()));
+
+	// Use the first one so the second one is the oldest.
+	usleep(10 * 1000);
+	CHECK(u_distortion_images_bake(&xdev, 0, false, dim, r.data(), g.data(), b.data()));
+	usleep(10 * 1000);
+	CHECK_FALSE(u_distortion_images_bake(&xdev, 0, true, dim, r.data(), g.data(), b.data()));
+
+	CHECK(u_distortion_images_bake(&xdev, 0, false, dim, r.data(), g.data(), b.data()));
+	CHECK(u_distortion_images_bake(&xdev, 0, true, dim, r.data(), g.data(), b.data()));
+	CHECK_FALSE(u_distortion_images_bake(&xdev, 1, false, dim, r.data(), g.data(), b.data()));
+
+	unsetenv("XRT_MESH_CACHE_MAX_KB");
+
+	std::string cmd = std::string("rm -rf ") + dir;
+	CHECK(system(cmd.c_str()) == 0);
+	unsetenv("XDG_CACHE_HOME");
+}
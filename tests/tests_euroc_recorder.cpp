@@ -0,0 +1,232 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief EuRoC recorder tests and encoder benchmark.
+ */
+
+#include <tracking/t_euroc_recorder.h>
+#include <os/os_time.h>
+#include <util/u_frame.h>
+#include <util/u_time.h>
+
+#include "catch/catch.hpp"
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+
+namespace fs = std::filesystem;
+
+namespace {
+
+//! Fresh directory that is removed again when going out of scope.
+struct TempDir
+{
+	fs::path path;
+
+	explicit TempDir(const char *name)
+	{
+		path = fs::temp_directory_path() / (std::string(name) + "_" + std::to_string(getpid()));
+		fs::remove_all(path);
+		fs::create_directories(path);
+	}
+
+	~TempDir()
+	{
+		fs::remove_all(path);
+	}
+};
+
+//! Grayscale frame with some structure so compression has work to do.
+struct xrt_frame *
+make_frame(uint32_t width, uint32_t height, uint64_t timestamp)
+{
+	struct xrt_frame *xf = NULL;
+	u_frame_create_one_off(XRT_FORMAT_L8, width, height, &xf);
+	xf->timestamp = timestamp;
+
+	uint32_t state = (uint32_t)timestamp | 1;
+	for (uint32_t y = 0; y < height; y++) {
+		uint8_t *row = xf->data + y * xf->stride;
+		for (uint32_t x = 0; x < width; x++) {
+			state = state * 1664525u + 1013904223u;
+			row[x] = (uint8_t)((x + y) / 4 + (state >> 28));
+		}
+	}
+
+	return xf;
+}
+
+//! The recorder adds a datetime suffix to the path, find the dataset directory.
+fs::path
+find_dataset(const fs::path &parent)
+{
+	for (const auto &entry : fs::directory_iterator(parent)) {
+		if (entry.is_directory()) {
+			return entry.path();
+		}
+	}
+	return {};
+}
+
+size_t
+count_images(const fs::path &dataset, int cam_count)
+{
+	size_t count = 0;
+	for (int i = 0; i < cam_count; i++) {
+		fs::path data = dataset / "mav0" / ("cam" + std::to_string(i)) / "data";
+		if (!fs::exists(data)) {
+			continue;
+		}
+		for (const auto &entry : fs::directory_iterator(data)) {
+			(void)entry;
+			count++;
+		}
+	}
+	return count;
+}
+
+//! Waits until all images are on disk, the sinks drop queued frames when destroyed.
+bool
+wait_for_images(const fs::path &parent, int cam_count, size_t expected, std::chrono::seconds timeout)
+{
+	auto end = std::chrono::steady_clock::now() + timeout;
+	while (std::chrono::steady_clock::now() < end) {
+		fs::path dataset = find_dataset(parent);
+		if (!dataset.empty() && count_images(dataset, cam_count) >= expected) {
+			return true;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	return false;
+}
+
+} // namespace
+
+
+TEST_CASE("euroc_recorder")
+{
+	TempDir dir("monado_euroc_recorder_test");
+
+	constexpr int kCams = 2;
+	constexpr int kFrames = 20;
+
+	struct xrt_frame_context xfctx = {};
+	std::string prefix = (dir.path / "rec").string();
+	struct xrt_slam_sinks *sinks = euroc_recorder_create(&xfctx, prefix.c_str(), kCams, true);
+	REQUIRE(sinks != nullptr);
+
+	for (int f = 0; f < kFrames; f++) {
+		for (int c = 0; c < kCams; c++) {
+			struct xrt_frame *xf = make_frame(64, 48, 1000 + f);
+			xrt_sink_push_frame(sinks->cams[c], xf);
+			xrt_frame_reference(&xf, NULL);
+		}
+	}
+
+	CHECK(wait_for_images(dir.path, kCams, kCams * kFrames, std::chrono::seconds(30)));
+
+	// Waits for the encoders to finish.
+	xrt_frame_context_destroy_nodes(&xfctx);
+
+	fs::path dataset = find_dataset(dir.path);
+	REQUIRE(!dataset.empty());
+	CHECK(count_images(dataset, kCams) == kCams * kFrames);
+
+	for (int c = 0; c < kCams; c++) {
+		std::ifstream csv(dataset / "mav0" / ("cam" + std::to_string(c)) / "data.csv");
+		int lines = 0;
+		std::string line;
+		while (std::getline(csv, line)) {
+			lines++;
+		}
+		CHECK(lines == kFrames + 1); // Plus the header.
+	}
+}
+
+
+/*
+ *
+ * Benchmark, run with: tests_euroc_recorder "[benchmark]"
+ *
+ */
+
+TEST_CASE("euroc_recorder_throughput", "[.][benchmark]")
+{
+	constexpr int kCams = 4;
+	constexpr int kRateHz = 60;
+	constexpr int kFrames = 2 * kRateHz;
+	constexpr uint32_t kWidth = 640;
+	constexpr uint32_t kHeight = 480;
+	constexpr uint64_t kPeriodNs = U_TIME_1S_IN_NS / kRateHz;
+
+	// Reference: what the writer sink used to do for every frame.
+	{
+		TempDir dir("monado_euroc_recorder_bench_sync");
+		struct xrt_frame *xf = make_frame(kWidth, kHeight, 1);
+		cv::Mat img{(int)kHeight, (int)kWidth, CV_8UC1, xf->data, xf->stride};
+
+		constexpr int kSamples = 20;
+		uint64_t start_ns = os_monotonic_get_ns();
+		for (int i = 0; i < kSamples; i++) {
+			cv::imwrite((dir.path / (std::to_string(i) + ".png")).string(), img);
+		}
+		uint64_t per_frame_ns = (os_monotonic_get_ns() - start_ns) / kSamples;
+		xrt_frame_reference(&xf, NULL);
+
+		std::cout << "synchronous imwrite: " << per_frame_ns / 1000 << "us per frame, budget for " << kCams
+		          << " cameras at " << kRateHz << "Hz is " << kPeriodNs / kCams / 1000 << "us per frame"
+		          << std::endl;
+	}
+
+	TempDir dir("monado_euroc_recorder_bench");
+	struct xrt_frame_context xfctx = {};
+	std::string prefix = (dir.path / "rec").string();
+	struct xrt_slam_sinks *sinks = euroc_recorder_create(&xfctx, prefix.c_str(), kCams, true);
+
+	// Pre-generate the frames so the benchmark only measures the recorder.
+	std::vector<struct xrt_frame *> frames;
+	for (int f = 0; f < kFrames; f++) {
+		frames.push_back(make_frame(kWidth, kHeight, (uint64_t)(f + 1) * kPeriodNs));
+	}
+
+	// Push at the camera rate, like a real device would.
+	uint64_t start_ns = os_monotonic_get_ns();
+	for (int f = 0; f < kFrames; f++) {
+		for (int c = 0; c < kCams; c++) {
+			xrt_sink_push_frame(sinks->cams[c], frames[f]);
+		}
+
+		uint64_t next_ns = start_ns + (uint64_t)(f + 1) * kPeriodNs;
+		uint64_t now_ns = os_monotonic_get_ns();
+		if (now_ns < next_ns) {
+			os_nanosleep((int64_t)(next_ns - now_ns));
+		}
+	}
+	uint64_t pushed_ns = os_monotonic_get_ns();
+
+	bool done = wait_for_images(dir.path, kCams, kCams * kFrames, std::chrono::seconds(120));
+	xrt_frame_context_destroy_nodes(&xfctx);
+	uint64_t done_ns = os_monotonic_get_ns();
+
+	for (struct xrt_frame *xf : frames) {
+		xrt_frame_reference(&xf, NULL);
+	}
+
+	CHECK(done);
+
+	double capture_s = (double)(pushed_ns - start_ns) / U_TIME_1S_IN_NS;
+	double lag_ms = (double)(done_ns - pushed_ns) / U_TIME_1MS_IN_NS;
+	std::cout << "recorder: " << kCams << " cameras " << kWidth << "x" << kHeight << " at " << kRateHz << "Hz, "
+	          << kCams * kFrames << " frames captured in " << capture_s << "s, finished writing " << lag_ms
+	          << "ms after the last frame" << std::endl;
+}
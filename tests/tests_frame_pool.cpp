@@ -0,0 +1,144 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Frame pool tests.
+ */
+
+#include <util/u_frame.h>
+#include <util/u_frame_pool.h>
+
+#include "catch/catch.hpp"
+
+#include <chrono>
+#include <iostream>
+
+
+TEST_CASE("u_frame_pool_reuse")
+{
+	struct u_frame_pool *pool = u_frame_pool_create(XRT_FORMAT_L8, 64, 48, 2, "Test pool");
+	REQUIRE(pool != nullptr);
+
+	struct xrt_frame *a = nullptr;
+	u_frame_pool_get(pool, &a);
+	REQUIRE(a != nullptr);
+	CHECK(a->format == XRT_FORMAT_L8);
+	CHECK(a->width == 64);
+	CHECK(a->height == 48);
+	CHECK(a->stride == 64);
+	CHECK(a->size == 64 * 48);
+	REQUIRE(a->data != nullptr);
+
+	// Metadata must not leak from one user of the frame to the next.
+	a->timestamp = 1234;
+	a->source_sequence = 42;
+	uint8_t *data = a->data;
+
+	xrt_frame_reference(&a, nullptr);
+	CHECK(a == nullptr);
+
+	struct xrt_frame *b = nullptr;
+	u_frame_pool_get(pool, &b);
+	CHECK(b->data == data);
+	CHECK(b->timestamp == 0);
+	CHECK(b->source_sequence == 0);
+	CHECK(b->reference.count == 1);
+
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	u_frame_pool_get_stats(pool, &hits, &misses);
+	CHECK(hits == 1);
+	CHECK(misses == 1);
+
+	xrt_frame_reference(&b, nullptr);
+	u_frame_pool_destroy(&pool);
+	CHECK(pool == nullptr);
+}
+
+TEST_CASE("u_frame_pool_max_free")
+{
+	struct u_frame_pool *pool = u_frame_pool_create(XRT_FORMAT_R8G8B8, 16, 16, 2, "Test pool");
+
+	struct xrt_frame *frames[4] = {};
+	for (auto &f : frames) {
+		u_frame_pool_get(pool, &f);
+	}
+	for (auto &f : frames) {
+		xrt_frame_reference(&f, nullptr);
+	}
+
+	// Only two were kept, the other two have to be allocated again.
+	for (auto &f : frames) {
+		u_frame_pool_get(pool, &f);
+	}
+
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	u_frame_pool_get_stats(pool, &hits, &misses);
+	CHECK(hits == 2);
+	CHECK(misses == 6);
+
+	for (auto &f : frames) {
+		xrt_frame_reference(&f, nullptr);
+	}
+	u_frame_pool_destroy(&pool);
+}
+
+TEST_CASE("u_frame_pool_outlives_owner")
+{
+	struct u_frame_pool *pool = u_frame_pool_create(XRT_FORMAT_L8, 32, 32, 4, "Test pool");
+
+	struct xrt_frame *held = nullptr;
+	u_frame_pool_get(pool, &held);
+
+	// A ROI keeps a reference to the pooled frame, like the WMR camera does.
+	struct xrt_rect roi = {{0, 0}, {16, 16}};
+	struct xrt_frame *sub = nullptr;
+	u_frame_create_roi(held, roi, &sub);
+
+	u_frame_pool_destroy(&pool);
+
+	// Still usable after the owner is gone, released frames are freed.
+	held->data[0] = 0xff;
+	CHECK(sub->data[0] == 0xff);
+	xrt_frame_reference(&held, nullptr);
+	xrt_frame_reference(&sub, nullptr);
+}
+
+
+/*
+ *
+ * Benchmark, run with: tests_frame_pool "[benchmark]"
+ *
+ */
+
+TEST_CASE("u_frame_pool_vs_one_off", "[.][benchmark]")
+{
+	using clock = std::chrono::steady_clock;
+	constexpr int kIterations = 2000;
+	// Size of a WMR G1 frame, two cameras side by side plus the metadata line.
+	constexpr uint32_t kWidth = 1280;
+	constexpr uint32_t kHeight = 481;
+
+	auto start = clock::now();
+	for (int i = 0; i < kIterations; i++) {
+		struct xrt_frame *xf = nullptr;
+		u_frame_create_one_off(XRT_FORMAT_L8, kWidth, kHeight, &xf);
+		xf->data[i % xf->size] = (uint8_t)i;
+		xrt_frame_reference(&xf, nullptr);
+	}
+	auto one_off = std::chrono::duration<double, std::micro>(clock::now() - start).count() / kIterations;
+
+	struct u_frame_pool *pool = u_frame_pool_create(XRT_FORMAT_L8, kWidth, kHeight, 4, "Benchmark pool");
+	start = clock::now();
+	for (int i = 0; i < kIterations; i++) {
+		struct xrt_frame *xf = nullptr;
+		u_frame_pool_get(pool, &xf);
+		xf->data[i % xf->size] = (uint8_t)i;
+		xrt_frame_reference(&xf, nullptr);
+	}
+	auto pooled = std::chrono::duration<double, std::micro>(clock::now() - start).count() / kIterations;
+	u_frame_pool_destroy(&pool);
+
+	std::cout << "one-off: " << one_off << "us/frame, pooled: " << pooled << "us/frame" << std::endl;
+}
@@ -0,0 +1,247 @@
+// Copyright 2026, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Asynchronous hand tracking wrapper tests.
+ */
+
+#include <util/u_frame.h>
+#include <tracking/t_hand_tracking.h>
+
+#include "catch/catch.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+
+namespace {
+
+/*!
+ * Sync tracker that records which slots and frames it is given. Its optimize
+ * stage is held until released, so the test can push frames while a frame is
+ * being optimised.
+ */
+struct FakeTracker
+{
+	struct t_hand_tracking_sync base = {};
+
+	std::mutex mutex;
+	std::condition_variable cv;
+
+	uint64_t slot_timestamps[2] = {};
+
+	std::vector<uint32_t> inferred_slots;
+	std::vector<uint64_t> inferred_timestamps;
+	std::vector<uint32_t> optimized_slots;
+	std::vector<uint64_t> optimized_timestamps;
+
+	bool optimizing = false;
+	bool released = true;
+
+	explicit FakeTracker(bool split)
+	{
+		base.process = process;
+		base.destroy = destroy;
+		if (split) {
+			base.infer = infer;
+			base.optimize = optimize;
+			base.pipeline_depth = 2;
+		}
+	}
+
+	static FakeTracker *
+	from(struct t_hand_tracking_sync *ht_sync)
+	{
+		return reinterpret_cast<FakeTracker *>(ht_sync);
+	}
+
+	static void
+	fill_hands(uint64_t timestamp,
+	           struct xrt_hand_joint_set *out_left_hand,
+	           struct xrt_hand_joint_set *out_right_hand,
+	           uint64_t *out_timestamp_ns)
+	{
+		*out_left_hand = {};
+		*out_right_hand = {};
+		out_left_hand->is_active = true;
+		out_right_hand->is_active = true;
+		*out_timestamp_ns = timestamp;
+	}
+
+	static void
+	process(struct t_hand_tracking_sync *ht_sync,
+	        struct xrt_frame *left_frame,
+	        struct xrt_frame *right_frame,
+	        struct xrt_hand_joint_set *out_left_hand,
+	        struct xrt_hand_joint_set *out_right_hand,
+	        uint64_t *out_timestamp_ns)
+	{
+		FakeTracker *self = from(ht_sync);
+		std::unique_lock<std::mutex> lock(self->mutex);
+		self->optimized_timestamps.push_back(left_frame->timestamp);
+		fill_hands(left_frame->timestamp, out_left_hand, out_right_hand, out_timestamp_ns);
+		self->cv.notify_all();
+	}
+
+	static void
+	infer(struct t_hand_tracking_sync *ht_sync,
+	      uint32_t slot,
+	      struct xrt_frame *left_frame,
+	      struct xrt_frame *right_frame)
+	{
+		FakeTracker *self = from(ht_sync);
+		std::unique_lock<std::mutex> lock(self->mutex);
+		self->slot_timestamps[slot] = left_frame->timestamp;
+		self->inferred_slots.push_back(slot);
+		self->inferred_timestamps.push_back(left_frame->timestamp);
+		self->cv.notify_all();
+	}
+
+	static void
+	optimize(struct t_hand_tracking_sync *ht_sync,
+	         uint32_t slot,
+	         struct xrt_hand_joint_set *out_left_hand,
+	         struct xrt_hand_joint_set *out_right_hand,
+	         uint64_t *out_timestamp_ns)
+	{
+		FakeTracker *self = from(ht_sync);
+		std::unique_lock<std::mutex> lock(self->mutex);
+		self->optimizing = true;
+		self->cv.notify_all();
+		self->cv.wait(lock, [&] { return self->released; });
+
+		self->optimizing = false;
+		self->optimized_slots.push_back(slot);
+		self->optimized_timestamps.push_back(self->slot_timestamps[slot]);
+		fill_hands(self->slot_timestamps[slot], out_left_hand, out_right_hand, out_timestamp_ns);
+		self->cv.notify_all();
+	}
+
+	static void
+	destroy(struct t_hand_tracking_sync *ht_sync)
+	{
+		// Owned by the test.
+	}
+
+	void
+	hold()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		released = false;
+	}
+
+	void
+	release()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		released = true;
+		cv.notify_all();
+	}
+
+	void
+	wait_inferred(size_t count)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		cv.wait(lock, [&] { return inferred_timestamps.size() >= count; });
+	}
+
+	void
+	wait_optimizing()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		cv.wait(lock, [&] { return optimizing; });
+	}
+
+	void
+	wait_optimized(size_t count)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		cv.wait(lock, [&] { return optimized_timestamps.size() >= count; });
+	}
+};
+
+void
+push_pair(struct t_hand_tracking_async *hta, uint64_t timestamp)
+{
+	struct xrt_frame *frames[2] = {};
+	for (int i = 0; i < 2; i++) {
+		u_frame_create_one_off(XRT_FORMAT_L8, 4, 4, &frames[i]);
+		frames[i]->timestamp = timestamp;
+	}
+
+	xrt_sink_push_frame(&hta->left, frames[0]);
+	xrt_sink_push_frame(&hta->right, frames[1]);
+
+	xrt_frame_reference(&frames[0], NULL);
+	xrt_frame_reference(&frames[1], NULL);
+}
+
+bool
+hand_is_active(struct t_hand_tracking_async *hta, enum xrt_input_name name)
+{
+	struct xrt_hand_joint_set hand = {};
+	uint64_t timestamp_ns = 0;
+	hta->get_hand(hta, name, 1000, &hand, &timestamp_ns);
+	return hand.is_active;
+}
+
+} // namespace
+
+
+TEST_CASE("t_hand_tracking_async_unsplit")
+{
+	struct xrt_frame_context xfctx = {};
+	FakeTracker tracker(false);
+
+	struct t_hand_tracking_async *hta = t_hand_tracking_async_default_create(&xfctx, &tracker.base);
+	REQUIRE(hta != NULL);
+
+	CHECK_FALSE(hand_is_active(hta, XRT_INPUT_GENERIC_HAND_TRACKING_LEFT));
+
+	push_pair(hta, 100);
+	tracker.wait_optimized(1);
+
+	CHECK(tracker.inferred_timestamps.empty());
+	CHECK(tracker.optimized_timestamps == std::vector<uint64_t>{100});
+
+	xrt_frame_context_destroy_nodes(&xfctx);
+}
+
+TEST_CASE("t_hand_tracking_async_pipelined")
+{
+	struct xrt_frame_context xfctx = {};
+	FakeTracker tracker(true);
+
+	struct t_hand_tracking_async *hta = t_hand_tracking_async_default_create(&xfctx, &tracker.base);
+	REQUIRE(hta != NULL);
+
+	// Hold the first frame in the optimizer.
+	tracker.hold();
+	push_pair(hta, 100);
+	tracker.wait_optimizing();
+
+	// The next frame is inferred while the first one is optimised.
+	push_pair(hta, 200);
+	tracker.wait_inferred(2);
+
+	// Two frames in flight, the pipeline is full and this one is dropped.
+	push_pair(hta, 300);
+
+	tracker.release();
+	tracker.wait_optimized(2);
+
+	// Room again, the first slot is reused.
+	push_pair(hta, 400);
+	tracker.wait_optimized(3);
+
+	CHECK(tracker.inferred_slots == std::vector<uint32_t>{0, 1, 0});
+	CHECK(tracker.optimized_slots == std::vector<uint32_t>{0, 1, 0});
+	CHECK(tracker.inferred_timestamps == std::vector<uint64_t>{100, 200, 400});
+	CHECK(tracker.optimized_timestamps == std::vector<uint64_t>{100, 200, 400});
+
+	CHECK(hand_is_active(hta, XRT_INPUT_GENERIC_HAND_TRACKING_LEFT));
+	CHECK(hand_is_active(hta, XRT_INPUT_GENERIC_HAND_TRACKING_RIGHT));
+
+	xrt_frame_context_destroy_nodes(&xfctx);
+}
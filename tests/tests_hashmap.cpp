@@ -0,0 +1,295 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Hashmap and hashset tests, and a path interning benchmark.
+ */
+
+#include <util/u_misc.h>
+#include <util/u_hashmap.h>
+#include <util/u_hashset.h>
+#include <os/os_time.h>
+
+extern "C" {
+#include "bindings/b_generated_bindings.h"
+}
+
+#include "catch/catch.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace {
+
+void
+free_item(struct u_hashset_item *item, void *priv)
+{
+	(*(int *)priv)++;
+	free(item);
+}
+
+void
+count_item(void *item, void *priv)
+{
+	(*(int *)priv)++;
+}
+
+} // namespace
+
+
+TEST_CASE("u_hashmap_int_matches_unordered_map")
+{
+	struct u_hashmap_int *hmi = nullptr;
+	REQUIRE(u_hashmap_int_create(&hmi) == 0);
+	CHECK(u_hashmap_int_empty(hmi));
+
+	// Random inserts, overwrites and erases, small key range for collisions.
+	std::unordered_map<uint64_t, void *> reference;
+	std::mt19937_64 rng(3);
+	bool same = true;
+	for (int i = 0; i < 20000; i++) {
+		uint64_t key = rng() % 2048;
+		switch (rng() % 3) {
+		case 0:
+		case 1: {
+			void *value = (void *)(intptr_t)(rng() | 1);
+			u_hashmap_int_insert(hmi, key, value);
+			reference[key] = value;
+		} break;
+		case 2:
+			u_hashmap_int_erase(hmi, key);
+			reference.erase(key);
+			break;
+		}
+
+		uint64_t probe = rng() % 2048;
+		void *found = nullptr;
+		int ret = u_hashmap_int_find(hmi, probe, &found);
+		auto it = reference.find(probe);
+		same = same && (it == reference.end() ? ret < 0 : (ret == 0 && found == it->second));
+	}
+	CHECK(same);
+
+	// Every entry once.
+	size_t visited = 0;
+	u_hashmap_int_for_each(
+	    hmi, [](uint64_t key, const void *value, void *priv) { (*(size_t *)priv)++; }, &visited);
+	CHECK(visited == reference.size());
+
+	int cleared = 0;
+	u_hashmap_int_clear_and_call_for_each(hmi, count_item, &cleared);
+	CHECK((size_t)cleared == reference.size());
+	CHECK(u_hashmap_int_empty(hmi));
+
+	u_hashmap_int_destroy(&hmi);
+	CHECK(hmi == nullptr);
+}
+
+TEST_CASE("u_hashset_strings")
+{
+	struct u_hashset *hs = nullptr;
+	REQUIRE(u_hashset_create(&hs) == 0);
+
+	// Prefixes of each other and the empty string.
+	const char *strs[] = {"", "/user", "/user/hand", "/user/hand/left", "/user/hand/right", "/user/head"};
+	struct u_hashset_item *items[ARRAY_SIZE(strs)] = {};
+	for (size_t i = 0; i < ARRAY_SIZE(strs); i++) {
+		REQUIRE(u_hashset_create_and_insert_str_c(hs, strs[i], &items[i]) == 0);
+	}
+
+	// Already there.
+	struct u_hashset_item *dup = nullptr;
+	CHECK(u_hashset_create_and_insert_str_c(hs, "/user/hand", &dup) < 0);
+
+	bool same = true;
+	for (size_t i = 0; i < ARRAY_SIZE(strs); i++) {
+		struct u_hashset_item *found = nullptr;
+		same = same && u_hashset_find_c_str(hs, strs[i], &found) == 0 && found == items[i];
+		same = same && strcmp(found->c_str(), strs[i]) == 0;
+	}
+	CHECK(same);
+
+	// Not null terminated lookup.
+	struct u_hashset_item *found = nullptr;
+	CHECK(u_hashset_find_str(hs, "/user/hand/left/input", 15, &found) == 0);
+	CHECK(found == items[3]);
+	CHECK(u_hashset_find_c_str(hs, "/user/hand/le", &found) < 0);
+
+	u_hashset_erase_item(hs, items[2]);
+	free(items[2]);
+	CHECK(u_hashset_find_c_str(hs, "/user/hand", &found) < 0);
+	CHECK(u_hashset_find_c_str(hs, "/user/hand/right", &found) == 0);
+
+	int freed = 0;
+	u_hashset_clear_and_call_for_each(hs, free_item, &freed);
+	CHECK(freed == (int)ARRAY_SIZE(strs) - 1);
+	CHECK(u_hashset_find_c_str(hs, "/user", &found) < 0);
+
+	u_hashset_destroy(&hs);
+}
+
+
+/*
+ *
+ * Benchmark, run with: tests_hashmap "[benchmark]"
+ *
+ */
+
+namespace {
+
+/*!
+ * All of the paths an app suggesting bindings for every profile would intern,
+ * profile paths, subaction paths and each binding path with the subaction.
+ */
+std::vector<std::string>
+all_binding_paths()
+{
+	std::vector<std::string> paths;
+	for (const struct profile_template &profile : profile_templates) {
+		paths.push_back(profile.path);
+		for (size_t i = 0; i < profile.binding_count; i++) {
+			const struct binding_template &binding = profile.bindings[i];
+			if (binding.subaction_path != nullptr) {
+				paths.push_back(binding.subaction_path);
+			}
+			for (const char *path : binding.paths) {
+				if (path != nullptr) {
+					paths.push_back(path);
+				}
+			}
+		}
+	}
+	return paths;
+}
+
+template <typename F>
+double
+time_ns_per_op(size_t count, int iterations, F &&f)
+{
+	uint64_t start = os_monotonic_get_ns();
+	for (int i = 0; i < iterations; i++) {
+		f();
+	}
+	return (double)(os_monotonic_get_ns() - start) / ((double)count * iterations);
+}
+
+} // namespace
+
+TEST_CASE("u_hashset_path_intern_benchmark", "[.][benchmark]")
+{
+	std::vector<std::string> paths = all_binding_paths();
+	const int iterations = 200;
+
+	// Intern, like xrStringToPath, every path is looked up and created if missing.
+	double intern = time_ns_per_op(paths.size(), iterations, [&] {
+		struct u_hashset *hs = nullptr;
+		u_hashset_create(&hs);
+		for (const std::string &path : paths) {
+			struct u_hashset_item *item = nullptr;
+			if (u_hashset_find_str(hs, path.c_str(), path.size(), &item) != 0) {
+				u_hashset_create_and_insert_str(hs, path.c_str(), path.size(), &item);
+			}
+		}
+		int freed = 0;
+		u_hashset_clear_and_call_for_each(hs, free_item, &freed);
+		u_hashset_destroy(&hs);
+	});
+
+	// The node based map this replaced, with a string made for each call.
+	double intern_std = time_ns_per_op(paths.size(), iterations, [&] {
+		std::unordered_map<std::string, struct u_hashset_item *> map;
+		for (const std::string &path : paths) {
+			std::string key(path.c_str(), path.size());
+			if (map.find(key) == map.end()) {
+				auto *item = U_CALLOC_WITH_CAST(struct u_hashset_item, sizeof(u_hashset_item) + key.size() + 1);
+				map[std::string(path.c_str(), path.size())] = item;
+			}
+		}
+		for (auto &n : map) {
+			free(n.second);
+		}
+	});
+
+	// Lookups of already interned paths.
+	struct u_hashset *hs = nullptr;
+	u_hashset_create(&hs);
+	std::unordered_map<std::string, struct u_hashset_item *> map;
+	for (const std::string &path : paths) {
+		struct u_hashset_item *item = nullptr;
+		if (u_hashset_create_and_insert_str(hs, path.c_str(), path.size(), &item) == 0) {
+			map[path] = item;
+		}
+	}
+
+	size_t hits = 0;
+	double lookup = time_ns_per_op(paths.size(), iterations * 5, [&] {
+		for (const std::string &path : paths) {
+			struct u_hashset_item *item = nullptr;
+			hits += u_hashset_find_str(hs, path.c_str(), path.size(), &item) == 0;
+		}
+	});
+	double lookup_std = time_ns_per_op(paths.size(), iterations * 5, [&] {
+		for (const std::string &path : paths) {
+			hits += map.find(std::string(path.c_str(), path.size())) != map.end();
+		}
+	});
+
+	std::cout << paths.size() << " paths (" << map.size() << " unique) of " << ARRAY_SIZE(profile_templates)
+	          << " profiles" << std::endl;
+	std::cout << "intern: flat " << intern << "ns, std " << intern_std << "ns" << std::endl;
+	std::cout << "lookup: flat " << lookup << "ns, std " << lookup_std << "ns (" << hits << " hits)" << std::endl;
+
+	int freed = 0;
+	u_hashset_clear_and_call_for_each(hs, free_item, &freed);
+	u_hashset_destroy(&hs);
+}
+
+TEST_CASE("u_hashmap_int_benchmark", "[.][benchmark]")
+{
+	// Pointer like keys, like the device to space map, used in random order.
+	const size_t count = 4096;
+	std::vector<uint64_t> keys(count);
+	for (size_t i = 0; i < count; i++) {
+		keys[i] = 0x7f0000001000ULL + i * 64;
+	}
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(4));
+
+	struct u_hashmap_int *hmi = nullptr;
+	u_hashmap_int_create(&hmi);
+	std::unordered_map<uint64_t, void *> map;
+
+	double insert = time_ns_per_op(count, 100, [&] {
+		for (uint64_t key : keys) {
+			u_hashmap_int_insert(hmi, key, &keys);
+		}
+	});
+	double insert_std = time_ns_per_op(count, 100, [&] {
+		for (uint64_t key : keys) {
+			map[key] = &keys;
+		}
+	});
+
+	size_t hits = 0;
+	double find = time_ns_per_op(count, 1000, [&] {
+		for (uint64_t key : keys) {
+			void *ptr = nullptr;
+			hits += u_hashmap_int_find(hmi, key, &ptr) == 0;
+		}
+	});
+	double find_std = time_ns_per_op(count, 1000, [&] {
+		for (uint64_t key : keys) {
+			hits += map.find(key) != map.end();
+		}
+	});
+
+	std::cout << "insert: flat " << insert << "ns, std " << insert_std << "ns" << std::endl;
+	std::cout << "find:   flat " << find << "ns, std " << find_std << "ns (" << hits << " hits)" << std::endl;
+
+	u_hashmap_int_destroy(&hmi);
+}
@@ -0,0 +1,205 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief HSV filter exactness tests and benchmark.
+ */
+
+#include <tracking/t_tracking.h>
+#include <util/u_frame.h>
+#include <util/u_format.h>
+#include <os/os_time.h>
+
+#include "catch/catch.hpp"
+
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+
+namespace {
+
+//! Keeps a copy of the last L8 frame pushed to it.
+struct CaptureSink
+{
+	struct xrt_frame_sink base = {};
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> pixels;
+
+	CaptureSink()
+	{
+		base.push_frame = push;
+	}
+
+	static void
+	push(struct xrt_frame_sink *xfs, struct xrt_frame *xf)
+	{
+		auto *self = reinterpret_cast<CaptureSink *>(xfs);
+		self->width = xf->width;
+		self->height = xf->height;
+
+		self->pixels.clear();
+		for (uint32_t y = 0; y < xf->height; y++) {
+			const uint8_t *row = xf->data + y * xf->stride;
+			self->pixels.insert(self->pixels.end(), row, row + xf->width);
+		}
+	}
+};
+
+struct xrt_frame *
+make_random_frame(enum xrt_format format, uint32_t width, uint32_t height, uint32_t seed)
+{
+	struct xrt_frame *xf = NULL;
+	u_frame_create_one_off(format, width, height, &xf);
+
+	std::mt19937 rng(seed);
+	for (size_t i = 0; i < xf->size; i++) {
+		xf->data[i] = (uint8_t)rng();
+	}
+	return xf;
+}
+
+//! The original per pixel loop, kept as the reference for the kernels.
+void
+reference_filter(struct t_hsv_filter_optimized_table *table,
+                 struct xrt_frame *xf,
+                 std::vector<uint8_t> (&planes)[4])
+{
+	for (auto &plane : planes) {
+		plane.assign((size_t)xf->width * xf->height, 0);
+	}
+
+	for (uint32_t y = 0; y < xf->height; y++) {
+		const uint8_t *src = xf->data + y * xf->stride;
+		for (uint32_t x = 0; x < xf->width; x++) {
+			uint8_t bits;
+			if (xf->format == XRT_FORMAT_YUV888) {
+				bits = t_hsv_filter_sample(table, src[x * 3 + 0], src[x * 3 + 1], src[x * 3 + 2]);
+			} else {
+				const uint8_t *pair = src + (x / 2) * 4;
+				bits = t_hsv_filter_sample(table, pair[(x % 2) * 2], pair[1], pair[3]);
+			}
+
+			size_t i = (size_t)y * xf->width + x;
+			for (int k = 0; k < 4; k++) {
+				planes[k][i] = (bits & (1 << k)) ? 0xff : 0x00;
+			}
+		}
+	}
+}
+
+struct Filter
+{
+	struct xrt_frame_context xfctx = {};
+	CaptureSink captures[4];
+	struct xrt_frame_sink *sink = nullptr;
+
+	explicit Filter(uint32_t workers, bool capture = true)
+	{
+		struct t_hsv_filter_params params = T_HSV_DEFAULT_PARAMS();
+		struct xrt_frame_sink *sinks[4] = {};
+		for (int k = 0; capture && k < 4; k++) {
+			sinks[k] = &captures[k].base;
+		}
+		t_hsv_filter_create(&xfctx, &params, sinks, &sink);
+		CHECK(t_hsv_filter_set_worker_count(sink, workers));
+	}
+
+	~Filter()
+	{
+		xrt_frame_context_destroy_nodes(&xfctx);
+	}
+};
+
+} // namespace
+
+
+TEST_CASE("t_hsv_filter_exact")
+{
+	struct t_hsv_filter_params params = T_HSV_DEFAULT_PARAMS();
+	auto table = std::make_unique<t_hsv_filter_optimized_table>();
+	t_hsv_build_optimized_table(&params, table.get());
+
+	// YUYV is always an even number of pixels wide, odd YUV widths cover the scalar tail.
+	const enum xrt_format formats[] = {XRT_FORMAT_YUV888, XRT_FORMAT_YUYV422};
+	const uint32_t widths[] = {2, 14, 16, 38, 640};
+	const uint32_t workers[] = {0, 3};
+
+	for (enum xrt_format format : formats) {
+		for (uint32_t width : widths) {
+			for (uint32_t w : workers) {
+				uint32_t width_fmt = format == XRT_FORMAT_YUV888 ? width + 1 : width;
+				uint32_t height = 97;
+				CAPTURE(u_format_str(format), width_fmt, w);
+
+				struct xrt_frame *xf = make_random_frame(format, width_fmt, height, width + w);
+				std::vector<uint8_t> expected[4];
+				reference_filter(table.get(), xf, expected);
+
+				Filter filter(w);
+				xrt_sink_push_frame(filter.sink, xf);
+
+				for (int k = 0; k < 4; k++) {
+					CHECK(filter.captures[k].width == width_fmt);
+					CHECK(filter.captures[k].height == height);
+					// Not directly in CHECK, stringifying the vectors is very slow.
+					bool same = filter.captures[k].pixels == expected[k];
+					CHECK(same);
+				}
+
+				xrt_frame_reference(&xf, NULL);
+			}
+		}
+	}
+}
+
+TEST_CASE("t_hsv_filter_set_worker_count_checks_sink")
+{
+	CaptureSink capture;
+	CHECK_FALSE(t_hsv_filter_set_worker_count(&capture.base, 2));
+}
+
+
+/*
+ *
+ * Benchmark, run with: tests_hsv_filter "[benchmark]"
+ * Set T_HSV_FILTER_SCALAR=1 to time the scalar kernels inside the filter.
+ *
+ */
+
+TEST_CASE("t_hsv_filter_throughput", "[.][benchmark]")
+{
+	constexpr int kIterations = 100;
+
+	// A side by side stereo PS4 camera style frame, same pixel count as two 640x480 PSEyes.
+	struct xrt_frame *xf = make_random_frame(XRT_FORMAT_YUYV422, 1280, 480, 1);
+
+	struct t_hsv_filter_params params = T_HSV_DEFAULT_PARAMS();
+	auto table = std::make_unique<t_hsv_filter_optimized_table>();
+	t_hsv_build_optimized_table(&params, table.get());
+
+	std::vector<uint8_t> planes[4];
+	uint64_t start = os_monotonic_get_ns();
+	for (int i = 0; i < kIterations; i++) {
+		reference_filter(table.get(), xf, planes);
+	}
+	double ref_ms = (double)(os_monotonic_get_ns() - start) / kIterations / 1e6;
+	std::cout << "reference scalar: " << ref_ms << "ms/frame" << std::endl;
+
+	for (uint32_t workers : {0, 2, 4}) {
+		Filter filter(workers, false);
+		xrt_sink_push_frame(filter.sink, xf); // Warm up the frame pool.
+
+		start = os_monotonic_get_ns();
+		for (int i = 0; i < kIterations; i++) {
+			xrt_sink_push_frame(filter.sink, xf);
+		}
+		double ms = (double)(os_monotonic_get_ns() - start) / kIterations / 1e6;
+		std::cout << "filter, " << workers << " workers: " << ms << "ms/frame" << std::endl;
+	}
+
+	xrt_frame_reference(&xf, NULL);
+}
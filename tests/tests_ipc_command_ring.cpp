@@ -0,0 +1,278 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Shared memory command ring tests and round-trip latency benchmark.
+ */
+
+#include <shared/ipc_command_ring.h>
+#include <shared/ipc_message_channel.h>
+#include <os/os_time.h>
+
+#include "catch/catch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+
+namespace {
+
+struct Command
+{
+	uint32_t cmd;
+	uint32_t value;
+	uint64_t payload[3];
+};
+
+struct Reply
+{
+	int32_t result;
+	uint64_t value;
+};
+
+//! A ring in memory shared with forked children, and a socket pair standing in for the connection.
+struct Connection
+{
+	struct ipc_command_ring *ring = nullptr;
+	struct ipc_message_channel client = {};
+	struct ipc_message_channel server = {};
+
+	Connection()
+	{
+		void *ptr = mmap(NULL, sizeof(*ring), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		REQUIRE(ptr != MAP_FAILED);
+		ring = static_cast<struct ipc_command_ring *>(ptr);
+
+		int fds[2] = {-1, -1};
+		REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+		client.ipc_handle = fds[0];
+		client.log_level = U_LOGGING_WARN;
+		server.ipc_handle = fds[1];
+		server.log_level = U_LOGGING_WARN;
+	}
+
+	~Connection()
+	{
+		ipc_message_channel_close(&client);
+		ipc_message_channel_close(&server);
+		munmap(ring, sizeof(*ring));
+	}
+};
+
+//! Serves the ring until it is closed, replies with the value doubled.
+void
+serve(struct ipc_command_ring *ring, std::atomic<bool> *stop)
+{
+	int32_t seq = 0;
+	while (stop == nullptr || !stop->load()) {
+		Command msg = {};
+		size_t len = 0;
+		xrt_result_t xret = ipc_command_ring_wait_request(ring, seq, 100, &seq, &msg, sizeof(msg), &len);
+		if (xret == XRT_TIMEOUT) {
+			if (xrt_atomic_s32_load(&ring->active) == 0) {
+				break;
+			}
+			continue;
+		}
+		if (xret != XRT_SUCCESS || len != sizeof(msg)) {
+			break;
+		}
+
+		Reply reply = {XRT_SUCCESS, (uint64_t)msg.value * 2};
+		ipc_command_ring_reply(ring, seq, &reply, sizeof(reply));
+	}
+}
+
+} // namespace
+
+
+TEST_CASE("ipc_command_ring_calls")
+{
+	Connection c;
+	ipc_command_ring_open(c.ring);
+
+	std::thread server(serve, c.ring, nullptr);
+
+	bool all_ok = true;
+	for (uint32_t i = 0; i < 1000; i++) {
+		Command msg = {1, i, {i, i, i}};
+		Reply reply = {};
+		xrt_result_t xret = ipc_command_ring_call(c.ring, &c.client, &msg, sizeof(msg), &reply, sizeof(reply));
+		all_ok = all_ok && xret == XRT_SUCCESS && reply.value == (uint64_t)i * 2;
+	}
+	CHECK(all_ok);
+
+	// Wrong reply size is an error, the service sent something else.
+	Command msg = {1, 3, {}};
+	uint64_t too_small = 0;
+	CHECK(ipc_command_ring_call(c.ring, &c.client, &msg, sizeof(msg), &too_small, sizeof(too_small)) ==
+	      XRT_ERROR_IPC_FAILURE);
+
+	ipc_command_ring_close(c.ring);
+	server.join();
+
+	// Closed rings fail straight away.
+	Reply reply = {};
+	CHECK(ipc_command_ring_call(c.ring, &c.client, &msg, sizeof(msg), &reply, sizeof(reply)) ==
+	      XRT_ERROR_IPC_FAILURE);
+}
+
+TEST_CASE("ipc_command_ring_close_while_waiting")
+{
+	Connection c;
+	ipc_command_ring_open(c.ring);
+
+	// Nobody serves the ring, closing it must fail the call in flight.
+	std::thread closer([&c] {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		ipc_command_ring_close(c.ring);
+	});
+
+	Command msg = {1, 1, {}};
+	Reply reply = {};
+	CHECK(ipc_command_ring_call(c.ring, &c.client, &msg, sizeof(msg), &reply, sizeof(reply)) ==
+	      XRT_ERROR_IPC_FAILURE);
+
+	closer.join();
+}
+
+TEST_CASE("ipc_command_ring_service_gone")
+{
+	Connection c;
+	ipc_command_ring_open(c.ring);
+
+	// A crashed service never closes the ring, only the socket.
+	ipc_message_channel_close(&c.server);
+
+	Command msg = {1, 1, {}};
+	Reply reply = {};
+	CHECK(ipc_command_ring_call(c.ring, &c.client, &msg, sizeof(msg), &reply, sizeof(reply)) ==
+	      XRT_ERROR_IPC_FAILURE);
+}
+
+TEST_CASE("ipc_command_ring_bad_request")
+{
+	Connection c;
+	ipc_command_ring_open(c.ring);
+
+	// Whatever the client writes the service must not read past its buffer.
+	c.ring->request_size = sizeof(c.ring->request) + 1;
+	xrt_atomic_s32_store(&c.ring->request_seq, 1);
+
+	uint8_t buf[IPC_BUF_SIZE];
+	size_t len = 0;
+	int32_t seq = 0;
+	CHECK(ipc_command_ring_wait_request(c.ring, 0, 10, &seq, buf, sizeof(buf), &len) == XRT_ERROR_IPC_FAILURE);
+
+	// Nothing new is a timeout.
+	CHECK(ipc_command_ring_wait_request(c.ring, 1, 10, &seq, buf, sizeof(buf), &len) == XRT_TIMEOUT);
+}
+
+
+/*
+ *
+ * Benchmark, run with: tests_ipc_command_ring "[benchmark]"
+ *
+ */
+
+namespace {
+
+constexpr int kRoundTrips = 20000;
+
+//! Framed socket server like the per client thread in the service.
+[[noreturn]] void
+socket_server(int fd)
+{
+	struct ipc_frame_reader reader = {};
+	struct ipc_message_channel imc = {};
+	imc.ipc_handle = fd;
+	imc.log_level = U_LOGGING_WARN;
+	imc.reader = &reader;
+
+	while (true) {
+		Command msg;
+		size_t len = 0;
+		if (ipc_receive_command(&imc, &msg, sizeof(msg), &len) != XRT_SUCCESS || len != sizeof(msg)) {
+			break;
+		}
+
+		Reply reply = {XRT_SUCCESS, (uint64_t)msg.value * 2};
+		if (ipc_send(&imc, &reply, sizeof(reply)) != XRT_SUCCESS) {
+			break;
+		}
+	}
+
+	_exit(0);
+}
+
+void
+run_round_trips(const char *name, bool ring)
+{
+	Connection c;
+	ipc_command_ring_open(c.ring);
+
+	pid_t pid = fork();
+	REQUIRE(pid >= 0);
+	if (pid == 0) {
+		ipc_message_channel_close(&c.client);
+		if (ring) {
+			serve(c.ring, nullptr);
+			_exit(0);
+		}
+		socket_server(c.server.ipc_handle);
+	}
+	ipc_message_channel_close(&c.server);
+
+	std::vector<uint64_t> samples;
+	samples.reserve(kRoundTrips);
+
+	bool ok = true;
+	for (int i = 0; i < kRoundTrips && ok; i++) {
+		Command msg = {1, (uint32_t)i, {}};
+		Reply reply = {};
+
+		uint64_t start = os_monotonic_get_ns();
+		if (ring) {
+			ok = ipc_command_ring_call(c.ring, &c.client, &msg, sizeof(msg), &reply, sizeof(reply)) ==
+			     XRT_SUCCESS;
+		} else {
+			ok = ipc_send_command(&c.client, &msg, sizeof(msg)) == XRT_SUCCESS &&
+			     ipc_receive(&c.client, &reply, sizeof(reply)) == XRT_SUCCESS;
+		}
+		ok = ok && reply.value == (uint64_t)i * 2;
+		samples.push_back(os_monotonic_get_ns() - start);
+	}
+
+	ipc_command_ring_close(c.ring);
+	ipc_message_channel_close(&c.client);
+	waitpid(pid, NULL, 0);
+	CHECK(ok);
+
+	std::sort(samples.begin(), samples.end());
+	uint64_t total = 0;
+	for (uint64_t s : samples) {
+		total += s;
+	}
+
+	std::cout << name << ": " << samples.size() << " round trips, mean " << total / samples.size() << "ns, p50 "
+	          << samples[samples.size() / 2] << "ns, p99 " << samples[samples.size() * 99 / 100] << "ns"
+	          << std::endl;
+}
+
+} // namespace
+
+TEST_CASE("ipc_command_ring_round_trip", "[.][benchmark]")
+{
+	run_round_trips("framed socket", false);
+	run_round_trips("command ring ", true);
+}
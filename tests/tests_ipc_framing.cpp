@@ -0,0 +1,286 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Framed IPC command tests and round-trip latency benchmark.
+ */
+
+#include <shared/ipc_message_channel.h>
+#include <os/os_time.h>
+
+#include "catch/catch.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+
+namespace {
+
+struct SocketPair
+{
+	struct ipc_message_channel client = {};
+	struct ipc_message_channel server = {};
+	struct ipc_frame_reader reader = {};
+
+	SocketPair()
+	{
+		int fds[2] = {-1, -1};
+		REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+		client.ipc_handle = fds[0];
+		client.log_level = U_LOGGING_WARN;
+		server.ipc_handle = fds[1];
+		server.log_level = U_LOGGING_WARN;
+		server.reader = &reader;
+	}
+
+	~SocketPair()
+	{
+		ipc_message_channel_close(&client);
+		ipc_message_channel_close(&server);
+	}
+
+	void
+	set_server_timeout_ms(int ms)
+	{
+		struct timeval timeout = {0, ms * 1000};
+		REQUIRE(setsockopt(server.ipc_handle, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) == 0);
+	}
+};
+
+struct Command
+{
+	uint32_t cmd;
+	uint32_t value;
+	uint64_t payload[3];
+};
+
+} // namespace
+
+
+TEST_CASE("ipc_framing_pipelined")
+{
+	SocketPair sp;
+
+	// Three commands and some variable length data, all sent before anything is read.
+	Command a = {1, 10, {1, 2, 3}};
+	uint32_t b[2] = {2, 20};
+	uint8_t extra[300];
+	for (size_t i = 0; i < sizeof(extra); i++) {
+		extra[i] = (uint8_t)i;
+	}
+	Command c = {3, 30, {4, 5, 6}};
+
+	REQUIRE(ipc_send_command(&sp.client, &a, sizeof(a)) == XRT_SUCCESS);
+	REQUIRE(ipc_send_command(&sp.client, b, sizeof(b)) == XRT_SUCCESS);
+	REQUIRE(ipc_send(&sp.client, extra, sizeof(extra)) == XRT_SUCCESS);
+	REQUIRE(ipc_send_command(&sp.client, &c, sizeof(c)) == XRT_SUCCESS);
+
+	uint8_t buf[512];
+	size_t len = 0;
+
+	REQUIRE(ipc_receive_command(&sp.server, buf, sizeof(buf), &len) == XRT_SUCCESS);
+	CHECK(len == sizeof(a));
+	CHECK(memcmp(buf, &a, sizeof(a)) == 0);
+
+	// Everything was read in one go, the rest must come from the buffer.
+	size_t header = sizeof(struct ipc_frame_header);
+	CHECK(sp.reader.end - sp.reader.start == header + sizeof(b) + sizeof(extra) + header + sizeof(c));
+
+	REQUIRE(ipc_receive_command(&sp.server, buf, sizeof(buf), &len) == XRT_SUCCESS);
+	CHECK(len == sizeof(b));
+	CHECK(memcmp(buf, b, sizeof(b)) == 0);
+
+	// Variable length data read by a handler comes out of the read ahead buffer.
+	uint8_t extra_out[sizeof(extra)] = {};
+	REQUIRE(ipc_receive(&sp.server, extra_out, sizeof(extra_out)) == XRT_SUCCESS);
+	CHECK(memcmp(extra, extra_out, sizeof(extra)) == 0);
+
+	REQUIRE(ipc_receive_command(&sp.server, buf, sizeof(buf), &len) == XRT_SUCCESS);
+	CHECK(len == sizeof(c));
+	CHECK(memcmp(buf, &c, sizeof(c)) == 0);
+	CHECK(sp.reader.end == sp.reader.start);
+
+	// A graceful close between commands is a zero sized command.
+	ipc_message_channel_close(&sp.client);
+	REQUIRE(ipc_receive_command(&sp.server, buf, sizeof(buf), &len) == XRT_SUCCESS);
+	CHECK(len == 0);
+}
+
+TEST_CASE("ipc_framing_partial")
+{
+	SocketPair sp;
+	sp.set_server_timeout_ms(10);
+
+	Command a = {7, 70, {7, 8, 9}};
+	struct ipc_frame_header header = {sizeof(a)};
+	uint8_t wire[sizeof(header) + sizeof(a)];
+	memcpy(wire, &header, sizeof(header));
+	memcpy(wire + sizeof(header), &a, sizeof(a));
+
+	uint8_t buf[512];
+	size_t len = 0;
+
+	// Nothing sent yet.
+	CHECK(ipc_receive_command(&sp.server, buf, sizeof(buf), &len) == XRT_TIMEOUT);
+
+	// Half of the header, then the rest of the header and some of the message.
+	REQUIRE(send(sp.client.ipc_handle, wire, 2, 0) == 2);
+	CHECK(ipc_receive_command(&sp.server, buf, sizeof(buf), &len) == XRT_TIMEOUT);
+	REQUIRE(send(sp.client.ipc_handle, wire + 2, 10, 0) == 10);
+	CHECK(ipc_receive_command(&sp.server, buf, sizeof(buf), &len) == XRT_TIMEOUT);
+	REQUIRE(send(sp.client.ipc_handle, wire + 12, sizeof(wire) - 12, 0) == (ssize_t)(sizeof(wire) - 12));
+
+	REQUIRE(ipc_receive_command(&sp.server, buf, sizeof(buf), &len) == XRT_SUCCESS);
+	CHECK(len == sizeof(a));
+	CHECK(memcmp(buf, &a, sizeof(a)) == 0);
+
+	// Too large for the receive buffer is an error.
+	REQUIRE(ipc_send_command(&sp.client, &a, sizeof(a)) == XRT_SUCCESS);
+	CHECK(ipc_receive_command(&sp.server, buf, sizeof(a) - 1, &len) == XRT_ERROR_IPC_FAILURE);
+}
+
+
+/*
+ *
+ * Benchmark, run with: tests_ipc_framing "[benchmark]"
+ *
+ */
+
+namespace {
+
+constexpr int kRoundTrips = 20000;
+
+//! The previous server loop: epoll, peek the command, read it, reply.
+[[noreturn]] void
+legacy_server(int fd)
+{
+	int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	struct epoll_event ev = {};
+	ev.events = EPOLLIN;
+	ev.data.fd = fd;
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+
+	while (true) {
+		struct epoll_event event = {};
+		if (epoll_wait(epoll_fd, &event, 1, 500) <= 0 || (event.events & EPOLLHUP) != 0) {
+			break;
+		}
+
+		uint32_t cmd = 0;
+		if (recv(fd, &cmd, sizeof(cmd), MSG_PEEK) != sizeof(cmd)) {
+			break;
+		}
+
+		Command msg;
+		if (recv(fd, &msg, sizeof(msg), 0) != sizeof(msg)) {
+			break;
+		}
+
+		uint64_t reply = msg.value;
+		if (send(fd, &reply, sizeof(reply), MSG_NOSIGNAL) != sizeof(reply)) {
+			break;
+		}
+	}
+
+	_exit(0);
+}
+
+//! The framed server loop, a single receive per command.
+[[noreturn]] void
+framed_server(int fd)
+{
+	struct ipc_frame_reader reader = {};
+	struct ipc_message_channel imc = {};
+	imc.ipc_handle = fd;
+	imc.log_level = U_LOGGING_WARN;
+	imc.reader = &reader;
+
+	struct timeval timeout = {0, 500 * 1000};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	while (true) {
+		Command msg;
+		size_t len = 0;
+		if (ipc_receive_command(&imc, &msg, sizeof(msg), &len) != XRT_SUCCESS || len != sizeof(msg)) {
+			break;
+		}
+
+		uint64_t reply = msg.value;
+		if (ipc_send(&imc, &reply, sizeof(reply)) != XRT_SUCCESS) {
+			break;
+		}
+	}
+
+	_exit(0);
+}
+
+void
+run_round_trips(const char *name, bool framed)
+{
+	int fds[2] = {-1, -1};
+	REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+	pid_t pid = fork();
+	REQUIRE(pid >= 0);
+	if (pid == 0) {
+		close(fds[0]);
+		if (framed) {
+			framed_server(fds[1]);
+		} else {
+			legacy_server(fds[1]);
+		}
+	}
+	close(fds[1]);
+
+	struct ipc_message_channel imc = {};
+	imc.ipc_handle = fds[0];
+	imc.log_level = U_LOGGING_WARN;
+
+	std::vector<uint64_t> samples;
+	samples.reserve(kRoundTrips);
+
+	bool ok = true;
+	for (int i = 0; i < kRoundTrips && ok; i++) {
+		Command msg = {1, (uint32_t)i, {}};
+		uint64_t reply = 0;
+
+		uint64_t start = os_monotonic_get_ns();
+		if (framed) {
+			ok = ipc_send_command(&imc, &msg, sizeof(msg)) == XRT_SUCCESS;
+		} else {
+			ok = ipc_send(&imc, &msg, sizeof(msg)) == XRT_SUCCESS;
+		}
+		ok = ok && ipc_receive(&imc, &reply, sizeof(reply)) == XRT_SUCCESS && reply == (uint64_t)i;
+		samples.push_back(os_monotonic_get_ns() - start);
+	}
+
+	ipc_message_channel_close(&imc);
+	waitpid(pid, NULL, 0);
+	CHECK(ok);
+
+	std::sort(samples.begin(), samples.end());
+	uint64_t total = 0;
+	for (uint64_t s : samples) {
+		total += s;
+	}
+
+	std::cout << name << ": " << samples.size() << " round trips, mean " << total / samples.size() << "ns, p50 "
+	          << samples[samples.size() / 2] << "ns, p99 " << samples[samples.size() * 99 / 100] << "ns"
+	          << std::endl;
+}
+
+} // namespace
+
+TEST_CASE("ipc_framing_round_trip", "[.][benchmark]")
+{
+	run_round_trips("epoll + peek + recv", false);
+	run_round_trips("framed single recv ", true);
+}
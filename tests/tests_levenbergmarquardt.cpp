@@ -14,13 +14,21 @@
 #include <math/m_vec3.h>
 #include <math/m_vec2.h>
 
+#include <math/m_api.h>
+#include <os/os_time.h>
+
 #include "kine_common.hpp"
 #include "lm_interface.hpp"
+#include "lm_replay.hpp"
+#include "lm_test_hooks.hpp"
 
 #include "catch/catch.hpp"
 
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <iostream>
+#include <vector>
 #include "fenv.h"
 
 using namespace xrt::tracking::hand::mercury;
@@ -84,3 +92,375 @@ TEST_CASE("LevenbergMarquardt")
 	CHECK(std::isfinite(out_reprojection_error));
 	CHECK(std::isfinite(out_hand_size));
 }
+
+
+/*
+ *
+ * Synthetic sequences and replays of recorded ones.
+ *
+ */
+
+namespace {
+
+constexpr float kStereographicRadius = 0.25f;
+
+// Optimizer output joint for each of the 21 keypoints.
+int
+joint21_to_xrt(int i)
+{
+	if (i == 0) {
+		return XRT_HAND_JOINT_WRIST;
+	}
+	if (i <= 4) {
+		return XRT_HAND_JOINT_THUMB_METACARPAL + (i - 1);
+	}
+	int finger = (i - 5) / 4;
+	int joint = (i - 5) % 4;
+	return XRT_HAND_JOINT_INDEX_PROXIMAL + finger * 5 + joint;
+}
+
+/*!
+ * Observe @p joints, positions in the left camera, like the keypoint estimator
+ * would if it was perfect.
+ */
+one_frame_input
+observe(const std::vector<xrt_vec3> &joints, const xrt_pose &left_in_right, float hand_size)
+{
+	one_frame_input input = {};
+
+	for (int view = 0; view < 2; view++) {
+		one_frame_one_view &v = input.views[view];
+		v.active = true;
+		v.look_dir = XRT_QUAT_IDENTITY;
+		v.stereographic_radius = kStereographicRadius;
+		for (int i = 0; i < 5; i++) {
+			v.curls[i].value = 0.0f;
+			v.curls[i].variance = 1.0f;
+		}
+
+		xrt_vec3 in_view[21];
+		for (int i = 0; i < 21; i++) {
+			in_view[i] = joints[i];
+			if (view == 1) {
+				math_quat_rotate_vec3(&left_in_right.orientation, &in_view[i], &in_view[i]);
+				in_view[i] = m_vec3_add(in_view[i], left_in_right.position);
+			}
+		}
+
+		float pxm_depth = m_vec3_len(in_view[Joint21::INDX_PXM]);
+		for (int i = 0; i < 21; i++) {
+			xrt_vec3 dir = m_vec3_normalize(in_view[i]);
+			vec2_5 &kp = v.keypoints_in_scaled_stereographic[i];
+			kp.pos_2d.x = dir.x / (1.0f - dir.z) / kStereographicRadius;
+			kp.pos_2d.y = dir.y / (1.0f - dir.z) / kStereographicRadius;
+			kp.depth_relative_to_midpxm = (m_vec3_len(in_view[i]) - pxm_depth) / hand_size;
+			kp.confidence_xy = 1.0f;
+			kp.confidence_depth = 1.0f;
+		}
+	}
+
+	return input;
+}
+
+/*!
+ * Fit a fresh optimizer to @p joints like the first frame of a sequence does,
+ * returns the joints of the fitted hand.
+ */
+std::vector<xrt_vec3>
+fit_first_frame(const std::vector<xrt_vec3> &joints,
+                bool is_right,
+                const xrt_pose &left_in_right,
+                float hand_size,
+                float &out_reprojection_error)
+{
+	lm::KinematicHandLM *hand = nullptr;
+	lm::optimizer_create(left_in_right, is_right, U_LOGGING_WARN, &hand);
+
+	one_frame_input input = observe(joints, left_in_right, hand_size);
+	xrt_hand_joint_set set = {};
+	float out_hand_size = 0.0f;
+	lm::optimizer_run(hand, input, true, 2.0f, false, hand_size, 1.0f, 0.01f, set, out_hand_size,
+	                  out_reprojection_error);
+	lm::optimizer_destroy(&hand);
+
+	std::vector<xrt_vec3> fitted(21);
+	for (int i = 0; i < 21; i++) {
+		fitted[i] = set.values.hand_joint_set_default[joint21_to_xrt(i)].relation.pose.position;
+	}
+	return fitted;
+}
+
+/*!
+ * A hand the optimizer can represent exactly, found by fitting it to a rough
+ * open hand in front of the cameras. The fit is repeated on its own result
+ * until a fresh optimizer finds it again, a first frame can otherwise settle
+ * in a local minimum close to it and which one depends on float rounding.
+ */
+std::vector<xrt_vec3>
+ground_truth_hand(bool is_right, const xrt_pose &left_in_right, float hand_size)
+{
+	std::vector<xrt_vec3> joints(21);
+	joints[0] = {0.0f, -0.08f, -0.4f};
+	for (int finger = 0; finger < 5; finger++) {
+		float angle = (float)(-50 + 25 * finger) * (float)M_PI / 180.0f;
+		for (int joint = 0; joint < 4; joint++) {
+			float dist = 0.04f + 0.025f * (float)joint;
+			xrt_vec3 &j = joints[1 + finger * 4 + joint];
+			j = {sinf(angle) * dist, -0.08f + cosf(angle) * dist, -0.4f};
+			if (is_right) {
+				j.x = -j.x;
+			}
+		}
+	}
+
+	float reprojection_error = 0.0f;
+	std::vector<xrt_vec3> fitted = fit_first_frame(joints, is_right, left_in_right, hand_size, reprojection_error);
+	for (int i = 0; i < 10 && reprojection_error > 1e-5f; i++) {
+		joints = fitted;
+		fitted = fit_first_frame(joints, is_right, left_in_right, hand_size, reprojection_error);
+	}
+	REQUIRE(reprojection_error < 1e-5f);
+
+	return joints;
+}
+
+/*!
+ * Both hands moving and turning a bit each frame, starting from the ground
+ * truth, a right hand frame follows each left hand frame like in a live session.
+ */
+std::vector<lm::replay_frame>
+synthetic_sequence(const xrt_pose &left_in_right, int num_frames)
+{
+	const float hand_size = 0.09f;
+	std::vector<lm::replay_frame> frames;
+
+	for (int hand_idx = 0; hand_idx < 2; hand_idx++) {
+		std::vector<xrt_vec3> truth = ground_truth_hand(hand_idx == 1, left_in_right, hand_size);
+		xrt_vec3 center = truth[Joint21::MIDL_PXM];
+
+		for (int f = 0; f < num_frames; f++) {
+			float t = (float)f / 60.0f;
+			xrt_quat rot = {};
+			xrt_vec3 axis = {0.3f, 1.0f, 0.1f};
+			axis = m_vec3_normalize(axis);
+			math_quat_from_angle_vector(0.4f * sinf(t * 3.0f), &axis, &rot);
+			xrt_vec3 move = {0.03f * sinf(t * 2.0f), 0.02f * sinf(t * 5.0f), 0.02f * sinf(t)};
+
+			std::vector<xrt_vec3> joints(21);
+			for (int i = 0; i < 21; i++) {
+				xrt_vec3 p = m_vec3_sub(truth[i], center);
+				math_quat_rotate_vec3(&rot, &p, &p);
+				joints[i] = m_vec3_add(m_vec3_add(p, center), move);
+			}
+
+			lm::replay_frame frame = {};
+			frame.is_right = hand_idx == 1;
+			frame.hand_was_untracked_last_frame = f == 0;
+			frame.optimize_hand_size = false;
+			frame.smoothing_factor = 2.0f;
+			frame.target_hand_size = hand_size;
+			frame.hand_size_err_mul = 1.0f;
+			frame.amt_use_depth = 0.01f;
+			frame.observation = observe(joints, left_in_right, hand_size);
+
+			size_t at = std::min(frames.size(), (size_t)f * 2 + hand_idx);
+			frames.insert(frames.begin() + at, frame);
+		}
+	}
+
+	return frames;
+}
+
+xrt_pose
+synthetic_left_in_right()
+{
+	xrt_pose left_in_right = XRT_POSE_IDENTITY;
+	left_in_right.position.x = -0.064f;
+	return left_in_right;
+}
+
+struct replay_result
+{
+	std::vector<lm::optimizer_stats> stats;
+	std::vector<float> reprojection_errors;
+	std::vector<float> jacobian_differences;
+};
+
+replay_result
+replay(const std::vector<lm::replay_frame> &frames, const xrt_pose &left_in_right)
+{
+	lm::KinematicHandLM *hands[2] = {};
+	lm::optimizer_create(left_in_right, false, U_LOGGING_WARN, &hands[0]);
+	lm::optimizer_create(left_in_right, true, U_LOGGING_WARN, &hands[1]);
+
+	replay_result result = {};
+	for (const lm::replay_frame &frame : frames) {
+		lm::KinematicHandLM *hand = hands[frame.is_right ? 1 : 0];
+
+		// The optimizer mutates it.
+		one_frame_input observation = frame.observation;
+		xrt_hand_joint_set set = {};
+		float out_hand_size = 0.0f;
+		float reprojection_error = 0.0f;
+		lm::optimizer_run(hand, observation, frame.hand_was_untracked_last_frame, frame.smoothing_factor,
+		                  frame.optimize_hand_size, frame.target_hand_size, frame.hand_size_err_mul,
+		                  frame.amt_use_depth, set, out_hand_size, reprojection_error);
+
+		lm::optimizer_stats stats = {};
+		lm::optimizer_get_last_stats(hand, stats);
+		result.stats.push_back(stats);
+		result.reprojection_errors.push_back(reprojection_error);
+		result.jacobian_differences.push_back(lm::optimizer_jacobian_difference(hand));
+	}
+
+	lm::optimizer_destroy(&hands[0]);
+	lm::optimizer_destroy(&hands[1]);
+
+	return result;
+}
+
+} // namespace
+
+TEST_CASE("LevenbergMarquardt_synthetic_converges")
+{
+	xrt_pose left_in_right = synthetic_left_in_right();
+	std::vector<lm::replay_frame> frames = synthetic_sequence(left_in_right, 30);
+	REQUIRE(frames.size() == 60);
+
+	replay_result result = replay(frames, left_in_right);
+
+	// Perfect observations of a hand the optimizer can represent, every frame should fit.
+	bool converged = true;
+	bool fits = true;
+	for (size_t i = 0; i < frames.size(); i++) {
+		converged = converged && result.stats[i].converged &&
+		            result.stats[i].final_cost <= result.stats[i].initial_cost;
+		fits = fits && result.reprojection_errors[i] < 0.001f;
+	}
+	CHECK(converged);
+	CHECK(fits);
+}
+
+TEST_CASE("LevenbergMarquardt_analytic_jacobian")
+{
+	// Turned cameras so the view transforms are not trivial.
+	xrt_pose left_in_right = synthetic_left_in_right();
+	xrt_vec3 axis = {0.2f, 1.0f, -0.3f};
+	axis = m_vec3_normalize(axis);
+	math_quat_from_angle_vector(0.15f, &axis, &left_in_right.orientation);
+
+	std::vector<lm::replay_frame> frames = synthetic_sequence(left_in_right, 10);
+	for (size_t i = 0; i < frames.size(); i += 3) {
+		frames[i].optimize_hand_size = true;
+	}
+
+	replay_result result = replay(frames, left_in_right);
+
+	float worst = 0.0f;
+	for (float diff : result.jacobian_differences) {
+		worst = std::max(worst, diff);
+	}
+	CHECK(worst < 1e-5f);
+}
+
+TEST_CASE("LevenbergMarquardt_replay_file")
+{
+	xrt_pose left_in_right = synthetic_left_in_right();
+	std::vector<lm::replay_frame> frames = synthetic_sequence(left_in_right, 3);
+
+	char path[] = "/tmp/monado-lm-replay-XXXXXX";
+	int fd = mkstemp(path);
+	REQUIRE(fd >= 0);
+	FILE *file = fdopen(fd, "wb");
+	REQUIRE(file != nullptr);
+
+	CHECK(lm::replay_write_header(file, left_in_right));
+	for (const lm::replay_frame &frame : frames) {
+		CHECK(lm::replay_write_frame(file, frame));
+	}
+	fclose(file);
+
+	xrt_pose read_left_in_right = {};
+	std::vector<lm::replay_frame> read_frames;
+	CHECK(lm::replay_read_file(path, read_left_in_right, read_frames));
+	CHECK(read_left_in_right.position.x == left_in_right.position.x);
+	REQUIRE(read_frames.size() == frames.size());
+
+	bool same = true;
+	for (size_t i = 0; i < frames.size(); i++) {
+		const lm::replay_frame &a = frames[i];
+		const lm::replay_frame &b = read_frames[i];
+		same = same && a.is_right == b.is_right &&
+		       a.hand_was_untracked_last_frame == b.hand_was_untracked_last_frame &&
+		       a.target_hand_size == b.target_hand_size;
+		for (int view = 0; view < 2; view++) {
+			for (int j = 0; j < 21; j++) {
+				const vec2_5 &ka = a.observation.views[view].keypoints_in_scaled_stereographic[j];
+				const vec2_5 &kb = b.observation.views[view].keypoints_in_scaled_stereographic[j];
+				same = same && ka.pos_2d.x == kb.pos_2d.x && ka.pos_2d.y == kb.pos_2d.y &&
+				       ka.depth_relative_to_midpxm == kb.depth_relative_to_midpxm;
+			}
+		}
+	}
+	CHECK(same);
+
+	remove(path);
+
+	// Not a recording.
+	CHECK_FALSE(lm::replay_read_file(path, read_left_in_right, read_frames));
+}
+
+
+/*
+ *
+ * Benchmark, run with: tests_levenbergmarquardt "[benchmark]"
+ * Set MERCURY_LM_REPLAY to a file recorded with MERCURY_LM_RECORD to use that.
+ *
+ */
+
+TEST_CASE("LevenbergMarquardt_benchmark", "[.][benchmark]")
+{
+	xrt_pose left_in_right = synthetic_left_in_right();
+	std::vector<lm::replay_frame> frames;
+
+	const char *path = getenv("MERCURY_LM_REPLAY");
+	if (path != nullptr) {
+		REQUIRE(lm::replay_read_file(path, left_in_right, frames));
+		std::cout << "Replaying '" << path << "'" << std::endl;
+	} else {
+		frames = synthetic_sequence(left_in_right, 300);
+		std::cout << "Synthetic sequence" << std::endl;
+	}
+
+	// Warm up, then time.
+	replay(frames, left_in_right);
+	replay_result result = replay(frames, left_in_right);
+
+	double iterations = 0;
+	double converged = 0;
+	double final_cost = 0;
+	double reprojection_error = 0;
+	std::vector<uint64_t> solve_ns;
+	for (size_t i = 0; i < frames.size(); i++) {
+		iterations += result.stats[i].iterations;
+		converged += result.stats[i].converged ? 1 : 0;
+		final_cost += result.stats[i].final_cost;
+		reprojection_error += result.reprojection_errors[i];
+		solve_ns.push_back(result.stats[i].solve_ns);
+	}
+	std::sort(solve_ns.begin(), solve_ns.end());
+
+	double count = (double)frames.size();
+	double mean_us = 0;
+	for (uint64_t ns : solve_ns) {
+		mean_us += (double)ns / 1000.0 / count;
+	}
+
+	std::cout << frames.size() << " hands" << std::endl;
+	std::cout << "iterations: " << iterations / count << ", converged " << converged / count * 100.0 << "%"
+	          << std::endl;
+	std::cout << "final cost: " << final_cost / count << ", reprojection error " << reprojection_error / count
+	          << std::endl;
+	std::cout << "solve: mean " << mean_us << "us, median " << (double)solve_ns[solve_ns.size() / 2] / 1000.0
+	          << "us, max " << (double)solve_ns.back() / 1000.0 << "us per hand" << std::endl;
+}
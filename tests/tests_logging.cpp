@@ -0,0 +1,294 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Asynchronous and JSON logging tests.
+ */
+
+#include <util/u_logging.h>
+#include <util/u_json.h>
+#include <os/os_time.h>
+
+#include "catch/catch.hpp"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+/*!
+ * Sends stderr to a temporary file while alive, the logging options are read
+ * once so they are set before anything logs.
+ */
+struct CaptureStderr
+{
+	char path[64] = "/tmp/monado-log-XXXXXX";
+	int saved = -1;
+
+	CaptureStderr()
+	{
+		setenv("XRT_LOG", "trace", 1);
+		setenv("XRT_LOG_ASYNC", "1", 0);
+		setenv("XRT_JSON_LOG", "1", 1);
+
+		int fd = mkstemp(path);
+		fflush(stderr);
+		saved = dup(STDERR_FILENO);
+		dup2(fd, STDERR_FILENO);
+		close(fd);
+	}
+
+	~CaptureStderr()
+	{
+		fflush(stderr);
+		dup2(saved, STDERR_FILENO);
+		close(saved);
+		unlink(path);
+	}
+
+	//! Each line parsed as JSON, or null if it wasn't valid.
+	std::vector<cJSON *>
+	read_lines()
+	{
+		u_log_flush();
+
+		std::vector<cJSON *> out;
+		std::ifstream file(path);
+		std::string line;
+		while (std::getline(file, line)) {
+			out.push_back(cJSON_Parse(line.c_str()));
+		}
+		return out;
+	}
+};
+
+void
+free_lines(std::vector<cJSON *> &lines)
+{
+	for (cJSON *json : lines) {
+		cJSON_Delete(json);
+	}
+	lines.clear();
+}
+
+std::string
+get_string(cJSON *json, const char *name)
+{
+	cJSON *item = cJSON_GetObjectItemCaseSensitive(json, name);
+	return cJSON_IsString(item) ? item->valuestring : "";
+}
+
+CaptureStderr &
+capture()
+{
+	static CaptureStderr c;
+	return c;
+}
+
+} // namespace
+
+
+TEST_CASE("u_logging_json_escaping")
+{
+	CaptureStderr &c = capture();
+
+	const char *tricky = "quote \" backslash \\ newline \n tab \t control \x01 utf-8 \xc3\xa5 end";
+	U_LOG_I("%s", tricky);
+
+	std::string long_message(5000, 'x');
+	U_LOG_W("%s\"%s", long_message.c_str(), long_message.c_str());
+
+	std::vector<cJSON *> lines = c.read_lines();
+	REQUIRE(lines.size() >= 2);
+
+	cJSON *first = lines[lines.size() - 2];
+	REQUIRE(first != nullptr);
+	CHECK(get_string(first, "level") == "info");
+	CHECK(get_string(first, "file") == __FILE__);
+	CHECK(get_string(first, "message") == tricky);
+
+	// Truncated but still a whole object.
+	cJSON *second = lines.back();
+	REQUIRE(second != nullptr);
+	CHECK(get_string(second, "level") == "warn");
+	std::string message = get_string(second, "message");
+	CHECK(message.size() > 2048); // Cut to what fits, not halved.
+	CHECK(message.size() < long_message.size());
+	CHECK(message.find_first_not_of('x') == std::string::npos);
+
+	free_lines(lines);
+}
+
+TEST_CASE("u_logging_json_truncation")
+{
+	CaptureStderr &c = capture();
+
+	// Never cut in the middle of a character.
+	std::string utf8;
+	for (int i = 0; i < 2000; i++) {
+		utf8 += "\xc3\xa5";
+	}
+	U_LOG_I("x%s", utf8.c_str());
+
+	// Not even the prefix fits, the line is still an object.
+	std::string long_func(5000, 'f');
+	u_log(__FILE__, __LINE__, long_func.c_str(), U_LOGGING_WARN, "lost");
+
+	std::vector<cJSON *> lines = c.read_lines();
+	REQUIRE(lines.size() >= 2);
+
+	cJSON *first = lines[lines.size() - 2];
+	REQUIRE(first != nullptr);
+	std::string message = get_string(first, "message");
+	CHECK(message.size() > 2048);
+	CHECK(message.size() % 2 == 1);
+	CHECK(message.substr(message.size() - 2) == "\xc3\xa5");
+
+	cJSON *second = lines.back();
+	REQUIRE(second != nullptr);
+	CHECK(get_string(second, "level") == "warn");
+	CHECK(get_string(second, "message") == "");
+
+	free_lines(lines);
+}
+
+TEST_CASE("u_logging_async_threads")
+{
+	CaptureStderr &c = capture();
+
+	const int num_threads = 4;
+	const int num_messages = 5000;
+	int32_t dropped_before = u_log_get_dropped_count();
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < num_threads; t++) {
+		threads.emplace_back([t] {
+			for (int i = 0; i < num_messages; i++) {
+				U_LOG_D("thread %i message %i", t, i);
+			}
+		});
+	}
+	for (std::thread &t : threads) {
+		t.join();
+	}
+
+	// Errors are written out straight away.
+	U_LOG_E("last");
+
+	std::vector<cJSON *> lines = c.read_lines();
+
+	// Every message is either written or counted as dropped, and in order for each thread.
+	int received = 0;
+	int last[num_threads] = {-1, -1, -1, -1};
+	bool valid = true;
+	bool ordered = true;
+	for (cJSON *json : lines) {
+		valid = valid && json != nullptr;
+		int t = 0;
+		int i = 0;
+		if (json == nullptr || sscanf(get_string(json, "message").c_str(), "thread %i message %i", &t, &i) != 2) {
+			continue;
+		}
+		ordered = ordered && i > last[t];
+		last[t] = i;
+		received++;
+	}
+	CHECK(valid);
+	CHECK(ordered);
+	CHECK(received + (u_log_get_dropped_count() - dropped_before) == num_threads * num_messages);
+	REQUIRE(lines.back() != nullptr);
+	CHECK(get_string(lines.back(), "message") == "last");
+
+	free_lines(lines);
+}
+
+
+TEST_CASE("u_logging_async_order_between_threads")
+{
+	CaptureStderr &c = capture();
+
+	// Each thread has its own ring, they are merged in the order the messages were logged.
+	std::thread first([] {
+		for (int i = 0; i < 100; i++) {
+			U_LOG_D("order first %i", i);
+		}
+	});
+	first.join();
+
+	U_LOG_D("order main");
+
+	std::thread second([] { U_LOG_D("order second"); });
+	second.join();
+
+	std::vector<cJSON *> lines = c.read_lines();
+
+	std::vector<std::string> messages;
+	for (cJSON *json : lines) {
+		std::string message = json != nullptr ? get_string(json, "message") : "";
+		if (message.rfind("order ", 0) == 0) {
+			messages.push_back(message);
+		}
+	}
+
+	REQUIRE(messages.size() == 102);
+	CHECK(messages[0] == "order first 0");
+	CHECK(messages[99] == "order first 99");
+	CHECK(messages[100] == "order main");
+	CHECK(messages[101] == "order second");
+
+	free_lines(lines);
+}
+
+
+/*
+ *
+ * Benchmark, run with: tests_logging "[benchmark]"
+ * Compare with XRT_LOG_ASYNC=0 for the synchronous output.
+ *
+ */
+
+TEST_CASE("u_logging_async_benchmark", "[.][benchmark]")
+{
+	CaptureStderr &c = capture();
+
+	// Bursts like an IMU thread with trace logging, the caller should never wait on the output.
+	const int count = 20000;
+	int32_t dropped_before = u_log_get_dropped_count();
+	std::vector<uint64_t> took(count);
+
+	// Starts the logging thread.
+	U_LOG_T("start");
+
+	for (int i = 0; i < count; i++) {
+		uint64_t before = os_monotonic_get_ns();
+		U_LOG_T("sample %i: %f %f %f", i, 0.1 * i, 0.2 * i, 0.3 * i);
+		took[i] = os_monotonic_get_ns() - before;
+
+		if (i % 100 == 0) {
+			os_nanosleep(U_TIME_1MS_IN_NS);
+		}
+	}
+
+	std::sort(took.begin(), took.end());
+	uint64_t total_ns = 0;
+	for (uint64_t t : took) {
+		total_ns += t;
+	}
+
+	std::vector<cJSON *> lines = c.read_lines();
+	free_lines(lines);
+
+	std::cout << "json, XRT_LOG_ASYNC=" << getenv("XRT_LOG_ASYNC") << ": " << (double)total_ns / count << "ns per message, 99th " << took[count * 99 / 100]
+	          << "ns, worst " << took.back() << "ns, "
+	          << u_log_get_dropped_count() - dropped_before << " dropped" << std::endl;
+}
@@ -0,0 +1,246 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Batch math function tests and benchmark against the single element functions.
+ */
+
+#include <math/m_api.h>
+#include <os/os_time.h>
+
+#include "catch/catch.hpp"
+
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+
+namespace {
+
+//! Owns the arrays behind the structure of arrays views.
+struct Poses
+{
+	std::vector<float> data[7];
+	struct math_pose_soa soa = {};
+
+	explicit Poses(size_t count)
+	{
+		for (auto &d : data) {
+			d.resize(count);
+		}
+		soa.orientation = {data[0].data(), data[1].data(), data[2].data(), data[3].data()};
+		soa.position = {data[4].data(), data[5].data(), data[6].data()};
+	}
+
+	struct xrt_pose
+	get(size_t i) const
+	{
+		return {{data[0][i], data[1][i], data[2][i], data[3][i]}, {data[4][i], data[5][i], data[6][i]}};
+	}
+
+	void
+	set(size_t i, const struct xrt_pose &p)
+	{
+		data[0][i] = p.orientation.x;
+		data[1][i] = p.orientation.y;
+		data[2][i] = p.orientation.z;
+		data[3][i] = p.orientation.w;
+		data[4][i] = p.position.x;
+		data[5][i] = p.position.y;
+		data[6][i] = p.position.z;
+	}
+};
+
+Poses
+random_poses(size_t count, uint32_t seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+	Poses poses(count);
+	for (size_t i = 0; i < count; i++) {
+		struct xrt_pose p = {{dist(rng), dist(rng), dist(rng), dist(rng)}, {dist(rng), dist(rng), dist(rng)}};
+		math_quat_normalize(&p.orientation);
+		poses.set(i, p);
+	}
+	return poses;
+}
+
+bool
+close(float a, float b)
+{
+	return std::fabs(a - b) < 1e-5f;
+}
+
+bool
+close(const struct xrt_pose &a, const struct xrt_pose &b)
+{
+	return close(a.orientation.x, b.orientation.x) && close(a.orientation.y, b.orientation.y) &&
+	       close(a.orientation.z, b.orientation.z) && close(a.orientation.w, b.orientation.w) &&
+	       close(a.position.x, b.position.x) && close(a.position.y, b.position.y) &&
+	       close(a.position.z, b.position.z);
+}
+
+} // namespace
+
+
+// Counts that are not a multiple of the batch size also go through the tail.
+TEST_CASE("math_batch_matches_single")
+{
+	const size_t count = GENERATE(0, 1, 15, 16, 52, 1000);
+
+	Poses a = random_poses(count, 1);
+	Poses b = random_poses(count, 2);
+
+	SECTION("math_quat_rotate_vec3_n")
+	{
+		Poses out(count);
+		math_quat_rotate_vec3_n(&a.soa.orientation, &b.soa.position, &out.soa.position, count);
+
+		bool same = true;
+		for (size_t i = 0; i < count; i++) {
+			struct xrt_pose pa = a.get(i);
+			struct xrt_pose pb = b.get(i);
+			struct xrt_vec3 expected;
+			math_quat_rotate_vec3(&pa.orientation, &pb.position, &expected);
+			struct xrt_pose po = out.get(i);
+			same = same && close(po.position.x, expected.x) && close(po.position.y, expected.y) &&
+			       close(po.position.z, expected.z);
+		}
+		CHECK(same);
+	}
+
+	SECTION("math_pose_transform_n")
+	{
+		Poses out(count);
+		math_pose_transform_n(&a.soa, &b.soa, &out.soa, count);
+
+		// In place too.
+		math_pose_transform_n(&a.soa, &b.soa, &b.soa, count);
+
+		bool same = true;
+		Poses original = random_poses(count, 2);
+		for (size_t i = 0; i < count; i++) {
+			struct xrt_pose pa = a.get(i);
+			struct xrt_pose pb = original.get(i);
+			struct xrt_pose expected;
+			math_pose_transform(&pa, &pb, &expected);
+			same = same && close(out.get(i), expected) && close(b.get(i), expected);
+		}
+		CHECK(same);
+	}
+
+	SECTION("math_quat_slerp_n")
+	{
+		std::vector<float> t(count);
+		for (size_t i = 0; i < count; i++) {
+			t[i] = (float)(i % 11) / 10.0f;
+		}
+
+		// Some pairs that are the same or opposite, the linear branch.
+		for (size_t i = 0; i < count; i += 7) {
+			struct xrt_pose p = a.get(i);
+			if (i % 2 == 0) {
+				p.orientation.x = -p.orientation.x;
+				p.orientation.y = -p.orientation.y;
+				p.orientation.z = -p.orientation.z;
+				p.orientation.w = -p.orientation.w;
+			}
+			struct xrt_pose q = b.get(i);
+			q.orientation = p.orientation;
+			b.set(i, q);
+		}
+
+		Poses out(count);
+		math_quat_slerp_n(&a.soa.orientation, &b.soa.orientation, t.data(), &out.soa.orientation, count);
+
+		bool same = true;
+		for (size_t i = 0; i < count; i++) {
+			struct xrt_pose pa = a.get(i);
+			struct xrt_pose pb = b.get(i);
+			struct xrt_quat expected;
+			math_quat_slerp(&pa.orientation, &pb.orientation, t[i], &expected);
+			struct xrt_quat got = out.get(i).orientation;
+			same = same && close(got.x, expected.x) && close(got.y, expected.y) && close(got.z, expected.z) &&
+			       close(got.w, expected.w);
+		}
+		CHECK(same);
+	}
+}
+
+
+/*
+ *
+ * Benchmark, run with: tests_math_batch "[benchmark]"
+ *
+ */
+
+namespace {
+
+template <typename F>
+double
+time_ns_per_element(size_t count, int iterations, F &&f)
+{
+	uint64_t start = os_monotonic_get_ns();
+	for (int i = 0; i < iterations; i++) {
+		f();
+	}
+	return (double)(os_monotonic_get_ns() - start) / ((double)count * iterations);
+}
+
+} // namespace
+
+TEST_CASE("math_batch_benchmark", "[.][benchmark]")
+{
+	// Both hands of joints, and a large batch.
+	for (size_t count : {size_t(52), size_t(4096)}) {
+		const int iterations = (int)(4000000 / count);
+		Poses a = random_poses(count, 1);
+		Poses b = random_poses(count, 2);
+		Poses out(count);
+		std::vector<float> t(count, 0.3f);
+
+		double single = time_ns_per_element(count, iterations, [&] {
+			for (size_t i = 0; i < count; i++) {
+				struct xrt_pose pa = a.get(i);
+				struct xrt_pose pb = b.get(i);
+				math_pose_transform(&pa, &pb, &pb);
+				out.set(i, pb);
+			}
+		});
+		double batch = time_ns_per_element(count, iterations, [&] {
+			math_pose_transform_n(&a.soa, &b.soa, &out.soa, count); //
+		});
+		std::cout << "pose_transform   x" << count << ": single " << single << "ns, batch " << batch << "ns"
+		          << std::endl;
+
+		single = time_ns_per_element(count, iterations, [&] {
+			for (size_t i = 0; i < count; i++) {
+				struct xrt_pose pa = a.get(i);
+				struct xrt_pose pb = b.get(i);
+				math_quat_rotate_vec3(&pa.orientation, &pb.position, &pb.position);
+				out.set(i, pb);
+			}
+		});
+		batch = time_ns_per_element(count, iterations, [&] {
+			math_quat_rotate_vec3_n(&a.soa.orientation, &b.soa.position, &out.soa.position, count); //
+		});
+		std::cout << "quat_rotate_vec3 x" << count << ": single " << single << "ns, batch " << batch << "ns"
+		          << std::endl;
+
+		single = time_ns_per_element(count, iterations, [&] {
+			for (size_t i = 0; i < count; i++) {
+				struct xrt_pose pa = a.get(i);
+				struct xrt_pose pb = b.get(i);
+				math_quat_slerp(&pa.orientation, &pb.orientation, t[i], &pb.orientation);
+				out.set(i, pb);
+			}
+		});
+		batch = time_ns_per_element(count, iterations, [&] {
+			math_quat_slerp_n(&a.soa.orientation, &b.soa.orientation, t.data(), &out.soa.orientation, count);
+		});
+		std::cout << "quat_slerp       x" << count << ": single " << single << "ns, batch " << batch << "ns"
+		          << std::endl;
+	}
+}
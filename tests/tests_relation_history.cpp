@@ -0,0 +1,279 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Concurrency tests and contention benchmark for m_relation_history.
+ */
+
+#include <math/m_relation_history.h>
+#include <util/u_time.h>
+#include <util/u_template_historybuf.hpp>
+
+#include "catch/catch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+using xrt::auxiliary::math::RelationHistory;
+
+static constexpr uint64_t kStep = U_TIME_1MS_IN_NS;
+static constexpr uint64_t kT0 = 20 * (uint64_t)U_TIME_1S_IN_NS;
+
+static xrt_space_relation
+make_relation(uint64_t i)
+{
+	xrt_space_relation relation = XRT_SPACE_RELATION_ZERO;
+	relation.relation_flags = (xrt_space_relation_flags)( //
+	    XRT_SPACE_RELATION_POSITION_TRACKED_BIT |         //
+	    XRT_SPACE_RELATION_POSITION_VALID_BIT |           //
+	    XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT |      //
+	    XRT_SPACE_RELATION_ORIENTATION_VALID_BIT);        //
+
+	// Every field encodes the index, so torn reads are easy to spot.
+	relation.pose.position.x = (float)i;
+	relation.pose.position.y = (float)i;
+	relation.pose.position.z = (float)i;
+	return relation;
+}
+
+TEST_CASE("m_relation_history_concurrent")
+{
+	RelationHistory rh;
+
+	constexpr uint64_t kCount = 20000;
+	constexpr int kReaders = 3;
+
+	std::atomic<bool> done{false};
+	std::atomic<uint64_t> bad{0};
+	std::atomic<uint64_t> reads{0};
+
+	std::vector<std::thread> readers;
+	for (int r = 0; r < kReaders; r++) {
+		readers.emplace_back([&] {
+			while (!done.load()) {
+				uint64_t latest_ts = 0;
+				xrt_space_relation latest = {};
+				if (!rh.get_latest(&latest_ts, &latest)) {
+					continue;
+				}
+
+				uint64_t i = (latest_ts - kT0) / kStep;
+				if (latest.pose.position.x != (float)i || latest.pose.position.z != (float)i) {
+					bad++;
+				}
+
+				// Exact lookup of something that was in the buffer.
+				xrt_space_relation out = {};
+				auto res = rh.get(latest_ts, &out);
+				if (res == RelationHistory::Result::M_RELATION_HISTORY_RESULT_EXACT &&
+				    out.pose.position.x != (float)i) {
+					bad++;
+				}
+
+				// Half way between the two latest, must lerp between consistent entries.
+				if (i > 0) {
+					res = rh.get(latest_ts - kStep / 2, &out);
+					if (res == RelationHistory::Result::M_RELATION_HISTORY_RESULT_INTERPOLATED &&
+					    (out.pose.position.x != out.pose.position.y ||
+					     out.pose.position.x != out.pose.position.z)) {
+						bad++;
+					}
+				}
+				reads++;
+			}
+		});
+	}
+
+	for (uint64_t i = 0; i < kCount; i++) {
+		xrt_space_relation relation = make_relation(i);
+		CHECK(rh.push(relation, kT0 + i * kStep));
+		if (i == kCount / 2) {
+			rh.clear();
+		}
+	}
+
+	// On few cores the readers might not have been scheduled yet.
+	while (reads.load() == 0) {
+		std::this_thread::yield();
+	}
+
+	done = true;
+	for (auto &t : readers) {
+		t.join();
+	}
+
+	CHECK(bad.load() == 0);
+	CHECK(reads.load() > 0);
+	CHECK(rh.size() > 0);
+}
+
+TEST_CASE("m_relation_history_resolve")
+{
+	RelationHistory rh;
+
+	constexpr uint32_t kCount = 16;
+	xrt_space_relation relations[kCount];
+	uint64_t timestamps[kCount];
+	for (uint32_t i = 0; i < kCount; i++) {
+		relations[i] = make_relation(i);
+		relations[i].linear_velocity.x = 1.0f;
+		timestamps[i] = kT0 + i * kStep;
+		rh.push(relations[i], timestamps[i]);
+	}
+
+	// Before, exactly on, between and after the entries.
+	const uint64_t times[] = {kT0 - kStep, kT0, kT0 + kStep / 3, kT0 + 7 * kStep, kT0 + 20 * kStep};
+	for (uint64_t ts : times) {
+		xrt_space_relation from_history = {};
+		xrt_space_relation from_arrays = {};
+		auto res_history = rh.get(ts, &from_history);
+		auto res_arrays = m_relation_history_resolve(relations, timestamps, kCount, ts, &from_arrays);
+
+		CHECK(res_history == res_arrays);
+		CHECK(from_history.relation_flags == from_arrays.relation_flags);
+		CHECK(from_history.pose.position.x == from_arrays.pose.position.x);
+		CHECK(from_history.pose.orientation.w == from_arrays.pose.orientation.w);
+	}
+
+	xrt_space_relation out = {};
+	CHECK(m_relation_history_resolve(relations, timestamps, 0, kT0, &out) == M_RELATION_HISTORY_RESULT_INVALID);
+}
+
+
+/*
+ *
+ * Benchmark, run with: tests_relation_history "[benchmark]"
+ *
+ */
+
+namespace {
+
+//! The previous implementation: one mutex for everybody, kept as a reference.
+class LockedHistory
+{
+public:
+	struct Entry
+	{
+		xrt_space_relation relation;
+		uint64_t timestamp;
+	};
+
+	void
+	push(xrt_space_relation const &relation, uint64_t ts)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		buf_.push_back(Entry{relation, ts});
+	}
+
+	void
+	get(uint64_t at_ts, xrt_space_relation *out)
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		if (buf_.empty()) {
+			return;
+		}
+		auto it = std::lower_bound(buf_.begin(), buf_.end(), at_ts,
+		                           [](const Entry &e, uint64_t ts) { return e.timestamp < ts; });
+		*out = it == buf_.end() ? buf_.back().relation : it->relation;
+	}
+
+private:
+	std::mutex mutex_;
+	xrt::auxiliary::util::HistoryBuffer<Entry, 4096> buf_;
+};
+
+struct ReaderStats
+{
+	uint64_t count = 0;
+	uint64_t total_ns = 0;
+	uint64_t max_ns = 0;
+	std::vector<uint64_t> samples;
+};
+
+template <typename Push, typename Get>
+static void
+run_contention(const char *name, int num_readers, Push &&push, Get &&get)
+{
+	using clock = std::chrono::steady_clock;
+	constexpr auto kDuration = std::chrono::milliseconds(500);
+
+	std::atomic<bool> done{false};
+	std::vector<ReaderStats> stats(num_readers);
+	std::vector<std::thread> readers;
+
+	for (int r = 0; r < num_readers; r++) {
+		readers.emplace_back([&, r] {
+			ReaderStats &s = stats[r];
+			s.samples.reserve(1 << 20);
+			uint64_t i = 0;
+			while (!done.load(std::memory_order_relaxed)) {
+				xrt_space_relation out = {};
+				auto start = clock::now();
+				get(kT0 + (i++ % 4096) * kStep + kStep / 2, &out);
+				uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - start)
+				                  .count();
+				s.count++;
+				s.total_ns += ns;
+				s.max_ns = std::max(s.max_ns, ns);
+				if (s.samples.size() < s.samples.capacity()) {
+					s.samples.push_back(ns);
+				}
+			}
+		});
+	}
+
+	// The single writer, pushing as fast as it can.
+	uint64_t pushes = 0;
+	auto end = clock::now() + kDuration;
+	while (clock::now() < end) {
+		push(make_relation(pushes), kT0 + pushes * kStep);
+		pushes++;
+	}
+
+	done = true;
+	for (auto &t : readers) {
+		t.join();
+	}
+
+	ReaderStats all;
+	for (auto &s : stats) {
+		all.count += s.count;
+		all.total_ns += s.total_ns;
+		all.max_ns = std::max(all.max_ns, s.max_ns);
+		all.samples.insert(all.samples.end(), s.samples.begin(), s.samples.end());
+	}
+	std::sort(all.samples.begin(), all.samples.end());
+	uint64_t p99 = all.samples.empty() ? 0 : all.samples[all.samples.size() * 99 / 100];
+
+	std::cout << name << ": 1 writer (" << pushes << " pushes), " << num_readers << " readers, "
+	          << all.count << " reads, mean " << (all.count ? all.total_ns / all.count : 0) << "ns, p99 "
+	          << p99 << "ns, max " << all.max_ns << "ns" << std::endl;
+}
+
+} // namespace
+
+TEST_CASE("m_relation_history_contention", "[.][benchmark]")
+{
+	int max_readers = std::max(2, (int)std::thread::hardware_concurrency() - 1);
+
+	for (int n = 1; n <= max_readers; n *= 2) {
+		{
+			RelationHistory rh;
+			run_contention(
+			    "seqlock", n, [&](xrt_space_relation const &rel, uint64_t ts) { rh.push(rel, ts); },
+			    [&](uint64_t ts, xrt_space_relation *out) { rh.get(ts, out); });
+		}
+		{
+			LockedHistory lh;
+			run_contention(
+			    "mutex  ", n, [&](xrt_space_relation const &rel, uint64_t ts) { lh.push(rel, ts); },
+			    [&](uint64_t ts, xrt_space_relation *out) { lh.get(ts, out); });
+		}
+	}
+}
@@ -0,0 +1,184 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Remote driver streaming tests, over loopback.
+ */
+
+#include <xrt/xrt_device.h>
+#include <xrt/xrt_system.h>
+#include <xrt/xrt_space.h>
+#include <os/os_time.h>
+#include <math/m_relation_history.h>
+
+#include "remote/r_interface.h"
+#include "remote/r_internal.h"
+
+#include "catch/catch.hpp"
+
+#include <unistd.h>
+
+#include <cstdlib>
+#include <vector>
+
+
+namespace {
+
+constexpr uint16_t kPort = 14242;
+
+/*!
+ * A hub with UDP enabled and a TCP connection to it, the option is read once so
+ * it is set before the first hub is made.
+ */
+struct Remote
+{
+	struct xrt_system_devices *xsysd = nullptr;
+	struct xrt_space_overseer *xso = nullptr;
+	struct r_hub *r = nullptr;
+
+	struct r_remote_connection rc = {};
+	struct r_remote_data reset = {};
+	struct r_remote_data data = {};
+
+	Remote()
+	{
+		setenv("REMOTE_UDP", "1", 1);
+
+		REQUIRE(r_create_devices(kPort, nullptr, &xsysd, &xso) == XRT_SUCCESS);
+		r = (struct r_hub *)xsysd;
+
+		// The hub sets up the socket on its thread.
+		rc.fd = -1;
+		for (int i = 0; i < 100 && r_remote_connection_init(&rc, "localhost", kPort) != 0; i++) {
+			os_nanosleep(U_TIME_1MS_IN_NS * 10);
+		}
+		REQUIRE(rc.fd >= 0);
+		REQUIRE(r_remote_connection_read_one(&rc, &reset) == 0);
+		REQUIRE(r_remote_connection_read_one(&rc, &data) == 0);
+	}
+
+	~Remote()
+	{
+		close(rc.fd);
+		xrt_space_overseer_destroy(&xso);
+		xrt_system_devices_destroy(&xsysd);
+	}
+};
+
+//! Waits for the history to have @p count entries.
+bool
+wait_for_size(struct m_relation_history *rh, uint32_t count)
+{
+	for (int i = 0; i < 200 && m_relation_history_get_size(rh) < count; i++) {
+		os_nanosleep(U_TIME_1MS_IN_NS * 10);
+	}
+	return m_relation_history_get_size(rh) >= count;
+}
+
+/*!
+ * Streams @p count samples of the left or right controller moving along x at
+ * 1m/s, sampled every millisecond and sent @p per_batch at a time as they
+ * would be by a client running in real time.
+ */
+void
+stream(struct r_remote_connection *rc, const struct r_remote_data &base, bool left, int count, int per_batch)
+{
+	std::vector<struct r_remote_data> batch;
+	uint64_t start_ns = os_monotonic_get_ns();
+
+	for (int i = 0; i < count; i++) {
+		struct r_remote_data d = base;
+		struct r_remote_controller_data &c = left ? d.left : d.right;
+		d.timestamp_ns = start_ns + i * U_TIME_1MS_IN_NS;
+		c.active = true;
+		c.pose.position.x = i * 0.001f;
+		c.linear_velocity.x = 1.0f;
+		batch.push_back(d);
+
+		if ((int)batch.size() == per_batch) {
+			os_nanosleep((int64_t)d.timestamp_ns - (int64_t)os_monotonic_get_ns());
+			REQUIRE(r_remote_connection_write_batch(rc, batch.data(), (uint32_t)batch.size()) == 0);
+			batch.clear();
+		}
+	}
+}
+
+} // namespace
+
+
+TEST_CASE("remote_streaming")
+{
+	Remote remote;
+	struct r_hub *r = remote.r;
+	struct xrt_device *left = remote.xsysd->xdevs[r->left_index];
+	struct xrt_device *right = remote.xsysd->xdevs[r->right_index];
+
+	CHECK(remote.reset.header == R_HEADER_VALUE);
+
+	SECTION("tcp samples are interpolated")
+	{
+		stream(&remote.rc, remote.data, true, 200, 10);
+		REQUIRE(wait_for_size(r->history.left, 200));
+
+		// Half way between two samples, in our clock.
+		uint64_t sample_ns = 0;
+		struct xrt_space_relation latest = {};
+		REQUIRE(m_relation_history_get_latest(r->history.left, &sample_ns, &latest));
+		CHECK(latest.pose.position.x == Approx(0.199f));
+
+		struct xrt_space_relation a = {};
+		struct xrt_space_relation b = {};
+		uint64_t at_ns = sample_ns - 50 * U_TIME_1MS_IN_NS;
+		xrt_device_get_tracked_pose(left, XRT_INPUT_INDEX_GRIP_POSE, at_ns, &a);
+		xrt_device_get_tracked_pose(left, XRT_INPUT_INDEX_GRIP_POSE, at_ns + U_TIME_1MS_IN_NS / 2, &b);
+
+		CHECK((a.relation_flags & XRT_SPACE_RELATION_POSITION_TRACKED_BIT) != 0);
+		CHECK(a.pose.position.x == Approx(0.149f).margin(0.005f));
+		CHECK(b.pose.position.x - a.pose.position.x == Approx(0.0005f).margin(0.0002f));
+
+		// Predicted with the velocity past the latest sample.
+		xrt_device_get_tracked_pose(left, XRT_INPUT_INDEX_GRIP_POSE, sample_ns + 10 * U_TIME_1MS_IN_NS, &a);
+		CHECK(a.pose.position.x == Approx(0.209f).margin(0.0005f));
+	}
+
+	SECTION("history is cleared when inactive")
+	{
+		stream(&remote.rc, remote.data, true, 50, 10);
+		REQUIRE(wait_for_size(r->history.left, 50));
+
+		struct r_remote_data d = remote.data;
+		d.timestamp_ns = os_monotonic_get_ns();
+		d.left.active = false;
+		REQUIRE(r_remote_connection_write_one(&remote.rc, &d) == 0);
+
+		for (int i = 0; i < 200 && m_relation_history_get_size(r->history.left) != 0; i++) {
+			os_nanosleep(U_TIME_1MS_IN_NS * 10);
+		}
+		CHECK(m_relation_history_get_size(r->history.left) == 0);
+	}
+
+	SECTION("udp batches at 1kHz")
+	{
+		struct r_remote_connection udp = {};
+		REQUIRE(r_remote_connection_init_udp(&udp, "localhost", kPort) == 0);
+
+		// Nothing is lost on loopback.
+		stream(&udp, remote.data, false, 500, 5);
+		REQUIRE(wait_for_size(r->history.right, 500));
+
+		uint64_t sample_ns = 0;
+		struct xrt_space_relation rel = {};
+		REQUIRE(m_relation_history_get_latest(r->history.right, &sample_ns, &rel));
+		CHECK(rel.pose.position.x == Approx(0.499f));
+
+		xrt_device_get_tracked_pose(right, XRT_INPUT_INDEX_GRIP_POSE, sample_ns - U_TIME_1MS_IN_NS / 2, &rel);
+		CHECK((rel.relation_flags & XRT_SPACE_RELATION_POSITION_TRACKED_BIT) != 0);
+		CHECK(rel.pose.position.x == Approx(0.4985f).margin(0.0002f));
+
+		// A batch that is too big for a datagram is refused.
+		std::vector<struct r_remote_data> big(R_REMOTE_BATCH_MAX + 1, remote.data);
+		CHECK(r_remote_connection_write_batch(&udp, big.data(), (uint32_t)big.size()) < 0);
+
+		close(udp.fd);
+	}
+}
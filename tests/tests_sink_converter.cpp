@@ -0,0 +1,168 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Format converter sink tests and benchmark.
+ */
+
+#include <util/u_sink.h>
+#include <util/u_frame.h>
+#include <util/u_format.h>
+#include <os/os_time.h>
+
+#include "catch/catch.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+
+namespace {
+
+//! Keeps a copy of the last frame pushed to it.
+struct CaptureSink
+{
+	struct xrt_frame_sink base = {};
+
+	enum xrt_format format = XRT_FORMAT_L8;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> pixels;
+
+	CaptureSink()
+	{
+		base.push_frame = push;
+	}
+
+	static void
+	push(struct xrt_frame_sink *xfs, struct xrt_frame *xf)
+	{
+		auto *self = reinterpret_cast<CaptureSink *>(xfs);
+		self->format = xf->format;
+		self->width = xf->width;
+		self->height = xf->height;
+
+		// Only the pixels, not the padding at the end of rows, the tests only produce R8G8B8.
+		size_t bytes = (size_t)xf->width * 3;
+		self->pixels.clear();
+		for (uint32_t y = 0; y < xf->height; y++) {
+			const uint8_t *row = xf->data + y * xf->stride;
+			self->pixels.insert(self->pixels.end(), row, row + bytes);
+		}
+	}
+};
+
+struct xrt_frame *
+make_random_frame(enum xrt_format format, uint32_t width, uint32_t height, uint32_t seed)
+{
+	struct xrt_frame *xf = NULL;
+	u_frame_create_one_off(format, width, height, &xf);
+
+	std::mt19937 rng(seed);
+	for (size_t i = 0; i < xf->size; i++) {
+		xf->data[i] = (uint8_t)rng();
+	}
+	return xf;
+}
+
+CaptureSink
+convert(enum xrt_format format, uint32_t width, uint32_t height, uint32_t workers)
+{
+	struct xrt_frame_context xfctx = {};
+	CaptureSink capture;
+	struct xrt_frame_sink *converter = NULL;
+
+	u_sink_create_to_r8g8b8_or_l8(&xfctx, &capture.base, &converter);
+	CHECK(u_sink_converter_set_worker_count(converter, workers));
+
+	struct xrt_frame *xf = make_random_frame(format, width, height, 1234);
+	xrt_sink_push_frame(converter, xf);
+	xrt_frame_reference(&xf, NULL);
+
+	xrt_frame_context_destroy_nodes(&xfctx);
+
+	return capture;
+}
+
+} // namespace
+
+
+TEST_CASE("u_sink_converter_stripes")
+{
+	const enum xrt_format formats[] = {XRT_FORMAT_YUYV422, XRT_FORMAT_UYVY422, XRT_FORMAT_YUV888,
+	                                   XRT_FORMAT_BAYER_GR8};
+
+	for (enum xrt_format format : formats) {
+		// Sizes that split evenly and that leave a short last stripe.
+		for (uint32_t height : {480u, 203u}) {
+			CAPTURE(u_format_str(format), height);
+
+			CaptureSink single = convert(format, 640, height, 0);
+			REQUIRE(single.format == XRT_FORMAT_R8G8B8);
+			REQUIRE(!single.pixels.empty());
+
+			for (uint32_t workers : {2u, 3u, 8u}) {
+				CAPTURE(workers);
+				CaptureSink striped = convert(format, 640, height, workers);
+
+				CHECK(striped.width == single.width);
+				CHECK(striped.height == single.height);
+				// Not comparing in the macro, it would print the whole images.
+				bool same_pixels = striped.pixels == single.pixels;
+				CHECK(same_pixels);
+			}
+		}
+	}
+}
+
+TEST_CASE("u_sink_converter_set_worker_count_checks_sink")
+{
+	CaptureSink capture;
+	CHECK_FALSE(u_sink_converter_set_worker_count(&capture.base, 2));
+}
+
+
+/*
+ *
+ * Benchmark, run with: tests_sink_converter "[benchmark]"
+ *
+ */
+
+TEST_CASE("u_sink_converter_latency", "[.][benchmark]")
+{
+	// A high resolution side by side stereo frame.
+	constexpr uint32_t kWidth = 2 * 1920;
+	constexpr uint32_t kHeight = 1080;
+	constexpr int kIterations = 20;
+
+	const enum xrt_format formats[] = {XRT_FORMAT_YUYV422, XRT_FORMAT_BAYER_GR8};
+
+	for (enum xrt_format format : formats) {
+		struct xrt_frame *xf = make_random_frame(format, kWidth, kHeight, 42);
+
+		for (uint32_t workers : {0u, 2u, 4u, 8u}) {
+			struct xrt_frame_context xfctx = {};
+			CaptureSink capture;
+			struct xrt_frame_sink *converter = NULL;
+			u_sink_create_to_r8g8b8_or_l8(&xfctx, &capture.base, &converter);
+			REQUIRE(u_sink_converter_set_worker_count(converter, workers));
+
+			// Don't measure the copy in the capture sink.
+			capture.base.push_frame = [](struct xrt_frame_sink *, struct xrt_frame *) {};
+
+			uint64_t start = os_monotonic_get_ns();
+			for (int i = 0; i < kIterations; i++) {
+				xrt_sink_push_frame(converter, xf);
+			}
+			double ms = (double)(os_monotonic_get_ns() - start) / kIterations / 1e6;
+
+			std::cout << u_format_str(format) << " " << kWidth << "x" << kHeight << " workers " << workers
+			          << ": " << ms << "ms per frame" << std::endl;
+
+			xrt_frame_context_destroy_nodes(&xfctx);
+		}
+
+		xrt_frame_reference(&xf, NULL);
+	}
+}
@@ -0,0 +1,125 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Frame sink queue tests.
+ */
+
+#include <util/u_sink.h>
+#include <util/u_frame.h>
+
+#include "catch/catch.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+
+namespace {
+
+/*!
+ * Sink that records the sequence numbers it receives, and holds the queue
+ * thread in the first push until released so frames pile up in the queue.
+ */
+struct RecordingSink
+{
+	struct xrt_frame_sink base = {};
+
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::vector<uint64_t> received;
+	bool released = false;
+
+	RecordingSink()
+	{
+		base.push_frame = push;
+	}
+
+	static void
+	push(struct xrt_frame_sink *xfs, struct xrt_frame *xf)
+	{
+		auto *self = reinterpret_cast<RecordingSink *>(xfs);
+		std::unique_lock<std::mutex> lock(self->mutex);
+		self->received.push_back(xf->source_sequence);
+		self->cv.notify_all();
+		self->cv.wait(lock, [&] { return self->released; });
+	}
+
+	void
+	wait_for(size_t count)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		cv.wait(lock, [&] { return received.size() >= count; });
+	}
+
+	void
+	release()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		released = true;
+		cv.notify_all();
+	}
+};
+
+void
+push_sequence(struct xrt_frame_sink *xfs, uint64_t seq)
+{
+	struct xrt_frame *xf = NULL;
+	u_frame_create_one_off(XRT_FORMAT_L8, 4, 4, &xf);
+	xf->source_sequence = seq;
+	xrt_sink_push_frame(xfs, xf);
+	xrt_frame_reference(&xf, NULL);
+}
+
+std::vector<uint64_t>
+run_queue(uint64_t max_size, enum u_sink_queue_drop_policy policy, uint64_t count)
+{
+	struct xrt_frame_context xfctx = {};
+	RecordingSink sink;
+	struct xrt_frame_sink *queue = NULL;
+
+	REQUIRE(u_sink_queue_create_with_drop_policy(&xfctx, max_size, policy, &sink.base, &queue));
+
+	// First frame gets stuck in the consumer, everything else is queued.
+	push_sequence(queue, 0);
+	sink.wait_for(1);
+	for (uint64_t i = 1; i < count; i++) {
+		push_sequence(queue, i);
+	}
+	sink.release();
+
+	uint64_t expected = max_size == 0 ? count : std::min(count, max_size + 1);
+	sink.wait_for(expected);
+
+	xrt_frame_context_destroy_nodes(&xfctx);
+
+	return sink.received;
+}
+
+} // namespace
+
+
+TEST_CASE("u_sink_queue")
+{
+	SECTION("unbounded keeps everything")
+	{
+		// More than the initial ring capacity, so it has to grow.
+		auto received = run_queue(0, U_SINK_QUEUE_DROP_NEWEST, 40);
+		REQUIRE(received.size() == 40);
+		for (uint64_t i = 0; i < 40; i++) {
+			CHECK(received[i] == i);
+		}
+	}
+
+	SECTION("bounded drop newest")
+	{
+		auto received = run_queue(2, U_SINK_QUEUE_DROP_NEWEST, 6);
+		CHECK(received == std::vector<uint64_t>{0, 1, 2});
+	}
+
+	SECTION("bounded drop oldest")
+	{
+		auto received = run_queue(2, U_SINK_QUEUE_DROP_OLDEST, 6);
+		CHECK(received == std::vector<uint64_t>{0, 4, 5});
+	}
+}
@@ -0,0 +1,135 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Space overseer tests.
+ */
+
+#include <xrt/xrt_device.h>
+#include <xrt/xrt_space.h>
+#include <math/m_api.h>
+#include <util/u_space_overseer.h>
+
+#include "catch/catch.hpp"
+
+#include <cstdlib>
+
+
+namespace {
+
+struct FakeDevice
+{
+	struct xrt_device base = {};
+	uint32_t pose_calls = 0;
+
+	FakeDevice()
+	{
+		base.get_tracked_pose = get_tracked_pose;
+	}
+
+	static void
+	get_tracked_pose(struct xrt_device *xdev,
+	                 enum xrt_input_name name,
+	                 uint64_t at_timestamp_ns,
+	                 struct xrt_space_relation *out_relation)
+	{
+		auto *self = reinterpret_cast<FakeDevice *>(xdev);
+		self->pose_calls++;
+
+		*out_relation = XRT_SPACE_RELATION_ZERO;
+		out_relation->relation_flags = (enum xrt_space_relation_flags)( //
+		    XRT_SPACE_RELATION_ORIENTATION_VALID_BIT |                 //
+		    XRT_SPACE_RELATION_ORIENTATION_TRACKED_BIT |               //
+		    XRT_SPACE_RELATION_POSITION_VALID_BIT |                    //
+		    XRT_SPACE_RELATION_POSITION_TRACKED_BIT);                  //
+		out_relation->pose.position = {1.0f, 2.0f, (float)(at_timestamp_ns % 7)};
+		struct xrt_vec3 axis = {0.0f, 1.0f, 0.0f};
+		math_quat_from_angle_vector(0.5f, &axis, &out_relation->pose.orientation);
+	}
+};
+
+//! Long enough that the memoised device poses never expire during a test.
+void
+set_long_memo_age()
+{
+	setenv("XRT_SPACE_POSE_MEMO_MS", "60000", 1);
+}
+
+xrt_pose
+make_pose(float x, float angle)
+{
+	xrt_pose pose = XRT_POSE_IDENTITY;
+	pose.position.x = x;
+	struct xrt_vec3 axis = {1.0f, 0.0f, 0.0f};
+	math_quat_from_angle_vector(angle, &axis, &pose.orientation);
+	return pose;
+}
+
+} // namespace
+
+
+TEST_CASE("u_space_overseer_pose_memo")
+{
+	set_long_memo_age();
+
+	struct u_space_overseer *uso = u_space_overseer_create(nullptr);
+	struct xrt_space_overseer *xso = (struct xrt_space_overseer *)uso;
+	struct xrt_space *root = xso->semantic.root;
+
+	FakeDevice dev;
+	u_space_overseer_link_space_to_device(uso, root, &dev.base);
+
+	// Many spaces of a few apps, all in the same device pose.
+	constexpr uint32_t kCount = 12;
+	struct xrt_space *spaces[kCount] = {};
+	for (uint32_t i = 0; i < kCount; i++) {
+		struct xrt_space *pose_space = nullptr;
+		REQUIRE(u_space_overseer_create_pose_space(uso, &dev.base, XRT_INPUT_GENERIC_HEAD_POSE, &pose_space) ==
+		        XRT_SUCCESS);
+		xrt_pose offset = make_pose((float)i, 0.1f * (float)i);
+		REQUIRE(u_space_overseer_create_offset_space(uso, pose_space, &offset, &spaces[i]) == XRT_SUCCESS);
+		xrt_space_reference(&pose_space, nullptr);
+	}
+
+	xrt_pose ident = XRT_POSE_IDENTITY;
+	auto locate_all = [&](uint64_t at_ns, xrt_space_relation *out) {
+		for (uint32_t i = 0; i < kCount; i++) {
+			REQUIRE(xrt_space_overseer_locate_space(xso, root, &ident, at_ns, spaces[i], &ident, &out[i]) ==
+			        XRT_SUCCESS);
+		}
+	};
+
+	// One device query for the whole frame.
+	xrt_space_relation first[kCount] = {};
+	locate_all(1000, first);
+	CHECK(dev.pose_calls == 1);
+
+	// Memoised result is the same as a fresh one.
+	xrt_space_relation again[kCount] = {};
+	locate_all(1000, again);
+	CHECK(dev.pose_calls == 1);
+	bool same = true;
+	for (uint32_t i = 0; i < kCount; i++) {
+		same = same && first[i].relation_flags == again[i].relation_flags &&
+		       first[i].pose.position.x == again[i].pose.position.x &&
+		       first[i].pose.position.z == again[i].pose.position.z &&
+		       first[i].pose.orientation.w == again[i].pose.orientation.w;
+	}
+	CHECK(same);
+
+	// New timestamp, new query.
+	xrt_space_relation next[kCount] = {};
+	locate_all(1001, next);
+	CHECK(dev.pose_calls == 2);
+	CHECK(next[0].pose.position.z != Approx(first[0].pose.position.z));
+
+	// Changing the graph drops the memo.
+	u_space_overseer_link_space_to_device(uso, root, &dev.base);
+	locate_all(1001, next);
+	CHECK(dev.pose_calls == 3);
+
+	for (auto &space : spaces) {
+		xrt_space_reference(&space, nullptr);
+	}
+	xrt_space_overseer_destroy(&xso);
+}
@@ -0,0 +1,82 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief Trajectory error tests.
+ */
+
+#include <math/m_trajectory.h>
+
+#include "catch/catch.hpp"
+
+#include <cmath>
+#include <vector>
+
+
+namespace {
+
+//! Positions along a curve that is not planar, so the alignment is unique.
+std::vector<xrt_vec3_f64>
+make_reference(size_t count)
+{
+	std::vector<xrt_vec3_f64> out(count);
+	for (size_t i = 0; i < count; i++) {
+		double t = (double)i * 0.05;
+		out[i] = {std::cos(t) * 2.0, std::sin(t * 1.3), t * 0.1};
+	}
+	return out;
+}
+
+//! Rotated about z and y, then translated.
+xrt_vec3_f64
+transform(const xrt_vec3_f64 &p)
+{
+	const double a = 0.7;
+	const double b = -0.4;
+	double x = std::cos(a) * p.x - std::sin(a) * p.y;
+	double y = std::sin(a) * p.x + std::cos(a) * p.y;
+	double z = p.z;
+	double x2 = std::cos(b) * x + std::sin(b) * z;
+	double z2 = -std::sin(b) * x + std::cos(b) * z;
+	return {x2 + 3.0, y - 1.0, z2 + 0.5};
+}
+
+} // namespace
+
+
+TEST_CASE("m_trajectory_ate_rmse")
+{
+	std::vector<xrt_vec3_f64> ref = make_reference(200);
+	std::vector<xrt_vec3_f64> est(ref.size());
+
+	SECTION("rigidly moved trajectory has no error")
+	{
+		for (size_t i = 0; i < ref.size(); i++) {
+			est[i] = transform(ref[i]);
+		}
+
+		double rmse = -1;
+		REQUIRE(m_trajectory_ate_rmse(est.data(), ref.data(), ref.size(), &rmse));
+		CHECK(rmse < 1e-9);
+	}
+
+	SECTION("offsets that can't be aligned away are the error")
+	{
+		// Alternating along z around the curve, the mean offset is zero.
+		for (size_t i = 0; i < ref.size(); i++) {
+			xrt_vec3_f64 p = ref[i];
+			p.z += i % 2 == 0 ? 0.01 : -0.01;
+			est[i] = transform(p);
+		}
+
+		double rmse = -1;
+		REQUIRE(m_trajectory_ate_rmse(est.data(), ref.data(), ref.size(), &rmse));
+		CHECK(rmse == Approx(0.01).epsilon(0.05));
+	}
+
+	SECTION("too few positions")
+	{
+		double rmse = -1;
+		CHECK_FALSE(m_trajectory_ate_rmse(est.data(), ref.data(), 2, &rmse));
+	}
+}
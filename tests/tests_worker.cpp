@@ -10,8 +10,11 @@
 
 #include "catch/catch.hpp"
 
-#include <thread>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <iostream>
+#include <thread>
 
 using namespace std::chrono_literals;
 
@@ -130,3 +133,120 @@ TEST_CASE("TaskCollection")
 		CHECK(calledA[2]);
 	}
 }
+
+TEST_CASE("u_worker_group many tasks")
+{
+	SharedThreadPool pool{2, 3, "Test"};
+	SharedThreadGroup groupA{pool};
+	SharedThreadGroup groupB{pool};
+
+	std::atomic<uint32_t> counter{0};
+	std::vector<TaskCollection::Functor> funcs(16, [&] { counter++; });
+
+	for (int i = 0; i < 100; i++) {
+		TaskCollection collectionA{groupA, funcs};
+		TaskCollection collectionB{groupB, funcs};
+	}
+
+	CHECK(counter.load() == 100 * 16 * 2);
+}
+
+static void
+increment(void *ptr)
+{
+	static_cast<std::atomic<uint32_t> *>(ptr)->fetch_add(1);
+}
+
+TEST_CASE("u_worker_group destroyed right after wait")
+{
+	u_worker_thread_pool *uwtp = u_worker_thread_pool_create(2, 3, "Test");
+	std::atomic<uint32_t> counter{0};
+
+	// The last task must be done with the group before the wait returns, run under ASan or Valgrind.
+	for (int i = 0; i < 2000; i++) {
+		u_worker_group *uwg = u_worker_group_create(uwtp);
+		for (int k = 0; k < 3; k++) {
+			u_worker_group_push(uwg, increment, &counter);
+		}
+		u_worker_group_wait_all(uwg);
+		u_worker_group_reference(&uwg, NULL);
+	}
+
+	CHECK(counter.load() == 2000 * 3);
+
+	u_worker_thread_pool_reference(&uwtp, NULL);
+}
+
+
+/*
+ *
+ * Benchmarks, run with: tests_worker "[benchmark]"
+ *
+ */
+
+static void
+bench_increment(void *ptr)
+{
+	static_cast<std::atomic<uint64_t> *>(ptr)->fetch_add(1, std::memory_order_relaxed);
+}
+
+TEST_CASE("u_worker_throughput", "[.][benchmark]")
+{
+	constexpr uint32_t kBatch = 32;
+	constexpr uint32_t kRounds = 20000;
+
+	u_worker_thread_pool *uwtp = u_worker_thread_pool_create(3, 4, "Bench");
+	u_worker_group *uwg = u_worker_group_create(uwtp);
+
+	std::atomic<uint64_t> counter{0};
+
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t r = 0; r < kRounds; r++) {
+		for (uint32_t i = 0; i < kBatch; i++) {
+			u_worker_group_push(uwg, bench_increment, &counter);
+		}
+		u_worker_group_wait_all(uwg);
+	}
+	auto dur = std::chrono::steady_clock::now() - start;
+	double s = std::chrono::duration<double>(dur).count();
+
+	CHECK(counter.load() == uint64_t(kBatch) * kRounds);
+	std::cout << "throughput: " << counter.load() << " tasks in " << s << "s, " << (counter.load() / s)
+	          << " tasks/s" << std::endl;
+
+	u_worker_group_reference(&uwg, NULL);
+	u_worker_thread_pool_reference(&uwtp, NULL);
+}
+
+TEST_CASE("u_worker_wait_latency", "[.][benchmark]")
+{
+	constexpr uint32_t kRounds = 20000;
+
+	u_worker_thread_pool *uwtp = u_worker_thread_pool_create(3, 4, "Bench");
+	u_worker_group *uwg = u_worker_group_create(uwtp);
+
+	std::atomic<uint64_t> counter{0};
+	std::vector<uint64_t> samples;
+	samples.reserve(kRounds);
+
+	for (uint32_t r = 0; r < kRounds; r++) {
+		auto start = std::chrono::steady_clock::now();
+		u_worker_group_push(uwg, bench_increment, &counter);
+		u_worker_group_wait_all(uwg);
+		auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+		samples.push_back(ns.count());
+	}
+
+	std::sort(samples.begin(), samples.end());
+	uint64_t total = 0;
+	for (uint64_t ns : samples) {
+		total += ns;
+	}
+
+	CHECK(counter.load() == kRounds);
+	std::cout << "push + wait_all latency: mean " << total / kRounds << "ns, p50 " << samples[kRounds / 2]
+	          << "ns, p99 " << samples[kRounds * 99 / 100] << "ns" << std::endl;
+
+	u_worker_group_reference(&uwg, NULL);
+	u_worker_thread_pool_reference(&uwtp, NULL);
+}
@@ -0,0 +1,231 @@
+// Copyright 2024, Collabora, Ltd.
+// SPDX-License-Identifier: BSL-1.0
+/*!
+ * @file
+ * @brief YUV to RGB conversion kernel tests and benchmark.
+ */
+
+#include <util/u_yuv_convert.h>
+#include <os/os_time.h>
+
+#include "catch/catch.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+
+namespace {
+
+//! The formula the old lookup table in u_sink_converter.c was generated from.
+uint32_t
+reference_YUV444_to_RGBX8888(int y, int u, int v)
+{
+	auto clamp_to_byte = [](int x) { return x < 0 ? 0 : x >= 255 ? 255 : x; };
+
+	int C = y - 16;
+	int D = u - 128;
+	int E = v - 128;
+
+	int R = clamp_to_byte((298 * C + 409 * E + 128) >> 8);
+	int G = clamp_to_byte((298 * C - 100 * D - 209 * E + 128) >> 8);
+	int B = clamp_to_byte((298 * C + 516 * D + 128) >> 8);
+
+	return B << 16 | G << 8 | R;
+}
+
+void
+reference_pixel(int y, int u, int v, uint8_t *dst)
+{
+	uint32_t rgbx = reference_YUV444_to_RGBX8888(y, u, v);
+	dst[0] = rgbx & 0xff;
+	dst[1] = (rgbx >> 8) & 0xff;
+	dst[2] = (rgbx >> 16) & 0xff;
+}
+
+std::vector<u_yuv_convert_impl>
+supported_impls()
+{
+	std::vector<u_yuv_convert_impl> impls;
+	for (int i = 0; i < U_YUV_CONVERT_IMPL_COUNT; i++) {
+		if (u_yuv_convert_impl_supported((u_yuv_convert_impl)i)) {
+			impls.push_back((u_yuv_convert_impl)i);
+		}
+	}
+	return impls;
+}
+
+using convert_func = void (*)(u_yuv_convert_impl, const uint8_t *, uint8_t *, uint32_t);
+
+constexpr uint8_t kGuard = 0xa5;
+constexpr size_t kGuardSize = 64;
+
+} // namespace
+
+
+TEST_CASE("u_yuv_convert_yuv888_exhaustive")
+{
+	// Every possible YUV triple, one row of 256 V values per Y and U.
+	std::vector<uint8_t> src(256 * 3);
+	std::vector<uint8_t> expected(256 * 3);
+	std::vector<uint8_t> dst(256 * 3 + kGuardSize);
+
+	for (u_yuv_convert_impl impl : supported_impls()) {
+		CAPTURE(u_yuv_convert_impl_str(impl));
+		size_t mismatches = 0;
+
+		for (int y = 0; y < 256; y++) {
+			for (int u = 0; u < 256; u++) {
+				for (int v = 0; v < 256; v++) {
+					src[v * 3 + 0] = (uint8_t)y;
+					src[v * 3 + 1] = (uint8_t)u;
+					src[v * 3 + 2] = (uint8_t)v;
+					reference_pixel(y, u, v, &expected[v * 3]);
+				}
+
+				std::fill(dst.begin(), dst.end(), kGuard);
+				u_yuv_convert_yuv888_to_r8g8b8(impl, src.data(), dst.data(), 256);
+				if (memcmp(dst.data(), expected.data(), expected.size()) != 0) {
+					mismatches++;
+				}
+			}
+		}
+
+		CHECK(mismatches == 0);
+	}
+}
+
+TEST_CASE("u_yuv_convert_422")
+{
+	struct Case
+	{
+		const char *name;
+		convert_func func;
+		int y0, u, y1, v; //!< Byte offsets in a pixel pair
+	};
+	const Case cases[] = {
+	    {"yuyv", u_yuv_convert_yuyv422_to_r8g8b8, 0, 1, 2, 3},
+	    {"uyvy", u_yuv_convert_uyvy422_to_r8g8b8, 1, 0, 3, 2},
+	};
+
+	std::mt19937 rng(1234);
+
+	for (const Case &c : cases) {
+		for (u_yuv_convert_impl impl : supported_impls()) {
+			// Odd widths and widths around the SIMD block sizes.
+			for (uint32_t width = 1; width <= 70; width++) {
+				CAPTURE(c.name, u_yuv_convert_impl_str(impl), width);
+
+				uint32_t pairs = (width + 1) / 2;
+				std::vector<uint8_t> src(pairs * 4);
+				for (uint8_t &b : src) {
+					b = (uint8_t)rng();
+				}
+
+				std::vector<uint8_t> expected(pairs * 6);
+				for (uint32_t p = 0; p < pairs; p++) {
+					const uint8_t *s = &src[p * 4];
+					reference_pixel(s[c.y0], s[c.u], s[c.v], &expected[p * 6]);
+					reference_pixel(s[c.y1], s[c.u], s[c.v], &expected[p * 6 + 3]);
+				}
+
+				std::vector<uint8_t> dst(expected.size() + kGuardSize, kGuard);
+				c.func(impl, src.data(), dst.data(), width);
+
+				CHECK(memcmp(dst.data(), expected.data(), expected.size()) == 0);
+				for (size_t i = expected.size(); i < dst.size(); i++) {
+					CHECK(dst[i] == kGuard);
+				}
+			}
+		}
+	}
+}
+
+TEST_CASE("u_yuv_convert_yuv888_widths")
+{
+	std::mt19937 rng(4321);
+
+	for (u_yuv_convert_impl impl : supported_impls()) {
+		for (uint32_t width = 1; width <= 40; width++) {
+			CAPTURE(u_yuv_convert_impl_str(impl), width);
+
+			std::vector<uint8_t> src(width * 3);
+			std::vector<uint8_t> expected(width * 3);
+			for (uint8_t &b : src) {
+				b = (uint8_t)rng();
+			}
+			for (uint32_t x = 0; x < width; x++) {
+				reference_pixel(src[x * 3], src[x * 3 + 1], src[x * 3 + 2], &expected[x * 3]);
+			}
+
+			std::vector<uint8_t> dst(expected.size() + kGuardSize, kGuard);
+			u_yuv_convert_yuv888_to_r8g8b8(impl, src.data(), dst.data(), width);
+
+			CHECK(memcmp(dst.data(), expected.data(), expected.size()) == 0);
+			for (size_t i = expected.size(); i < dst.size(); i++) {
+				CHECK(dst[i] == kGuard);
+			}
+		}
+	}
+}
+
+
+/*
+ *
+ * Benchmark, run with: tests_yuv_convert "[benchmark]"
+ *
+ */
+
+TEST_CASE("u_yuv_convert_throughput", "[.][benchmark]")
+{
+	struct Format
+	{
+		const char *name;
+		convert_func func;
+		uint32_t bytes_per_pixel_x2;
+	};
+	const Format formats[] = {
+	    {"yuyv422", u_yuv_convert_yuyv422_to_r8g8b8, 4},
+	    {"uyvy422", u_yuv_convert_uyvy422_to_r8g8b8, 4},
+	    {"yuv888 ", u_yuv_convert_yuv888_to_r8g8b8, 6},
+	};
+
+	// PSEye and PSVR camera sizes.
+	const uint32_t sizes[][2] = {{640, 480}, {1748, 408}};
+
+	std::mt19937 rng(42);
+
+	for (const auto &size : sizes) {
+		uint32_t w = size[0];
+		uint32_t h = size[1];
+		std::vector<uint8_t> src(w * h * 3);
+		std::vector<uint8_t> dst(w * h * 3);
+		for (uint8_t &b : src) {
+			b = (uint8_t)rng();
+		}
+
+		for (const Format &f : formats) {
+			size_t src_stride = w * f.bytes_per_pixel_x2 / 2;
+			double scalar_ns = 0;
+
+			for (u_yuv_convert_impl impl : supported_impls()) {
+				constexpr int kIterations = 50;
+				uint64_t start = os_monotonic_get_ns();
+				for (int i = 0; i < kIterations; i++) {
+					for (uint32_t y = 0; y < h; y++) {
+						f.func(impl, &src[y * src_stride], &dst[y * w * 3], w);
+					}
+				}
+				double ns = (double)(os_monotonic_get_ns() - start) / kIterations;
+				if (impl == U_YUV_CONVERT_IMPL_SCALAR) {
+					scalar_ns = ns;
+				}
+
+				std::cout << f.name << " " << w << "x" << h << " " << u_yuv_convert_impl_str(impl)
+				          << ": " << ns / 1000.0 << "us per frame, " << (w * h) / (ns / 1000.0)
+				          << " MPix/s, " << scalar_ns / ns << "x scalar" << std::endl;
+			}
+		}
+	}
+}